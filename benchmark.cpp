@@ -0,0 +1,284 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <QFile>
+#include <QDir>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <functional>
+#include <algorithm>
+
+#include "benchmark.h"
+#include "zkanjimain.h"
+#include "words.h"
+#include "grammar.h"
+#include "kanjistrokes.h"
+#include "sentences.h"
+
+#include "checked_cast.h"
+
+extern char ZKANJI_PROGRAM_VERSION[];
+
+
+//-------------------------------------------------------------
+
+
+namespace
+{
+    // Returns the value at percent of the sorted samples, using the nearest rank.
+    qint64 percentile(const std::vector<qint64> &samples, int percent)
+    {
+        int rank = std::max<int>(1, (tosigned(samples.size()) * percent + 99) / 100);
+        return samples[std::min<int>(rank, tosigned(samples.size())) - 1];
+    }
+
+    // Parses the stroke data of a recognize line.
+    bool parseStrokes(const QString &str, StrokeList &strokes)
+    {
+        QStringList parts = str.split(';', QString::SkipEmptyParts);
+        for (const QString &part : parts)
+        {
+            Stroke s;
+            QStringList points = part.split(' ', QString::SkipEmptyParts);
+            for (const QString &p : points)
+            {
+                int pos = p.indexOf(',');
+                bool ok1 = false;
+                bool ok2 = false;
+                double x = pos == -1 ? 0 : p.left(pos).toDouble(&ok1);
+                double y = pos == -1 ? 0 : p.mid(pos + 1).toDouble(&ok2);
+                if (!ok1 || !ok2)
+                    return false;
+                s.add(QPointF(x, y));
+            }
+            if (s.empty())
+                return false;
+            strokes.add(std::move(s));
+        }
+        return !strokes.empty();
+    }
+}
+
+int runBenchmark(const QString &workloadfile, const QString &outfile)
+{
+    QTextStream err(stderr);
+
+    QFile f(workloadfile);
+    if (!f.open(QIODevice::ReadOnly | QIODevice::Text))
+    {
+        err << "Couldn't open workload file: " << workloadfile << endl;
+        return 1;
+    }
+
+    QTextStream stream(&f);
+    stream.setCodec("UTF-8");
+
+    int repeat = 10;
+    Dictionary *dict = ZKanji::dictionary(0);
+
+    QJsonArray results;
+
+    int linenum = 0;
+    while (!stream.atEnd())
+    {
+        QString line = stream.readLine().trimmed();
+        ++linenum;
+
+        if (line.isEmpty() || line.at(0) == '#')
+            continue;
+
+        int pos = line.indexOf(' ');
+        QString cmd = pos == -1 ? line : line.left(pos);
+        QString args = pos == -1 ? QString() : line.mid(pos + 1).trimmed();
+
+        if (cmd == "repeat")
+        {
+            bool ok;
+            repeat = args.toInt(&ok);
+            if (!ok || repeat < 1)
+            {
+                err << "Invalid repeat count in line " << linenum << endl;
+                return 1;
+            }
+            continue;
+        }
+
+        if (cmd == "dictionary")
+        {
+            int index = ZKanji::dictionaryIndex(args);
+            if (index == -1)
+            {
+                err << "Dictionary not found in line " << linenum << endl;
+                return 1;
+            }
+            dict = ZKanji::dictionary(index);
+            continue;
+        }
+
+        // The workload to measure. Returns the number of results, or -1 on error.
+        std::function<int()> work;
+
+        // Data used by the workloads.
+        std::vector<int> found;
+        StrokeList strokes;
+
+        if (cmd == "load")
+        {
+            QString path = QDir::isAbsolutePath(args) ? args : ZKanji::userFolder() + "/data/" + args;
+            work = [path]() {
+                Dictionary d;
+                try
+                {
+                    d.loadFile(path, false, false);
+                }
+                catch (...)
+                {
+                    return -1;
+                }
+                return d.entryCount();
+            };
+        }
+        else if (cmd == "find")
+        {
+            QStringList parts = args.split(' ', QString::SkipEmptyParts);
+            SearchMode mode = SearchMode::Japanese;
+            SearchWildcards wildcards = SearchWildcard::AnyAfter;
+            bool inflections = false;
+            while (!parts.isEmpty() && (parts.front() == "jp" || parts.front() == "def" || parts.front() == "-x" || parts.front() == "-i"))
+            {
+                if (parts.front() == "def")
+                    mode = SearchMode::Definition;
+                else if (parts.front() == "-x")
+                    wildcards = 0;
+                else if (parts.front() == "-i")
+                    inflections = true;
+                parts.pop_front();
+            }
+            QString search = parts.join(' ');
+            work = [dict, mode, wildcards, inflections, search]() {
+                WordResultList result(dict);
+                dict->findWords(result, mode, search, wildcards, false, inflections, false, nullptr, nullptr);
+                return tosigned(result.size());
+            };
+        }
+        else if (cmd == "deinflect")
+        {
+            work = [args]() {
+                smartvector<InflectionForm> forms;
+                deinflect(args, forms);
+                return tosigned(forms.size());
+            };
+        }
+        else if (cmd == "rebuild" && (args == "kana" || args == "def"))
+        {
+            bool kana = args == "kana";
+            work = [dict, kana]() {
+                TextSearchTree tree(dict, kana, false);
+                for (int ix = 0, siz = dict->entryCount(); ix != siz; ++ix)
+                    tree.expandWith(ix);
+                return dict->entryCount();
+            };
+        }
+        else if (cmd == "recognize")
+        {
+            if (!parseStrokes(args, strokes))
+            {
+                err << "Invalid stroke data in line " << linenum << endl;
+                return 1;
+            }
+            work = [&strokes, &found]() {
+                found.clear();
+                ZKanji::elements()->findCandidates(strokes, found);
+                return tosigned(found.size());
+            };
+        }
+        else if (cmd == "sentence")
+        {
+            QStringList parts = args.split(' ', QString::SkipEmptyParts);
+            bool ok1 = false;
+            bool ok2 = false;
+            int block = parts.size() == 2 ? parts.at(0).toInt(&ok1) : 0;
+            int sline = parts.size() == 2 ? parts.at(1).toInt(&ok2) : 0;
+            if (!ok1 || !ok2 || block < 0 || block > 0xffff || sline < 0 || sline > 0xff || !ZKanji::sentences.isLoaded())
+            {
+                err << "Invalid sentence in line " << linenum << endl;
+                return 1;
+            }
+            work = [block, sline]() {
+                ExampleSentenceData data = ZKanji::sentences.getSentence(block, sline);
+                return data.japanese.size();
+            };
+        }
+        else
+        {
+            err << "Unknown workload in line " << linenum << endl;
+            return 1;
+        }
+
+        std::vector<qint64> samples;
+        samples.reserve(repeat);
+        int count = 0;
+        QElapsedTimer timer;
+        for (int ix = 0; ix != repeat; ++ix)
+        {
+            timer.start();
+            count = work();
+            samples.push_back(timer.nsecsElapsed() / 1000);
+
+            if (count == -1)
+            {
+                err << "Workload failed in line " << linenum << endl;
+                return 1;
+            }
+        }
+
+        std::sort(samples.begin(), samples.end());
+        qint64 sum = 0;
+        for (qint64 s : samples)
+            sum += s;
+
+        QJsonObject obj;
+        obj["line"] = linenum;
+        obj["workload"] = cmd;
+        obj["arguments"] = args;
+        obj["results"] = count;
+        obj["runs"] = repeat;
+        obj["min"] = (double)samples.front();
+        obj["p50"] = (double)percentile(samples, 50);
+        obj["p90"] = (double)percentile(samples, 90);
+        obj["p99"] = (double)percentile(samples, 99);
+        obj["max"] = (double)samples.back();
+        obj["mean"] = (double)sum / repeat;
+        results.append(obj);
+    }
+
+    QJsonObject root;
+    root["version"] = QString::fromLatin1(ZKANJI_PROGRAM_VERSION);
+    root["workloads"] = results;
+    QByteArray json = QJsonDocument(root).toJson();
+
+    if (outfile.isEmpty())
+    {
+        QTextStream out(stdout);
+        out << json;
+        return 0;
+    }
+
+    QFile o(outfile);
+    if (!o.open(QIODevice::WriteOnly) || o.write(json) != json.size())
+    {
+        err << "Couldn't write output file: " << outfile << endl;
+        return 1;
+    }
+    return 0;
+}
+
+
+//-------------------------------------------------------------
+
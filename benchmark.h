@@ -0,0 +1,37 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+class QString;
+
+// Runs the timed workloads listed in the workload file on the loaded data, and writes the
+// timing of each workload line to outfile, or to the standard output if outfile is empty.
+// Returns the exit code of the program.
+//
+// Workload file format: UTF-8 text with a single workload on each line. Empty lines and
+// lines starting with # are skipped. Every workload is run as many times as the last repeat
+// line specified (10 by default), and the duration of each run is measured separately.
+//  repeat [count]
+//  dictionary [name]       Selects the dictionary used by the following lines. The main
+//                          dictionary is used at the start.
+//  load [file]             Loads a dictionary file into a temporary dictionary. Relative
+//                          paths are in the user data folder.
+//  find [jp|def] [-x] [-i] [text]
+//                          Word search with the Japanese text or in definitions. Use -x for
+//                          exact matches and -i to include inflected forms.
+//  deinflect [text]        Lists the possible deinflected forms of text.
+//  rebuild [kana|def]      Builds a new search tree of the dictionary, adding every word.
+//  recognize [strokes]     Handwriting recognition of the strokes. The strokes are separated
+//                          by ;, and each stroke is a list of x,y points separated by spaces.
+//  sentence [block] [line] Reads an example sentence, decompressing its block.
+//
+// The output is JSON with an object for each workload line. Durations are in microseconds.
+int runBenchmark(const QString &workloadfile, const QString &outfile);
+
+
+#endif // BENCHMARK_H
@@ -5,6 +5,8 @@
 **/
 
 #include <set>
+#include <algorithm>
+#include <iterator>
 #include "collectwordsform.h"
 #include "ui_collectwordsform.h"
 #include "globalui.h"
@@ -558,24 +560,20 @@ void CollectWordsForm::on_generateButton_clicked()
     //int minjlpt = ui->jlptMinCBox->currentIndex() == 0 ? 6 : 6 - ui->jlptMinCBox->currentIndex();
     //int maxjlpt = ui->jlptMaxCBox->currentIndex() == 0 ? -1 : 6 - ui->jlptMaxCBox->currentIndex();
 
-    // [kanji index, <checked readings, placement in word>]
-    std::map<ushort, std::pair<ushort, KanjiPlacement>> listkanji;
+    // Kanji with at least one reading checked, marked by their character code.
+    std::vector<uchar> listkanji(0x10000, 0);
     bool checkkanji = false;
     bool needfuri = false;
 
     for (int ix = 0, siz = tosigned(kanji.size()); ix != siz; ++ix)
     {
-
-        ushort kindex = kanji[ix];
-        ushort reading = readings[ix];
         // Kanji with no reading checked should be skipped.
-        if (reading == 0)
+        if (readings[ix] == 0)
             continue;
-        KanjiPlacement place = placement[ix];
-        listkanji[ZKanji::kanjis[kindex]->ch.unicode()] = std::make_pair(reading, place);
-        if (place != KanjiPlacement::Anywhere || reading != 0xffff)
+        listkanji[ZKanji::kanjis[kanji[ix]]->ch.unicode()] = 1;
+        if (placement[ix] != KanjiPlacement::Anywhere || readings[ix] != 0xffff)
             checkkanji = true;
-        if (reading != 0xffff)
+        if (readings[ix] != 0xffff)
             needfuri = true;
     }
 
@@ -587,67 +585,82 @@ void CollectWordsForm::on_generateButton_clicked()
         if (tosigned(e->freq) < minfreq || (maxklen > 0 && tosigned(e->kana.size()) > maxklen) /*||
             ((minjlpt != 6 || maxjlpt != -1) && ((cm = ZKanji::commons.findWord(e->kanji.data(), e->kana.data(), e->romaji.data())) == nullptr || cm->jlptn < maxjlpt || cm->jlptn > minjlpt))*/)
             words[ix] = -1;
-        else if (limit || maxkanji != -1 || checkkanji)
+        else if (limit || maxkanji != -1 || minkanji != 0)
         {
             int kanjicnt = 0;
-            bool kanjifound = !checkkanji;
-
-            std::vector<FuriganaData> furi;
-                
             for (int iy = 0, siz2 = e->kanji.size(); iy != siz2; ++iy)
             {
-                if (KANJI(e->kanji[iy].unicode()))
+                if (!KANJI(e->kanji[iy].unicode()))
+                    continue;
+
+                ++kanjicnt;
+                if ((maxkanji != -1 && kanjicnt > maxkanji) || (limit && listkanji[e->kanji[iy].unicode()] == 0))
                 {
-                    ++kanjicnt;
-
-                    std::map<ushort, std::pair<ushort, KanjiPlacement>>::iterator it;
-                    if ((maxkanji != -1 && (/*kanjicnt < minkanji ||*/ kanjicnt > maxkanji)) || (limit && ((it = listkanji.find(e->kanji[iy].unicode())) == listkanji.end() || it->second.first == 0)))
-                    {
-                        words[ix] = -1;
-                        break;
-                    }
-                    else if (!limit)
-                        it = listkanji.find(e->kanji[iy].unicode());
-
-                    if (!checkkanji || it == listkanji.end() || it->second.first == 0)
-                        continue;
-
-                    bool goodplace = (it->second.second == KanjiPlacement::Anywhere ||
-                        (iy == 0 && (it->second.second == KanjiPlacement::Front || it->second.second == KanjiPlacement::FrontEnd || it->second.second == KanjiPlacement::FrontMiddle)) ||
-                        (iy == siz2 - 1 && (it->second.second == KanjiPlacement::End || it->second.second == KanjiPlacement::FrontEnd || it->second.second == KanjiPlacement::MiddleEnd)) ||
-                        (iy != 0 && iy != siz2 - 1 && (it->second.second == KanjiPlacement::FrontMiddle || it->second.second == KanjiPlacement::MiddleEnd || it->second.second == KanjiPlacement::Middle)));
-                    if (!goodplace && strict)
-                    {
-                        words[ix] = -1;
-                        break;
-                    }
-
-                    bool goodfuri = !needfuri;
-                    if (needfuri)
-                    {
-                        if (furi.empty())
-                            findFurigana(e->kanji, e->kana, furi);
-
-                        int r = findKanjiReading(e->kanji, e->kana, iy, nullptr, &furi);
-                        if ((it->second.first & (1 << r)) != 0)
-                            goodfuri = true;
-                    }
-                    if (!goodfuri && strict)
-                    {
-                        words[ix] = -1;
-                        break;
-                    }
-
-                    if (goodfuri && goodplace)
-                        kanjifound = true;
+                    words[ix] = -1;
+                    break;
                 }
             }
-            if (!kanjifound || kanjicnt < minkanji)
+            if (kanjicnt < minkanji)
                 words[ix] = -1;
         }
     }
 
     words.resize(std::remove(words.begin(), words.end(), -1) - words.begin());
+
+    if (checkkanji && !words.empty())
+    {
+        // Words that contain a checked kanji with a correct reading at a correct position,
+        // and in strict mode, words where any checked kanji has a wrong reading or position.
+        std::vector<int> good;
+        std::vector<int> bad;
+
+        // Returns the bits of KanjiReadingIndex::Position values allowed by a placement.
+        // Single kanji words match both front and end placements.
+        auto placementPositions = [](KanjiPlacement p) {
+            const int front = 1 << (int)KanjiReadingIndex::Position::Front;
+            const int middle = 1 << (int)KanjiReadingIndex::Position::Middle;
+            const int end = 1 << (int)KanjiReadingIndex::Position::End;
+            const int whole = 1 << (int)KanjiReadingIndex::Position::Whole;
+            switch (p)
+            {
+            case KanjiPlacement::Front:
+                return front | whole;
+            case KanjiPlacement::Middle:
+                return middle;
+            case KanjiPlacement::End:
+                return end | whole;
+            case KanjiPlacement::FrontEnd:
+                return front | end | whole;
+            case KanjiPlacement::FrontMiddle:
+                return front | middle | whole;
+            case KanjiPlacement::MiddleEnd:
+                return middle | end | whole;
+            default:
+                return front | middle | end | whole;
+            }
+        };
+
+        const KanjiReadingIndex &index = dict->kanjiReadingIndex();
+        for (int ix = 0, siz = tosigned(kanji.size()); ix != siz; ++ix)
+        {
+            if (readings[ix] == 0)
+                continue;
+
+            int rmask = needfuri ? readings[ix] : -1;
+            int pmask = placementPositions(placement[ix]);
+
+            index.collect(kanji[ix], rmask, pmask, good);
+            if (strict)
+                index.collect(kanji[ix], rmask, pmask, bad, true);
+        }
+
+        std::vector<int> tmp;
+        tmp.reserve(words.size());
+        std::set_intersection(words.begin(), words.end(), good.begin(), good.end(), std::back_inserter(tmp));
+        words.clear();
+        std::set_difference(tmp.begin(), tmp.end(), bad.begin(), bad.end(), std::back_inserter(words));
+    }
+
     if (wmodel != nullptr)
         wmodel->deleteLater();
 
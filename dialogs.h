@@ -11,6 +11,7 @@
 
 class Dictionary;
 class QWidget;
+class QString;
 class WordToGroupForm;
 class KanjiToGroupForm;
 class WordToDictionaryForm;
@@ -53,6 +54,10 @@ void editNewWord(Dictionary *d);
 // dictionary can be changed by the user from a combo box.
 void showDictionaryStats(int dictindex);
 
+// Opens a window for reading Japanese text, using the words of the dictionary d. If text is
+// not empty, it is split into words when the window is shown.
+void analyzeText(Dictionary *d, const QString &text);
+
 // Opens an editor for the word entry. The definition at defindex will be initially selected.
 // Pass -1 to windex to start editing a new word.
 void editWord(Dictionary *d, int windex, int defindex, QWidget *parent);
@@ -9,8 +9,7 @@
 #include <QPushButton>
 #include <QScrollBar>
 #include <QDesktopWidget>
-#include <chrono>
-#include <thread>
+#include <functional>
 #include <list>
 #include "dictionarystatsform.h"
 #include "ui_dictionarystatsform.h"
@@ -46,21 +45,16 @@
 
 StatsThread::StatsThread(DictionaryStatsForm *owner, Dictionary *dict) : base(), owner(owner), dict(dict), valentry(0), valdef(0), valkanji(0)
 {
-    terminate = false;
-    done = false;
-
-    setAutoDelete(false);
 }
 
 StatsThread::~StatsThread()
 {
-    assert(done);
+    assert(!isRunning());
 }
 
-void StatsThread::run()
+bool StatsThread::execute()
 {
-    if (calculateEntries() && calculateDefinitions() && calculateKanji())
-        done = true;
+    return calculateEntries() && calculateDefinitions() && calculateKanji();
 }
 
 int StatsThread::entryResult() const
@@ -77,33 +71,19 @@ int StatsThread::kanjiResult() const
     return valkanji;
 }
 
-bool StatsThread::checkTerminate()
-{
-    if (terminate)
-    {
-        done = true;
-        return true;
-    }
-    return false;
-}
-
 bool StatsThread::calculateEntries()
 {
     if (dict->entryCount() == 0)
         return true;
 
-    if (checkTerminate())
+    if (isCancelled())
         return false;
 
     std::vector<int> list;
     list.resize(dict->entryCount());
     std::iota(list.begin(), list.end(), 0);
 
-    interruptSort(list.begin(), list.end(), [this](int a, int b, bool &localdone) {
-        localdone = terminate;
-        if (localdone)
-            return false;
-
+    if (!parallelSort(list.begin(), list.end(), [this](int a, int b) {
         WordEntry *ea = dict->wordEntry(a);
         WordEntry *eb = dict->wordEntry(b);
 
@@ -117,40 +97,40 @@ bool StatsThread::calculateEntries()
         }
 
         return false;
-    });
-    if (checkTerminate())
+    }, &token()))
         return false;
 
-    valentry = 1;
-    for (int ix = 1, siz = tosigned(list.size()); ix != siz; ++ix)
-    {
-        const auto &defa = dict->wordEntry(list[ix - 1])->defs;
-        const auto &defb = dict->wordEntry(list[ix])->defs;
-
-        if (defa.size() != defb.size())
-            ++valentry;
-        else
+    // Every entry differing from the one before it in the sorted list is unique.
+    valentry = 1 + parallelReduce(1, tosigned(list.size()), 8192, 0, [this, &list](int first, int last) {
+        int cnt = 0;
+        for (int ix = first; ix != last; ++ix)
         {
-            for (int iy = 0, sizy = tosigned(defa.size()); iy != sizy; ++iy)
+            const auto &defa = dict->wordEntry(list[ix - 1])->defs;
+            const auto &defb = dict->wordEntry(list[ix])->defs;
+
+            if (defa.size() != defb.size())
+                ++cnt;
+            else
             {
-                if (defa[iy].def != defb[iy].def)
+                for (int iy = 0, sizy = tosigned(defa.size()); iy != sizy; ++iy)
                 {
-                    ++valentry;
-                    break;
+                    if (defa[iy].def != defb[iy].def)
+                    {
+                        ++cnt;
+                        break;
+                    }
                 }
             }
         }
+        return cnt;
+    }, std::plus<int>(), &token());
 
-        if ((ix % 5 == 0) && checkTerminate())
-            return false;
-    }
-
-    return true;
+    return !isCancelled();
 }
 
 bool StatsThread::calculateDefinitions()
 {
-    if (checkTerminate())
+    if (isCancelled())
         return false;
 
     // Word index, definition index pairs.
@@ -167,38 +147,28 @@ bool StatsThread::calculateDefinitions()
     if (pairs.empty())
         return true;
 
-    if (checkTerminate())
-        return false;
-
-    interruptSort(pairs.begin(), pairs.end(), [this](const DefPair &a, const DefPair &b, bool &localdone) {
-        localdone = terminate;
-        if (localdone)
-            return false;
-
+    if (!parallelSort(pairs.begin(), pairs.end(), [this](const DefPair &a, const DefPair &b) {
         WordEntry *ea = dict->wordEntry(a.first);
         WordEntry *eb = dict->wordEntry(b.first);
 
         return ea->defs[a.second].def < eb->defs[b.second].def;
-    });
-    if (checkTerminate())
+    }, &token()))
         return false;
 
-    valdef = 1;
-    for (int ix = 1, siz = tosigned(pairs.size()); ix != siz; ++ix)
-    {
-        if (dict->wordEntry(pairs[ix - 1].first)->defs[pairs[ix - 1].second].def != dict->wordEntry(pairs[ix].first)->defs[pairs[ix].second].def)
-            ++valdef;
-
-        if ((ix % 10) && checkTerminate())
-            return false;
-    }
+    valdef = 1 + parallelReduce(1, tosigned(pairs.size()), 8192, 0, [this, &pairs](int first, int last) {
+        int cnt = 0;
+        for (int ix = first; ix != last; ++ix)
+            if (dict->wordEntry(pairs[ix - 1].first)->defs[pairs[ix - 1].second].def != dict->wordEntry(pairs[ix].first)->defs[pairs[ix].second].def)
+                ++cnt;
+        return cnt;
+    }, std::plus<int>(), &token());
 
-    return true;
+    return !isCancelled();
 }
 
 bool StatsThread::calculateKanji()
 {
-    if (checkTerminate())
+    if (isCancelled())
         return false;
 
     QSet<int> found;
@@ -208,14 +178,14 @@ bool StatsThread::calculateKanji()
     stack.push_back(cat);
     while (!stack.empty())
     {
-        if (checkTerminate())
+        if (isCancelled())
             return false;
 
         cat = stack.front();
         stack.pop_front();
         for (int ix = 0, siz = cat->categoryCount(); ix != siz; ++ix)
             stack.push_back(cat->categories(ix));
-        if (checkTerminate())
+        if (isCancelled())
             return false;
 
         for (int ix = 0, siz = tosigned(cat->size()); ix != siz; ++ix)
@@ -223,7 +193,7 @@ bool StatsThread::calculateKanji()
             KanjiGroup *grp = cat->items(ix);
             for (int iy = 0, siy = tosigned(grp->size()); iy != siy; ++iy)
             {
-                if ((iy % 10) == 0 && checkTerminate())
+                if ((iy % 10) == 0 && isCancelled())
                     return false;
                 int i = grp->items(iy)->index;
                 if (!found.contains(i))
@@ -333,7 +303,7 @@ bool DictionaryStatsForm::event(QEvent *e)
         QTimerEvent *te = (QTimerEvent*)e;
         if (te->timerId() == timer.timerId())
         {
-            if (thread != nullptr && !thread->terminate && thread->done)
+            if (thread != nullptr && thread->isFinished())
             {
                 timer.stop();
 
@@ -478,11 +448,8 @@ void DictionaryStatsForm::stopThreads()
     if (thread == nullptr)
         return;
 
-    thread->terminate = true;
-
-    auto mil1 = std::chrono::milliseconds(1);
-    while (!thread->done)
-        std::this_thread::sleep_for(mil1);
+    thread->cancel();
+    thread->wait();
 
     thread.reset();
 }
@@ -491,7 +458,7 @@ void DictionaryStatsForm::startThreads(Dictionary *d)
 {
     thread.reset(new StatsThread(this, d));
 
-    QThreadPool::globalInstance()->start(thread.get());
+    thread->start();
 
     timer.start(100, this);
 }
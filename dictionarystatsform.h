@@ -8,10 +8,9 @@
 #define DICTIONARYSTATSFORM_H
 
 #include <QBasicTimer>
-#include <QThread>
-#include <atomic>
 #include <memory>
 #include "dialogwindow.h"
+#include "taskscheduler.h"
 
 namespace Ui {
     class DictionaryStatsForm;
@@ -19,25 +18,19 @@ namespace Ui {
 
 class DictionaryStatsForm;
 class Dictionary;
-class StatsThread : public QRunnable
+class StatsThread : public BackgroundTask
 {
 public:
     StatsThread(DictionaryStatsForm *owner, Dictionary *dict);
     virtual ~StatsThread();
 
-    virtual void run() override;
-    // Returns the calculated value. Only valid when the variable "done" is set to true.
+    // Returns the calculated value. Only valid when isFinished() returns true.
     int entryResult() const;
     int definitionResult() const;
     int kanjiResult() const;
-
-    std::atomic_bool terminate;
-    std::atomic_bool done;
+protected:
+    virtual bool execute() override;
 private:
-    // Checks whether the thread should be terminated. If so, sets done to true and returns 
-    // true.
-    bool checkTerminate();
-
     bool calculateEntries();
     bool calculateDefinitions();
     bool calculateKanji();
@@ -49,7 +42,7 @@ private:
     int valdef;
     int valkanji;
 
-    typedef QRunnable base;
+    typedef BackgroundTask  base;
 };
 
 struct StatResult
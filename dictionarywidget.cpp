@@ -524,6 +524,7 @@ void DictionaryWidget::setListMode(ListMode newmode)
         filtermodel->deleteLater();
     filtermodel.release();
     sortfunc = nullptr;
+    sortkeyfunc = nullptr;
 
     model = nullptr;
 
@@ -630,11 +631,12 @@ void DictionaryWidget::setSortIndicatorVisible(bool showit)
         connect(ui->wordsTable->horizontalHeader(), &QHeaderView::sortIndicatorChanged, this, &DictionaryWidget::sortIndicatorChanged);
 }
 
-void DictionaryWidget::setSortFunction(ProxySortFunction func)
+void DictionaryWidget::setSortFunction(ProxySortFunction func, ProxySortKeyFunction keyfunc)
 {
     sortfunc = func;
+    sortkeyfunc = func ? keyfunc : nullptr;
     if (filtermodel != nullptr)
-        filtermodel->prepareSortFunction(sortfunc);
+        filtermodel->prepareSortFunction(sortfunc, sortkeyfunc);
 }
 
 void DictionaryWidget::setSortIndicator(int index, Qt::SortOrder order)
@@ -647,7 +649,7 @@ void DictionaryWidget::sortByIndicator()
     if (filtermodel == nullptr)
         updateWords();
     else
-        filtermodel->sortBy(ui->wordsTable->horizontalHeader()->sortIndicatorSection(), ui->wordsTable->horizontalHeader()->sortIndicatorOrder(), sortfunc);
+        filtermodel->sortBy(ui->wordsTable->horizontalHeader()->sortIndicatorSection(), ui->wordsTable->horizontalHeader()->sortIndicatorOrder(), sortfunc, sortkeyfunc);
 }
 
 int DictionaryWidget::checkBoxColumn() const
@@ -700,6 +702,7 @@ void DictionaryWidget::setModel(DictionaryItemModel *newmodel)
         filtermodel->deleteLater();
     filtermodel.release();
     sortfunc = nullptr;
+    sortkeyfunc = nullptr;
 
     model = newmodel;
 
@@ -804,14 +807,16 @@ int DictionaryWidget::selectionSize() const
 
 void DictionaryWidget::selectedIndexes(std::vector<int> &indexes) const
 {
-    ui->wordsTable->selectedRows(indexes);
-    for (int &ix : indexes)
-    {
-        if (listmode == DictSearch || filtermodel == nullptr)
-            ix = model->indexes(ix);
-        else if (filtermodel != nullptr)
-            ix = model->indexes(filtermodel->mapToSource(filtermodel->index(ix, 0)).row());
-    }
+    indexes.reserve(indexes.size() + ui->wordsTable->selectionSize());
+    ui->wordsTable->selectedRanges([this, &indexes](int first, int last) {
+        for (int ix = first; ix != last + 1; ++ix)
+        {
+            if (listmode == DictSearch || filtermodel == nullptr)
+                indexes.push_back(model->indexes(ix));
+            else
+                indexes.push_back(model->indexes(filtermodel->mapToSource(filtermodel->index(ix, 0)).row()));
+        }
+    });
 }
 
 void DictionaryWidget::selectedRows(std::vector<int> &rows) const
@@ -1681,6 +1686,7 @@ void DictionaryWidget::updateWords()
             filtermodel->deleteLater();
         filtermodel.release();
         sortfunc = nullptr;
+        sortkeyfunc = nullptr;
 
         model = nullptr;
 
@@ -1801,7 +1807,7 @@ void DictionaryWidget::updateWords()
             if (!searchText().isEmpty() || !conditionsEmpty())
                 filtermodel->filter(mode, searchText(), wildcards, strict, ui->inflButton->isChecked(), isStudyDefinitionUsed(), ui->filterButton->isChecked() ? conditions.get() : nullptr);
             if (sortfunc)
-                filtermodel->sortBy(ui->wordsTable->horizontalHeader()->sortIndicatorSection(), ui->wordsTable->horizontalHeader()->sortIndicatorOrder(), sortfunc);
+                filtermodel->sortBy(ui->wordsTable->horizontalHeader()->sortIndicatorSection(), ui->wordsTable->horizontalHeader()->sortIndicatorOrder(), sortfunc, sortkeyfunc);
 
             setTableModel(filtermodel.get());
         }
@@ -52,6 +52,9 @@ struct WordFilterConditions;
 // (Model, Column index, row A, row B) - The rows are for the source model before filtering,
 // no further conversion needed.
 typedef std::function<bool(DictionaryItemModel*, int, int, int)> ProxySortFunction;
+struct ProxySortKey;
+// (Model, Column index, row, key) - Computes the sort key of a row in the source model.
+typedef std::function<void(DictionaryItemModel*, int, int, ProxySortKey&)> ProxySortKeyFunction;
 
 class DictionaryWidget : public QWidget
 {
@@ -138,7 +141,9 @@ public:
     // Sets a function to use when sorting in the dictionary by the current sort indicator. To
     // sort the dictionary call sortByIndicator(). Pass null in func to reset the sort order.
     // Setting a different model or changing the display mode resets the sort function.
-    void setSortFunction(ProxySortFunction func);
+    // Pass keyfunc to sort by precomputed keys of the rows instead of calling func for every
+    // comparison. The keys must give the same ordering as func.
+    void setSortFunction(ProxySortFunction func, ProxySortKeyFunction keyfunc = nullptr);
 
     // Sets the displayed position and direction of the sort indicator in the horizontal
     // header. Does not sort the model. Use sortByIndicator() for sorting after the position
@@ -435,6 +440,8 @@ private:
 
     // Function used to determine sort order when sorting is requested.
     ProxySortFunction sortfunc;
+    // Function computing the sort keys of rows for sortfunc. Can be null.
+    ProxySortKeyFunction sortkeyfunc;
 
     QBasicTimer historytimer;
 
@@ -13,6 +13,7 @@
 #include "romajizer.h"
 #include "kanji.h"
 #include "words.h"
+#include "taskscheduler.h"
 
 #include "checked_cast.h"
 
@@ -1614,6 +1615,363 @@ bool matchKanjiReading(const QCharString &kanji, const QCharString &kana, KanjiE
     return false;
 }
 
+//-------------------------------------------------------------
+
+
+const quint8 FuriganaCache::notCached;
+
+FuriganaCache::FuriganaCache() : unused(0)
+{
+
+}
+
+void FuriganaCache::clear()
+{
+    offsets.clear();
+    counts.clear();
+    parts.clear();
+    unused = 0;
+}
+
+void FuriganaCache::swap(FuriganaCache &other)
+{
+    std::swap(offsets, other.offsets);
+    std::swap(counts, other.counts);
+    std::swap(parts, other.parts);
+    std::swap(unused, other.unused);
+}
+
+void FuriganaCache::build(const smartvector<WordEntry> &words)
+{
+    int siz = tosigned(words.size());
+    if (tosigned(counts.size()) > siz)
+    {
+        for (int ix = siz, cnt = tosigned(counts.size()); ix != cnt; ++ix)
+            if (counts[ix] != notCached)
+                unused += counts[ix];
+        offsets.resize(siz);
+        counts.resize(siz);
+    }
+    else
+    {
+        offsets.resize(siz, 0);
+        counts.resize(siz, notCached);
+    }
+
+    std::vector<int> missing;
+    for (int ix = 0; ix != siz; ++ix)
+        if (counts[ix] == notCached)
+            missing.push_back(ix);
+
+    if (missing.empty())
+        return;
+
+    // findFurigana() looks up kanji indexes on every thread.
+    ZKanji::completeKanjiIndex();
+
+    // Every interval of the missing words is computed into its own list, which are added to
+    // the cache in order.
+    const int chunk = 1024;
+    std::vector<std::vector<FuriganaData>> chunkparts((missing.size() + chunk - 1) / chunk);
+    std::vector<quint8> newcounts(missing.size());
+
+    parallelFor(0, tosigned(missing.size()), chunk, [&words, &missing, &chunkparts, &newcounts, chunk](int first, int last) {
+        std::vector<FuriganaData> &dest = chunkparts[first / chunk];
+        std::vector<FuriganaData> furi;
+        for (int ix = first; ix != last; ++ix)
+        {
+            const WordEntry *e = words[missing[ix]];
+            findFurigana(e->kanji, e->kana, furi);
+            if (furi.size() >= notCached)
+            {
+                newcounts[ix] = notCached;
+                continue;
+            }
+            newcounts[ix] = tounsigned<quint8>(furi.size());
+            dest.insert(dest.end(), furi.begin(), furi.end());
+        }
+    });
+
+    int pos = 0;
+    for (const std::vector<FuriganaData> &dest : chunkparts)
+    {
+        int destpos = 0;
+        for (int ix = pos, end = std::min<int>(pos + chunk, tosigned(missing.size())); ix != end; ++ix)
+        {
+            counts[missing[ix]] = newcounts[ix];
+            offsets[missing[ix]] = tounsigned<quint32>(parts.size() + destpos);
+            if (newcounts[ix] != notCached)
+                destpos += newcounts[ix];
+        }
+        parts.insert(parts.end(), dest.begin(), dest.end());
+        pos += chunk;
+    }
+}
+
+void FuriganaCache::get(int windex, const WordEntry *e, std::vector<FuriganaData> &furigana)
+{
+    if (find(windex, furigana))
+        return;
+
+    findFurigana(e->kanji, e->kana, furigana);
+    set(windex, furigana);
+}
+
+bool FuriganaCache::find(int windex, std::vector<FuriganaData> &furigana) const
+{
+    if (windex >= tosigned(counts.size()) || counts[windex] == notCached)
+        return false;
+
+    auto it = parts.begin() + offsets[windex];
+    furigana.assign(it, it + counts[windex]);
+    return true;
+}
+
+void FuriganaCache::invalidate(int windex)
+{
+    if (windex >= tosigned(counts.size()) || counts[windex] == notCached)
+        return;
+
+    unused += counts[windex];
+    counts[windex] = notCached;
+    compact();
+}
+
+void FuriganaCache::erase(int windex)
+{
+    if (windex >= tosigned(counts.size()))
+        return;
+
+    if (counts[windex] != notCached)
+        unused += counts[windex];
+    counts.erase(counts.begin() + windex);
+    offsets.erase(offsets.begin() + windex);
+    compact();
+}
+
+void FuriganaCache::load(QDataStream &stream, int wordcount)
+{
+    clear();
+
+    quint32 cnt;
+    stream >> cnt;
+
+    offsets.resize(cnt, 0);
+    counts.resize(cnt, notCached);
+
+    quint8 u8;
+    for (int ix = 0, siz = tosigned(cnt); ix != siz; ++ix)
+    {
+        stream >> u8;
+        counts[ix] = u8;
+        if (u8 == notCached)
+            continue;
+
+        offsets[ix] = tounsigned<quint32>(parts.size());
+        for (int iy = 0; iy != u8; ++iy)
+        {
+            FuriganaData d;
+            stream >> u8;
+            d.kanji.pos = u8;
+            stream >> u8;
+            d.kanji.len = u8;
+            stream >> u8;
+            d.kana.pos = u8;
+            stream >> u8;
+            d.kana.len = u8;
+            parts.push_back(d);
+        }
+    }
+
+    if (tosigned(cnt) != wordcount)
+        clear();
+}
+
+void FuriganaCache::save(QDataStream &stream) const
+{
+    stream << (quint32)counts.size();
+
+    for (int ix = 0, siz = tosigned(counts.size()); ix != siz; ++ix)
+    {
+        quint8 cnt = counts[ix];
+
+        // Positions in words are saved as bytes. Words too long for that are not saved.
+        for (int iy = 0; cnt != notCached && iy != cnt; ++iy)
+        {
+            const FuriganaData &d = parts[offsets[ix] + iy];
+            if (d.kanji.pos + d.kanji.len > 255 || d.kana.pos + d.kana.len > 255)
+                cnt = notCached;
+        }
+
+        stream << cnt;
+        if (cnt == notCached)
+            continue;
+
+        for (int iy = 0; iy != cnt; ++iy)
+        {
+            const FuriganaData &d = parts[offsets[ix] + iy];
+            stream << (quint8)d.kanji.pos << (quint8)d.kanji.len << (quint8)d.kana.pos << (quint8)d.kana.len;
+        }
+    }
+}
+
+void FuriganaCache::set(int windex, const std::vector<FuriganaData> &furigana)
+{
+    if (windex >= tosigned(counts.size()))
+    {
+        offsets.resize(windex + 1, 0);
+        counts.resize(windex + 1, notCached);
+    }
+    else if (counts[windex] != notCached)
+        unused += counts[windex];
+
+    if (furigana.size() >= notCached)
+    {
+        counts[windex] = notCached;
+        return;
+    }
+
+    counts[windex] = tounsigned<quint8>(furigana.size());
+    offsets[windex] = tounsigned<quint32>(parts.size());
+    parts.insert(parts.end(), furigana.begin(), furigana.end());
+    compact();
+}
+
+void FuriganaCache::compact()
+{
+    if (unused < 4096 || unused < tosigned(parts.size()) / 2)
+        return;
+
+    std::vector<FuriganaData> tmp;
+    tmp.reserve(parts.size() - unused);
+    for (int ix = 0, siz = tosigned(counts.size()); ix != siz; ++ix)
+    {
+        if (counts[ix] == notCached)
+            continue;
+        auto it = parts.begin() + offsets[ix];
+        offsets[ix] = tounsigned<quint32>(tmp.size());
+        tmp.insert(tmp.end(), it, it + counts[ix]);
+    }
+    std::swap(parts, tmp);
+    unused = 0;
+}
+
+
+//-------------------------------------------------------------
+
+
+KanjiReadingIndex::KanjiReadingIndex() : built(false)
+{
+
+}
+
+void KanjiReadingIndex::clear()
+{
+    lists.clear();
+    built = false;
+}
+
+void KanjiReadingIndex::swap(KanjiReadingIndex &other)
+{
+    std::swap(lists, other.lists);
+    std::swap(built, other.built);
+}
+
+bool KanjiReadingIndex::isBuilt() const
+{
+    return built;
+}
+
+void KanjiReadingIndex::build(const smartvector<WordEntry> &words, FuriganaCache &furigana)
+{
+    clear();
+
+    furigana.build(words);
+    ZKanji::completeKanjiIndex();
+
+    // Every kanji occurrence found in the words as [list key, word index] pairs. The lists
+    // are collected for intervals of words separately and merged in order, so the word
+    // indexes are added to the lists sorted.
+    typedef std::pair<quint32, int> Occurrence;
+    const int chunk = 2048;
+    std::vector<std::vector<Occurrence>> chunkitems((words.size() + chunk - 1) / chunk);
+
+    parallelFor(0, tosigned(words.size()), chunk, [&words, &furigana, &chunkitems, chunk](int first, int last) {
+        std::vector<Occurrence> &dest = chunkitems[first / chunk];
+        std::vector<FuriganaData> furi;
+        for (int ix = first; ix != last; ++ix)
+        {
+            const WordEntry *e = words[ix];
+            if (!furigana.find(ix, furi))
+                findFurigana(e->kanji, e->kana, furi);
+
+            for (int iy = 0, siz = e->kanji.size(); iy != siz; ++iy)
+            {
+                if (!KANJI(e->kanji[iy].unicode()))
+                    continue;
+                int kix = ZKanji::kanjiIndex(e->kanji[iy]);
+                if (kix < 0)
+                    continue;
+
+                int r = findKanjiReading(e->kanji, e->kana, iy, ZKanji::kanjis[kix], &furi);
+                Position pos = siz == 1 ? Position::Whole : iy == 0 ? Position::Front : iy == siz - 1 ? Position::End : Position::Middle;
+                dest.push_back(std::make_pair(listKey(kix, r + 1, pos), ix));
+            }
+        }
+    });
+
+    for (const std::vector<Occurrence> &items : chunkitems)
+    {
+        for (const Occurrence &o : items)
+        {
+            std::vector<int> &l = lists[o.first];
+            if (l.empty() || l.back() != o.second)
+                l.push_back(o.second);
+        }
+    }
+
+    built = true;
+}
+
+void KanjiReadingIndex::collect(int kindex, int readings, int positions, std::vector<int> &result, bool invert) const
+{
+    std::vector<int> found;
+
+    auto it = lists.lower_bound(listKey(kindex, 0, Position::Front));
+    auto last = lists.lower_bound(listKey(kindex + 1, 0, Position::Front));
+    for (; it != last; ++it)
+    {
+        int r = (it->first >> 2) & 0xffff;
+        int pos = it->first & 3;
+        // Reading bits only exist for the first 16 compact readings, and never for
+        // undetermined ones.
+        bool match = (positions & (1 << pos)) != 0 && (readings == -1 || (r != 0 && r <= 16 && (readings & (1 << (r - 1))) != 0));
+        if (match == invert)
+            continue;
+
+        const std::vector<int> &l = it->second;
+        size_t oldsize = found.size();
+        found.insert(found.end(), l.begin(), l.end());
+        std::inplace_merge(found.begin(), found.begin() + oldsize, found.end());
+    }
+
+    found.resize(std::unique(found.begin(), found.end()) - found.begin());
+
+    size_t oldsize = result.size();
+    result.insert(result.end(), found.begin(), found.end());
+    std::inplace_merge(result.begin(), result.begin() + oldsize, result.end());
+    result.resize(std::unique(result.begin(), result.end()) - result.begin());
+}
+
+quint32 KanjiReadingIndex::listKey(int kindex, int reading, Position pos)
+{
+    return (quint32(kindex) << 18) | (quint32(reading & 0xffff) << 2) | quint32(pos);
+}
+
+
+//-------------------------------------------------------------
+
+
 //#define CHECKED_WORD_INDEX  21522         206067
 
 void testFuriganaReadingTest()
@@ -8,9 +8,13 @@
 #define FURIGANA_H
 
 #include <vector>
+#include <map>
 #include "qcharstring.h"
+#include "smartvector.h"
 
+class QDataStream;
 struct KanjiEntry;
+struct WordEntry;
 
 // Length of kanji kun reading without okurigana and its separator character.
 int kunLen(const QChar *kun);
@@ -46,6 +50,96 @@ int findKanjiReading(const QCharString &kanji, const QCharString &kana, int kanj
 // kanji appears in the word multiple times, they are checked until a match is first found.
 bool matchKanjiReading(const QCharString &kanji, const QCharString &kana, KanjiEntry *k, int reading);
 
+// Furigana data of the words of a dictionary in a compact form. The furigana of every word is
+// computed in parallel with build(), or one by one when requested with get(). The data of
+// words whose kanji or kana change must be invalidated.
+// Not thread safe, only use the cache from the main thread.
+class FuriganaCache
+{
+public:
+    FuriganaCache();
+
+    void clear();
+    void swap(FuriganaCache &other);
+
+    // Computes the furigana of every word in the list that is not in the cache yet. The cache
+    // is resized to hold the same number of words as the list.
+    void build(const smartvector<WordEntry> &words);
+
+    // Fills furigana with the data of the word e found at windex. The data is computed and
+    // added to the cache if it's not there yet.
+    void get(int windex, const WordEntry *e, std::vector<FuriganaData> &furigana);
+    // Fills furigana with the cached data of the word at windex without changing the cache.
+    // Returns false if the word is not in the cache.
+    bool find(int windex, std::vector<FuriganaData> &furigana) const;
+
+    // Removes the data of the word at windex from the cache.
+    void invalidate(int windex);
+    // Removes the word at windex from the cache and moves the data of the words after it.
+    void erase(int windex);
+
+    // Loads the cache saved with save(). The words must be loaded first, and the cache is
+    // discarded if its size doesn't match wordcount.
+    void load(QDataStream &stream, int wordcount);
+    // Saves the data of every word in the cache. Call build() first for a complete cache.
+    void save(QDataStream &stream) const;
+private:
+    // Value in counts for words whose furigana is not in the cache.
+    static const quint8 notCached = 0xff;
+
+    // Stores the data for the word at windex, growing the cache if necessary.
+    void set(int windex, const std::vector<FuriganaData> &furigana);
+    // Removes the unused items from parts.
+    void compact();
+
+    // Position of the first furigana part of each word in parts.
+    std::vector<quint32> offsets;
+    // Number of furigana parts of each word, or notCached.
+    std::vector<quint8> counts;
+    // Furigana data of every cached word. Data of words that were invalidated is not removed
+    // immediately. They are counted in unused.
+    std::vector<FuriganaData> parts;
+    int unused;
+};
+
+// Lists of words that contain a kanji with a given reading at a given position, computed from
+// the furigana of the words. The lists are built for every kanji at once in build(), which
+// must be called again after the words change.
+class KanjiReadingIndex
+{
+public:
+    // Position of a kanji in a word. Whole is used for words made up of the single kanji.
+    enum class Position : uchar { Front, Middle, End, Whole, Count };
+
+    KanjiReadingIndex();
+
+    void clear();
+    void swap(KanjiReadingIndex &other);
+    // Whether the index has been built.
+    bool isBuilt() const;
+
+    // Fills the cache with the furigana of every word, and builds the word lists.
+    void build(const smartvector<WordEntry> &words, FuriganaCache &furigana);
+
+    // Adds the indexes of words to result, which contain the kanji at kindex with a compact
+    // reading index whose bit is set in readings, in a position whose bit is set in
+    // positions. The bits of positions correspond to the Position values. If readings is
+    // -1, the reading is not checked, even if it couldn't be determined. When invert is
+    // true, words are added which contain the kanji at a position or with a reading that
+    // doesn't match. The result must be sorted. Each word is only added once and the result
+    // remains sorted.
+    void collect(int kindex, int readings, int positions, std::vector<int> &result, bool invert = false) const;
+private:
+    // Returns the key of the list for the kanji with the reading and position. The lists of
+    // a kanji are next to each other when sorted by their keys.
+    static quint32 listKey(int kindex, int reading, Position pos);
+
+    // Sorted lists of word indexes for every kanji, reading and position that was found.
+    // Readings are stored with their compact index + 1, and 0 for undetermined readings.
+    std::map<quint32, std::vector<int>> lists;
+    bool built;
+};
+
 
 
 #endif // FURIGANA_H
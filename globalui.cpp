@@ -49,6 +49,7 @@
 #include "wordtodictionaryform.h"
 #include "languages.h"
 #include "languagesettings.h"
+#include "perftrace.h"
 
 //// Mode button icon image width.
 //static const int _iconW = 16;
@@ -979,7 +980,12 @@ void GlobalUI::timerEvent(QTimerEvent *e)
         if (lastsave.secsTo(now) >= Settings::data.interval * 60)
         {
             lastsave = now;
-            ZKanji::saveUserData();
+            PERFTRACE_SCOPE("autosave");
+            // Study answers and group edits are already written to the user data journals
+            // and would be restored at the next startup. A full save is only needed when
+            // something else changed, or the journals grew too large.
+            if (!ZKanji::userDataJournaled())
+                ZKanji::saveUserData();
         }
     }
 }
@@ -1362,7 +1368,7 @@ void GlobalUI::userImportAction()
     if (!f.exec(ZKanji::dictionary(d.result())))
         return;
 
-    QString fname = QFileDialog::getOpenFileName(!mainforms.empty() ? mainforms[0] : nullptr, tr("Open export file"), QString(), QString("%1 (*.zkanji.export)").arg(tr("Export file")));
+    QString fname = QFileDialog::getOpenFileName(!mainforms.empty() ? mainforms[0] : nullptr, tr("Open export file"), QString(), QString("%1 (*.zkanji.export *.zkanji.bexport)").arg(tr("Export file")));
     if (fname.isEmpty())
         return;
 
@@ -4,6 +4,9 @@
 ** GNU General Public License version 3. See the file LICENSE for details.
 **/
 
+#include <QVarLengthArray>
+#include <map>
+#include <algorithm>
 #include "grammar.h"
 #include "grammar_enums.h"
 #include "romajizer.h"
@@ -462,6 +465,157 @@ const InfTypes ruinftype[]
 
 
 
+// Suffix tables checked by deinflectedForms(), in the order they are checked.
+enum class DeinflectTable : uchar { Iku, Suru, Kuru, U, Ku, Gu, Su, Tu, Nu, Bu, Mu, R_u, Ru, Count };
+
+// Data of the suffix tables. The suffix replaces the inflected ending in the deinflected form.
+// The suru and kuru tables are handled separately.
+struct DeinflectTableData
+{
+    QCharStringList *list;
+    const InfTypes *types;
+    ushort suffix;
+    WordTypes type;
+};
+
+static const DeinflectTableData deinflecttables[(int)DeinflectTable::Count] = {
+    { &ikuinf, ikuinftype, 0x304f /* ku */, WordTypes::IkuVerb },
+    { &suruinf, suruinftype, 0, WordTypes::SuruVerb },
+    { &kuruinf, kuruinftype, 0, WordTypes::KuruVerb },
+    { &uinf, uinftype, 0x3046 /* u */, WordTypes::GodanVerb },
+    { &kuinf, kuinftype, 0x304f /* ku */, WordTypes::GodanVerb },
+    { &guinf, guinftype, 0x3050 /* gu */, WordTypes::GodanVerb },
+    { &suinf, suinftype, 0x3059 /* su */, WordTypes::GodanVerb },
+    { &tuinf, tuinftype, 0x3064 /* tu */, WordTypes::GodanVerb },
+    { &nuinf, nuinftype, 0x306C /* nu */, WordTypes::GodanVerb },
+    { &buinf, buinftype, 0x3076 /* bu */, WordTypes::GodanVerb },
+    { &muinf, muinftype, 0x3080 /* mu */, WordTypes::GodanVerb },
+    { &r_uinf, r_uinftype, 0x308B /* ru */, WordTypes::GodanVerb },
+    { &ruinf, ruinftype, 0x308B /* ru */, WordTypes::IchidanVerb }
+};
+
+// A suffix of one of the deinflection tables.
+struct DeinflectRule
+{
+    DeinflectTable table;
+    // Index of the suffix in the table.
+    int index;
+};
+
+// Node of the trie built from the reversed suffixes of every deinflection table. Walking the
+// trie from the root with the characters of a word backwards finds every suffix matching the
+// end of the word in one pass.
+struct DeinflectNode
+{
+    // Child nodes in deinflectedges, sorted by character.
+    int edgefirst;
+    int edgecount;
+    // Rules whose suffix ends in this node, in deinflectnoderules.
+    int rulefirst;
+    int rulecount;
+};
+
+struct DeinflectEdge
+{
+    ushort ch;
+    int node;
+};
+
+// Every rule in the order the tables and their suffixes are checked. Rules are referenced by
+// their index in this list.
+static std::vector<DeinflectRule> deinflectrules;
+static std::vector<DeinflectNode> deinflectnodes;
+static std::vector<DeinflectEdge> deinflectedges;
+static std::vector<int> deinflectnoderules;
+// The suffix of each table as a string.
+static QString deinflectsuffixes[(int)DeinflectTable::Count];
+
+// Builds the suffix trie from the deinflection tables. The tables must be initialized.
+static void compileDeinflectRules()
+{
+    // Temporary trie with the children of nodes in maps.
+    std::vector<std::map<ushort, int>> children(1);
+    std::vector<std::vector<int>> rules(1);
+
+    for (int tix = 0; tix != (int)DeinflectTable::Count; ++tix)
+    {
+        const QCharStringList &list = *deinflecttables[tix].list;
+        if (deinflecttables[tix].suffix != 0)
+            deinflectsuffixes[tix] = QChar(deinflecttables[tix].suffix);
+
+        for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
+        {
+            // The first character of kuru suffixes is checked separately, because it can be
+            // written in kanji as well.
+            int len = list[ix].size() - (tix == (int)DeinflectTable::Kuru ? 1 : 0);
+            const QChar *str = list[ix].rightData(len);
+
+            int node = 0;
+            for (int iy = len - 1; iy != -1; --iy)
+            {
+                auto it = children[node].find(str[iy].unicode());
+                if (it != children[node].end())
+                {
+                    node = it->second;
+                    continue;
+                }
+
+                children[node][str[iy].unicode()] = tosigned(children.size());
+                node = tosigned(children.size());
+                children.push_back(std::map<ushort, int>());
+                rules.push_back(std::vector<int>());
+            }
+
+            rules[node].push_back(tosigned(deinflectrules.size()));
+            deinflectrules.push_back({ (DeinflectTable)tix, ix });
+        }
+    }
+
+    // The children of each node are stored next to each other in the edge list.
+    deinflectnodes.resize(children.size());
+    for (int ix = 0, siz = tosigned(children.size()); ix != siz; ++ix)
+    {
+        DeinflectNode &n = deinflectnodes[ix];
+        n.edgefirst = tosigned(deinflectedges.size());
+        n.edgecount = tosigned(children[ix].size());
+        for (auto &c : children[ix])
+            deinflectedges.push_back({ c.first, c.second });
+        n.rulefirst = tosigned(deinflectnoderules.size());
+        n.rulecount = tosigned(rules[ix].size());
+        deinflectnoderules.insert(deinflectnoderules.end(), rules[ix].begin(), rules[ix].end());
+    }
+}
+
+// Rule indexes found for a single word. Only a few rules can match the same word.
+typedef QVarLengthArray<int, 32> DeinflectMatches;
+
+// Fills matches with the index of every rule whose suffix matches the end of hstr, in the
+// order the rules should be applied.
+static void matchDeinflectRules(const QString &hstr, DeinflectMatches &matches)
+{
+    const QChar *str = hstr.constData();
+    int node = 0;
+    for (int ix = 0; ix != deinflectnodes[0].rulecount; ++ix)
+        matches.append(deinflectnoderules[deinflectnodes[0].rulefirst + ix]);
+    for (int pos = hstr.size() - 1; pos != -1; --pos)
+    {
+        const DeinflectNode &n = deinflectnodes[node];
+        const DeinflectEdge *first = deinflectedges.data() + n.edgefirst;
+        const DeinflectEdge *last = first + n.edgecount;
+        ushort ch = str[pos].unicode();
+        const DeinflectEdge *e = std::lower_bound(first, last, ch, [](const DeinflectEdge &a, ushort b) { return a.ch < b; });
+        if (e == last || e->ch != ch)
+            break;
+
+        node = e->node;
+        const DeinflectNode &next = deinflectnodes[node];
+        for (int ix = 0; ix != next.rulecount; ++ix)
+            matches.append(deinflectnoderules[next.rulefirst + ix]);
+    }
+
+    std::sort(matches.begin(), matches.end());
+}
+
 void initializeRomajiToKana(const char **romaji, QCharStringList &kana, int size)
 {
     kana.reserve(size);
@@ -490,6 +644,7 @@ void initializeDeinflecter()
     INITRK(r_uinf);
     INITRK(ruinf);
 
+    compileDeinflectRules();
 
     //INITRK(zero0);
     //INITRK(ichi1);
@@ -616,14 +771,15 @@ uint convertOldFields(uint old)
     return result;
 }
 
-void deinflectedForms(QString str, QString hstr, int infsize, std::vector<InfTypes> inf, WordTypes oldtype, smartvector<InflectionForm> &results);
+void deinflectedForms(const QString &str, const QString &hstr, int infsize, std::vector<InfTypes> &inf, WordTypes oldtype, smartvector<InflectionForm> &results);
 
 // Both str and hstr contain the same kana word, but hstr is hiraganized for checks. They are still
 // in their original inflected forms. Str is kept in case the result should keep the original katakana.
 // Newlen is the new length of the deinflected word without the suffix, which is added in this step
 // of deinflection. Infsize is the number of characters before deinflection, that were changed
-// in previous steps.
-void addInflectionVariant(QString str, QString hstr, int newlen, QString suffix, int infsize, WordTypes type, WordTypes oldtype, std::vector<InfTypes> inf, InfTypes inftype, smartvector<InflectionForm> &results)
+// in previous steps. Inf holds the inflections found in previous steps. It's shared by every step
+// of the deinflection and is restored before the function returns.
+void addInflectionVariant(const QString &origstr, const QString &orighstr, int newlen, const QString &suffix, int infsize, WordTypes type, WordTypes oldtype, std::vector<InfTypes> &inf, InfTypes inftype, smartvector<InflectionForm> &results)
 {
     static const QString dekirukana = toKana("dekiru", 6);
     static const QString irukana = toKana("iru", 3);
@@ -633,12 +789,14 @@ void addInflectionVariant(QString str, QString hstr, int newlen, QString suffix,
     static const QString dekirukanji1 = QString::fromUtf16(dekirukanji1arr);
     static const QString dekirukanji2 = QString::fromUtf16(dekirukanji2arr);
 
-    infsize = std::max(0, infsize - std::max(0, str.size() - newlen)) + suffix.size();
+    infsize = std::max(0, infsize - std::max(0, origstr.size() - newlen)) + suffix.size();
 
-    str = str.left(newlen) + suffix;
-    hstr = hstr.left(newlen) + suffix;
+    QString str;
+    str.reserve(newlen + suffix.size());
+    str.append(origstr.constData(), newlen).append(suffix);
 
-    if (str.isEmpty() || (str.size() == 1 && hstr == QChar(MINITSU)) || (infsize == str.size() && type != WordTypes::TrueAdj && type != WordTypes::SuruVerb && type != WordTypes::KuruVerb))
+    // The hiragana form is only created when it's needed for further deinflection.
+    if (str.isEmpty() || (str.size() == 1 && (newlen == 1 ? orighstr.at(0) : suffix.at(0)) == QChar(MINITSU)) || (infsize == str.size() && type != WordTypes::TrueAdj && type != WordTypes::SuruVerb && type != WordTypes::KuruVerb))
         return;
 
     if (inf.empty() && inftype == InfTypes::Rareru && (str == dekirukana || str == dekirukanji1 || str == dekirukanji2))
@@ -694,7 +852,7 @@ void addInflectionVariant(QString str, QString hstr, int newlen, QString suffix,
     // so to avoid infinite loops we do nothing when this happens.
     for (const InflectionForm *form : results)
     {
-        if (form->form == str && form->inf == inf && form->type == type)
+        if (form->type == type && form->inf == inf && form->form == str)
             return;
     }
 
@@ -705,7 +863,14 @@ void addInflectionVariant(QString str, QString hstr, int newlen, QString suffix,
 
     if ((type == WordTypes::TakesSuru || type == WordTypes::IchidanVerb || type == WordTypes::GodanVerb ||
         type == WordTypes::TrueAdj /*|| type == WordTypes::AuxAdj*/) && (inftype != InfTypes::I || type != WordTypes::IchidanVerb))
+    {
+        QString hstr;
+        hstr.reserve(newlen + suffix.size());
+        hstr.append(orighstr.constData(), newlen).append(suffix);
         deinflectedForms(str, hstr, infsize, inf, type, results);
+    }
+
+    inf.pop_back();
 }
 
 void deinflectAdjective(QString str, QString hstr, smartvector<InflectionForm> &results);
@@ -713,10 +878,11 @@ void deinflectAdjective(QString str, QString hstr, smartvector<InflectionForm> &
 // Called recursively to deinflect a word. Str is the current word form that might be deinflected further.
 // infl is the list of previous results which gets expanded in every iteration. Type contains the required
 // grammatical type of the form passed in str. If type is -1 no type is set.
-void deinflectedForms(QString str, QString hstr, int infsize, std::vector<InfTypes> inf, WordTypes oldtype, smartvector<InflectionForm> &results)
+void deinflectedForms(const QString &str, const QString &hstr, int infsize, std::vector<InfTypes> &inf, WordTypes oldtype, smartvector<InflectionForm> &results)
 {
     static const QString surukana = toKana("suru", 4);
     static const QString kurukana = toKana("kuru", 4);
+    static const QString rusuffix = QChar(0x308B);
 
     if (hstr.isEmpty())
         return;
@@ -726,76 +892,53 @@ void deinflectedForms(QString str, QString hstr, int infsize, std::vector<InfTyp
 
     // If the "inflection" is the -na ending of a na adjective, it is added as the sole possible inflection.
     if (inf.empty() && (hstr.at(hstr.size() - 1).unicode() == 0x306A /* na */ || hstr.at(hstr.size() - 1).unicode() == 0x306B /* ni */ || hstr.at(hstr.size() - 1).unicode() == 0x3067 /* de */))
-        addInflectionVariant(str, hstr, hstr.size() - 1, QString(), infsize, WordTypes::NaAdj, oldtype, std::vector<InfTypes>(), hstr.at(hstr.size() - 1).unicode() == 0x306A ? InfTypes::Na : hstr.at(hstr.size() - 1).unicode() == 0x306B ? InfTypes::Ku : InfTypes::Te, results);
+        addInflectionVariant(str, hstr, hstr.size() - 1, QString(), infsize, WordTypes::NaAdj, oldtype, inf, hstr.at(hstr.size() - 1).unicode() == 0x306A ? InfTypes::Na : hstr.at(hstr.size() - 1).unicode() == 0x306B ? InfTypes::Ku : InfTypes::Te, results);
+
+    DeinflectMatches matches;
+    matchDeinflectRules(hstr, matches);
 
-    for (int ix = 0, siz = tosigned(ikuinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(ikuinf[ix].size()) == ikuinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - ikuinf[ix].size(), QChar(0x304f) /* ku */, infsize, WordTypes::IkuVerb, oldtype, inf, ikuinftype[ix], results);
+    // The ichidan -i form is checked right before the suffixes of the ichidan table.
+    bool ichidani = inf.empty();
 
-    for (int ix = 0, siz = tosigned(suruinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(suruinf[ix].size()) == suruinf[ix])
+    for (int rule : matches)
+    {
+        const DeinflectRule &r = deinflectrules[rule];
+        const DeinflectTableData &t = deinflecttables[(int)r.table];
+        int len = (*t.list)[r.index].size();
+        InfTypes inftype = t.types[r.index];
+
+        if (ichidani && r.table == DeinflectTable::Ru)
         {
-            addInflectionVariant(str, hstr, hstr.size() - suruinf[ix].size(), surukana, infsize, WordTypes::SuruVerb, oldtype, inf, suruinftype[ix], results);
-            addInflectionVariant(str, hstr, hstr.size() - suruinf[ix].size(), QString(), infsize, WordTypes::TakesSuru, oldtype, inf, suruinftype[ix], results);
+            addInflectionVariant(str, hstr, hstr.size(), rusuffix, infsize, WordTypes::IchidanVerb, oldtype, inf, InfTypes::I, results);
+            ichidani = false;
         }
 
-    if (hstr.size() != 1)
-    {
-        for (int ix = 0, siz = tosigned(kuruinf.size()); ix != siz; ++ix)
+        switch (r.table)
         {
-            int len = kuruinf[ix].size();
-            if (hstr.size() >= len && qcharncmp(hstr.rightRef(len - 1).constData(), kuruinf[ix].rightData(len - 1), len - 1) == 0)
-            {
-                if (hstr.at(hstr.size() - len) == kuruinf[ix][0])
-                    addInflectionVariant(str, hstr, hstr.size() - len, kurukana, infsize, WordTypes::KuruVerb, oldtype, inf, kuruinftype[ix], results);
-                else if (hstr.at(hstr.size() - len) == QChar(0x6765) /* kuru kanji */ || hstr.at(hstr.size() - len) == QChar(0x4F86) /* kuru kanji variant */ )
-                    addInflectionVariant(str, hstr, hstr.size() - len + 1, QChar(0x308B) /* ru */, infsize, WordTypes::KuruVerb, oldtype, inf, kuruinftype[ix], results);
-            }
+        case DeinflectTable::Suru:
+            addInflectionVariant(str, hstr, hstr.size() - len, surukana, infsize, WordTypes::SuruVerb, oldtype, inf, inftype, results);
+            addInflectionVariant(str, hstr, hstr.size() - len, QString(), infsize, WordTypes::TakesSuru, oldtype, inf, inftype, results);
+            break;
+        case DeinflectTable::Kuru:
+        {
+            // Only the part after the first character of the suffix was matched. The first
+            // character can be the kuru kanji as well.
+            if (hstr.size() == 1 || hstr.size() < len)
+                break;
+            QChar ch = hstr.at(hstr.size() - len);
+            if (ch == (*t.list)[r.index][0])
+                addInflectionVariant(str, hstr, hstr.size() - len, kurukana, infsize, WordTypes::KuruVerb, oldtype, inf, inftype, results);
+            else if (ch == QChar(0x6765) /* kuru kanji */ || ch == QChar(0x4F86) /* kuru kanji variant */)
+                addInflectionVariant(str, hstr, hstr.size() - len + 1, rusuffix, infsize, WordTypes::KuruVerb, oldtype, inf, inftype, results);
+            break;
+        }
+        default:
+            addInflectionVariant(str, hstr, hstr.size() - len, deinflectsuffixes[(int)r.table], infsize, t.type, oldtype, inf, inftype, results);
         }
     }
 
-    for (int ix = 0, siz = tosigned(uinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(uinf[ix].size()) == uinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - uinf[ix].size(), QChar(0x3046) /* u */, infsize, WordTypes::GodanVerb, oldtype, inf, uinftype[ix], results);
-
-    for (int ix = 0, siz = tosigned(kuinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(kuinf[ix].size()) == kuinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - kuinf[ix].size(), QChar(0x304f) /* ku */, infsize, WordTypes::GodanVerb, oldtype, inf, kuinftype[ix], results);
-
-    for (int ix = 0, siz = tosigned(guinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(guinf[ix].size()) == guinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - guinf[ix].size(), QChar(0x3050) /* gu */, infsize, WordTypes::GodanVerb, oldtype, inf, guinftype[ix], results);
-
-    for (int ix = 0, siz = tosigned(suinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(suinf[ix].size()) == suinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - suinf[ix].size(), QChar(0x3059) /* su */, infsize, WordTypes::GodanVerb, oldtype, inf, suinftype[ix], results);
-
-    for (int ix = 0, siz = tosigned(tuinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(tuinf[ix].size()) == tuinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - tuinf[ix].size(), QChar(0x3064) /* tu */, infsize, WordTypes::GodanVerb, oldtype, inf, tuinftype[ix], results);
-
-    for (int ix = 0, siz = tosigned(nuinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(nuinf[ix].size()) == nuinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - nuinf[ix].size(), QChar(0x306C) /* nu */, infsize, WordTypes::GodanVerb, oldtype, inf, nuinftype[ix], results);
-
-    for (int ix = 0, siz = tosigned(buinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(buinf[ix].size()) == buinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - buinf[ix].size(), QChar(0x3076) /* bu */, infsize, WordTypes::GodanVerb, oldtype, inf, buinftype[ix], results);
-
-    for (int ix = 0, siz = tosigned(muinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(muinf[ix].size()) == muinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - muinf[ix].size(), QChar(0x3080) /* mu */, infsize, WordTypes::GodanVerb, oldtype, inf, muinftype[ix], results);
-
-    for (int ix = 0, siz = tosigned(r_uinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(r_uinf[ix].size()) == r_uinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - r_uinf[ix].size(), QChar(0x308B) /* ru */, infsize, WordTypes::GodanVerb, oldtype, inf, r_uinftype[ix], results);
-
-    if (inf.empty())
-        addInflectionVariant(str, hstr, hstr.size(), QChar(0x308B) /* ru */, infsize, WordTypes::IchidanVerb, oldtype, inf, InfTypes::I, results);
-
-    for (int ix = 0, siz = tosigned(ruinf.size()); ix != siz; ++ix)
-        if (hstr.rightRef(ruinf[ix].size()) == ruinf[ix])
-            addInflectionVariant(str, hstr, hstr.size() - ruinf[ix].size(), QChar(0x308B) /* ru */, infsize, WordTypes::IchidanVerb, oldtype, inf, ruinftype[ix], results);
+    if (ichidani)
+        addInflectionVariant(str, hstr, hstr.size(), rusuffix, infsize, WordTypes::IchidanVerb, oldtype, inf, InfTypes::I, results);
 }
 
 void deinflectAdjective(QString str, QString hstr, smartvector<InflectionForm> &results)
@@ -884,7 +1027,11 @@ void deinflectAdjective(QString str, QString hstr, smartvector<InflectionForm> &
 void deinflect(QString str, smartvector<InflectionForm> &result)
 {
     //smartvector<InflectionForm> inflections;
-    deinflectedForms(str, hiraganize(str), 0, std::vector<InfTypes>(), WordTypes::Count, result);
+
+    // Inflections found in each step of the deinflection, shared by every step.
+    std::vector<InfTypes> inf;
+    inf.reserve(16);
+    deinflectedForms(str, hiraganize(str), 0, inf, WordTypes::Count, result);
     //return inflections;
 }
 
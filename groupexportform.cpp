@@ -51,7 +51,10 @@ bool GroupExportForm::exec(Dictionary *dict)
 
 void GroupExportForm::exportClicked()
 {
-    QString fname = QFileDialog::getSaveFileName(nullptr, tr("Save export file"), QString(), QString("%1 (*.zkanji.export)").arg(tr("Export file")));
+    QString textfilter = QString("%1 (*.zkanji.export)").arg(tr("Export file"));
+    QString binaryfilter = QString("%1 (*.zkanji.bexport)").arg(tr("Binary export file"));
+    QString selfilter;
+    QString fname = QFileDialog::getSaveFileName(nullptr, tr("Save export file"), QString(), textfilter + ";;" + binaryfilter, &selfilter);
     if (fname.isEmpty())
         closeCancel();
 
@@ -78,7 +81,10 @@ void GroupExportForm::exportClicked()
     }
 
     Dictionary *dict = ZKanji::dictionary(ZKanji::dictionaryPosition(ui->dictCBox->currentIndex()));
-    dict->exportUserData(fname, kanjilist, ui->kanjiBox->isChecked(), wordslist, ui->wordsBox->isChecked());
+    // The binary format is faster to write and import for large groups, but only zkanji can
+    // read it.
+    bool binary = selfilter == binaryfilter || fname.endsWith(".zkanji.bexport");
+    dict->exportUserData(fname, kanjilist, ui->kanjiBox->isChecked(), wordslist, ui->wordsBox->isChecked(), binary);
 
     closeOk();
 }
@@ -19,6 +19,7 @@
 #include "grammar_enums.h"
 #include "zdictionarymodel.h"
 #include "zkanjigridmodel.h"
+#include "userjournal.h"
 
 #include "checked_cast.h"
 
@@ -1005,12 +1006,12 @@ void GroupCategoryBase::selectTopItems(const std::vector<GroupBase*> &src, std::
 //    ;
 //}
 
-WordGroup::WordGroup(WordGroupCategory *parent, QString name) : base(parent, name), study(this)
+WordGroup::WordGroup(WordGroupCategory *parent, QString name) : base(parent, name), poshashvalid(false), study(this)
 {
     ;
 }
 
-WordGroup::WordGroup(WordGroup &&src) : base(nullptr), study(this)
+WordGroup::WordGroup(WordGroup &&src) : base(nullptr), poshashvalid(false), study(this)
 {
     *this = std::forward<WordGroup>(src);
 }
@@ -1020,6 +1021,8 @@ WordGroup& WordGroup::operator=(WordGroup &&src)
     base::operator=(std::forward<WordGroup>(src));
     std::swap(study, src.study);
     std::swap(list, src.list);
+    invalidatePositions();
+    src.invalidatePositions();
     //std::swap(defs, src.defs);
 
     return *this;
@@ -1036,10 +1039,8 @@ void WordGroup::load(QDataStream &stream)
 
     stream >> make_zvec<qint32, qint32>(list);
     for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
-    {
-        owner().groupsOfWord(list[ix]).push_front(this);
-        dictionary()->wordEntry(list[ix])->dat |= (1 << (int)WordRuntimeData::InGroup);
-    }
+        owner().addWordGroup(list[ix], this);
+    invalidatePositions();
 
     study.load(stream);
 }
@@ -1072,6 +1073,7 @@ void WordGroup::copy(GroupBase *src)
     base::copy(src);
     modelptr.reset();
     list = ((WordGroup*)src)->list;
+    invalidatePositions();
     study.copy(&((WordGroup*)src)->study);
 }
 
@@ -1098,6 +1100,8 @@ void WordGroup::applyChanges(const std::map<int, int> &changes)
 
     study.applyChanges(changes);
 
+    invalidatePositions();
+
     if (changed)
         dictionary()->setToUserModified();
 }
@@ -1107,42 +1111,18 @@ void WordGroup::processRemovedWord(int windex)
     study.processRemovedWord(windex);
 
     int pos = removeIndexFromList(windex, list);
+    invalidatePositions();
     if (pos != -1)
         emit owner().itemsRemoved(this, { { pos, pos } });
 }
 
 void WordGroup::clear()
 {
+    WordGroups &o = owner();
     for (int ix = 0, siz = tosigned(size()); ix != siz; ++ix)
-    {
-        int wix = list[ix];
-        if (owner().wordHasGroups(wix))
-        {
-            auto g = owner().groupsOfWord(wix);
-
-            // Opening a scope here, to make sure `it` and `itn` are freed before their
-            // parent list gets deleted in checkGroupsOfWord below, to satisfy the
-            // VS' dumb debug version of the STL.
-            {
-                auto it = g.before_begin();
-                auto itn = std::next(it);
-                while (itn != g.end())
-                {
-                    if (*itn == this)
-                    {
-                        g.erase_after(it);
-                        break;
-                    }
-                    ++it;
-                    ++itn;
-                }
-            }
-
-            if (g.empty())
-                owner().checkGroupsOfWord(wix);
-        }
-    }
+        o.removeWordGroup(list[ix], this);
     list.clear();
+    invalidatePositions();
 }
 
 size_t WordGroup::size() const
@@ -1211,13 +1191,26 @@ int WordGroup::indexes(int pos) const
     return list[pos];
 }
 
+bool WordGroup::contains(int windex) const
+{
+    return owner().wordInGroup(windex, this);
+}
+
 int WordGroup::indexOf(int windex) const
 {
-    auto it = std::find(list.begin(), list.end(), windex);
-    if (it == list.end())
+    if (!contains(windex))
         return -1;
 
-    return it - list.begin();
+    if (!poshashvalid)
+    {
+        poshash.clear();
+        poshash.reserve(tosigned(list.size()));
+        for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
+            poshash.insert(list[ix], ix);
+        poshashvalid = true;
+    }
+
+    return poshash.value(windex, -1);
 }
 
 void WordGroup::indexOf(const std::vector<int> &windexes, std::vector<int> &positions) const
@@ -1225,39 +1218,18 @@ void WordGroup::indexOf(const std::vector<int> &windexes, std::vector<int> &posi
     if (windexes.empty())
         return;
 
-    // An ordering of list by word index.
-    std::vector<int> order;
-    order.reserve(list.size());
-    for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
-        order.push_back(ix);
-    std::sort(order.begin(), order.end(), [this](int a, int b) { return list[a] < list[b]; });
-
-    std::vector<int> worder = windexes;
-    std::sort(worder.begin(), worder.end());
-
-    positions.clear();
-
-    int opos = std::lower_bound(order.begin(), order.end(), worder.front(), [this](int ord, int wix) { return list[ord] < wix; }) - order.begin();
-    for (int wpos = 0, wsiz = tosigned(worder.size()), osiz = tosigned(order.size()); wpos != wsiz && opos != osiz;)
+    std::vector<int> result;
+    result.reserve(windexes.size());
+    for (int windex : windexes)
     {
-        while (wpos != wsiz && worder[wpos] < list[order[opos]])
-            ++wpos;
-        if (wpos == wsiz)
-            break;
-        while (opos != osiz && worder[wpos] > list[order[opos]])
-            ++opos;
-        if (opos == osiz)
-            break;
-
-        while (opos != osiz && wpos != wsiz && worder[wpos] == list[order[opos]])
-        {
-            positions.push_back(order[opos]);
-            ++opos;
-            ++wpos;
-        }
+        int pos = indexOf(windex);
+        if (pos != -1)
+            result.push_back(pos);
     }
 
-    std::sort(positions.begin(), positions.end());
+    std::sort(result.begin(), result.end());
+    result.resize(std::unique(result.begin(), result.end()) - result.begin());
+    positions.swap(result);
 }
 
 
@@ -1326,27 +1298,24 @@ int WordGroup::insert(int windex, int pos)
     if (pos == -1)
         pos = tosigned(list.size());
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     // Check whether the entry is already added to this group to not add it again.
 
-    std::forward_list<WordGroup*> wg = owner().groupsOfWord(windex);
-    auto git = std::find(wg.begin(), wg.end(), this);
-    if (git != wg.end())
+    if (contains(windex))
     {
         // Word entry already added. Just return its position.
-
-        auto it = std::find(list.begin(), list.end(), windex);
-        return it - list.begin();
+        return indexOf(windex);
     }
 
-    // Word entry wasn't added. Set its dat to remember that it has been added here.
-
-    dictionary()->wordEntry(windex)->dat |= (1 << (int)WordRuntimeData::InGroup);
     list.insert(list.begin() + pos, windex);
+    invalidatePositions();
 
-    // The wg list holds which groups have the word entry. It must be updated.
-    wg.push_front(this);
+    // Remember which groups have the word entry, and mark the word as being in a group.
+    owner().addWordGroup(windex, this);
 
     dictionary()->setToUserModified();
+    dictionary()->userJournal()->wordGroupInsert(this, { windex }, pos);
     emit owner().itemsInserted(this, { { pos, 1 } });
 
     return pos;
@@ -1367,81 +1336,59 @@ int WordGroup::insert(const std::vector<int> &windexes, int pos, std::vector<int
     if (pos == -1)
         pos = tosigned(list.size());
 
-    // To avoid adding duplicate words, the list of words and the windexes are both sorted
-    // and checked for duplicates.
+    // To avoid adding duplicate words, the windexes are looked up in the group first.
 
     if (windexes.empty())
         return 0;
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     if (windexes.size() == 1)
     {
         // Special case.
 
         int s = tosigned(list.size());
 
-        pos = insert(windexes.front(), pos);
+        int wpos = insert(windexes.front(), pos);
 
         if (positions != nullptr)
-            positions->push_back(pos);
+            positions->push_back(wpos);
 
         // list size is changed in the insert() above.
-        return s == tosigned(list.size()) ? 0 : 1;
-    }
+        if (s == tosigned(list.size()))
+            return 0;
 
-    // Pairs of [index in list, word index].
-    std::vector<std::pair<int, int>> listorder;
-    listorder.reserve(list.size());
-    for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
-        listorder.push_back(std::make_pair(ix, list[ix]));
-    std::sort(listorder.begin(), listorder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) { return a.second < b.second; });
-
-    // Pairs of [index in windexes, word index].
-    std::vector<std::pair<int, int>> worder;
-    worder.reserve(windexes.size());
-    for (int ix = 0, siz = tosigned(windexes.size()); ix != siz; ++ix)
-        worder.push_back(std::make_pair(ix, windexes[ix]));
-    std::sort(worder.begin(), worder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) { return a.second < b.second; });
+        dictionary()->userJournal()->wordGroupInsert(this, windexes, pos);
+        return 1;
+    }
 
     if (positions != nullptr)
         positions->reserve(windexes.size());
 
-    int added = tosigned(windexes.size());
+    // Word indexes to be inserted. To show that a word has already been added, its word
+    // index is changed to a negative value. The value is set to [-1 - word's old position in
+    // list]. This value will be used later to update the positions list.
+    std::vector<int> worder = windexes;
 
-    for (int ix = 0, wix = 0, siz = tosigned(listorder.size()), wsiz = tosigned(worder.size()); ix != siz && wix != wsiz; )
+    int added = tosigned(windexes.size());
+    for (int &val : worder)
     {
-        if (listorder[ix].second < worder[wix].second)
+        int oldpos = indexOf(val);
+        if (oldpos != -1)
         {
-            // Word in group but not in windexes.
-            ++ix;
-            continue;
-        }
-
-        if (listorder[ix].second == worder[wix].second)
-        {
-            // To show that a word has already been added, its word index is changed to a
-            // negative value. The value is set to [-1 - word's old position in list]. This
-            // value will be used later to update the positions list.
-            worder[wix].second = -1 - listorder[ix].first;
-
-            ++ix;
+            val = -1 - oldpos;
             --added;
         }
-
-        ++wix;
     }
 
-    // Restore the original order of the entry indexes to be inserted.
-    std::sort(worder.begin(), worder.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
-        return a.first < b.first;
-    });
-
     if (positions == nullptr && added == 0)
         return 0;
 
     list.insert(list.begin() + pos, added, 0);
+    invalidatePositions();
     for (int ix = 0, aix = 0, siz = tosigned(worder.size()); ix != siz; ++ix)
     {
-        int val = worder[ix].second;
+        int val = worder[ix];
         if (val < 0)
         {
             // Word already in group.
@@ -1460,14 +1407,10 @@ int WordGroup::insert(const std::vector<int> &windexes, int pos, std::vector<int
             continue;
         }
 
-        // Mark the word as present in a group.
-        dictionary()->wordEntry(val)->dat |= (1 << (int)WordRuntimeData::InGroup);
-
         list[pos + aix] = val;
 
-        // The list that holds which groups have the word entry must be updated.
-        std::forward_list<WordGroup*> wg = owner().groupsOfWord(val);
-        wg.push_front(this);
+        // Update the groups of the word and mark it as present in a group.
+        owner().addWordGroup(val, this);
 
         if (positions != nullptr)
             positions->push_back(pos + aix);
@@ -1478,6 +1421,7 @@ int WordGroup::insert(const std::vector<int> &windexes, int pos, std::vector<int
     if (added != 0)
     {
         dictionary()->setToUserModified();
+        dictionary()->userJournal()->wordGroupInsert(this, windexes, pos);
         emit owner().itemsInserted(this, { { pos, added } });
     }
 
@@ -1500,6 +1444,8 @@ void WordGroup::remove(const smartvector<Range> &ranges)
     if (ranges.empty())
         return;
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     //std::vector<int> sorted = indexes;
 
     //std::sort(sorted.begin(), sorted.end());
@@ -1543,6 +1489,8 @@ void WordGroup::remove(const smartvector<Range> &ranges)
     }
 
     dictionary()->setToUserModified();
+    dictionary()->userJournal()->wordGroupRemove(this, ranges);
+
     emit owner().itemsRemoved(this, ranges);
 }
 
@@ -1554,19 +1502,28 @@ void WordGroup::move(const smartvector<Range> &ranges, int pos)
     if (pos == -1)
         pos = tosigned(list.size());
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     if (_moveRanges(ranges, pos, list))
+    {
+        invalidatePositions();
         dictionary()->setToUserModified();
+        dictionary()->userJournal()->wordGroupMove(this, ranges, pos);
+    }
     emit owner().itemsMoved(this, ranges, pos);
 }
 
 void WordGroup::removeAt(int index)
 {
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     removeFromGroup(index);
 
     //emit owner().beginItemsRemove(this, index, index);
 
     list.erase(list.begin() + index);
     dictionary()->setToUserModified();
+    dictionary()->userJournal()->wordGroupRemove(this, index, index);
 
     emit owner().itemsRemoved(this, { { index, 1 } }/*, index, index*/);
 }
@@ -1578,6 +1535,8 @@ void WordGroup::removeRange(int first, int last)
         throw "Invalid range.";
 #endif
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     //emit owner().beginItemsRemove(this, first, last);
 
     for (int ix = last; ix != first - 1; --ix)
@@ -1585,6 +1544,7 @@ void WordGroup::removeRange(int first, int last)
 
     list.erase(list.begin() + first, list.begin() + last + 1);
     dictionary()->setToUserModified();
+    dictionary()->userJournal()->wordGroupRemove(this, first, last);
 
     emit owner().itemsRemoved(this, { { first, last } }/*, first, last*/);
 }
@@ -1632,38 +1592,23 @@ const WordGroups& WordGroup::owner() const
 
 void WordGroup::removeFromGroup(int index)
 {
-    int windex = list[index];
-
-    // Check whether the word is added to this group first, and erase it from the list of
-    // groups for this word.
-    std::forward_list<WordGroup*> wg = owner().groupsOfWord(windex);
-    bool found = false;
-
-    if (!wg.empty())
-    {
-        auto preit = wg.before_begin();
-        auto it = std::next(preit);
-        while (it != wg.end())
-        {
-            if (*it == this)
-            {
-                wg.erase_after(preit);
-                found = true;
-                break;
-            }
-            preit = it;
-            it = std::next(preit);
-        }
-
-    }
+    // The positions of the words after index change when the caller erases it from list.
+    invalidatePositions();
 
 #ifdef _DEBUG
-    if (!found)
+    if (!owner().removeWordGroup(list[index], this))
         throw "Word at specific index wasn't in the global list of words.";
+#else
+    owner().removeWordGroup(list[index], this);
 #endif
+}
 
-    if (wg.empty())
-        owner().checkGroupsOfWord(windex);
+void WordGroup::invalidatePositions()
+{
+    if (!poshashvalid)
+        return;
+    poshashvalid = false;
+    poshash.clear();
 }
 
 //void WordGroup::_move(int first, int last, int pos)
@@ -1992,7 +1937,9 @@ WordGroups::~WordGroups()
 void WordGroups::clear()
 {
     base::clear();
-    wordsgroups.clear();
+    wordslots.clear();
+    slotgroups.clear();
+    freeslots.clear();
 
     //if (qApp->eventDispatcher() != nullptr)
     emit groupsReseted();
@@ -2000,32 +1947,11 @@ void WordGroups::clear()
 
 void WordGroups::applyChanges(const std::map<int, int> &changes)
 {
-    // Fix the words' groups listing.
-    std::map<int, std::forward_list<WordGroup*>> tmp;
-    for (auto it = wordsgroups.begin(); it != wordsgroups.end(); ++it)
-    {
-        auto ch = changes.find(it->first);
-        if (ch->second != -1)
-        {
-            std::forward_list<WordGroup*> &tmplist = tmp[ch->second];
-            if (tmplist.empty())
-            {
-                tmplist = std::move(it->second);
-                dictionary()->wordEntry(ch->second)->dat |= (1 << (int)WordRuntimeData::InGroup);
-            }
-            else
-                tmplist.insert_after(tmplist.before_begin(), it->second.begin(), it->second.end());
-        }
-    }
-    std::swap(tmp, wordsgroups);
-    for (auto it = wordsgroups.begin(); it != wordsgroups.end(); ++it)
-    {
-        it->second.sort();
-        it->second.unique();
-    }
-
     // Apply changes in categories and their groups recursively.
     groupsApplyChanges(this, changes);
+
+    // The groups hold the new word indexes. The words' groups listing is built from them.
+    fixWordsGroups();
     //for (int ix = 0; ix != groups.size(); ++ix)
     //    groups.items(ix)->applyChanges(changes);
 
@@ -2041,19 +1967,17 @@ void WordGroups::copy(WordGroups *src)
 
 void WordGroups::processRemovedWord(int windex)
 {
-    // Rebuilding the wordsgroups mapping.
-
-    std::map<int, std::forward_list<WordGroup*>> tmp;
-    std::swap(tmp, wordsgroups);
-
-    for (auto it = tmp.begin(); it != tmp.end(); ++it)
+    // Freeing the slot of the removed word, and moving the slots of words above it down.
+    if (windex < tosigned(wordslots.size()))
     {
-        if (it->first < windex)
-            wordsgroups[it->first] = std::move(it->second);
-        else if (it->first > windex)
-            wordsgroups[it->first - 1] = std::move(it->second);
+        int slot = wordslots[windex];
+        if (slot != -1)
+        {
+            slotgroups[slot].clear();
+            freeslots.push_back(slot);
+        }
+        wordslots.erase(wordslots.begin() + windex);
     }
-    tmp.clear();
 
     // Removing the word from each group.
     walkGroups([windex](GroupBase *g) { ((WordGroup*)g)->processRemovedWord(windex); });
@@ -2069,35 +1993,75 @@ const Dictionary* WordGroups::dictionary() const
     return owner->dictionary();
 }
 
-std::forward_list<WordGroup*>& WordGroups::groupsOfWord(int windex)
+const std::vector<WordGroup*>& WordGroups::groupsOfWord(int windex) const
 {
-    //auto it = wordsgroups.find(windex);
-
-    //if (it != wordsgroups.end())
-    //    return it->second;
-
-    return wordsgroups[windex];
+    static const std::vector<WordGroup*> empty;
+    if (windex < 0 || windex >= tosigned(wordslots.size()) || wordslots[windex] == -1)
+        return empty;
+    return slotgroups[wordslots[windex]];
 }
 
 bool WordGroups::wordHasGroups(int windex) const
 {
-    return wordsgroups.find(windex) != wordsgroups.end();
+    return windex >= 0 && windex < tosigned(wordslots.size()) && wordslots[windex] != -1;
+}
+
+bool WordGroups::wordInGroup(int windex, const WordGroup *g) const
+{
+    const std::vector<WordGroup*> &groups = groupsOfWord(windex);
+    return std::find(groups.begin(), groups.end(), g) != groups.end();
 }
 
 int WordGroups::wordsInGroups() const
 {
-    return tosigned(wordsgroups.size());
+    return tosigned(slotgroups.size() - freeslots.size());
 }
 
-void WordGroups::checkGroupsOfWord(int windex)
+void WordGroups::addWordGroup(int windex, WordGroup *g)
 {
-    auto it = wordsgroups.find(windex);
-    if (it == wordsgroups.end() || it->second.empty())
+    if (windex >= tosigned(wordslots.size()))
+        wordslots.resize(std::max(windex + 1, dictionary()->entryCount()), -1);
+
+    int &slot = wordslots[windex];
+    if (slot == -1)
     {
+        if (!freeslots.empty())
+        {
+            slot = freeslots.back();
+            freeslots.pop_back();
+        }
+        else
+        {
+            slot = tosigned(slotgroups.size());
+            slotgroups.emplace_back();
+        }
+        dictionary()->wordEntry(windex)->dat |= (1 << (int)WordRuntimeData::InGroup);
+    }
+
+    slotgroups[slot].push_back(g);
+}
+
+bool WordGroups::removeWordGroup(int windex, WordGroup *g)
+{
+    if (!wordHasGroups(windex))
+        return false;
+
+    int slot = wordslots[windex];
+    std::vector<WordGroup*> &groups = slotgroups[slot];
+    auto it = std::find(groups.begin(), groups.end(), g);
+    if (it == groups.end())
+        return false;
+
+    groups.erase(it);
+    if (groups.empty())
+    {
+        // Release the memory of the list, as a free slot might not be used for a long time.
+        std::vector<WordGroup*>().swap(groups);
+        freeslots.push_back(slot);
+        wordslots[windex] = -1;
         dictionary()->wordEntry(windex)->dat &= ~(1 << (int)WordRuntimeData::InGroup);
-        if (it != wordsgroups.end())
-            wordsgroups.erase(it);
     }
+    return true;
 }
 
 WordGroup* WordGroups::groupFromEncodedName(const QString &fullname, int pos, int len, bool create)
@@ -2144,7 +2108,14 @@ void WordGroups::groupsApplyChanges(GroupCategoryBase *cat, const std::map<int,
 
 void WordGroups::fixWordsGroups()
 {
-    wordsgroups.clear();
+    Dictionary *dict = dictionary();
+    for (int ix = 0, siz = std::min(tosigned(wordslots.size()), dict->entryCount()); ix != siz; ++ix)
+        if (wordslots[ix] != -1)
+            dict->wordEntry(ix)->dat &= ~(1 << (int)WordRuntimeData::InGroup);
+
+    wordslots.clear();
+    slotgroups.clear();
+    freeslots.clear();
 
     std::list<WordGroupCategory*> stack;
 
@@ -2162,10 +2133,7 @@ void WordGroups::fixWordsGroups()
         {
             WordGroup *g = cat->items(ix);
             for (int iy = 0, siy = tosigned(g->size()); iy != siy; ++iy)
-            {
-                auto wg = groupsOfWord(g->indexes(iy));
-                wg.push_front(g);
-            }
+                addWordGroup(g->indexes(iy), g);
         }
     }
 }
@@ -2347,12 +2315,15 @@ int KanjiGroup::insert(ushort kindex, int pos)
     if (pos == -1)
         pos = tosigned(list.size());
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     auto it = std::find(list.begin(), list.end(), kindex);
     if (it != list.end())
         return it - list.begin();
 
     list.insert(list.begin() + pos, kindex);
     dictionary()->setToUserModified();
+    dictionary()->userJournal()->kanjiGroupInsert(this, { kindex }, pos);
     emit owner().itemsInserted(this, { { pos, 1 } });
 
     return pos;
@@ -2367,6 +2338,9 @@ void KanjiGroup::remove(const smartvector<Range> &ranges)
 {
     if (ranges.empty())
         return;
+
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     //std::vector<int> sorted = indexes;
 
     //std::sort(sorted.begin(), sorted.end());
@@ -2402,6 +2376,8 @@ void KanjiGroup::remove(const smartvector<Range> &ranges)
     }
 
     dictionary()->setToUserModified();
+    dictionary()->userJournal()->kanjiGroupRemove(this, ranges);
+
     emit owner().itemsRemoved(this, ranges);
 }
 
@@ -2421,19 +2397,25 @@ int KanjiGroup::insert(const std::vector<ushort> &kindexes, int pos, std::vector
     if (kindexes.empty())
         return 0;
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     if (kindexes.size() == 1)
     {
         // Special case.
 
         int s = tosigned(list.size());
 
-        pos = insert(kindexes.front(), pos);
+        int kpos = insert(kindexes.front(), pos);
 
         if (positions != nullptr)
-            positions->push_back(pos);
+            positions->push_back(kpos);
 
         // list size is changed in the insert() above.
-        return s == tosigned(list.size()) ? 0 : 1;
+        if (s == tosigned(list.size()))
+            return 0;
+
+        dictionary()->userJournal()->kanjiGroupInsert(this, kindexes, pos);
+        return 1;
     }
 
     // Pairs of [index in list, kanji index].
@@ -2517,6 +2499,9 @@ int KanjiGroup::insert(const std::vector<ushort> &kindexes, int pos, std::vector
     }
 
     dictionary()->setToUserModified();
+    if (added != 0)
+        dictionary()->userJournal()->kanjiGroupInsert(this, kindexes, pos);
+
     emit owner().itemsInserted(this, { { pos, added } });
 
     return added;
@@ -2527,8 +2512,13 @@ void KanjiGroup::move(const smartvector<Range> &ranges, int pos)
     if (ranges.empty())
         return;
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     if (_moveRanges(ranges, pos, list))
+    {
         dictionary()->setToUserModified();
+        dictionary()->userJournal()->kanjiGroupMove(this, ranges, pos);
+    }
 
     emit owner().itemsMoved(this, ranges, pos);
 }
@@ -2540,9 +2530,12 @@ void KanjiGroup::removeAt(int index)
         throw "Kanji remove index out of range.";
 #endif
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     //emit owner().beginItemsRemove(this, index, index);
     list.erase(list.begin() + index);
     dictionary()->setToUserModified();
+    dictionary()->userJournal()->kanjiGroupRemove(this, index, index);
 
     emit owner().itemsRemoved(this, { { index, index } }/*, first, last*/);
 }
@@ -2554,9 +2547,12 @@ void KanjiGroup::removeRange(int first, int last)
         throw "Kanji remove index out of range.";
 #endif
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     //emit owner().beginItemsRemove(this, first, last);
     list.erase(list.begin() + first, list.begin() + last + 1);
     dictionary()->setToUserModified();
+    dictionary()->userJournal()->kanjiGroupRemove(this, first, last);
 
     emit owner().itemsRemoved(this, { { first, last } }/*, first, last*/);
 }
@@ -9,8 +9,9 @@
 
 #include <QCoreApplication>
 #include <QDateTime>
+#include <QHash>
 #include <memory>
-#include <forward_list>
+#include <vector>
 #include <functional>
 #include <memory>
 #include "smartvector.h"
@@ -433,6 +434,8 @@ public:
     // Returns the word at the given position in the group.
     int indexes(int pos) const;
 
+    // Returns whether the word is in the group.
+    bool contains(int windex) const;
     // Returns the index of a word in the group. Returns -1 if the word is not in the group.
     int indexOf(int windex) const;
     // Fills positions with the group index of every word index. If a word is not found, it's
@@ -508,12 +511,14 @@ protected:
     WordGroup(WordGroup &&src);
     WordGroup& operator=(WordGroup &&src);
 private:
-    // Removes this group from the word's list of groups. If the group doesn't remain in any
-    // group, the list is deleted and the flag marking the word as being in a group is
-    // cleared. In _DEBUG mode, throws exception if group is not in the global list of groups
-    // for that word.
+    // Removes this group from the groups of the word at index. If the word doesn't remain in
+    // any group, the flag marking the word as being in a group is cleared. In _DEBUG mode,
+    // throws exception if group is not in the global list of groups for that word.
     void removeFromGroup(int index);
 
+    // Marks the position hash out of date after list changed.
+    void invalidatePositions();
+
     // Moves items between first and last to pos. The passed range is guaranteed to be outside
     // pos, but can be below or above it. Pos refers to an item position before the move.
     // First and last are both inclusive positions.
@@ -521,6 +526,11 @@ private:
 
     std::vector<int> list;
 
+    // [word index, position in list] for every word in the group. Only built when looking up
+    // positions of words, and rebuilt after list changed.
+    mutable QHash<int, int> poshash;
+    mutable bool poshashvalid;
+
     std::unique_ptr<DictionaryGroupItemModel> modelptr;
 
     WordStudy study;
@@ -561,21 +571,17 @@ public:
     virtual Dictionary* dictionary() override;
     virtual const Dictionary* dictionary() const override;
 
-    // Returns the list of groups a word is placed in. If the word was not added to a group,
-    // an empty list is created and returned that can be used for expanding. To avoid creating
-    // this list for words not in a group, check first with wordHasGroups().
-    std::forward_list<WordGroup*>& groupsOfWord(int windex);
+    // Returns the list of groups a word is placed in. The list is empty if the word is not in
+    // any group.
+    const std::vector<WordGroup*>& groupsOfWord(int windex) const;
     // Returns whether a word is placed in any group.
     bool wordHasGroups(int windex) const;
-
+    // Returns whether a word is placed in the group g.
+    bool wordInGroup(int windex, const WordGroup *g) const;
 
     // Returns the total number of words added to a group.
     int wordsInGroups() const;
 
-    // Checks whether the word of windex is still in a group, and if not, removes its
-    // groupsOfWord entry, and unsets the inGroup tag for the word.
-    void checkGroupsOfWord(int windex);
-
     // Returns a word group with the full name (includes paths and encoded with ^.) If the
     // group does not exist, the value of create determines whether a group will be created
     // and returned. Otherwise returns the existing or created group.
@@ -594,17 +600,31 @@ private:
     // Calls applyChanges for the passed category's items and sub categories.
     void groupsApplyChanges(GroupCategoryBase *cat, const std::map<int, int> &changes);
 
-    // Newly creates the data in wordsgroups.
+    // Adds g to the groups of the word, and sets the word's inGroup tag. The word must not
+    // be in g yet.
+    void addWordGroup(int windex, WordGroup *g);
+    // Removes g from the groups of the word. If the word doesn't remain in any group, its
+    // slot is freed and the inGroup tag of the word is unset. Returns false if the word was
+    // not in g.
+    bool removeWordGroup(int windex, WordGroup *g);
+
+    // Newly creates the data in wordslots and slotgroups from the words of every group.
     void fixWordsGroups();
 
     Groups *owner;
 
-    // [word index, groups list] where the word is found in.
-    std::map<int, std::forward_list<WordGroup*>> wordsgroups;
+    // Slot in slotgroups of every word index, or -1 for words not in any group. Word indexes
+    // at or above the size of wordslots are not in any group either.
+    std::vector<int> wordslots;
+    // Groups each word is found in, at the slot of the word. Slots of words removed from
+    // every group are empty, and are listed in freeslots to be reused.
+    std::vector<std::vector<WordGroup*>> slotgroups;
+    std::vector<int> freeslots;
 
     // Group last selected in a word to group dialog as destination.
     WordGroup *lastgroup;
 
+    friend class WordGroup;
     typedef WordGroupCategory base;
 };
 
@@ -44,27 +44,16 @@ void WordGroup::loadLegacy(QDataStream &stream, bool isstudy, int version)
 
         // Check whether we have a duplicate because another meaning of the
         // same word was added to the group.
-        bool duplicate = 0;
-        std::forward_list<WordGroup*> wg = owner().groupsOfWord(index);
-        for (WordGroup *g : wg)
-        {
-            if (g == this)
-            {
-                duplicate = true;
-                break;
-            }
-        }
-
-        if (!duplicate)
+        if (!owner().wordInGroup(index, this))
         {
             indextmp.push_back(tosigned(list.size()));
             list.push_back(index);
-            wg.push_front(this);
-            dictionary()->wordEntry(index)->dat |= (1 << (int)WordRuntimeData::InGroup);
+            owner().addWordGroup(index, this);
         }
         else
             indextmp.push_back(-1);
     }
+    invalidatePositions();
 
     if (isstudy)
         study.loadLegacy(stream, studymethod, version, indextmp);
@@ -11,6 +11,9 @@
 #include <QtEndian>
 
 #include <set>
+#include <map>
+#include <cstring>
+#include <cstdlib>
 
 #include "import.h"
 #include "ui_import.h"
@@ -28,6 +31,8 @@
 #include "jlptreplaceform.h"
 #include "generalsettings.h"
 #include "globalui.h"
+#include "wordkeytable.h"
+#include "taskscheduler.h"
 
 #include "checked_cast.h"
 
@@ -1172,6 +1177,7 @@ bool DictImport::doImportDict()
         if (!importKanjidic())
             return false;
 
+        ZKanji::packKanjiText();
         ZKanji::generateValidKanji();
 
         if (!importRadFiles())
@@ -2925,6 +2931,15 @@ bool DictImport::doImportUserData()
     if (!setInfoText(tr("Opening export file...")))
         return false;
 
+    {
+        QFile f(path);
+        if (f.open(QIODevice::ReadOnly) && f.peek(3) == "zux")
+        {
+            f.close();
+            return doImportUserDataBinary();
+        }
+    }
+
     if (!file.open(path))
     {
         setErrorText(tr("Couldn't open file for reading."));
@@ -2943,6 +2958,10 @@ bool DictImport::doImportUserData()
         return false;
     ++step;
 
+    // Words in the file are looked up by their key instead of searching the dictionary.
+    WordKeyTable wordkeys;
+    wordkeys.build(dict);
+
     QString str;
 
     while (file.getLine(str))
@@ -3002,7 +3021,7 @@ bool DictImport::doImportUserData()
                     return false;
                 }
 
-                int windex = dict->findKanjiKanaWord(kanji, kana);
+                int windex = wordkeys.find(kanji, kana);
                 if (windex == -1)
                 {
                     setInfoText(tr("Word %1(%2) missing from dictionary for studied word definition.").arg(kanji).arg(kana));
@@ -3066,7 +3085,7 @@ bool DictImport::doImportUserData()
                         return false;
                     }
 
-                    int windex = dict->findKanjiKanaWord(kanji, kana);
+                    int windex = wordkeys.find(kanji, kana);
 
                     if (windex == -1)
                         setInfoText(tr("Word %1(%2) missing from dictionary, as example for kanji: %3").arg(kanji).arg(kana).arg(str.at(0)));
@@ -3192,7 +3211,7 @@ bool DictImport::doImportUserData()
 
                     ++pos;
 
-                    int windex = dict->findKanjiKanaWord(kanji, kana);
+                    int windex = wordkeys.find(kanji, kana);
 
                     if (windex == -1)
                     {
@@ -3214,6 +3233,313 @@ bool DictImport::doImportUserData()
     return true;
 }
 
+bool DictImport::doImportUserDataBinary()
+{
+    // See Dictionary::exportUserDataBinary() in words.cpp for the file format.
+
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly))
+    {
+        setErrorText(tr("Couldn't open file for reading."));
+        return false;
+    }
+
+    if (!setInfoText(tr("Opened file, reading...")))
+        return false;
+
+    ui->progressBar->setMaximum(f.size());
+
+    QDataStream stream(&f);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    char tmp[7];
+    tmp[6] = 0;
+    stream.readRawData(tmp, 6);
+
+    int ver = atol(tmp + 3);
+    if (strncmp(tmp, "zux", 3) || ver != 1)
+    {
+        setErrorText(tr("Unsupported export file version."));
+        return false;
+    }
+
+    if (!setInfoText(tr("%1/%2 - Processing file...").arg(step).arg(stepcnt)))
+        return false;
+    ++step;
+
+    WordKeyTable wordkeys;
+    wordkeys.build(dict);
+
+    // Dictionary index of every word in the word list of the file, or -1 for words missing
+    // from the dictionary.
+    std::vector<int> wlist;
+    // Written form and kana of the missing words, for the info texts. The key is the word's
+    // position in wlist.
+    std::map<int, std::pair<QString, QString>> missing;
+
+    // Returns the dictionary index of the word at pos in the word list. Returns -2 for
+    // invalid positions.
+    auto listedWord = [&wlist](qint32 pos) {
+        if (pos < 0 || pos >= tosigned(wlist.size()))
+            return -2;
+        return wlist[pos];
+    };
+    auto invalidData = [this]() {
+        setErrorText(tr("Invalid data in export file."));
+        return false;
+    };
+
+    try
+    {
+        quint8 section;
+        stream >> section;
+        while (stream.status() == QDataStream::Ok && section != (quint8)UserExportSection::End)
+        {
+            if (section == (quint8)UserExportSection::Words)
+            {
+                std::vector<quint64> keys;
+                std::vector<QString> kanji;
+                std::vector<QString> kana;
+
+                qint32 cnt;
+                stream >> cnt;
+                while (cnt > 0 && stream.status() == QDataStream::Ok)
+                {
+                    if (cnt > userExportChunkSize)
+                        return invalidData();
+
+                    keys.resize(cnt);
+                    kanji.resize(cnt);
+                    kana.resize(cnt);
+                    for (int ix = 0; ix != cnt; ++ix)
+                    {
+                        stream >> keys[ix];
+                        stream >> make_zstr(kanji[ix], ZStrFormat::Byte);
+                        stream >> make_zstr(kana[ix], ZStrFormat::Byte);
+                    }
+                    if (stream.status() != QDataStream::Ok)
+                        return invalidData();
+
+                    // The words of the chunk are matched with the dictionary on several
+                    // threads.
+                    int first = tosigned(wlist.size());
+                    wlist.resize(first + cnt);
+                    parallelFor(0, cnt, 256, [&wordkeys, &wlist, &keys, &kanji, &kana, first](int a, int b) {
+                        for (int ix = a; ix != b; ++ix)
+                            wlist[first + ix] = wordkeys.find(keys[ix], kanji[ix].constData(), kanji[ix].size(), kana[ix].constData(), kana[ix].size());
+                    });
+
+                    for (int ix = 0; ix != cnt; ++ix)
+                        if (wlist[first + ix] == -1)
+                            missing[first + ix] = std::make_pair(kanji[ix], kana[ix]);
+
+                    if (!nextUpdate(f.pos(), true))
+                        return false;
+
+                    stream >> cnt;
+                }
+                if (cnt < 0)
+                    return invalidData();
+            }
+            else if (section == (quint8)UserExportSection::Definitions)
+            {
+                qint32 cnt;
+                stream >> cnt;
+                if (cnt < 0)
+                    return invalidData();
+
+                for (int ix = 0; ix != cnt && stream.status() == QDataStream::Ok; ++ix)
+                {
+                    if (!nextUpdate(f.pos()))
+                        return false;
+
+                    qint32 pos;
+                    QString def;
+                    stream >> pos >> make_zstr(def, ZStrFormat::Int);
+
+                    int windex = listedWord(pos);
+                    if (windex == -2)
+                        return invalidData();
+                    if (!studymeanings)
+                        continue;
+
+                    if (windex == -1)
+                    {
+                        const std::pair<QString, QString> &w = missing[pos];
+                        setInfoText(tr("Word %1(%2) missing from dictionary for studied word definition.").arg(w.first).arg(w.second));
+                        continue;
+                    }
+
+                    dict->setWordStudyDefinition(windex, def);
+                }
+            }
+            else if (section == (quint8)UserExportSection::KanjiExamples)
+            {
+                qint32 cnt;
+                stream >> cnt;
+                if (cnt < 0)
+                    return invalidData();
+
+                for (int ix = 0; ix != cnt && stream.status() == QDataStream::Ok; ++ix)
+                {
+                    if (!nextUpdate(f.pos()))
+                        return false;
+
+                    quint16 ch;
+                    qint32 wcnt;
+                    stream >> ch >> wcnt;
+                    if (wcnt < 0)
+                        return invalidData();
+
+                    int kindex = ZKanji::kanjiIndex(QChar(ch));
+                    if (kindex == -1)
+                    {
+                        setErrorText(tr("Unrecognized kanji in kanji word examples listing."));
+                        return false;
+                    }
+
+                    for (int iy = 0; iy != wcnt && stream.status() == QDataStream::Ok; ++iy)
+                    {
+                        qint32 pos;
+                        stream >> pos;
+
+                        int windex = listedWord(pos);
+                        if (windex == -2)
+                            return invalidData();
+                        if (!kanjiex)
+                            continue;
+
+                        if (windex == -1)
+                        {
+                            const std::pair<QString, QString> &w = missing[pos];
+                            setInfoText(tr("Word %1(%2) missing from dictionary, as example for kanji: %3").arg(w.first).arg(w.second).arg(QChar(ch)));
+                            continue;
+                        }
+
+                        if (dict->wordEntry(windex)->kanji.find(QChar(ch)) == -1)
+                        {
+                            setErrorText(tr("Word listed as example for kanji doesn't contain the kanji."));
+                            return false;
+                        }
+                        dict->addKanjiExample(kindex, windex);
+                    }
+                }
+            }
+            else if (section == (quint8)UserExportSection::KanjiGroups)
+            {
+                qint32 cnt;
+                stream >> cnt;
+                if (cnt < 0)
+                    return invalidData();
+
+                std::vector<ushort> kindexes;
+                for (int ix = 0; ix != cnt && stream.status() == QDataStream::Ok; ++ix)
+                {
+                    if (!nextUpdate(f.pos()))
+                        return false;
+
+                    QString name;
+                    qint32 kcnt;
+                    stream >> make_zstr(name, ZStrFormat::Int) >> kcnt;
+                    if (kcnt < 0)
+                        return invalidData();
+
+                    kindexes.clear();
+                    for (int iy = 0; iy != kcnt && stream.status() == QDataStream::Ok; ++iy)
+                    {
+                        quint16 ch;
+                        stream >> ch;
+
+                        int kindex = ZKanji::kanjiIndex(QChar(ch));
+                        if (kindex == -1)
+                        {
+                            setErrorText(tr("Unrecognized kanji or invalid character in kanji listing."));
+                            return false;
+                        }
+                        kindexes.push_back(kindex);
+                    }
+
+                    if (kanjiroot == nullptr)
+                        continue;
+
+                    KanjiGroup *grp = kanjiroot->groupFromEncodedName(name, 0, -1, true);
+                    if (grp == nullptr)
+                    {
+                        setErrorText(tr("Invalid or missing group name."));
+                        return false;
+                    }
+                    grp->add(kindexes);
+                }
+            }
+            else if (section == (quint8)UserExportSection::WordGroups)
+            {
+                qint32 cnt;
+                stream >> cnt;
+                if (cnt < 0)
+                    return invalidData();
+
+                std::vector<int> windexes;
+                for (int ix = 0; ix != cnt && stream.status() == QDataStream::Ok; ++ix)
+                {
+                    if (!nextUpdate(f.pos()))
+                        return false;
+
+                    QString name;
+                    qint32 wcnt;
+                    stream >> make_zstr(name, ZStrFormat::Int) >> wcnt;
+                    if (wcnt < 0)
+                        return invalidData();
+
+                    WordGroup *grp = wordsroot == nullptr ? nullptr : wordsroot->groupFromEncodedName(name, 0, -1, true);
+                    if (wordsroot != nullptr && grp == nullptr)
+                    {
+                        setErrorText(tr("Invalid or missing group name."));
+                        return false;
+                    }
+
+                    windexes.clear();
+                    for (int iy = 0; iy != wcnt && stream.status() == QDataStream::Ok; ++iy)
+                    {
+                        qint32 pos;
+                        stream >> pos;
+
+                        int windex = listedWord(pos);
+                        if (windex == -2)
+                            return invalidData();
+                        if (grp == nullptr)
+                            continue;
+
+                        if (windex == -1)
+                        {
+                            const std::pair<QString, QString> &w = missing[pos];
+                            setInfoText(tr("Word %1(%2) missing from dictionary in group %3").arg(w.first).arg(w.second).arg(grp->fullName(wordsroot)));
+                            continue;
+                        }
+                        windexes.push_back(windex);
+                    }
+
+                    if (grp != nullptr)
+                        grp->add(windexes);
+                }
+            }
+            else
+                return invalidData();
+
+            stream >> section;
+        }
+    }
+    catch (const ZException &)
+    {
+        return invalidData();
+    }
+
+    if (stream.status() != QDataStream::Ok)
+        return invalidData();
+
+    return true;
+}
+
 bool DictImport::importRadFiles()
 {
     ui->progressBar->setValue(0);
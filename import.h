@@ -323,6 +323,9 @@ private:
 
     // Imports the exported user data from path and creates groups in the specified roots.
     bool doImportUserData();
+    // Imports user data from path written in the binary export format. Called by
+    // doImportUserData() when the file is in that format.
+    bool doImportUserDataBinary();
 
     // Changes the large font text informing the user about the operation taking place.
     void setMainText(const QString &str);
@@ -204,6 +204,12 @@ namespace ZKanji
         return -1;
     }
 
+    void completeKanjiIndex()
+    {
+        for (int ksiz = tosigned(kanjis.size()); kmapchecked != ksiz; ++kmapchecked)
+            kanjiindexmap[kanjis[kmapchecked]->ch] = kmapchecked;
+    }
+
     bool isKanjiMissing()
     {
         if (kanjis.size() == 0)
@@ -214,6 +220,27 @@ namespace ZKanji
         return false;
     }
 
+    // Pool of the readings and meanings of the kanji, filled in packKanjiText().
+    std::unique_ptr<QCharStringPool> kanjitext;
+
+    void packKanjiText()
+    {
+        // The strings are packed into a new pool, and the old pool is freed once no kanji
+        // refers to it.
+        std::unique_ptr<QCharStringPool> pool(new QCharStringPool);
+        for (int ix = 0, siz = tosigned(kanjis.size()); ix != siz; ++ix)
+        {
+            KanjiEntry *k = kanjis[ix];
+            if (k == nullptr)
+                continue;
+            k->on.pack(*pool);
+            k->kun.pack(*pool);
+            k->nam.pack(*pool);
+            k->meanings.pack(*pool);
+        }
+        kanjitext = std::move(pool);
+    }
+
     int kanjiReadingCount(KanjiEntry *k, bool compact)
     {
         if (!compact)
@@ -172,10 +172,18 @@ namespace ZKanji
 
     KanjiEntry* addKanji(QChar ch, int kindex = -1);
     int kanjiIndex(QChar kanjichar);
+    // Adds every kanji to the mapping used by kanjiIndex(). Once the mapping is complete,
+    // kanjiIndex() doesn't change it and can be called from several threads at once.
+    void completeKanjiIndex();
 
     // Returns true if the ZKanji::kanjis list has nullptr items or the list is empty.
     bool isKanjiMissing();
 
+    // Moves the readings and meanings of every kanji into a single string pool, where
+    // identical strings are only stored once. Call after the kanji data was loaded or
+    // replaced.
+    void packKanjiText();
+
     // Returns the sum of kanji readings in a given kanji. If compact is true, KUN readings
     // that only differ in okurigana are counted as a single reading.
     int kanjiReadingCount(KanjiEntry *k, bool compact);
@@ -11,6 +11,7 @@
 #include <QByteArray>
 #include <QDesktopWidget>
 #include <QApplication>
+#include <algorithm>
 
 #include "kanjiinfoform.h"
 #include "ui_kanjiinfoform.h"
@@ -32,6 +33,7 @@
 #include "formstates.h"
 #include "generalsettings.h"
 #include "dialogs.h"
+#include "kanjisimilarity.h"
 
 // Event posted when deferring the resize of controls in the info form.
 ZEVENT(InfoResizeEvent)
@@ -147,6 +149,7 @@ KanjiInfoForm::KanjiInfoForm(QWidget *parent) : base(parent), ui(new Ui::KanjiIn
 
     connect(gUI, &GlobalUI::settingsChanged, this, &KanjiInfoForm::settingsChanged);
     connect(gUI, &GlobalUI::dictionaryReplaced, this, &KanjiInfoForm::dictionaryReplaced);
+    connect(&ZKanji::lookalikes, &KanjiSimilarityTable::tableChanged, this, &KanjiInfoForm::updateSimilarKanji);
 
     connect(ui->similarScroller, &ZItemScroller::itemClicked, this, &KanjiInfoForm::scrollerClicked);
     connect(ui->partsScroller, &ZItemScroller::itemClicked, this, &KanjiInfoForm::scrollerClicked);
@@ -427,6 +430,37 @@ namespace ZKanji
     extern QChar radsymbols[214];
 }
 
+void KanjiInfoForm::updateSimilarKanji()
+{
+    int kindex = ui->kanjiView->kanjiIndex();
+    if (kindex < 0)
+        return;
+
+    KanjiEntry *k = ZKanji::kanjis[kindex];
+
+    // The similar kanji listed in similar.txt come first. Kanji found similar by their
+    // stroke order data are listed after them in the second group.
+    std::vector<int> l;
+    int categlimit = 0;
+    auto simit = ZKanji::similarkanji.find(k->ch.unicode());
+    if (simit != ZKanji::similarkanji.end())
+    {
+        auto &arr = simit->second.second;
+        l.reserve(arr.size());
+        for (int ix = 0, siz = tosigned(arr.size()); ix != siz; ++ix)
+            l.push_back(arr[ix]);
+        categlimit = simit->second.first;
+    }
+
+    std::vector<int> lookalikes;
+    ZKanji::lookalikes.similarKanji(kindex, lookalikes);
+    for (int kix : lookalikes)
+        if (std::find(l.begin(), l.end(), kix) == l.end())
+            l.push_back(kix);
+
+    simmodel->setItems(l, categlimit);
+}
+
 void KanjiInfoForm::setKanji(Dictionary *d, int kindex)
 {
     if (dict != nullptr)
@@ -449,20 +483,11 @@ void KanjiInfoForm::setKanji(Dictionary *d, int kindex)
 
     ui->countLabel->setText(QStringLiteral("<span style=\"font-weight: bold; font-size: %2pt;\">%1</span>").arg(ZKanji::elements()->size() != 0 ? ZKanji::elements()->strokeCount(kindex < 0 ? (-1 - kindex) : k->element, 0) : k->strokes, 2, 10, QChar('0')).arg(Settings::scaled(ui->countLabel->font().pointSize())));
 
+    updateSimilarKanji();
+
     std::vector<int> l;
     if (k != nullptr)
     {
-        auto simit = ZKanji::similarkanji.find(k->ch.unicode());
-        if (simit != ZKanji::similarkanji.end())
-        {
-            auto &arr = simit->second.second;
-            l.reserve(arr.size());
-            for (int ix = 0, siz = tosigned(arr.size()); ix != siz; ++ix)
-                l.push_back(arr[ix]);
-            simmodel->setItems(l, simit->second.first);
-            l.clear();
-        }
-
         ui->strokesLabel->setText(QString::number(k->strokes));
         ui->radLabel->setText(QString::number(k->rad));
         ui->radSymLabel->setText(ZKanji::radsymbols[k->rad - 1]);
@@ -130,6 +130,9 @@ private slots:
     void dictionaryReplaced(Dictionary *olddict, Dictionary *newdict, int index);
 
     void wordSelChanged();
+
+    // Lists the similar kanji of the shown kanji.
+    void updateSimilarKanji();
 private:
     // Reads an SVG image file as text, replacing the black color (#000000) with the passed
     // color, and returning it as an icon of size siz.
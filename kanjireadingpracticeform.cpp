@@ -299,7 +299,7 @@ void KanjiReadingPracticeForm::initNextRound()
     {
         const WordEntry *const w = d->wordEntry(wix);
         std::vector<FuriganaData> furi;
-        findFurigana(w->kanji, w->kana, furi);
+        d->wordFurigana(wix, furi);
 
         readings.push_back(std::vector<int>());
         std::vector<int> &rlist = readings.back();
@@ -0,0 +1,431 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <QFile>
+#include <QDataStream>
+#include <bitset>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include "kanjisimilarity.h"
+#include "kanjistrokes.h"
+#include "taskscheduler.h"
+#include "perftrace.h"
+
+#include "checked_cast.h"
+
+
+static char ZKANJI_SIMILARITY_FILE_VERSION[] = "001";
+
+
+namespace ZKanji
+{
+    KanjiSimilarityTable lookalikes;
+}
+
+
+//-------------------------------------------------------------
+
+
+namespace
+{
+    // Number of cells in a row or column of the grid the strokes are drawn on, when
+    // comparing where the strokes of two kanji are.
+    const int gridSize = 16;
+
+    // Kanji with a lower similarity score than this are not listed as similar.
+    const double minimumScore = 0.4;
+
+    typedef std::bitset<gridSize * gridSize> StrokeGrid;
+
+    // Data of a kanji compared with the others.
+    struct KanjiFeatures
+    {
+        // Cells of the grid touched by the strokes of the kanji.
+        StrokeGrid grid;
+        // The grid with every cell set next to a touched cell.
+        StrokeGrid wide;
+        int cells;
+
+        // The elements making up the kanji, and the ratio of the kanji's area they take up.
+        // Sorted by element index.
+        std::vector<std::pair<int, double>> parts;
+
+        int strokes;
+    };
+
+    void kanjiFeatures(const KanjiElementList *elements, int element, KanjiFeatures &f)
+    {
+        f.strokes = elements->strokeCount(element, 0);
+
+        // The rectangle is large enough for the padding around the drawn strokes to not
+        // matter.
+        const double size = gridSize * 16;
+        std::vector<QPointF> points;
+        elements->strokeOutline(element, 0, QRectF(0, 0, size, size), 6, points);
+        for (const QPointF &pt : points)
+        {
+            int x = std::max(0, std::min(gridSize - 1, (int)(pt.x() * gridSize / size)));
+            int y = std::max(0, std::min(gridSize - 1, (int)(pt.y() * gridSize / size)));
+            f.grid.set(y * gridSize + x);
+        }
+        f.cells = tosigned(f.grid.count());
+
+        for (int y = 0; y != gridSize; ++y)
+            for (int x = 0; x != gridSize; ++x)
+            {
+                if (!f.grid.test(y * gridSize + x))
+                    continue;
+                for (int wy = std::max(0, y - 1), ylim = std::min(gridSize - 1, y + 1); wy <= ylim; ++wy)
+                    for (int wx = std::max(0, x - 1), xlim = std::min(gridSize - 1, x + 1); wx <= xlim; ++wx)
+                        f.wide.set(wy * gridSize + wx);
+            }
+
+        // Parts used at several places are merged, adding up their area.
+        elements->elementComponents(element, 0, f.parts);
+        std::sort(f.parts.begin(), f.parts.end());
+        int pos = 0;
+        for (int ix = 0, siz = tosigned(f.parts.size()); ix != siz; ++ix)
+        {
+            if (pos != 0 && f.parts[pos - 1].first == f.parts[ix].first)
+                f.parts[pos - 1].second = std::min(1.0, f.parts[pos - 1].second + f.parts[ix].second);
+            else
+                f.parts[pos++] = f.parts[ix];
+        }
+        f.parts.resize(pos);
+    }
+
+    // Returns the similarity of two kanji in the range [0, 1].
+    double kanjiSimilarity(const KanjiFeatures &a, const KanjiFeatures &b)
+    {
+        // Parts: the area of the shared parts compared to the area of all the parts.
+        double shared = 0;
+        double all = 0;
+        auto ait = a.parts.begin();
+        auto bit = b.parts.begin();
+        while (ait != a.parts.end() || bit != b.parts.end())
+        {
+            if (bit == b.parts.end() || (ait != a.parts.end() && ait->first < bit->first))
+            {
+                all += ait->second;
+                ++ait;
+            }
+            else if (ait == a.parts.end() || bit->first < ait->first)
+            {
+                all += bit->second;
+                ++bit;
+            }
+            else
+            {
+                shared += std::min(ait->second, bit->second);
+                all += std::max(ait->second, bit->second);
+                ++ait;
+                ++bit;
+            }
+        }
+        double partscore = all == 0 ? 0 : shared / all;
+
+        // Strokes: the cells of each kanji touched by strokes that are near the strokes of
+        // the other kanji.
+        double gridscore = a.cells + b.cells == 0 ? 0 : (double)((a.grid & b.wide).count() + (b.grid & a.wide).count()) / (a.cells + b.cells);
+
+        double strokescore = 1.0 - (double)std::abs(a.strokes - b.strokes) / std::max(1, std::max(a.strokes, b.strokes));
+
+        return partscore * 0.45 + gridscore * 0.45 + strokescore * 0.1;
+    }
+}
+
+
+//-------------------------------------------------------------
+
+
+// Computes the table of similar kanji in a background thread.
+class KanjiSimilarityBuild : public BackgroundTask
+{
+public:
+    KanjiSimilarityBuild(KanjiSimilarityTable *owner, int id, const KanjiElementList *elements, int kanjicount);
+    virtual ~KanjiSimilarityBuild();
+protected:
+    virtual bool execute() override;
+private:
+    KanjiSimilarityTable *owner;
+    int id;
+    const KanjiElementList *elements;
+    int kanjicount;
+
+    std::vector<ushort> table;
+
+    friend class KanjiSimilarityTable;
+
+    typedef BackgroundTask  base;
+};
+
+KanjiSimilarityBuild::KanjiSimilarityBuild(KanjiSimilarityTable *owner, int id, const KanjiElementList *elements, int kanjicount) : base(), owner(owner), id(id), elements(elements), kanjicount(kanjicount)
+{
+
+}
+
+KanjiSimilarityBuild::~KanjiSimilarityBuild()
+{
+
+}
+
+bool KanjiSimilarityBuild::execute()
+{
+    if (!KanjiSimilarityTable::compute(elements, kanjicount, table, &token()))
+        return false;
+
+    // The owner is notified in the main thread, where it waits for the task to stop.
+    QMetaObject::invokeMethod(owner, "buildFinished", Qt::QueuedConnection, Q_ARG(int, id));
+    return true;
+}
+
+
+//-------------------------------------------------------------
+
+
+const int KanjiSimilarityTable::neighborCount = 10;
+
+KanjiSimilarityTable::KanjiSimilarityTable() : base(), kanjicnt(0), elemcnt(0), buildid(0)
+{
+
+}
+
+KanjiSimilarityTable::~KanjiSimilarityTable()
+{
+    cancelBuild();
+}
+
+void KanjiSimilarityTable::clear()
+{
+    cancelBuild();
+
+    kanjicnt = 0;
+    elemcnt = 0;
+    table.clear();
+    table.shrink_to_fit();
+}
+
+bool KanjiSimilarityTable::empty()
+{
+    return !finishBuild() || table.empty();
+}
+
+void KanjiSimilarityTable::build(const KanjiElementList *elements, int kanjicount)
+{
+    clear();
+
+    if (compute(elements, kanjicount, table, nullptr))
+    {
+        kanjicnt = kanjicount;
+        elemcnt = tosigned(elements->size());
+    }
+    else
+        table.clear();
+}
+
+void KanjiSimilarityTable::startBuild(const KanjiElementList *elements, int kanjicount, const QString &filename)
+{
+    clear();
+
+    savename = filename;
+    task.reset(new KanjiSimilarityBuild(this, ++buildid, elements, kanjicount));
+    task->start();
+}
+
+bool KanjiSimilarityTable::load(const QString &filename, const KanjiElementList *elements, int kanjicount)
+{
+    clear();
+
+    QFile f(filename);
+    if (!f.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&f);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    char tmp[7];
+    tmp[6] = 0;
+    stream.readRawData(tmp, 6);
+
+    int ver = atol(tmp + 3);
+    if (strncmp(tmp, "zsk", 3) || ver != 1)
+        return false;
+
+    qint32 kcnt;
+    qint32 ecnt;
+    qint32 ncnt;
+    stream >> kcnt >> ecnt >> ncnt;
+
+    // The table is only valid for the same stroke order data and kanji.
+    if (kcnt != kanjicount || ecnt != tosigned(elements->size()) || ncnt != neighborCount)
+        return false;
+
+    table.resize(kanjicount * neighborCount);
+    for (ushort &val : table)
+        stream >> val;
+
+    if (stream.status() != QDataStream::Ok)
+    {
+        table.clear();
+        return false;
+    }
+
+    kanjicnt = kanjicount;
+    elemcnt = ecnt;
+    return true;
+}
+
+void KanjiSimilarityTable::save(const QString &filename)
+{
+    if (!finishBuild())
+        return;
+
+    QFile f(filename);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    QDataStream stream(&f);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    stream.writeRawData("zsk", 3);
+    stream.writeRawData(ZKANJI_SIMILARITY_FILE_VERSION, 3);
+
+    stream << (qint32)kanjicnt << (qint32)elemcnt << (qint32)neighborCount;
+    for (ushort val : table)
+        stream << val;
+}
+
+void KanjiSimilarityTable::similarKanji(int kindex, std::vector<int> &result)
+{
+    if (!finishBuild())
+        return;
+
+    if (kindex < 0 || kindex >= kanjicnt || table.empty())
+        return;
+
+    for (int ix = kindex * neighborCount, last = ix + neighborCount; ix != last && table[ix] != (ushort)-1; ++ix)
+        result.push_back(table[ix]);
+}
+
+void KanjiSimilarityTable::buildFinished(int id)
+{
+    if (task == nullptr || id != buildid)
+        return;
+
+    // The task only has to return after sending the notification.
+    task->wait();
+    finishBuild();
+}
+
+bool KanjiSimilarityTable::finishBuild()
+{
+    if (task == nullptr)
+        return true;
+
+    if (task->isRunning())
+        return false;
+
+    bool finished = task->isFinished();
+    if (finished)
+    {
+        std::swap(table, task->table);
+        kanjicnt = task->kanjicount;
+        elemcnt = tosigned(task->elements->size());
+    }
+    task.reset();
+
+    if (!finished)
+        return true;
+
+    // This can be called before the notification of the task arrives, which is then ignored.
+    QString filename = savename;
+    savename.clear();
+    if (!filename.isEmpty() && !table.empty())
+        save(filename);
+
+    // The caller might be in the middle of using the table.
+    QMetaObject::invokeMethod(this, "tableChanged", Qt::QueuedConnection);
+
+    return true;
+}
+
+void KanjiSimilarityTable::cancelBuild()
+{
+    if (task == nullptr)
+        return;
+
+    task->cancel();
+    task->wait();
+    task.reset();
+}
+
+bool KanjiSimilarityTable::compute(const KanjiElementList *elements, int kanjicount, std::vector<ushort> &dest, const CancelToken *token)
+{
+    PERFTRACE_SCOPE("KanjiSimilarityTable::compute");
+
+    dest.clear();
+    if (elements == nullptr || elements->size() == 0 || kanjicount == 0)
+        return true;
+
+    // Kanji with stroke order data and their features.
+    std::vector<int> kanji;
+    for (int ix = 0; ix != kanjicount; ++ix)
+        if (elements->elementOf(ix) != -1)
+            kanji.push_back(ix);
+    int cnt = tosigned(kanji.size());
+
+    std::vector<KanjiFeatures> features(cnt);
+    if (!parallelFor(0, cnt, 64, [elements, &kanji, &features](int first, int last) {
+        for (int ix = first; ix != last; ++ix)
+            kanjiFeatures(elements, elements->elementOf(kanji[ix]), features[ix]);
+    }, token))
+        return false;
+
+    // Every kanji is compared with all the others. The best matches are kept in order.
+    dest.resize(kanjicount * neighborCount, (ushort)-1);
+    if (!parallelFor(0, cnt, 16, [&kanji, &features, &dest, cnt](int first, int last) {
+        std::vector<std::pair<double, int>> best;
+        best.reserve(neighborCount + 1);
+        for (int ix = first; ix != last; ++ix)
+        {
+            best.clear();
+            for (int iy = 0; iy != cnt; ++iy)
+            {
+                if (iy == ix)
+                    continue;
+                double score = kanjiSimilarity(features[ix], features[iy]);
+                if (score < minimumScore || (tosigned(best.size()) == neighborCount && score <= best.back().first))
+                    continue;
+
+                auto it = std::upper_bound(best.begin(), best.end(), score, [](double val, const std::pair<double, int> &item) {
+                    return val > item.first;
+                });
+                best.insert(it, std::make_pair(score, iy));
+                if (tosigned(best.size()) > neighborCount)
+                    best.pop_back();
+            }
+
+            ushort *row = dest.data() + kanji[ix] * neighborCount;
+            for (int iy = 0, siz = tosigned(best.size()); iy != siz; ++iy)
+                row[iy] = kanji[best[iy].second];
+        }
+    }, token))
+    {
+        dest.clear();
+        return false;
+    }
+
+    PERFTRACE_COUNT("similar kanji compared", cnt);
+
+    return true;
+}
+
+
+//-------------------------------------------------------------
+
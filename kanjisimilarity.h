@@ -0,0 +1,100 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef KANJISIMILARITY_H
+#define KANJISIMILARITY_H
+
+#include <QObject>
+#include <QString>
+#include <vector>
+#include <memory>
+
+class KanjiElementList;
+class KanjiSimilarityBuild;
+class CancelToken;
+
+// Table of the kanji that look the most like each kanji. The table is computed from the
+// kanji stroke order elements by comparing every pair of kanji. Kanji are similar when they
+// are made up of the same parts at similar places, their strokes cover the same areas, and
+// they have about the same number of strokes.
+// The table is computed when importing the dictionary data and saved next to it. If the
+// saved table doesn't match the loaded data, it's computed in the background instead, and
+// saved when finished. The table is empty until then, and tableChanged() is emitted when the
+// computed table can be used.
+class KanjiSimilarityTable : public QObject
+{
+    Q_OBJECT
+signals:
+    // The table computed in the background has replaced the previous one.
+    void tableChanged();
+public:
+    // Number of similar kanji stored for each kanji.
+    static const int neighborCount;
+
+    KanjiSimilarityTable();
+    ~KanjiSimilarityTable();
+
+    void clear();
+    bool empty();
+
+    // Computes the table for the first kanjicount kanji with stroke order data in elements.
+    void build(const KanjiElementList *elements, int kanjicount);
+    // Starts computing the table in a background thread. The table is empty while it's being
+    // computed. Once finished, the table is saved to filename if it's not empty.
+    void startBuild(const KanjiElementList *elements, int kanjicount, const QString &filename = QString());
+
+    // Loads a table saved with save(). Returns false and leaves the table empty if the file
+    // is missing, or it was computed from different stroke order data or kanji.
+    bool load(const QString &filename, const KanjiElementList *elements, int kanjicount);
+    void save(const QString &filename);
+
+    // Adds the indexes of kanji similar to the kanji at kindex to result, the most similar
+    // kanji first. Adds nothing while the table is computed in the background.
+    void similarKanji(int kindex, std::vector<int> &result);
+private slots:
+    // Called in the main thread by the background computation with the id of the build when
+    // it's done.
+    void buildFinished(int id);
+private:
+    // Replaces the current table with the one computed in the background if it's finished,
+    // saves it and notifies the listeners. Returns false if the computation is still
+    // running.
+    bool finishBuild();
+    // Stops the computation of the table in the background if it's running.
+    void cancelBuild();
+
+    // Fills dest with the similar kanji of the first kanjicount kanji, neighborCount values
+    // for each. Returns false if the computation was cancelled with token.
+    static bool compute(const KanjiElementList *elements, int kanjicount, std::vector<ushort> &dest, const CancelToken *token);
+
+    // Number of kanji and stroke order elements the table was computed for.
+    int kanjicnt;
+    int elemcnt;
+
+    // The indexes of the similar kanji of each kanji, neighborCount values per kanji. Unused
+    // values are (ushort)-1.
+    std::vector<ushort> table;
+
+    std::unique_ptr<KanjiSimilarityBuild> task;
+    // File to save the table to when the background computation finishes.
+    QString savename;
+    // Incremented for each background computation, to ignore the notifications of abandoned
+    // computations.
+    int buildid;
+
+    friend class KanjiSimilarityBuild;
+
+    typedef QObject base;
+};
+
+namespace ZKanji
+{
+    // Kanji found similar by comparing their stroke order data.
+    extern KanjiSimilarityTable lookalikes;
+}
+
+
+#endif // KANJISIMILARITY_H
@@ -9,6 +9,7 @@
 #include <QMessageBox>
 #include <QApplication>
 #include <QPainterPath>
+#include <QtEndian>
 
 #include <cmath>
 #include <set>
@@ -17,6 +18,7 @@
 #include "kanji.h"
 #include "zkanjimain.h"
 #include "generalsettings.h"
+#include "perftrace.h"
 
 #include "checked_cast.h"
 
@@ -1173,16 +1175,21 @@ ElementPointT ElementTransform::transformed(const ElementPoint &pt) const
 //-------------------------------------------------------------
 
 
-KanjiElementList::KanjiElementList() : version(0)
+KanjiElementList::KanjiElementList() : version(0), data(nullptr), datasize(0)
 {
 
 }
 
-KanjiElementList::KanjiElementList(const QString &filename) : version(0)
+KanjiElementList::KanjiElementList(const QString &filename) : version(0), data(nullptr), datasize(0)
 {
     load(filename);
 }
 
+KanjiElementList::~KanjiElementList()
+{
+
+}
+
 void KanjiElementList::clear(bool /*full*/)
 {
     list.clear();
@@ -1190,24 +1197,97 @@ void KanjiElementList::clear(bool /*full*/)
     cmodels.clear();
     repos.clear();
     varnames.clear();
+    shapes.clear();
 
+    file.reset();
+    filedata.clear();
+    data = nullptr;
+    datasize = 0;
+}
+
+namespace
+{
+    // Reads little endian values from the stroke order data in memory. Reading past the end
+    // of the data throws a ZException.
+    class ElementDataReader
+    {
+    public:
+        ElementDataReader(const uchar *data, qint64 size) : data(data), size(size), pos(0) {}
+
+        qint64 position() const
+        {
+            return pos;
+        }
+
+        quint8 readByte()
+        {
+            check(1);
+            return data[pos++];
+        }
+
+        quint16 readWord()
+        {
+            check(2);
+            quint16 r = qFromLittleEndian<quint16>(data + pos);
+            pos += 2;
+            return r;
+        }
+
+        qint32 readInt()
+        {
+            check(4);
+            qint32 r = qFromLittleEndian<qint32>(data + pos);
+            pos += 4;
+            return r;
+        }
+
+        void skip(qint64 len)
+        {
+            check(len);
+            pos += len;
+        }
+    private:
+        void check(qint64 len) const
+        {
+            if (pos + len > size)
+                throw ZException("Invalid stroke order file format.");
+        }
+
+        const uchar *data;
+        qint64 size;
+        qint64 pos;
+    };
 }
 
 void KanjiElementList::load(const QString &filename)
 {
+    PERFTRACE_SCOPE("KanjiElementList::load");
+
     clear(true);
 
-    QFile f(filename);
+    file.reset(new QFile(filename));
 
-    if (!f.open(QIODevice::ReadOnly))
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        file.reset();
         return;
+    }
 
-    QDataStream stream(&f);
-    stream.setVersion(QDataStream::Qt_5_5);
-    stream.setByteOrder(QDataStream::LittleEndian);
+    // The file is used in place. Only the data needed to look up the elements is read here,
+    // and the variants and recognizer data of each element are skipped until they are used.
+    datasize = file->size();
+    data = file->map(0, datasize);
+    if (data == nullptr)
+    {
+        filedata = file->readAll();
+        data = (const uchar*)filedata.constData();
+    }
+
+    ElementDataReader reader(data, datasize);
 
     char tmp[9];
-    stream.readRawData(tmp, 8);
+    for (int ix = 0; ix != 8; ++ix)
+        tmp[ix] = reader.readByte();
     tmp[8] = 0;
 
     bool good = !strncmp("zksod", tmp, 5);
@@ -1220,22 +1300,17 @@ void KanjiElementList::load(const QString &filename)
     if (version < 7)
         throw ZException("Stroke order data version too old.");
 
-    quint16 cnt;
-    stream >> cnt;
+    quint16 cnt = reader.readWord();
 
     list.reserve(cnt);
     int lsiz = 0;
     while (lsiz++ != cnt)
         list.push_back(new KanjiElement);
 
-
-    quint16 ui;
-    qint16 si;
-
     for (int ix = 0; ix != cnt; ++ix)
     {
         KanjiElement *e = list[ix];
-        stream >> e->owner;
+        e->owner = reader.readWord();
 
         if (e->owner < 0x2000)
         {
@@ -1253,159 +1328,73 @@ void KanjiElementList::load(const QString &filename)
             e->owner = (ushort)-1;
         }
 
-        qint32 i;
-        stream >> i;
+        qint32 i = reader.readInt();
         if (i < 0 || i >= (int)KanjiPattern::Count)
             throw ZException("Invalid element pattern.");
 
         e->pattern = (KanjiPattern)i;
 
-        quint16 pcnt;
-        stream >> pcnt;
+        quint16 pcnt = reader.readWord();
         e->parents.resize(pcnt);
         for (int iy = 0; iy != pcnt; ++iy)
-            stream >> e->parents[iy];
+            e->parents[iy] = reader.readWord();
         for (int iy = 0; iy != 4; ++iy)
-            stream >> e->parts[iy];
+            e->parts[iy] = (qint16)reader.readWord();
 
-        quint8 vcnt;
-        stream >> vcnt;
-        e->variants.reserve(vcnt);
-        for (int iy = 0; iy != vcnt; ++iy)
-        {
-            ElementVariant *v = new ElementVariant;
-            e->variants.push_back(v);
-
-            // Stroke count.
-            stream >> v->strokecnt;
+        e->variantcnt = reader.readByte();
+        e->datapos = (quint32)reader.position();
+        e->decoded = false;
 
-            stream >> ui;
-            v->width = ui * 5;
-            stream >> ui;
-            v->height = ui * 5;
-            stream >> si;
-            v->x = si * 5;
-            stream >> si;
-            v->y = si * 5;
+        // Stroke count of the first variant, which is the number of recognizer data items.
+        int reccnt = 0;
+        for (int iy = 0; iy != e->variantcnt; ++iy)
+        {
+            quint8 strokecnt = reader.readByte();
+            if (iy == 0)
+                reccnt = strokecnt;
 
-            stream >> v->centerpoint;
-            stream >> v->standalone;
+            // Size, position and center point.
+            reader.skip(9);
 
-            if (!v->standalone)
+            bool standalone = reader.readByte() != 0;
+            if (!standalone)
             {
-                v->partpos.resize(4);
-                for (int j = 0; j != 4; ++j)
-                {
-                    ElementPart &p = v->partpos[j];
-                    stream >> p.variant;
-
-                    stream >> ui;
-                    p.width = ui * 5;
-                    stream >> ui;
-                    p.height = ui * 5;
-                    stream >> si;
-                    p.x = si * 5;
-                    stream >> si;
-                    p.y = si * 5;
-                }
+                // Variant, size and position of 4 parts.
+                reader.skip(4 * 9);
             }
-            else if (v->strokecnt)
+            else
             {
-                v->strokes.resize(v->strokecnt);
-                for (int j = 0; j != v->strokecnt; ++j)
+                for (int j = 0; j != strokecnt; ++j)
                 {
-                    ElementStroke &s = v->strokes[j];
-                    quint8 ptcnt;
-                    stream >> ptcnt;
-                    s.points.resize(ptcnt);
-                    for (int k = 0; k != ptcnt; ++k)
-                    {
-                        ElementPoint &ep = s.points[k];
-                        stream >> si;
-                        ep.x = si * 5;
-                        stream >> si;
-                        ep.y = si * 5;
-
-                        stream >> si;
-                        ep.c1x = si * 5;
-                        stream >> si;
-                        ep.c1y = si * 5;
-                        stream >> si;
-                        ep.c2x = si * 5;
-                        stream >> si;
-                        ep.c2y = si * 5;
-
-                        stream >> i;
-                        ep.type = (ElementPoint::Type)i;
-                    }
-
-                    quint8 b;
-                    stream >> b;
-                    OldStrokeTips ot = (OldStrokeTips)b;
-                    switch (ot)
-                    {
-                    case OldStrokeTips::NormalTip:
-                    case OldStrokeTips::EndPointed:
-                    case OldStrokeTips::EndThin:
-                        s.tips = (int)StrokeTips::NormalTip;
-                        break;
-                    case OldStrokeTips::StartPointed:
-                    case OldStrokeTips::StartPointedEndPointed:
-                    case OldStrokeTips::StartPointedEndThin:
-                        s.tips = (int)StrokeTips::StartPointed;
-                        break;
-                    case OldStrokeTips::StartThin:
-                    case OldStrokeTips::StartThinEndPointed:
-                    case OldStrokeTips::StartThinEndThin:
-                        s.tips = (int)StrokeTips::StartThin;
-                        break;
-                    case OldStrokeTips::SingleDot:
-                        s.tips = (int)StrokeTips::SingleDot;
-                        break;
-                    }
-
-                    switch (ot)
-                    {
-                    case OldStrokeTips::NormalTip:
-                    case OldStrokeTips::StartPointed:
-                    case OldStrokeTips::StartThin:
-                    case OldStrokeTips::SingleDot:
-                        break;
-                    case OldStrokeTips::EndPointed:
-                    case OldStrokeTips::StartPointedEndPointed:
-                    case OldStrokeTips::StartThinEndPointed:
-                        s.tips |= (int)StrokeTips::EndPointed;
-                        break;
-                    case OldStrokeTips::EndThin:
-                    case OldStrokeTips::StartPointedEndThin:
-                    case OldStrokeTips::StartThinEndThin:
-                        s.tips |= (int)StrokeTips::EndThin;
-                        break;
-                    }
+                    quint8 ptcnt = reader.readByte();
+                    // Coordinates and type of each point, and the tips of the stroke.
+                    reader.skip(ptcnt * 16 + 1);
                 }
             }
         }
 
-        if ((e->owner != (ushort)-1 || e->unicode != 0) && !e->variants.empty() && e->variants[0]->strokecnt != 0)
-        {
-            e->recdata.resize(e->variants[0]->strokecnt);
-            for (int iy = 0; iy != e->variants[0]->strokecnt; ++iy)
-                e->recdata[iy].pos.setSize(e->variants[0]->strokecnt - 1);
-        }
-
-        if (!e->recdata.empty())
+        if (e->owner != (ushort)-1 || e->unicode != 0)
         {
-            for (int iy = 0; iy != e->variants[0]->strokecnt; ++iy)
+            for (int iy = 0; iy != reccnt; ++iy)
             {
-                stream >> e->recdata[iy].data.index;
-                stream >> e->recdata[iy].data.distance;
+                // Model index and distance.
+                reader.skip(6);
 
-                for (int j = 0; j != e->variants[0]->strokecnt - 1; ++j)
-                    e->recdata[iy].pos[j].load(stream);
+                for (int j = 0; j != reccnt - 1; ++j)
+                {
+                    quint8 bitcnt = reader.readByte();
+                    reader.skip((bitcnt + 7) / 8);
+                }
             }
         }
     }
 
+    file->seek(reader.position());
+
+    QDataStream stream(file.get());
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
     loadModels(stream, models);
     loadModels(stream, cmodels);
 
@@ -1414,6 +1403,172 @@ void KanjiElementList::load(const QString &filename)
     loadVariantNames(stream);
 }
 
+const ElementVariant* KanjiElementList::elementVariant(const KanjiElement *e, int index) const
+{
+    if (!e->decoded)
+        decodeElement(const_cast<KanjiElement*>(e));
+    return e->variants[index];
+}
+
+const fastarray<RecognizerData>& KanjiElementList::recognizerData(const KanjiElement *e) const
+{
+    if (!e->decoded)
+        decodeElement(const_cast<KanjiElement*>(e));
+    return e->recdata;
+}
+
+void KanjiElementList::decodeElement(KanjiElement *e) const
+{
+    QMutexLocker locker(&decodemutex);
+    if (e->decoded)
+        return;
+
+    QDataStream stream(QByteArray::fromRawData((const char*)data + e->datapos, datasize - e->datapos));
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    quint16 ui;
+    qint16 si;
+    qint32 i;
+
+    e->variants.reserve(e->variantcnt);
+    for (int iy = 0; iy != e->variantcnt; ++iy)
+    {
+        ElementVariant *v = new ElementVariant;
+        e->variants.push_back(v);
+
+        // Stroke count.
+        stream >> v->strokecnt;
+
+        stream >> ui;
+        v->width = ui * 5;
+        stream >> ui;
+        v->height = ui * 5;
+        stream >> si;
+        v->x = si * 5;
+        stream >> si;
+        v->y = si * 5;
+
+        stream >> v->centerpoint;
+        stream >> v->standalone;
+
+        if (!v->standalone)
+        {
+            v->partpos.resize(4);
+            for (int j = 0; j != 4; ++j)
+            {
+                ElementPart &p = v->partpos[j];
+                stream >> p.variant;
+
+                stream >> ui;
+                p.width = ui * 5;
+                stream >> ui;
+                p.height = ui * 5;
+                stream >> si;
+                p.x = si * 5;
+                stream >> si;
+                p.y = si * 5;
+            }
+        }
+        else if (v->strokecnt)
+        {
+            v->strokes.resize(v->strokecnt);
+            for (int j = 0; j != v->strokecnt; ++j)
+            {
+                ElementStroke &s = v->strokes[j];
+                quint8 ptcnt;
+                stream >> ptcnt;
+                s.points.resize(ptcnt);
+                for (int k = 0; k != ptcnt; ++k)
+                {
+                    ElementPoint &ep = s.points[k];
+                    stream >> si;
+                    ep.x = si * 5;
+                    stream >> si;
+                    ep.y = si * 5;
+
+                    stream >> si;
+                    ep.c1x = si * 5;
+                    stream >> si;
+                    ep.c1y = si * 5;
+                    stream >> si;
+                    ep.c2x = si * 5;
+                    stream >> si;
+                    ep.c2y = si * 5;
+
+                    stream >> i;
+                    ep.type = (ElementPoint::Type)i;
+                }
+
+                quint8 b;
+                stream >> b;
+                OldStrokeTips ot = (OldStrokeTips)b;
+                switch (ot)
+                {
+                case OldStrokeTips::NormalTip:
+                case OldStrokeTips::EndPointed:
+                case OldStrokeTips::EndThin:
+                    s.tips = (int)StrokeTips::NormalTip;
+                    break;
+                case OldStrokeTips::StartPointed:
+                case OldStrokeTips::StartPointedEndPointed:
+                case OldStrokeTips::StartPointedEndThin:
+                    s.tips = (int)StrokeTips::StartPointed;
+                    break;
+                case OldStrokeTips::StartThin:
+                case OldStrokeTips::StartThinEndPointed:
+                case OldStrokeTips::StartThinEndThin:
+                    s.tips = (int)StrokeTips::StartThin;
+                    break;
+                case OldStrokeTips::SingleDot:
+                    s.tips = (int)StrokeTips::SingleDot;
+                    break;
+                }
+
+                switch (ot)
+                {
+                case OldStrokeTips::NormalTip:
+                case OldStrokeTips::StartPointed:
+                case OldStrokeTips::StartThin:
+                case OldStrokeTips::SingleDot:
+                    break;
+                case OldStrokeTips::EndPointed:
+                case OldStrokeTips::StartPointedEndPointed:
+                case OldStrokeTips::StartThinEndPointed:
+                    s.tips |= (int)StrokeTips::EndPointed;
+                    break;
+                case OldStrokeTips::EndThin:
+                case OldStrokeTips::StartPointedEndThin:
+                case OldStrokeTips::StartThinEndThin:
+                    s.tips |= (int)StrokeTips::EndThin;
+                    break;
+                }
+            }
+        }
+    }
+
+    if ((e->owner != (ushort)-1 || e->unicode != 0) && !e->variants.empty() && e->variants[0]->strokecnt != 0)
+    {
+        e->recdata.resize(e->variants[0]->strokecnt);
+        for (int iy = 0; iy != e->variants[0]->strokecnt; ++iy)
+            e->recdata[iy].pos.setSize(e->variants[0]->strokecnt - 1);
+    }
+
+    if (!e->recdata.empty())
+    {
+        for (int iy = 0; iy != e->variants[0]->strokecnt; ++iy)
+        {
+            stream >> e->recdata[iy].data.index;
+            stream >> e->recdata[iy].data.distance;
+
+            for (int j = 0; j != e->variants[0]->strokecnt - 1; ++j)
+                e->recdata[iy].pos[j].load(stream);
+        }
+    }
+
+    e->decoded = true;
+}
+
 int KanjiElementList::elementOf(int kindex) const
 {
     if (kindex < 0)
@@ -1557,6 +1712,8 @@ void KanjiElementList::computeStrokePositions(BitArray &bits, QRectF orig, QRect
 
 void KanjiElementList::findCandidates(const StrokeList &strokes, std::vector<int> &result, int strokecnt, bool kanji, bool kana, bool other)
 {
+    PERFTRACE_SCOPE("KanjiElementList::findCandidates");
+
     // Number of items to include in result at most.
     const int cntlimit = 256;
     // Drawn stroke order can be different for each stroke by swplimit position.
@@ -1572,9 +1729,9 @@ void KanjiElementList::findCandidates(const StrokeList &strokes, std::vector<int
     for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
     {
         KanjiElement *e = list[ix];
-        if (kanji && !e->recdata.empty() && e->owner != (ushort)-1)
+        if (kanji && !recognizerData(e).empty() && e->owner != (ushort)-1)
             hasrec++;
-        else if (!e->recdata.empty() && e->unicode != 0 && ((KANA(e->unicode) && kana) || (VALIDCODE(e->unicode) && other)))
+        else if (!recognizerData(e).empty() && e->unicode != 0 && ((KANA(e->unicode) && kana) || (VALIDCODE(e->unicode) && other)))
             charrec++;
     }
 
@@ -1597,23 +1754,28 @@ void KanjiElementList::findCandidates(const StrokeList &strokes, std::vector<int
         {
             KanjiElement *e = list[ix];
 
-            if (e->recdata.empty() || (e->owner != (ushort)-1 && !kanji) || ((cntlimit >= 0 && abs(e->variants[0]->strokecnt - strokecnt) > cntlimit) || (!cntlimit && e->variants[0]->strokecnt < std::max(1, std::min(strokecnt - 3, strokecnt / 2)))) || (e->unicode != 0 && ((KANA(e->unicode) && !kana) || (VALIDCODE(e->unicode) && !other) || (!other && !kana) )))
+            const fastarray<RecognizerData> &recdata = recognizerData(e);
+            if (recdata.empty())
+                continue;
+            const ElementVariant *v = elementVariant(e, 0);
+
+            if ((e->owner != (ushort)-1 && !kanji) || ((cntlimit >= 0 && abs(v->strokecnt - strokecnt) > cntlimit) || (!cntlimit && v->strokecnt < std::max(1, std::min(strokecnt - 3, strokecnt / 2)))) || (e->unicode != 0 && ((KANA(e->unicode) && !kana) || (VALIDCODE(e->unicode) && !other) || (!other && !kana) )))
                 continue;
 
             memset(used, -1, sizeof(int) * 255);
-            value[pos].distance = std::max(0, strokecnt - e->variants[0]->strokecnt) * 40000;
+            value[pos].distance = std::max(0, strokecnt - v->strokecnt) * 40000;
             value[pos].index = ix;
-            for (int iy = 0; iy < std::min(e->variants[0]->strokecnt + swplimit, strokecnt) && value[pos].distance < std::max(10000, lowest) * 1.5; ++iy)
+            for (int iy = 0; iy < std::min(v->strokecnt + swplimit, strokecnt) && value[pos].distance < std::max(10000, lowest) * 1.5; ++iy)
             {
                 int distmin = -1;
                 int sindex = -1;
                 for (int k = iy - swplimit; k < iy + swplimit + 1; ++k)
                 {
-                    if (k < 0 || k >= e->variants[0]->strokecnt || (used[k] >= 0 && (k == 0 || k != iy || used[k - 1] >= 0)))
+                    if (k < 0 || k >= v->strokecnt || (used[k] >= 0 && (k == 0 || k != iy || used[k - 1] >= 0)))
                         continue;
                     double dval;
 
-                    dval = strokes.cmpItems(iy)[e->recdata[k].data.index].distance / 2.;
+                    dval = strokes.cmpItems(iy)[recdata[k].data.index].distance / 2.;
 
                     dval += abs(k - iy) * 300;
 
@@ -1640,7 +1802,7 @@ void KanjiElementList::findCandidates(const StrokeList &strokes, std::vector<int
 
             int compdist = std::max(3000, value[pos].distance);
 
-            int n = std::min(strokecnt, (int)e->variants[0]->strokecnt);
+            int n = std::min(strokecnt, (int)v->strokecnt);
             double posw;
             for (int iy = 0; iy < n && value[pos].distance < std::max(10000, lowest) * 1.5; ++iy)
             {
@@ -1661,10 +1823,10 @@ void KanjiElementList::findCandidates(const StrokeList &strokes, std::vector<int
                     {
                         posw = iz - iy == 1 ? 0.09 : 0.03;
 
-                        dval = ((double)(posDiff(e->recdata[iy].pos[iz - 1], strokes.posItems(c)[c2 - (c2 > c ? 1 : 0)])) * ((double)compdist * posw)) / n;
-                        if (swplimit > 0 && iz == iy + 1 && c == iy && c2 == iz && e->recdata[iy].data.index == e->recdata[iz].data.index)
+                        dval = ((double)(posDiff(recdata[iy].pos[iz - 1], strokes.posItems(c)[c2 - (c2 > c ? 1 : 0)])) * ((double)compdist * posw)) / n;
+                        if (swplimit > 0 && iz == iy + 1 && c == iy && c2 == iz && recdata[iy].data.index == recdata[iz].data.index)
                         {
-                            double dtmp = ((double)(posDiff(e->recdata[iy].pos[iz - 1], strokes.posItems(c2)[c])) * ((double)compdist * posw)) / n;
+                            double dtmp = ((double)(posDiff(recdata[iy].pos[iz - 1], strokes.posItems(c2)[c])) * ((double)compdist * posw)) / n;
                             if (dtmp < dval)
                             {
                                 dval = dtmp;
@@ -1683,21 +1845,21 @@ void KanjiElementList::findCandidates(const StrokeList &strokes, std::vector<int
                     {
                         posw = iy - iz == 1 ? 0.09 : 0.03;
 
-                        dval = ((double)(posDiff(e->recdata[iy].pos[iz], strokes.posItems(c)[c2 - (c2 > c ? 1 : 0)])) * ((double)compdist * posw)) / n;
+                        dval = ((double)(posDiff(recdata[iy].pos[iz], strokes.posItems(c)[c2 - (c2 > c ? 1 : 0)])) * ((double)compdist * posw)) / n;
                         value[pos].distance += dval;
                     }
                 }
 
             }
 
-            if (e->variants[0]->width < 5000 && e->variants[0]->height < 5000)
+            if (v->width < 5000 && v->height < 5000)
             {
                 if (strokes.width() < 0.35 && strokes.height() < 0.35)
                     value[pos].distance = std::max(0.0, value[pos].distance - compdist * 0.05);
                 else if (strokes.width() > 0.5 || strokes.height() > 0.5)
                     value[pos].distance += compdist * 0.05;
             }
-            else if (e->variants[0]->width > 5000 && e->variants[0]->height > 5000)
+            else if (v->width > 5000 && v->height > 5000)
             {
                 if (strokes.width() < 0.35 && strokes.height() < 0.35)
                     value[pos].distance += compdist * 0.05;
@@ -1705,9 +1867,9 @@ void KanjiElementList::findCandidates(const StrokeList &strokes, std::vector<int
                     value[pos].distance = std::max(0.0, value[pos].distance - compdist * 0.05);
             }
 
-            if (e->variants[0]->strokecnt > strokecnt)
+            if (v->strokecnt > strokecnt)
             {
-                int d = std::min(4, e->variants[0]->strokecnt - strokecnt);
+                int d = std::min(4, v->strokecnt - strokecnt);
                 value[pos].distance += d * 2500 + std::min((d - 1) * 3333, 10000);
             }
 
@@ -1869,6 +2031,91 @@ void KanjiElementList::elementParents(int index, bool skipelements, bool usekanj
     }
 }
 
+void KanjiElementList::elementComponents(int element, int variant, std::vector<std::pair<int, double>> &result) const
+{
+    const KanjiElement *e = list[element];
+    const ElementVariant *v = elementVariant(e, variant);
+
+    // Stack of parts to visit, with their variant and area ratio.
+    struct Item
+    {
+        const KanjiElement *e;
+        const ElementVariant *v;
+        double area;
+    };
+    std::vector<Item> stack;
+    stack.push_back({ e, v, 1.0 });
+
+    while (!stack.empty())
+    {
+        Item item = stack.back();
+        stack.pop_back();
+
+        int cnt = 0;
+        for (int ix = 0; ix != 4; ++ix)
+            if (item.e->parts[ix] != -1)
+                ++cnt;
+
+        for (int ix = 0; ix != 4; ++ix)
+        {
+            int part = item.e->parts[ix];
+            if (part == -1)
+                continue;
+
+            const KanjiElement *pe = list[part];
+            double area;
+            const ElementVariant *pv;
+            if (!item.v->standalone)
+            {
+                const ElementPart &pos = item.v->partpos[ix];
+                area = item.area * ((double)pos.width * pos.height) / std::max(1.0, (double)item.v->width * item.v->height);
+                pv = elementVariant(pe, pos.variant);
+            }
+            else
+            {
+                // The positions of the parts of standalone variants are not stored.
+                area = item.area / cnt;
+                pv = elementVariant(pe, 0);
+            }
+
+            result.push_back(std::make_pair(part, std::min(1.0, area)));
+            stack.push_back({ pe, pv, area });
+        }
+    }
+}
+
+void KanjiElementList::strokeOutline(int element, int variant, const QRectF &rect, int steps, std::vector<QPointF> &result) const
+{
+    for (int ix = 0, cnt = tosigned(strokeCount(element, variant)); ix != cnt; ++ix)
+    {
+        ElementTransform tr;
+        double strokew;
+        const ElementStroke *s = findStroke(element, variant, ix, rect, tr, strokew);
+        if (s == nullptr || s->points.empty())
+            continue;
+
+        ElementPointT pastpoint = tr.transformed(s->points[0]);
+        result.push_back(QPointF(pastpoint.x, pastpoint.y));
+        for (int iy = 1, siz = tosigned(s->points.size()); iy != siz; ++iy)
+        {
+            ElementPointT point = tr.transformed(s->points[iy]);
+            for (int step = 1; step <= steps; ++step)
+            {
+                double t = (double)step / steps;
+                if (point.type == ElementPoint::Curve)
+                {
+                    double u = 1.0 - t;
+                    result.push_back(QPointF(u * u * u * pastpoint.x + 3 * u * u * t * point.c1x + 3 * u * t * t * point.c2x + t * t * t * point.x,
+                        u * u * u * pastpoint.y + 3 * u * u * t * point.c1y + 3 * u * t * t * point.c2y + t * t * t * point.y));
+                }
+                else
+                    result.push_back(QPointF(pastpoint.x + (point.x - pastpoint.x) * t, pastpoint.y + (point.y - pastpoint.y) * t));
+            }
+            pastpoint = point;
+        }
+    }
+}
+
 void KanjiElementList::drawElement(QPainter &p, int element, int variant, const QRectF &rect, bool animated)
 {
     int cnt = tosigned(strokeCount(element, variant));
@@ -1884,57 +2131,27 @@ void KanjiElementList::drawElement(QPainter &p, int element, int variant, const
 
 uchar KanjiElementList::strokeCount(int element, int variant) const
 {
-    return list[element]->variants[variant]->strokecnt;
+    return elementVariant(list[element], variant)->strokecnt;
 }
 
 int KanjiElementList::strokePartCount(int element, int variant, int stroke, const QRectF &rect, double partlen, std::vector<int> &parts) const
 {
-    const KanjiElement *e = list[element];
-    const ElementVariant *v = e->variants[variant];
-
-    QRectF r = rect;
-
-    double strokew = basePenWidth(std::min(rect.width(), rect.height()));
-
-    // Setting the r rectangle relative to rect where the variant will be stretched. The r
-    // rectangle will be centered in rect. Leave padding of strokew / 2 + 1 to make sure it
-    // fits.
-    // The variants to be drawn are "normalized" in the editor, usually to reach a maximum of
-    // 42500 width and 40000 height. Because some kanji must be drawn smaller (e.g. the mouth)
-    // these numbers are used directly.
-    // To stretch the drawn parts to fill the rectangle, replace these with v->width and
-    // v->height.
-    double div = std::min(r.width() / 42500, r.height() / 40000);
-    r = QRectF(r.left() + (r.width() - v->width * div) / 2.0 + strokew / 2.0 + 2, r.top() + (r.height() - v->height * div) / 2.0 + strokew / 2.0 + 2, v->width * div - strokew - 4, v->height * div - strokew - 4);
-
-    ElementTransform tr;
-    const ElementStroke *s = findStroke(e, v, stroke, r, tr);
+    const StrokeShape *shape = strokeShape(element, variant, stroke, rect, partlen, std::fabs(partlen + 1.0) > 0.0001, nullptr);
+    if (shape == nullptr)
+    {
+        parts.clear();
+        return 0;
+    }
 
-    return strokePartCount(/*std::min(r.width(), r.height()),*/ s, tr, partlen, std::fabs(partlen + 1.0) > 0.0001, parts);
+    parts = shape->parts;
+    return shape->partcount;
 }
 
 void KanjiElementList::strokeData(int element, int variant, int stroke, const QRectF &rect, StrokeDirection &dir, QPoint &startpoint) const
 {
-    const KanjiElement *e = list[element];
-    const ElementVariant *v = e->variants[variant];
-
-    QRectF r = rect;
-
-    double strokew = basePenWidth(std::min(rect.width(), rect.height()));
-
-    // Setting the r rectangle relative to rect where the variant will be stretched. The r
-    // rectangle will be centered in rect. Leave padding of strokew / 2 + 1 to make sure it
-    // fits.
-    // The variants to be drawn are "normalized" in the editor, usually to reach a maximum of
-    // 42500 width and 40000 height. Because some kanji must be drawn smaller (e.g. the mouth)
-    // these numbers are used directly.
-    // To stretch the drawn parts to fill the rectangle, replace these with v->width and
-    // v->height.
-    double div = std::min(r.width() / 42500, r.height() / 40000);
-    r = QRectF(r.left() + (r.width() - v->width * div) / 2.0 + strokew / 2.0 + 2, r.top() + (r.height() - v->height * div) / 2.0 + strokew / 2.0 + 2, v->width * div - strokew - 4, v->height * div - strokew - 4);
-
     ElementTransform tr;
-    const ElementStroke *s = findStroke(e, v, stroke, r, tr);
+    double strokew;
+    const ElementStroke *s = findStroke(element, variant, stroke, rect, tr, strokew);
 
     strokeData(s, tr, dir, startpoint);
 }
@@ -1946,68 +2163,25 @@ double KanjiElementList::basePenWidth(int minsize) const
 
 void KanjiElementList::drawStroke(QPainter &painter, int element, int variant, int stroke, const QRectF &rect, double partlen, QColor startcolor, QColor endcolor)
 {
-    KanjiElement *e = list[element];
-    ElementVariant *v = e->variants[variant];
-
-    QRectF r = rect;
-
-    double strokew = basePenWidth(std::min(rect.width(), rect.height()));
-
-    // Setting the r rectangle relative to rect where the variant will be stretched. The r
-    // rectangle will be centered in rect. Leave padding of strokew / 2 + 1 to make sure it
-    // fits.
-    // The variants to be drawn are "normalized" in the editor, usually to reach a maximum of
-    // 42500 width and 40000 height. Because some kanji must be drawn smaller (e.g. the mouth)
-    // these numbers are used directly.
-    // To stretch the drawn parts to fill the rectangle, replace these with v->width and
-    // v->height.
-    double div = std::min(r.width() / 42500, r.height() / 40000);
-    r = QRectF(r.left() + (r.width() - v->width * div) / 2.0 + strokew / 2.0 + 2, r.top() + (r.height() - v->height * div) / 2.0 + strokew / 2.0 + 2, v->width * div - strokew - 4, v->height * div - strokew - 4);
-
-    ElementTransform tr;
-    const ElementStroke *s = findStroke(e, v, stroke, r, tr);
-
-    if (s == nullptr)
-        return;
-
     bool animated = partlen == 0;
     if (partlen <= 0)
         partlen = std::max(2.0, std::min(rect.width(), rect.height()) / 50.0);
-    std::vector<int> parts;
-    int cnt = strokePartCount(s, tr, partlen, animated, parts);
 
-    //drawStroke(painter, std::min(r.width(), r.height()), strokew, s, tr, startcolor, endcolor);
-    for (int ix = 0; ix != cnt; ++ix)
-        drawStrokePart(painter, false, strokew, s, tr, parts, ix, startcolor, endcolor);
+    const StrokeShape *shape = strokeShape(element, variant, stroke, rect, partlen, animated, nullptr);
+    if (shape == nullptr)
+        return;
+
+    for (int ix = 0; ix != shape->partcount; ++ix)
+        drawShapePart(painter, false, *shape, ix, startcolor, endcolor);
 }
 
 void KanjiElementList::drawStrokePart(QPainter &painter, bool partialline, int element, int variant, int stroke, const QRectF &rect, const std::vector<int> &parts, int part, QColor startcolor, QColor endcolor) const
 {
-    const KanjiElement *e = list[element];
-    const ElementVariant *v = e->variants[variant];
-
-    QRectF r = rect;
-
-    double strokew = basePenWidth(std::min(rect.width(), rect.height()));
-
-    // Setting the r rectangle relative to rect where the variant will be stretched. The r
-    // rectangle will be centered in rect. Leave padding of strokew / 2 + 1 to make sure it
-    // fits.
-    // The variants to be drawn are "normalized" in the editor, usually to reach a maximum of
-    // 42500 width and 40000 height. Because some kanji must be drawn smaller (e.g. the mouth)
-    // these numbers are used directly.
-    // To stretch the drawn parts to fill the rectangle, replace these with v->width and
-    // v->height.
-    double div = std::min(r.width() / 42500, r.height() / 40000);
-    r = QRectF(r.left() + (r.width() - v->width * div) / 2.0 + strokew / 2.0 + 2, r.top() + (r.height() - v->height * div) / 2.0 + strokew / 2.0 + 2, v->width * div - strokew - 4, v->height * div - strokew - 4);
-
-    ElementTransform tr;
-    const ElementStroke *s = findStroke(e, v, stroke, r, tr);
-
-    if (s == nullptr)
+    const StrokeShape *shape = strokeShape(element, variant, stroke, rect, -2.0, false, &parts);
+    if (shape == nullptr || part < 0 || part >= shape->partcount)
         return;
 
-    drawStrokePart(painter, partialline, strokew, s, tr, parts, part, startcolor, endcolor);
+    drawShapePart(painter, partialline, *shape, part, startcolor, endcolor);
 }
 
 const ElementStroke* KanjiElementList::findStroke(const KanjiElement *e, const ElementVariant *v, int sindex, QRectF r, ElementTransform &tr) const
@@ -2039,7 +2213,7 @@ const ElementStroke* KanjiElementList::findStroke(const KanjiElement *e, const E
             continue;
 
         const KanjiElement *pe = list[e->parts[varix]];
-        const ElementVariant *pv = pe->variants[v->partpos[varix].variant];
+        const ElementVariant *pv = elementVariant(pe, v->partpos[varix].variant);
 
         if (varix == 0)
             usecenter = usecenter && pv->standalone && pv->centerpoint != 0;
@@ -2057,7 +2231,7 @@ const ElementStroke* KanjiElementList::findStroke(const KanjiElement *e, const E
     if (usecenter && varix == 4)
     {
         varix = 0;
-        sindex += list[e->parts[varix]]->variants[v->partpos[varix].variant]->centerpoint - 1;
+        sindex += elementVariant(list[e->parts[varix]], v->partpos[varix].variant)->centerpoint - 1;
     }
 
     if (varix == 4)
@@ -2066,7 +2240,7 @@ const ElementStroke* KanjiElementList::findStroke(const KanjiElement *e, const E
     const ElementPart &part = v->partpos[varix];
 
     const KanjiElement *pe = list[e->parts[varix]];
-    const ElementVariant *pv = pe->variants[part.variant];
+    const ElementVariant *pv = elementVariant(pe, part.variant);
 
     // The rectangle of the varix part relative to r.
     QRect pr = QRect(r.left() + r.width() * (part.x - v->x) / std::max<ushort>(1, v->width), r.top() + r.height() * (part.y - v->y) / std::max<ushort>(1, v->height), r.width() * part.width / std::max<ushort>(1, v->width), r.height() * part.height / std::max<ushort>(1, v->height));
@@ -2074,6 +2248,241 @@ const ElementStroke* KanjiElementList::findStroke(const KanjiElement *e, const E
     return findStroke(pe, pv, sindex, pr, tr);
 }
 
+const ElementStroke* KanjiElementList::findStroke(int element, int variant, int sindex, const QRectF &rect, ElementTransform &tr, double &strokew) const
+{
+    const KanjiElement *e = list[element];
+    const ElementVariant *v = elementVariant(e, variant);
+
+    QRectF r = rect;
+
+    strokew = basePenWidth(std::min(rect.width(), rect.height()));
+
+    // Setting the r rectangle relative to rect where the variant will be stretched. The r
+    // rectangle will be centered in rect. Leave padding of strokew / 2 + 1 to make sure it
+    // fits.
+    // The variants to be drawn are "normalized" in the editor, usually to reach a maximum of
+    // 42500 width and 40000 height. Because some kanji must be drawn smaller (e.g. the mouth)
+    // these numbers are used directly.
+    // To stretch the drawn parts to fill the rectangle, replace these with v->width and
+    // v->height.
+    double div = std::min(r.width() / 42500, r.height() / 40000);
+    r = QRectF(r.left() + (r.width() - v->width * div) / 2.0 + strokew / 2.0 + 2, r.top() + (r.height() - v->height * div) / 2.0 + strokew / 2.0 + 2, v->width * div - strokew - 4, v->height * div - strokew - 4);
+
+    return findStroke(e, v, sindex, r, tr);
+}
+
+const KanjiElementList::StrokeShape* KanjiElementList::strokeShape(int element, int variant, int stroke, const QRectF &rect, double partlen, bool animated, const std::vector<int> *parts) const
+{
+    for (auto it = shapes.begin(); it != shapes.end(); ++it)
+    {
+        if (it->element != element || it->variant != variant || it->stroke != stroke || it->rect != rect)
+            continue;
+        if (parts != nullptr ? it->parts != *parts : (it->partlen != partlen || it->animated != animated))
+            continue;
+
+        if (it != shapes.begin())
+            shapes.splice(shapes.begin(), shapes, it);
+        return &shapes.front();
+    }
+
+    ElementTransform tr;
+    double strokew;
+    const ElementStroke *s = findStroke(element, variant, stroke, rect, tr, strokew);
+    if (s == nullptr || s->points.size() < 2)
+        return nullptr;
+
+    // A few diagrams are shown at the same time, and only their current strokes are drawn
+    // repeatedly. Shapes used long ago won't be needed again.
+    while (shapes.size() >= 256)
+        shapes.pop_back();
+
+    shapes.emplace_front();
+    StrokeShape &shape = shapes.front();
+    shape.element = element;
+    shape.variant = variant;
+    shape.stroke = stroke;
+    shape.rect = rect;
+    shape.basewidth = strokew;
+
+    if (parts != nullptr)
+    {
+        shape.partlen = -2.0;
+        shape.animated = false;
+        shape.parts = *parts;
+        // The parts are not checked, and the shape ends at the last segment of the stroke.
+        shape.parts.resize(std::min(shape.parts.size(), s->points.size() - 1));
+        shape.partcount = 0;
+        for (int cnt : shape.parts)
+            shape.partcount += cnt;
+    }
+    else
+    {
+        shape.partlen = partlen;
+        shape.animated = animated;
+        shape.partcount = strokePartCount(s, tr, partlen, animated, shape.parts);
+    }
+
+    buildStrokeShape(shape, s, tr);
+
+    return &shape;
+}
+
+void KanjiElementList::buildStrokeShape(StrokeShape &shape, const ElementStroke *s, const ElementTransform &tr) const
+{
+    double basewidth = shape.basewidth;
+    int siz = tosigned(s->points.size());
+
+    shape.pointstart = (s->tips & (int)StrokeTips::StartPointed) == (int)StrokeTips::StartPointed || s->tips == (int)StrokeTips::SingleDot;
+    shape.list.clear();
+    shape.list.reserve(shape.partcount);
+
+    int fullcnt = shape.partcount;
+    int startcnt = 0;
+
+    ElementPointT pastpoint = tr.transformed(s->points[0]);
+    for (int ix = 1, partspos = 0; partspos != tosigned(shape.parts.size()); ++ix, ++partspos)
+    {
+        ElementPointT point = tr.transformed(s->points[ix]);
+
+        int partcnt = shape.parts[partspos];
+        int endcnt = fullcnt - startcnt - partcnt;
+
+        double startw = basewidth;
+        double endw = basewidth;
+        if (ix == 1)
+        {
+            if ((s->tips & (int)StrokeTips::StartPointed) == (int)StrokeTips::StartPointed)
+                startw = std::max(basewidth * 0.3, 0.2);
+            if ((s->tips & (int)StrokeTips::StartThin) == (int)StrokeTips::StartThin)
+                startw = std::max(basewidth * 0.7, 0.3);
+        }
+        if (ix == siz - 1)
+        {
+            if ((s->tips & (int)StrokeTips::EndPointed) == (int)StrokeTips::EndPointed)
+                endw = std::max(basewidth * 0.3, 0.2);
+            if ((s->tips & (int)StrokeTips::EndThin) == (int)StrokeTips::EndThin)
+                endw = std::max(basewidth * 0.7, 0.3);
+        }
+
+        for (int part = 0; part != partcnt; ++part)
+        {
+            StrokeShape::Part p;
+            p.last = part == partcnt - 1;
+
+            if (point.type == ElementPoint::LineTo)
+            {
+                p.line = true;
+                p.gradstart = QPointF(pastpoint.x, pastpoint.y);
+                p.gradend = QPointF(point.x, point.y);
+                p.gradbefore = startcnt;
+                p.gradcount = partcnt;
+                p.gradafter = endcnt;
+
+                if (p.last)
+                    p.path = linePath(QPointF(pastpoint.x, pastpoint.y), QPointF(point.x, point.y), startw, endw);
+                else
+                {
+                    double mul = double(part + 1) / partcnt;
+                    QPointF pt = QPointF(pastpoint.x + (point.x - pastpoint.x) * mul, pastpoint.y + (point.y - pastpoint.y) * mul);
+                    p.path = linePath(QPointF(pastpoint.x, pastpoint.y), pt, startw, startw + (endw - startw) * mul);
+                }
+            }
+            else
+            {
+                p.line = false;
+
+                double startt = double(part) / partcnt;
+                double endt = double(part + 1) / partcnt;
+
+                double partstartw;
+                double partendw;
+                // Negative width makes the bezier draw a "dot" stroke.
+                if (s->tips != (int)StrokeTips::SingleDot)
+                {
+                    partstartw = startw + (endw - startw) * startt;
+                    partendw = startw + (endw - startw) * endt;
+                }
+                else
+                {
+                    // The widths of a singledot stroke are computed by one component of a bezier.
+                    partstartw = basewidth * (std::pow(1.0 - startt, 3) * dotwsy + 3 * startt * std::pow(1 - startt, 2) * dotwc1y + 3 * std::pow(startt, 2) * (1 - startt) * dotwc2y + std::pow(startt, 3) * dotwey);
+                    partendw = basewidth * (std::pow(1.0 - endt, 3) * dotwsy + 3 * endt * std::pow(1 - endt, 2) * dotwc1y + 3 * std::pow(endt, 2) * (1 - endt) * dotwc2y + std::pow(endt, 3) * dotwey);
+                }
+
+                double p1x = pastpoint.x;
+                double p1y = pastpoint.y;
+                double p2x = point.x;
+                double p2y = point.y;
+
+                double c1x = point.c1x;
+                double c1y = point.c1y;
+                double c2x = point.c2x;
+                double c2y = point.c2y;
+
+                double ptx1 = std::pow(1.0 - startt, 3) * p1x + 3 * startt * std::pow(1 - startt, 2) * c1x + 3 * std::pow(startt, 2) * (1 - startt) * c2x + std::pow(startt, 3) * p2x;
+                double pty1 = std::pow(1.0 - startt, 3) * p1y + 3 * startt * std::pow(1 - startt, 2) * c1y + 3 * std::pow(startt, 2) * (1 - startt) * c2y + std::pow(startt, 3) * p2y;
+
+                double ptx2 = std::pow(1.0 - endt, 3) * p1x + 3 * endt * std::pow(1 - endt, 2) * c1x + 3 * std::pow(endt, 2) * (1 - endt) * c2x + std::pow(endt, 3) * p2x;
+                double pty2 = std::pow(1.0 - endt, 3) * p1y + 3 * endt * std::pow(1 - endt, 2) * c1y + 3 * std::pow(endt, 2) * (1 - endt) * c2y + std::pow(endt, 3) * p2y;
+
+                p.gradstart = QPointF(ptx1, pty1);
+                p.gradend = QPointF(ptx2, pty2);
+                p.gradbefore = startcnt + part;
+                p.gradcount = 1;
+                p.gradafter = endcnt + partcnt - part - 1;
+
+                p.path = linePath(p.gradstart, p.gradend, partstartw, partendw);
+            }
+
+            shape.list.push_back(std::move(p));
+        }
+
+        startcnt += partcnt;
+        pastpoint = point;
+    }
+}
+
+void KanjiElementList::drawShapePart(QPainter &painter, bool partialline, const StrokeShape &shape, int part, QColor startcolor, QColor endcolor) const
+{
+    const StrokeShape::Part &p = shape.list[part];
+
+    // Lines are drawn from the start of their segment, and only their last part is drawn
+    // when partialline is set. Curves are not drawn in that case.
+    if (p.line ? p.last == partialline : partialline)
+        return;
+
+    double basewidth = shape.basewidth;
+    bool usecolor = startcolor.isValid() && endcolor.isValid();
+
+    int salpha = usecolor ? startcolor.alpha() : painter.brush().color().alpha();
+    int ealpha = usecolor ? endcolor.alpha() : salpha;
+    if (basewidth < 2.0)
+    {
+        salpha = salpha * basewidth / 2.0;
+        ealpha = ealpha * basewidth / 2.0;
+    }
+
+    QBrush b = painter.brush();
+    if (usecolor)
+    {
+        QColor sc = startcolor;
+        sc.setAlpha(salpha);
+        QColor ec = endcolor;
+        ec.setAlpha(ealpha);
+        painter.setBrush(paintGradient(p.gradstart.x(), p.gradstart.y(), p.gradend.x(), p.gradend.y(), basewidth * (shape.pointstart ? 2 : 1), p.gradbefore, p.gradcount, p.gradafter, sc, ec));
+    }
+    else
+    {
+        QColor c = b.color();
+        c.setAlpha(salpha);
+        painter.setBrush(c);
+    }
+
+    painter.drawPath(p.path);
+
+    painter.setBrush(b);
+}
+
 int KanjiElementList::strokePartCount(const ElementStroke *s, const ElementTransform &tr, double partlen, bool animated, std::vector<int> &parts) const
 {
     ElementPointT pastpoint = tr.transformed(s->points[0]);
@@ -2229,167 +2638,12 @@ QLinearGradient KanjiElementList::paintGradient(double x1, double y1, double x2,
 }
 
 
-void KanjiElementList::drawStrokePart(QPainter &painter, bool partialline, double basewidth, const ElementStroke *s, const ElementTransform &tr, const std::vector<int> &parts, int part, QColor startcolor, QColor endcolor) const
+void KanjiElementList::drawLine(QPainter &painter, const QPointF &start, const QPointF &end, double startw, double endw) const
 {
-    int partspos = 0;
-    int ix = 1;
-    int siz = tosigned(s->points.size());
-
-    QBrush b;
-    int fullcnt = 0;
-    int startcnt = 0;
-    bool usecolor = startcolor.isValid() && endcolor.isValid();
-    if (usecolor)
-    {
-        for (int iy = 0, sizy = tosigned(parts.size()); iy != sizy; ++iy)
-            fullcnt += parts[iy];
-    }
-
-    for (; ix != siz; ++ix)
-    {
-        if (part >= parts[partspos])
-        {
-            startcnt += parts[partspos];
-            part -= parts[partspos];
-            ++partspos;
-            continue;
-        }
-        break;
-    }
-
-    int partcnt = parts[partspos];
-    int endcnt = fullcnt - startcnt - partcnt;
-
-    ElementPointT pastpoint = tr.transformed(s->points[ix - 1]);
-    ElementPointT point = tr.transformed(s->points[ix]);
-
-    int salpha = usecolor ? startcolor.alpha() : painter.brush().color().alpha();
-    int ealpha = usecolor ? endcolor.alpha() : salpha;
-    if (basewidth < 2.0)
-    {
-        salpha = salpha * basewidth / 2.0;
-        ealpha = ealpha * basewidth / 2.0;
-    }
-
-    double startw = basewidth;
-    double endw = basewidth;
-    bool pointstart = (s->tips & (int)StrokeTips::StartPointed) == (int)StrokeTips::StartPointed || s->tips == (int)StrokeTips::SingleDot;
-    if (ix == 1)
-    {
-        if ((s->tips & (int)StrokeTips::StartPointed) == (int)StrokeTips::StartPointed)
-            startw = std::max(basewidth * 0.3, 0.2);
-        if ((s->tips & (int)StrokeTips::StartThin) == (int)StrokeTips::StartThin)
-            startw = std::max(basewidth * 0.7, 0.3);
-    }
-    if (ix == siz - 1)
-    {
-        if ((s->tips & (int)StrokeTips::EndPointed) == (int)StrokeTips::EndPointed)
-            endw = std::max(basewidth * 0.3, 0.2);
-        if ((s->tips & (int)StrokeTips::EndThin) == (int)StrokeTips::EndThin)
-            endw = std::max(basewidth * 0.7, 0.3);
-    }
-
-    if (point.type == ElementPoint::LineTo)
-    {
-        bool last = (part == partcnt - 1);
-        if (last == partialline)
-            return;
-
-        b = painter.brush();
-        if (usecolor)
-        {
-            QColor sc = startcolor;
-            sc.setAlpha(salpha);
-            QColor ec = endcolor;
-            ec.setAlpha(ealpha);
-            painter.setBrush(paintGradient(pastpoint.x, pastpoint.y, point.x, point.y, basewidth * (pointstart ? 2 : 1), startcnt, partcnt, endcnt, sc, ec));
-        }
-        else
-        {
-            QColor c = b.color();
-            c.setAlpha(salpha);
-            painter.setBrush(c);
-        }
-
-
-        if (last)
-            drawLine(painter, QPointF(pastpoint.x, pastpoint.y), QPointF(point.x, point.y), startw, endw);
-        else
-        {
-            double mul = double(part + 1) / partcnt;
-            point.x = pastpoint.x + (point.x - pastpoint.x) * mul;
-            point.y = pastpoint.y + (point.y - pastpoint.y) * mul;
-
-            endw = startw + (endw - startw) * mul;
-
-            drawLine(painter, QPointF(pastpoint.x, pastpoint.y), QPointF(point.x, point.y), startw, endw);
-        }
-        painter.setBrush(b);
-    }
-    else if (point.type == ElementPoint::Curve)
-    {
-        if (partialline)
-            return;
-
-        double startt = double(part) / partcnt;
-        double endt = double(part + 1) / partcnt;
-
-        double tmpstartw = startw;
-        double tmpendw = endw;
-
-        // Negative width makes the bezier draw a "dot" stroke.
-        if (s->tips != (int)StrokeTips::SingleDot)
-        {
-            startw = tmpstartw + (tmpendw - tmpstartw) * startt;
-            endw = tmpstartw + (tmpendw - tmpstartw) * endt;
-        }
-        else
-        {
-            // The widths of a singledot stroke are computed by one component of a bezier.
-            startw = basewidth * (std::pow(1.0 - startt, 3) * dotwsy + 3 * startt * std::pow(1 - startt, 2) * dotwc1y + 3 * std::pow(startt, 2) * (1 - startt) * dotwc2y + std::pow(startt, 3) * dotwey);
-            endw = basewidth * (std::pow(1.0 - endt, 3) * dotwsy + 3 * endt * std::pow(1 - endt, 2) * dotwc1y + 3 * std::pow(endt, 2) * (1 - endt) * dotwc2y + std::pow(endt, 3) * dotwey);
-        }
-
-        double p1x = pastpoint.x;
-        double p1y = pastpoint.y;
-        double p2x = point.x;
-        double p2y = point.y;
-
-        double c1x = point.c1x;
-        double c1y = point.c1y;
-        double c2x = point.c2x;
-        double c2y = point.c2y;
-
-        double ptx1 = std::pow(1.0 - startt, 3) * p1x + 3 * startt * std::pow(1 - startt, 2) * c1x + 3 * std::pow(startt, 2) * (1 - startt) * c2x + std::pow(startt, 3) * p2x;
-        double pty1 = std::pow(1.0 - startt, 3) * p1y + 3 * startt * std::pow(1 - startt, 2) * c1y + 3 * std::pow(startt, 2) * (1 - startt) * c2y + std::pow(startt, 3) * p2y;
-
-        double ptx2 = std::pow(1.0 - endt, 3) * p1x + 3 * endt * std::pow(1 - endt, 2) * c1x + 3 * std::pow(endt, 2) * (1 - endt) * c2x + std::pow(endt, 3) * p2x;
-        double pty2 = std::pow(1.0 - endt, 3) * p1y + 3 * endt * std::pow(1 - endt, 2) * c1y + 3 * std::pow(endt, 2) * (1 - endt) * c2y + std::pow(endt, 3) * p2y;
-
-        b = painter.brush();
-        if (usecolor)
-        {
-            QColor sc = startcolor;
-            sc.setAlpha(salpha);
-            QColor ec = endcolor;
-            ec.setAlpha(ealpha);
-            painter.setBrush(paintGradient(ptx1, pty1, ptx2, pty2, basewidth * (pointstart ? 2 : 1), startcnt + part, 1, endcnt + partcnt - part - 1, sc, ec));
-        }
-        else
-        {
-            QColor c = b.color();
-            c.setAlpha(salpha);
-            painter.setBrush(c);
-        }
-
-        drawLine(painter, QPointF(ptx1, pty1), QPointF(ptx2, pty2), startw, endw);
-
-        painter.setBrush(b);
-    }
-
+    painter.drawPath(linePath(start, end, startw, endw));
 }
 
-void KanjiElementList::drawLine(QPainter &painter, const QPointF &start, const QPointF &end, double startw, double endw) const
+QPainterPath KanjiElementList::linePath(const QPointF &start, const QPointF &end, double startw, double endw) const
 {
     // Line drawing with differing start and end widths is done by placing arcs at the start
     // and end points of the path. The filled path will make the line.
@@ -2413,8 +2667,7 @@ void KanjiElementList::drawLine(QPainter &painter, const QPointF &start, const Q
     if (fabs(sx - ex) < 0.00001 && fabs(sy - ey) < 0.00001)
     {
         path.addEllipse(startw > endw ? startr : endr);
-        painter.drawPath(path);
-        return;
+        return path;
     }
 
     double deg = std::atan2(ex - sx, ey - sy) * 180 / const_PI;
@@ -2430,7 +2683,7 @@ void KanjiElementList::drawLine(QPainter &painter, const QPointF &start, const Q
     path.arcTo(endr, enddeg, 180);
     path.closeSubpath();
 
-    painter.drawPath(path);
+    return path;
 }
 
 double KanjiElementList::bezierLength(const QPointF &start, const QPointF &c1, const QPointF &c2, const QPointF &end, double maxerror) const
@@ -8,13 +8,17 @@
 #define RECOGNIZER_H
 
 #include <QPainter>
+#include <QPainterPath>
+#include <QMutex>
 //#include <QPoint>
 //#include <QRect>
 
 #include <cmath>
 #include <vector>
 #include <map>
+#include <list>
 #include <memory>
+#include <atomic>
 #include "smartvector.h"
 #include "fastarray.h"
 #include "bits.h"
@@ -22,6 +26,7 @@
 
 class RadianDistance;
 class KanjiElementList;
+class QFile;
 
 namespace ZKanji
 {
@@ -497,6 +502,17 @@ struct KanjiElement
 
     fastarray<ushort> parents;
 
+    // Number of variants of the element.
+    uchar variantcnt;
+
+    // Position of the element's variants in the stroke order data, followed by the
+    // recognizer data. The variants and recdata are only filled from the data the first
+    // time they are used. Use KanjiElementList::elementVariant() and recognizerData()
+    // instead of accessing them directly.
+    quint32 datapos;
+    // Set once variants and recdata are filled.
+    std::atomic_bool decoded;
+
     smartvector<ElementVariant> variants;
 
     fastarray<RecognizerData> recdata;
@@ -529,6 +545,8 @@ class KanjiElementList
 public:
     typedef size_t  size_type;
 
+    ~KanjiElementList();
+
     // Removes all data from the recognizer. Set full to true to remove kanji stroke model
     // data as well.
     void clear(bool full = false);
@@ -590,6 +608,16 @@ public:
     // Otherwise positive values are returned for the elements.
     void elementParents(int index, bool skipelements, bool usekanji, std::vector<int> &result) const;
 
+    // Adds the elements making up the variant of an element to result, together with the
+    // ratio of the variant's area they take up. Parts of the parts are added as well, and
+    // elements used at several places are listed once for each.
+    void elementComponents(int element, int variant, std::vector<std::pair<int, double>> &result) const;
+
+    // Adds points along every stroke of the variant of an element to result, as if it was
+    // drawn in rect. Lines and curves between the points of the strokes are divided into
+    // steps parts.
+    void strokeOutline(int element, int variant, const QRectF &rect, int steps, std::vector<QPointF> &result) const;
+
     // Draws every stroke of an element's variant with painter in the center of the passed
     // rectangle. Set animated to true when it's important that the drawn element strokes are
     // made up of around the same number of parts independent of the rectangle size.
@@ -638,13 +666,82 @@ private:
     KanjiElementList();
     KanjiElementList(const QString &filename);
 
+    // Returns the variant at index of the element e, decoding the element's data first if
+    // it hasn't been used yet.
+    const ElementVariant* elementVariant(const KanjiElement *e, int index) const;
+    // Returns the recognizer data of the element e, decoding the element's data first if it
+    // hasn't been used yet.
+    const fastarray<RecognizerData>& recognizerData(const KanjiElement *e) const;
+    // Fills the variants and recognizer data of e from the stroke order data.
+    void decodeElement(KanjiElement *e) const;
+
     // Returns the kanji variant's stroke at sindex. The r rectangle should be the position
     // and dimensions where the variant would be drawn. The transformation is updated to be
     // used with stroke to make it fit in r.
     const ElementStroke* findStroke(const KanjiElement *e, const ElementVariant *v, int sindex, QRectF r, ElementTransform &tr) const;
 
+    // Returns the stroke of an element's variant at sindex, when the whole variant is drawn
+    // centered in rect. The transformation is updated to be used with the stroke to make it
+    // fit, and strokew is set to the base pen width for rect.
+    const ElementStroke* findStroke(int element, int variant, int sindex, const QRectF &rect, ElementTransform &tr, double &strokew) const;
+
     int strokePartCount(const ElementStroke *s, const ElementTransform &tr, double partlen, bool animated, std::vector<int> &parts) const;
 
+    // Stroke of an element's variant cut into parts and converted to paths, ready to be
+    // drawn in a rectangle. Animations draw the same stroke part by part many times, and
+    // the shapes are cached to only compute the geometry of the parts once.
+    struct StrokeShape
+    {
+        int element;
+        int variant;
+        int stroke;
+        QRectF rect;
+        // Values passed to strokePartCount() when the parts were computed. Shapes created
+        // for parts passed from outside have a partlen of -2.
+        double partlen;
+        bool animated;
+
+        // Number of parts of each segment of the stroke.
+        std::vector<int> parts;
+        int partcount;
+
+        double basewidth;
+        // The stroke starts with a pointed tip or is a single dot.
+        bool pointstart;
+
+        struct Part
+        {
+            // Filled outline of the part.
+            QPainterPath path;
+
+            // The part is of a straight line segment. Parts of lines are drawn from the start
+            // of the segment.
+            bool line;
+            // The part is the last one of its segment.
+            bool last;
+
+            // Line and part counts passed to paintGradient() when drawing with colors.
+            QPointF gradstart;
+            QPointF gradend;
+            int gradbefore;
+            int gradcount;
+            int gradafter;
+        };
+        std::vector<Part> list;
+    };
+
+    // Returns the cached shape of the stroke of an element's variant drawn in rect. If parts
+    // is not null, the shape is made of those parts, otherwise the parts are computed with
+    // partlen and animated. Returns null if the stroke is not found.
+    const StrokeShape* strokeShape(int element, int variant, int stroke, const QRectF &rect, double partlen, bool animated, const std::vector<int> *parts) const;
+
+    // Fills the parts of shape with the geometry of stroke s transformed by tr.
+    void buildStrokeShape(StrokeShape &shape, const ElementStroke *s, const ElementTransform &tr) const;
+
+    // Draws a part of a stroke shape with painter. See the public drawStrokePart() for the
+    // meaning of the arguments.
+    void drawShapePart(QPainter &painter, bool partialline, const StrokeShape &shape, int part, QColor startcolor, QColor endcolor) const;
+
     void strokeData(const ElementStroke *s, const ElementTransform &tr, StrokeDirection &dir, QPoint &startpoint) const;
 
     // Draws a kanji stroke transformed by tr with painter. The width of the stroke can change
@@ -664,17 +761,14 @@ private:
     // "spot" at the beginning of the stroke, while endcolor is for the rest of the stroke.
     QLinearGradient paintGradient(double x1, double y1, double x2, double y2, double dotsize, int startcnt, int partcnt, int endcnt, QColor startcolor, QColor endcolor) const;
 
-    // Draws a kanji stroke part transformed by tr with painter. The width of the stroke can
-    // change depending on its tips, but the normal width is passed in basewidth.
-    // Set areasize to the width/height of the square where the variant's stroke is to be
-    // drawn. This will help determine the number of steps needed to cut up a bezier curve to
-    // make it look smooth.
-    void drawStrokePart(QPainter &painter, bool partialline, double basewidth, const ElementStroke *s, const ElementTransform &tr, const std::vector<int> &parts, int part, QColor startcolor, QColor endcolor) const;
-
     // Draws a line with painter between the starting and ending points with pen widths of
     // startw and endw.
     void drawLine(QPainter &painter, const QPointF &start, const QPointF &end, double startw, double endw) const;
 
+    // Returns the outline of a line between the starting and ending points with pen widths
+    // of startw and endw. The line is drawn by filling the path.
+    QPainterPath linePath(const QPointF &start, const QPointF &end, double startw, double endw) const;
+
     // Approximates the length of a cubic bezier. The maxerror is NOT the error between the
     // approximated length and real length. The bezier is divided until each part can be
     // approximated close enough. The maxerror is the acceptable difference between the length
@@ -716,6 +810,18 @@ private:
     // File version after loading.
     int version;
 
+    // The stroke order data file, mapped to memory while the list exists. The variants and
+    // recognizer data of the elements are decoded from it when they are first used.
+    std::unique_ptr<QFile> file;
+    // The contents of the stroke order data file if it couldn't be mapped.
+    QByteArray filedata;
+    // Start and size of the stroke order data in memory.
+    const uchar *data;
+    qint64 datasize;
+    // Locked while decoding the data of an element. Elements are used from several threads
+    // when building the similar kanji table.
+    mutable QMutex decodemutex;
+
     // List of all kanji elements made up of other elements. Many of them are actual
     // characters.
     smartvector<KanjiElement> list;
@@ -738,6 +844,12 @@ private:
     // to it.
     std::map<int, QCharString> varnames;
 
+    // Recently drawn stroke shapes. The most recently used is at the front. The cache is not
+    // locked, so the stroke drawing functions using it must only be called from the GUI
+    // thread. Functions used by background calculations, like strokeOutline(), don't touch
+    // it.
+    mutable std::list<StrokeShape> shapes;
+
     // [kanji index, element index] loaded when loading the KanjiElementList. Only used during
     // startup, before the base dictionary is loaded. Afterwards the elements of the kanji are
     // filled with the values stored here, and this list is cleared.
@@ -0,0 +1,644 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <QLocalSocket>
+#include <QDataStream>
+#include <QTextStream>
+#include <QStringList>
+#include <algorithm>
+#include <set>
+
+#include "lookupserver.h"
+#include "zkanjimain.h"
+#include "words.h"
+#include "kanji.h"
+#include "groups.h"
+#include "worddeck.h"
+#include "romajizer.h"
+#include "grammar_enums.h"
+
+#include "checked_cast.h"
+
+
+//-------------------------------------------------------------
+
+
+const char LookupServer::version[] = "001";
+
+namespace
+{
+    // Name of the local server of the running instance.
+    const char serverName[] = "zkanjiSingleAppServer";
+
+    // Requests larger than this are not accepted and the connection is closed.
+    const quint32 maxRequestSize = 1024 * 1024;
+
+    void setupStream(QDataStream &stream)
+    {
+        stream.setByteOrder(QDataStream::LittleEndian);
+        stream.setVersion(QDataStream::Qt_5_5);
+    }
+
+    // Returns payload with its size in front.
+    QByteArray makeFrame(const QByteArray &payload)
+    {
+        QByteArray frame;
+        QDataStream stream(&frame, QIODevice::WriteOnly);
+        setupStream(stream);
+        stream << (quint32)payload.size();
+        frame.append(payload);
+        return frame;
+    }
+
+    QStringList toStringList(const QCharStringList &list)
+    {
+        QStringList result;
+        for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
+            result << list[ix].toQString();
+        return result;
+    }
+}
+
+LookupServer::LookupServer(QObject *parent) : base(parent), ready(false)
+{
+    connect(&server, &QLocalServer::newConnection, this, &LookupServer::newConnection);
+}
+
+LookupServer::~LookupServer()
+{
+
+}
+
+bool LookupServer::listen(const QString &name)
+{
+    // TODO: add something specific to the server name for each user, so different users
+    // can run their own instances. Better alternative to include the path where zkanji
+    // will save its data, as that should limit the instances running.
+    QLocalServer::removeServer(name);
+    //server.setSocketOptions(); - Use this if the specific user mode is implemented by
+    // setting different name to the server for each user/data save location.
+    return server.listen(name);
+}
+
+void LookupServer::setReady(bool isready)
+{
+    ready = isready;
+}
+
+void LookupServer::newConnection()
+{
+    while (server.hasPendingConnections())
+    {
+        QLocalSocket *socket = server.nextPendingConnection();
+        connections[socket];
+        connect(socket, &QLocalSocket::readyRead, this, &LookupServer::readyRead);
+        connect(socket, &QLocalSocket::disconnected, this, &LookupServer::disconnected);
+
+        if (socket->bytesAvailable() != 0)
+            processRequests(socket);
+    }
+}
+
+void LookupServer::readyRead()
+{
+    processRequests((QLocalSocket*)sender());
+}
+
+void LookupServer::disconnected()
+{
+    QLocalSocket *socket = (QLocalSocket*)sender();
+
+    // Data might have arrived together with the disconnect.
+    if (socket->bytesAvailable() != 0)
+        processRequests(socket);
+
+    auto it = connections.find(socket);
+    if (it == connections.end())
+        return;
+
+    // A new instance of the program connects without sending anything.
+    bool activate = !it->second.started && it->second.data.isEmpty();
+    connections.erase(it);
+    socket->deleteLater();
+
+    if (activate)
+        emit activateRequested();
+}
+
+void LookupServer::processRequests(QLocalSocket *socket)
+{
+    auto it = connections.find(socket);
+    if (it == connections.end())
+        return;
+    Connection &c = it->second;
+
+    c.data.append(socket->readAll());
+
+    if (!c.started)
+    {
+        if (c.data.size() < 6)
+            return;
+        if (strncmp(c.data.constData(), "zkl", 3) != 0 || strncmp(c.data.constData() + 3, version, 3) != 0)
+        {
+            c.data.clear();
+            c.started = true;
+            socket->abort();
+            return;
+        }
+        c.started = true;
+        c.data.remove(0, 6);
+    }
+
+    int pos = 0;
+    while (c.data.size() - pos >= 4)
+    {
+        quint32 size;
+        {
+            QDataStream stream(c.data.mid(pos, 4));
+            setupStream(stream);
+            stream >> size;
+        }
+        if (size > maxRequestSize)
+        {
+            c.data.clear();
+            socket->abort();
+            return;
+        }
+        if (tounsigned(c.data.size() - pos - 4) < size)
+            break;
+
+        QByteArray payload = c.data.mid(pos + 4, size);
+        pos += 4 + size;
+
+        QDataStream stream(payload);
+        setupStream(stream);
+
+        quint32 id = 0;
+        quint8 cmd = 0;
+        stream >> id >> cmd;
+
+        QByteArray results;
+        QDataStream reply(&results, QIODevice::WriteOnly);
+        setupStream(reply);
+
+        Status status;
+        if (stream.status() != QDataStream::Ok)
+            status = Status::BadRequest;
+        else if (!ready && (Command)cmd != Command::Activate)
+            status = Status::NotReady;
+        else
+            status = handleRequest((Command)cmd, stream, reply);
+
+        // Results of failed requests are not sent.
+        if (status != Status::Ok)
+            results.clear();
+
+        QByteArray answer;
+        QDataStream astream(&answer, QIODevice::WriteOnly);
+        setupStream(astream);
+        astream << id << (quint8)status;
+        answer.append(results);
+
+        socket->write(makeFrame(answer));
+    }
+
+    c.data.remove(0, pos);
+}
+
+LookupServer::Status LookupServer::handleRequest(Command cmd, QDataStream &stream, QDataStream &reply)
+{
+    switch (cmd)
+    {
+    case Command::Activate:
+        emit activateRequested();
+        return Status::Ok;
+    case Command::FindWords:
+        return findWords(stream, reply);
+    case Command::KanjiInfo:
+        return kanjiInfo(stream, reply);
+    case Command::AddToGroup:
+        return addToGroup(stream, reply);
+    case Command::AddToDeck:
+        return addToDeck(stream, reply);
+    default:
+        return Status::BadRequest;
+    }
+}
+
+LookupServer::Status LookupServer::findWords(QDataStream &stream, QDataStream &reply)
+{
+    Dictionary *dict = readDictionary(stream);
+
+    quint8 mode;
+    quint8 wildcards;
+    quint8 deinflect;
+    quint32 maxresults;
+    QString search;
+    stream >> mode >> wildcards >> deinflect >> maxresults >> search;
+
+    if (stream.status() != QDataStream::Ok || (mode != (int)SearchMode::Japanese && mode != (int)SearchMode::Definition) || (wildcards & ~((int)SearchWildcard::AnyBefore | (int)SearchWildcard::AnyAfter)) != 0)
+        return Status::BadRequest;
+    if (dict == nullptr)
+        return Status::NotFound;
+
+    // Romaji is converted here, because the search only looks at the Japanese characters.
+    if ((SearchMode)mode == SearchMode::Japanese)
+    {
+        bool romaji = false;
+        for (int ix = 0, siz = search.size(); !romaji && ix != siz; ++ix)
+            romaji = search.at(ix).unicode() < 0x80;
+        if (romaji)
+            search = toKana(search);
+    }
+
+    WordResultList result(dict);
+    dict->findWords(result, (SearchMode)mode, search, SearchWildcards(wildcards), false, deinflect != 0, false, nullptr, nullptr);
+
+    const std::vector<int> &indexes = result.getIndexes();
+    const smartvector<std::vector<InfTypes>> &infs = result.getInflections();
+
+    // The maximum comes from the client and can be larger than any int.
+    quint32 cnt = (quint32)std::min<size_t>(indexes.size(), maxresults);
+    reply << cnt;
+    for (int ix = 0; ix != (int)cnt; ++ix)
+    {
+        int windex = indexes[ix];
+        const WordEntry *e = dict->wordEntry(windex);
+        reply << (quint32)windex << e->kanji.toQString() << e->kana.toQString() << dict->wordDefinitionString(windex, false);
+
+        const std::vector<InfTypes> *inf = ix < tosigned(infs.size()) ? infs[ix] : nullptr;
+        int infcnt = inf == nullptr ? 0 : std::min<int>(tosigned(inf->size()), 255);
+        reply << (quint8)infcnt;
+        for (int iy = 0; iy != infcnt; ++iy)
+            reply << (quint8)(*inf)[iy];
+    }
+
+    return Status::Ok;
+}
+
+LookupServer::Status LookupServer::kanjiInfo(QDataStream &stream, QDataStream &reply)
+{
+    Dictionary *dict = readDictionary(stream);
+    QString str;
+    stream >> str;
+
+    if (stream.status() != QDataStream::Ok)
+        return Status::BadRequest;
+    if (dict == nullptr)
+        return Status::NotFound;
+
+    std::vector<int> kindexes;
+    for (int ix = 0, siz = str.size(); ix != siz; ++ix)
+    {
+        if (!KANJI(str.at(ix).unicode()))
+            continue;
+        int kindex = ZKanji::kanjiIndex(str.at(ix));
+        if (kindex != -1)
+            kindexes.push_back(kindex);
+    }
+
+    reply << (quint32)kindexes.size();
+    for (int kindex : kindexes)
+    {
+        const KanjiEntry *k = ZKanji::kanjis[kindex];
+        reply << (ushort)k->ch.unicode() << (quint8)k->strokes << (quint8)k->jouyou << (quint8)k->jlpt << (quint16)k->frequency;
+        reply << toStringList(k->on) << toStringList(k->kun) << dict->kanjiMeaning(kindex);
+    }
+
+    return Status::Ok;
+}
+
+LookupServer::Status LookupServer::addToGroup(QDataStream &stream, QDataStream &reply)
+{
+    Dictionary *dict = readDictionary(stream);
+    QString name;
+    quint8 create;
+    stream >> name >> create;
+
+    std::vector<int> windexes;
+    if (stream.status() != QDataStream::Ok || name.isEmpty())
+        return Status::BadRequest;
+    if (dict == nullptr)
+        return Status::NotFound;
+    if (!readWordIndexes(stream, dict, windexes))
+        return Status::BadRequest;
+
+    WordGroup *group = dict->wordGroups().groupFromEncodedName(name, 0, -1, create != 0);
+    if (group == nullptr)
+        return Status::NotFound;
+
+    reply << (quint32)group->add(windexes);
+    return Status::Ok;
+}
+
+LookupServer::Status LookupServer::addToDeck(QDataStream &stream, QDataStream &reply)
+{
+    Dictionary *dict = readDictionary(stream);
+    QString name;
+    quint8 parts;
+    stream >> name >> parts;
+
+    std::vector<int> windexes;
+    if (stream.status() != QDataStream::Ok || (parts & ~(int)WordPartBits::AllParts) != 0)
+        return Status::BadRequest;
+    if (dict == nullptr)
+        return Status::NotFound;
+    if (!readWordIndexes(stream, dict, windexes))
+        return Status::BadRequest;
+
+    WordDeckList *decks = dict->wordDecks();
+    WordDeck *deck = nullptr;
+    if (name.isEmpty())
+        deck = decks->lastSelected();
+    else
+    {
+        int index = decks->indexOf(name);
+        if (index != -1)
+            deck = decks->items(index);
+    }
+    if (deck == nullptr)
+        return Status::NotFound;
+
+    std::vector<std::pair<int, int>> items;
+    items.reserve(windexes.size());
+    for (int windex : windexes)
+    {
+        int wparts = parts;
+        if (wparts == 0)
+        {
+            const WordEntry *e = dict->wordEntry(windex);
+            wparts = (int)WordPartBits::Kana | (int)WordPartBits::Definition;
+            if (qcharcmp(e->kanji.data(), e->kana.data()) != 0)
+                wparts |= (int)WordPartBits::Kanji;
+        }
+        items.push_back(std::make_pair(windex, wparts));
+    }
+
+    reply << (quint32)deck->queueWordItems(items);
+    decks->setLastSelected(deck);
+
+    return Status::Ok;
+}
+
+Dictionary* LookupServer::readDictionary(QDataStream &stream)
+{
+    QString name;
+    stream >> name;
+    if (stream.status() != QDataStream::Ok)
+        return nullptr;
+    if (name.isEmpty())
+        return ZKanji::dictionary(0);
+
+    int index = ZKanji::dictionaryIndex(name);
+    return index == -1 ? nullptr : ZKanji::dictionary(index);
+}
+
+bool LookupServer::readWordIndexes(QDataStream &stream, Dictionary *dict, std::vector<int> &result)
+{
+    quint32 cnt;
+    stream >> cnt;
+    if (stream.status() != QDataStream::Ok || cnt > maxRequestSize / 4)
+        return false;
+
+    result.reserve(cnt);
+    for (quint32 ix = 0; ix != cnt; ++ix)
+    {
+        quint32 windex;
+        stream >> windex;
+        if (stream.status() != QDataStream::Ok || windex >= tounsigned(dict->entryCount()))
+            return false;
+        result.push_back(windex);
+    }
+
+    // Groups and decks must not get the same word twice. Only the first of the repeated
+    // indexes is kept.
+    std::set<int> found;
+    result.erase(std::remove_if(result.begin(), result.end(), [&found](int windex) {
+        return !found.insert(windex).second;
+    }), result.end());
+
+    return true;
+}
+
+
+//-------------------------------------------------------------
+
+
+namespace
+{
+    void printClientUsage(QTextStream &out)
+    {
+        out << "USAGE: zkanji --lookup [-d dictionary] [-m jp|def] [-x] [-i] [-n max] text" << endl;
+        out << "       zkanji --kanji [-d dictionary] text" << endl;
+        out << "       zkanji --to-group [-d dictionary] [-c] group windex..." << endl;
+        out << "       zkanji --to-deck [-d dictionary] [-p parts] deck windex..." << endl;
+    }
+
+    // Sends the request to the running instance and waits for its reply. Returns false if
+    // the instance couldn't be reached.
+    bool sendLookupRequest(const QByteArray &request, QByteArray &answer)
+    {
+        QLocalSocket socket;
+        socket.connectToServer(serverName);
+        if (!socket.waitForConnected(1000))
+            return false;
+
+        QByteArray data("zkl");
+        data.append(LookupServer::version, 3);
+        data.append(makeFrame(request));
+        socket.write(data);
+        if (!socket.waitForBytesWritten(1000))
+            return false;
+
+        QByteArray received;
+        quint32 size = 0;
+        while (received.size() < 4 || tounsigned(received.size() - 4) < size)
+        {
+            if (!socket.waitForReadyRead(10000))
+                return false;
+            received.append(socket.readAll());
+            if (received.size() >= 4)
+            {
+                QDataStream stream(received.left(4));
+                setupStream(stream);
+                stream >> size;
+            }
+        }
+        socket.disconnectFromServer();
+
+        answer = received.mid(4, size);
+        return true;
+    }
+}
+
+int runLookupClient(const QStringList &args)
+{
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    if (args.isEmpty())
+    {
+        printClientUsage(err);
+        return 1;
+    }
+
+    QString cmd = args.at(0);
+
+    QString dictname;
+    quint8 mode = (quint8)SearchMode::Japanese;
+    quint8 wildcards = (quint8)SearchWildcard::AnyAfter;
+    quint8 deinflect = 0;
+    quint32 maxresults = 100;
+    quint8 create = 0;
+    quint8 parts = 0;
+    QStringList params;
+
+    bool ok = true;
+    for (int ix = 1, siz = args.size(); ok && ix != siz; ++ix)
+    {
+        const QString &a = args.at(ix);
+        bool hasvalue = ix + 1 != siz;
+        if (a == "-d" && hasvalue)
+            dictname = args.at(++ix);
+        else if (a == "-m" && hasvalue && cmd == "--lookup")
+        {
+            QString m = args.at(++ix);
+            if (m == "def")
+                mode = (quint8)SearchMode::Definition;
+            else
+                ok = m == "jp";
+        }
+        else if (a == "-x" && cmd == "--lookup")
+            wildcards = 0;
+        else if (a == "-i" && cmd == "--lookup")
+            deinflect = 1;
+        else if (a == "-n" && hasvalue && cmd == "--lookup")
+            maxresults = args.at(++ix).toUInt(&ok);
+        else if (a == "-c" && cmd == "--to-group")
+            create = 1;
+        else if (a == "-p" && hasvalue && cmd == "--to-deck")
+        {
+            int p = args.at(++ix).toInt(&ok);
+            ok = ok && (p & ~(int)WordPartBits::AllParts) == 0;
+            parts = p;
+        }
+        else
+            params << a;
+    }
+
+    QByteArray request;
+    QDataStream stream(&request, QIODevice::WriteOnly);
+    setupStream(stream);
+    stream << (quint32)1;
+
+    if (ok && cmd == "--lookup" && params.size() == 1)
+        stream << (quint8)LookupServer::Command::FindWords << dictname << mode << wildcards << deinflect << maxresults << params.at(0);
+    else if (ok && cmd == "--kanji" && params.size() == 1)
+        stream << (quint8)LookupServer::Command::KanjiInfo << dictname << params.at(0);
+    else if (ok && (cmd == "--to-group" || cmd == "--to-deck") && params.size() >= 2)
+    {
+        if (cmd == "--to-group")
+            stream << (quint8)LookupServer::Command::AddToGroup << dictname << params.at(0) << create;
+        else
+            stream << (quint8)LookupServer::Command::AddToDeck << dictname << params.at(0) << parts;
+
+        stream << (quint32)(params.size() - 1);
+        for (int ix = 1, siz = params.size(); ok && ix != siz; ++ix)
+            stream << (quint32)params.at(ix).toUInt(&ok);
+    }
+    else
+        ok = false;
+
+    if (!ok)
+    {
+        printClientUsage(err);
+        return 1;
+    }
+
+    QByteArray answer;
+    if (!sendLookupRequest(request, answer))
+    {
+        err << "zkanji is not running or not responding." << endl;
+        return 2;
+    }
+
+    QDataStream reply(answer);
+    setupStream(reply);
+    quint32 id;
+    quint8 status;
+    reply >> id >> status;
+
+    switch ((LookupServer::Status)status)
+    {
+    case LookupServer::Status::Ok:
+        break;
+    case LookupServer::Status::NotFound:
+        err << "The dictionary, group or deck was not found." << endl;
+        return 3;
+    case LookupServer::Status::NotReady:
+        err << "zkanji is not ready yet." << endl;
+        return 2;
+    default:
+        err << "Invalid request." << endl;
+        return 1;
+    }
+
+    // The results are printed with tab separated fields, one item per line.
+
+    quint32 cnt;
+    if (cmd == "--lookup")
+    {
+        reply >> cnt;
+        for (quint32 ix = 0; ix != cnt && reply.status() == QDataStream::Ok; ++ix)
+        {
+            quint32 windex;
+            QString kanji;
+            QString kana;
+            QString def;
+            quint8 infcnt;
+            reply >> windex >> kanji >> kana >> def >> infcnt;
+            QStringList infs;
+            for (int iy = 0; iy != infcnt; ++iy)
+            {
+                quint8 inf;
+                reply >> inf;
+                infs << QString::number(inf);
+            }
+            out << windex << "\t" << kanji << "\t" << kana << "\t" << def;
+            if (!infs.isEmpty())
+                out << "\t" << infs.join(",");
+            out << endl;
+        }
+    }
+    else if (cmd == "--kanji")
+    {
+        reply >> cnt;
+        for (quint32 ix = 0; ix != cnt && reply.status() == QDataStream::Ok; ++ix)
+        {
+            ushort ch;
+            quint8 strokes;
+            quint8 jouyou;
+            quint8 jlpt;
+            quint16 freq;
+            QStringList on;
+            QStringList kun;
+            QString meaning;
+            reply >> ch >> strokes >> jouyou >> jlpt >> freq >> on >> kun >> meaning;
+            out << QString(QChar(ch)) << "\t" << (int)strokes << "\t" << (int)jouyou << "\t" << (int)jlpt << "\t" << freq << "\t" << on.join(", ") << "\t" << kun.join(", ") << "\t" << meaning << endl;
+        }
+    }
+    else
+    {
+        reply >> cnt;
+        out << cnt << endl;
+    }
+
+    return 0;
+}
+
+
+//-------------------------------------------------------------
+
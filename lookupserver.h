@@ -0,0 +1,136 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef LOOKUPSERVER_H
+#define LOOKUPSERVER_H
+
+#include <QObject>
+#include <QLocalServer>
+#include <QByteArray>
+#include <map>
+#include <vector>
+
+class QStringList;
+class QLocalSocket;
+class QDataStream;
+class Dictionary;
+
+// Local server of the running zkanji instance. A new zkanji process connects to it to ask
+// the running instance to show its window. Other programs and the command line client (see
+// runLookupClient()) can use it to look up words and kanji in the dictionaries of the
+// running instance, or to add words to groups and decks, without loading any data.
+//
+// Protocol:
+//  The client starts by sending the header: "zkl" + 3 byte version. The server closes the
+//      connection if the header doesn't match. A connection closed by the client without
+//      sending anything asks the running instance to show its window.
+//  Requests and replies: [quint32 size][payload]. Every value in the payload is written by
+//      QDataStream with little endian byte order and Qt_5_5 version.
+//  Request payload: [quint32 request id][quint8 command][command arguments]
+//  Reply payload: [quint32 request id][quint8 status][command results if status is Ok]
+//  The server answers requests in the order they arrive.
+//
+// Commands:
+//  Activate: no arguments or results.
+//  FindWords: arguments: [QString dictionary name][quint8 SearchMode][quint8 SearchWildcards]
+//      [quint8 deinflect][quint32 max results][QString search]. Japanese searches can be in
+//      kana or romaji. An empty dictionary name selects the main dictionary.
+//      Results: [quint32 count] then for each word [quint32 word index][QString kanji]
+//      [QString kana][QString definition][quint8 inflection count][quint8 InfTypes...]
+//  KanjiInfo: arguments: [QString dictionary name][QString kanji]
+//      Results: [quint32 count] then for each kanji found in the string [ushort kanji]
+//      [quint8 strokes][quint8 jouyou][quint8 jlpt][quint16 frequency][QStringList on]
+//      [QStringList kun][QString meaning]
+//  AddToGroup: arguments: [QString dictionary name][QString group][quint8 create]
+//      [quint32 count][quint32 word index...] The group name is the full encoded path of
+//      the group. A missing group is created if create is not 0.
+//      Results: [quint32 number of words added]
+//  AddToDeck: arguments: [QString dictionary name][QString deck][quint8 WordPartBits]
+//      [quint32 count][quint32 word index...] An empty deck name selects the last deck words
+//      were added to. When the parts are 0, the kana and definition are added, and the
+//      kanji too if the word has kanji.
+//      Results: [quint32 number of items queued]
+class LookupServer : public QObject
+{
+    Q_OBJECT
+signals:
+    // A new zkanji instance was started, or a client asked the window to be shown.
+    void activateRequested();
+public:
+    // Version of the protocol. Must be 3 characters long.
+    static const char version[];
+
+    enum class Command : quint8 { Activate = 0, FindWords = 1, KanjiInfo = 2, AddToGroup = 3, AddToDeck = 4 };
+    enum class Status : quint8 {
+        Ok = 0,
+        // The request couldn't be read or had invalid arguments.
+        BadRequest = 1,
+        // The requested dictionary, group or deck was not found.
+        NotFound = 2,
+        // The instance is still starting up and can't answer requests.
+        NotReady = 3
+    };
+
+    LookupServer(QObject *parent = nullptr);
+    ~LookupServer();
+
+    // Starts listening for connections with the server name. Returns whether the server has
+    // been started.
+    bool listen(const QString &name);
+
+    // Requests are only answered after the server was set to be ready. Before that, they
+    // receive the NotReady status.
+    void setReady(bool ready);
+private slots:
+    void newConnection();
+    void readyRead();
+    void disconnected();
+private:
+    LookupServer(const LookupServer&) = delete;
+    LookupServer& operator=(const LookupServer&) = delete;
+
+    // Reads and answers every complete request received on socket.
+    void processRequests(QLocalSocket *socket);
+
+    // Reads the request from stream and writes the results to reply. Returns the status of
+    // the reply.
+    Status handleRequest(Command cmd, QDataStream &stream, QDataStream &reply);
+
+    Status findWords(QDataStream &stream, QDataStream &reply);
+    Status kanjiInfo(QDataStream &stream, QDataStream &reply);
+    Status addToGroup(QDataStream &stream, QDataStream &reply);
+    Status addToDeck(QDataStream &stream, QDataStream &reply);
+
+    // Reads a dictionary name from stream and returns the dictionary. An empty name selects
+    // the main dictionary. Returns null if the dictionary was not found.
+    static Dictionary* readDictionary(QDataStream &stream);
+    // Reads a list of word indexes from stream. Returns false if any index is invalid in
+    // dict. Repeated indexes are only added to result once.
+    static bool readWordIndexes(QDataStream &stream, Dictionary *dict, std::vector<int> &result);
+
+    QLocalServer server;
+
+    bool ready;
+
+    // Data received but not processed yet from each connection, and whether the header of
+    // the connection has been received.
+    struct Connection
+    {
+        QByteArray data;
+        bool started = false;
+    };
+    std::map<QLocalSocket*, Connection> connections;
+
+    typedef QObject base;
+};
+
+// Command line client of the lookup server. Sends a single request to the running instance
+// and prints the results to the standard output. Args are the command line arguments after
+// the program name. Returns the exit code of the program.
+int runLookupClient(const QStringList &args);
+
+
+#endif // LOOKUPSERVER_H
@@ -38,16 +38,19 @@
 #include "globalui.h"
 #include "sentences.h"
 #include "kanjistrokes.h"
+#include "kanjisimilarity.h"
 
 #include "grammar_enums.h"
 #include "languages.h"
 #include "languagesettings.h"
 #include "dialogs.h"
+#include "lookupserver.h"
+#include "benchmark.h"
+#include "perftrace.h"
 
 #ifdef WIN32
 #include <Windows.h>
 #else
-#include <QLocalServer>
 #include <QLocalSocket>
 #endif
 
@@ -386,6 +389,8 @@ namespace
 
     void loadDictionaries()
     {
+        PERFTRACE_SCOPE("loadDictionaries");
+
         // Creating and loading main dictionary.
         Dictionary *d = ZKanji::addDictionary();
         bool userdir = false;
@@ -607,6 +612,11 @@ namespace
             loaderrors += qApp->translate("", "Error loading student profile.");
         }
 
+        // Restoring the changes that were only written to the user data journals before the
+        // program last exited.
+        if (exuser == "zkuser" && ZKanji::loadFolder() == ZKanji::userFolder())
+            ZKanji::replayUserJournals();
+
         if (!loaderrors.isEmpty())
         {
             showSimpleDialog("zkanji", qApp->translate("", "Errors occurred during startup. The program will start but without the data causing the problem.\n\n %1").arg(loaderrors));
@@ -682,8 +692,16 @@ namespace
                 DictImport diform;
                 std::unique_ptr<Dictionary> dict(diform.importDict(dir.path(), true));
                 if (dict.get() != nullptr)
+                {
                     dict->saveImport(ZKanji::appFolder() + "/data");
 
+                    // The similar kanji are computed with the data, so they don't have to be
+                    // computed at every startup.
+                    KanjiSimilarityTable similar;
+                    similar.build(ZKanji::elements(), tosigned(ZKanji::kanjis.size()));
+                    similar.save(ZKanji::appFolder() + "/data/similar.zks");
+                }
+
                 ZKanji::cleanupImport();
 
                 ifound = true;
@@ -749,6 +767,13 @@ public:
 
 int main(int argc, char **argv)
 {
+    // The lookup client only talks to the running instance and doesn't need the GUI.
+    if (argc > 1 && (strcmp(argv[1], "--lookup") == 0 || strcmp(argv[1], "--kanji") == 0 || strcmp(argv[1], "--to-group") == 0 || strcmp(argv[1], "--to-deck") == 0))
+    {
+        QCoreApplication a(argc, argv);
+        return runLookupClient(a.arguments().mid(1));
+    }
+
 #ifdef _DEBUG
     ZApplication a(argc, argv);
 #else
@@ -785,10 +810,43 @@ int main(int argc, char **argv)
         out << "                               encoding." << endl;
         out << endl;
         out << "  -ie [path]      can be used when the files are located at the same path." << endl;
+        out << endl;
+        out << "  --lookup [-d dictionary] [-m jp|def] [-x] [-i] [-n max] text" << endl;
+        out << "                  search for words in the running instance of zkanji. Use -d" << endl;
+        out << "                  to select a dictionary, -m def to search in definitions, -x" << endl;
+        out << "                  for exact matches, -i to include inflected forms and -n to" << endl;
+        out << "                  limit the number of results." << endl;
+        out << endl;
+        out << "  --kanji [-d dictionary] text" << endl;
+        out << "                  list information of the kanji in text." << endl;
+        out << endl;
+        out << "  --to-group [-d dictionary] [-c] group windex..." << endl;
+        out << "                  add words to a word group of the running instance. Use -c" << endl;
+        out << "                  to create the group if it doesn't exist." << endl;
+        out << endl;
+        out << "  --to-deck [-d dictionary] [-p parts] deck windex..." << endl;
+        out << "                  add words to a study deck of the running instance." << endl;
+        out << endl;
+        out << "  --bench workload [output]" << endl;
+        out << "                  load the data, run the timed workloads listed in the workload" << endl;
+        out << "                  file and write the results as JSON to output or the standard" << endl;
+        out << "                  output. zkanji must not be running already." << endl;
+        out << endl;
+        out << "  --trace file    record the duration of loading, searches and other slow" << endl;
+        out << "                  operations, and save them to file in the Chrome trace" << endl;
+        out << "                  format when the program exits." << endl;
         out.flush();
         exit(0);
     }
 
+    QString tracefile;
+    int tracepos = args.indexOf("--trace");
+    if (tracepos != -1 && tracepos + 1 < args.size())
+    {
+        tracefile = args.at(tracepos + 1);
+        PerfTrace::setEnabled(true);
+    }
+
 #ifdef Q_OS_WIN
     QIcon prgico(":/programico.ico");
     a.setWindowIcon(prgico);
@@ -796,6 +854,8 @@ int main(int argc, char **argv)
 
     try
     {
+        LookupServer server;
+
         std::unique_ptr<QSharedMemory> singleappguard(new QSharedMemory("zkanjiSingleAppGuardSoNoMultipleZKanjiAppsGetOpened", &a));
 #ifdef Q_OS_WIN
         if (singleappguard->attach(QSharedMemory::ReadOnly))
@@ -825,8 +885,11 @@ int main(int argc, char **argv)
             singleappguard->unlock();
         }
 
+        // The window of the running instance is activated with a message on Windows. The
+        // server only answers lookups.
+        server.listen("zkanjiSingleAppServer");
+
 #else
-        QLocalServer server;
         if (singleappguard->attach(QSharedMemory::ReadOnly))
             singleappguard->detach();
         // Attach/detach done twice, because on Linux it seems this removes the shared memory
@@ -847,14 +910,8 @@ int main(int argc, char **argv)
             exit(0);
         }
 
-        // TODO: add something specific to the server name for each user, so different users
-        // can run their own instances. Better alternative to include the path where zkanji
-        // will save its data, as that should limit the instances running.
-        QLocalServer::removeServer("zkanjiSingleAppServer");
-        //server.setSocketOptions(); - Use this if the specific user mode is implemented by
-        // setting different name to the server for each user/data save location.
         server.listen("zkanjiSingleAppServer");
-        gUI->connect(&server, &QLocalServer::newConnection, gUI, &GlobalUI::secondAppStarted);
+        gUI->connect(&server, &LookupServer::activateRequested, gUI, &GlobalUI::secondAppStarted);
 #endif
 
         a.setApplicationName("zkanji");
@@ -894,6 +951,13 @@ int main(int argc, char **argv)
 
         loadDictionaries();
         ZKanji::loadSimilarKanji(ZKanji::appFolder() + "/data/similar.txt");
+        // The similar kanji table is computed once and saved in the data folder, or the user
+        // data folder if the program's folder is not writable.
+        QString simname = ZKanji::appFolder() + "/data/similar.zks";
+        QString usersimname = ZKanji::userFolder() + "/data/similar.zks";
+        if (!ZKanji::lookalikes.load(simname, ZKanji::elements(), tosigned(ZKanji::kanjis.size())) &&
+            (usersimname == simname || !ZKanji::lookalikes.load(usersimname, ZKanji::elements(), tosigned(ZKanji::kanjis.size()))))
+            ZKanji::lookalikes.startBuild(ZKanji::elements(), tosigned(ZKanji::kanjis.size()), QFileInfo(ZKanji::appFolder() + "/data").isWritable() ? simname : usersimname);
 
         if (!expath.isEmpty())
         {
@@ -912,6 +976,15 @@ int main(int argc, char **argv)
 
         ZKanji::sentences.load(ZKanji::appFolder() + "/data/examples.zkj");
 
+        int benchpos = args.indexOf("--bench");
+        if (benchpos != -1 && benchpos + 1 < args.size())
+        {
+            int result = runBenchmark(args.at(benchpos + 1), benchpos + 2 < args.size() ? args.at(benchpos + 2) : QString());
+            if (!tracefile.isEmpty())
+                PerfTrace::saveChromeTrace(tracefile);
+            return result;
+        }
+
 #define COUNT_WORD_DATA 0
 #if (COUNT_WORD_DATA == 1)
 
@@ -980,12 +1053,16 @@ int main(int argc, char **argv)
 
         a.postEvent(gUI, new StartEvent, INT_MIN);
 
+        server.setReady(true);
+
         //qreal dpi = QApplication::primaryScreen()->physicalDotsPerInch();
         //qreal dpi2 = QApplication::primaryScreen()->logicalDotsPerInchY();
         //qreal ratio = (qreal)QApplication::primaryScreen()->logicalDotsPerInchY() / QApplication::primaryScreen()->physicalDotsPerInchY();
         //QMessageBox::information(nullptr, "zkanji", QString("%1, %2, %3").arg(dpi).arg(dpi2).arg(ratio));
 
         int result = a.exec();
+        if (!tracefile.isEmpty() && !PerfTrace::saveChromeTrace(tracefile))
+            QTextStream(stderr) << "Couldn't write trace file: " << tracefile << endl;
         return result;
     }
     catch (...)
@@ -0,0 +1,205 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "perftrace.h"
+
+
+//-------------------------------------------------------------
+
+
+namespace PerfTrace
+{
+    std::atomic_bool active(false);
+
+    namespace
+    {
+        // Number of events kept for each thread.
+        const uint bufferSize = 4096;
+
+        struct Event
+        {
+            const char *name;
+            // Start of a duration event or time of a counter event.
+            qint64 time;
+            // Length of a duration event or value of a counter event.
+            qint64 value;
+            bool counter;
+        };
+
+        // Ring buffer of the events recorded by a single thread. Only the owner thread writes
+        // the events. Other threads can read them at the same time, and must check the
+        // written count again after reading, to drop events overwritten in the meantime.
+        struct ThreadEvents
+        {
+            int id;
+            bool mainthread;
+
+            Event events[bufferSize];
+            // Number of events ever written to the buffer.
+            std::atomic<quint64> written;
+            // Number of events written before the last clear().
+            std::atomic<quint64> cleared;
+        };
+
+        // Protects the buffer list and starting the timer. Only locked when a thread records
+        // its first event, and when reading the events.
+        QMutex mutex;
+        std::vector<std::unique_ptr<ThreadEvents>> buffers;
+
+        QElapsedTimer timer;
+
+        thread_local ThreadEvents *threadevents = nullptr;
+
+        ThreadEvents* currentBuffer()
+        {
+            if (threadevents != nullptr)
+                return threadevents;
+
+            ThreadEvents *b = new ThreadEvents;
+            b->written = 0;
+            b->cleared = 0;
+            b->mainthread = QCoreApplication::instance() != nullptr && QThread::currentThread() == QCoreApplication::instance()->thread();
+
+            QMutexLocker locker(&mutex);
+            b->id = (int)buffers.size() + 1;
+            buffers.push_back(std::unique_ptr<ThreadEvents>(b));
+
+            threadevents = b;
+            return b;
+        }
+
+        void addEvent(const char *name, qint64 time, qint64 value, bool counter)
+        {
+            ThreadEvents *b = currentBuffer();
+            quint64 pos = b->written.load(std::memory_order_relaxed);
+            Event &e = b->events[pos % bufferSize];
+            e.name = name;
+            e.time = time;
+            e.value = value;
+            e.counter = counter;
+            b->written.store(pos + 1, std::memory_order_release);
+        }
+    }
+
+    void setEnabled(bool enable)
+    {
+        if (enable)
+        {
+            QMutexLocker locker(&mutex);
+            if (!timer.isValid())
+                timer.start();
+        }
+        active = enable;
+    }
+
+    qint64 now()
+    {
+        return timer.nsecsElapsed();
+    }
+
+    void addDuration(const char *name, qint64 start, qint64 end)
+    {
+        addEvent(name, start, end - start, false);
+    }
+
+    void addCounter(const char *name, qint64 value)
+    {
+        addEvent(name, now(), value, true);
+    }
+
+    void clear()
+    {
+        QMutexLocker locker(&mutex);
+        for (auto &b : buffers)
+            b->cleared = b->written.load();
+    }
+
+    bool saveChromeTrace(const QString &filename)
+    {
+        double pid = QCoreApplication::applicationPid();
+
+        QJsonArray events;
+        {
+            QMutexLocker locker(&mutex);
+            std::vector<Event> list;
+            for (auto &b : buffers)
+            {
+                quint64 last = b->written.load(std::memory_order_acquire);
+                quint64 first = std::max<quint64>(b->cleared, last > bufferSize ? last - bufferSize : 0);
+
+                list.clear();
+                for (quint64 ix = first; ix != last; ++ix)
+                    list.push_back(b->events[ix % bufferSize]);
+
+                // Events written while copying could have overwritten the oldest copied ones.
+                // The slot of the next event might be half written already, so it's counted
+                // as overwritten too.
+                quint64 written = b->written.load(std::memory_order_acquire) + 1;
+                quint64 skip = written - first > bufferSize ? std::min<quint64>(written - first - bufferSize, list.size()) : 0;
+
+                QJsonObject meta;
+                meta["name"] = QStringLiteral("thread_name");
+                meta["ph"] = QStringLiteral("M");
+                meta["pid"] = pid;
+                meta["tid"] = b->id;
+                QJsonObject metaargs;
+                metaargs["name"] = b->mainthread ? QStringLiteral("Main thread") : QString("Thread %1").arg(b->id);
+                meta["args"] = metaargs;
+                events.append(meta);
+
+                for (int ix = (int)skip, siz = (int)list.size(); ix != siz; ++ix)
+                {
+                    const Event &e = list[ix];
+                    QJsonObject obj;
+                    obj["name"] = QString::fromLatin1(e.name);
+                    obj["pid"] = pid;
+                    obj["tid"] = b->id;
+                    obj["ts"] = e.time / 1000.0;
+                    if (e.counter)
+                    {
+                        obj["ph"] = QStringLiteral("C");
+                        QJsonObject args;
+                        args["value"] = (double)e.value;
+                        obj["args"] = args;
+                    }
+                    else
+                    {
+                        obj["ph"] = QStringLiteral("X");
+                        obj["dur"] = e.value / 1000.0;
+                    }
+                    events.append(obj);
+                }
+            }
+        }
+
+        QJsonObject root;
+        root["traceEvents"] = events;
+        root["displayTimeUnit"] = QStringLiteral("ms");
+        QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Compact);
+
+        QFile f(filename);
+        if (!f.open(QIODevice::WriteOnly))
+            return false;
+        return f.write(json) == json.size();
+    }
+}
+
+
+//-------------------------------------------------------------
+
@@ -0,0 +1,88 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef PERFTRACE_H
+#define PERFTRACE_H
+
+#include <QtGlobal>
+#include <atomic>
+
+class QString;
+
+// Timing of the slow operations of the program. Code marks the parts to be measured with
+// PERFTRACE_SCOPE, and records values like the number of results with PERFTRACE_COUNT.
+// Nothing is recorded until tracing is enabled, and the disabled macros only check a flag.
+//
+// The events are stored in a fixed size ring buffer of the thread that recorded them, so
+// recording needs no locking. When a buffer is full, the oldest events are overwritten.
+// The recorded events can be saved in the Chrome trace event format, which can be opened
+// in chrome://tracing or other trace viewers.
+namespace PerfTrace
+{
+    extern std::atomic_bool active;
+
+    // Returns whether events are recorded.
+    inline bool enabled() { return active.load(std::memory_order_relaxed); }
+    // Starts or stops recording events. Events recorded earlier are kept.
+    void setEnabled(bool enable);
+
+    // Returns the time in nanoseconds since tracing was first enabled.
+    qint64 now();
+
+    // Records an event called name which started at the start time and ended at end. The
+    // name must be a string literal or otherwise stay valid until the program exits.
+    void addDuration(const char *name, qint64 start, qint64 end);
+    // Records the value of a counter called name at the current time. The name must be a
+    // string literal or otherwise stay valid until the program exits.
+    void addCounter(const char *name, qint64 value);
+
+    // Discards the events recorded so far.
+    void clear();
+
+    // Writes the recorded events to filename in the Chrome trace event JSON format. Returns
+    // false if the file couldn't be written.
+    bool saveChromeTrace(const QString &filename);
+}
+
+// Records the time from its construction until its destruction, if tracing was enabled
+// when it was constructed. Use PERFTRACE_SCOPE instead of creating it directly.
+class PerfTraceScope
+{
+public:
+    PerfTraceScope(const char *eventname)
+    {
+        if (PerfTrace::enabled())
+        {
+            name = eventname;
+            start = PerfTrace::now();
+        }
+        else
+            name = nullptr;
+    }
+
+    ~PerfTraceScope()
+    {
+        if (name != nullptr)
+            PerfTrace::addDuration(name, start, PerfTrace::now());
+    }
+private:
+    PerfTraceScope(const PerfTraceScope&) = delete;
+    PerfTraceScope& operator=(const PerfTraceScope&) = delete;
+
+    const char *name;
+    qint64 start;
+};
+
+#define PERFTRACE_CONCAT_(a, b) a##b
+#define PERFTRACE_CONCAT(a, b) PERFTRACE_CONCAT_(a, b)
+
+// Measures the time until the end of the current block.
+#define PERFTRACE_SCOPE(name) PerfTraceScope PERFTRACE_CONCAT(perftracescope, __LINE__)(name)
+// Records the current value of a counter.
+#define PERFTRACE_COUNT(name, value) do { if (PerfTrace::enabled()) PerfTrace::addCounter(name, value); } while (false)
+
+
+#endif // PERFTRACE_H
@@ -0,0 +1,266 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <algorithm>
+#include "prefixsumlist.h"
+
+#include "checked_cast.h"
+
+
+namespace
+{
+    // Blocks with more items than this are split in two.
+    const int maxBlockSize = 512;
+}
+
+
+//-------------------------------------------------------------
+
+
+PrefixSumList::PrefixSumList() : validcnt(0), cnt(0), total(0)
+{
+
+}
+
+void PrefixSumList::clear()
+{
+    blocks.clear();
+    blockpos.clear();
+    blocksum.clear();
+    validcnt = 0;
+    cnt = 0;
+    total = 0;
+}
+
+bool PrefixSumList::empty() const
+{
+    return cnt == 0;
+}
+
+int PrefixSumList::size() const
+{
+    return cnt;
+}
+
+int PrefixSumList::sum() const
+{
+    return total;
+}
+
+void PrefixSumList::assign(const std::vector<int> &vals)
+{
+    clear();
+
+    // Blocks are only filled up to half, to leave space for inserted items.
+    const int fill = maxBlockSize / 2;
+    int siz = tosigned(vals.size());
+    blocks.resize((siz + fill - 1) / fill);
+    for (int ix = 0, bix = 0; ix != siz; ++bix)
+    {
+        Block &b = blocks[bix];
+        b.sum = 0;
+        b.sums.reserve(std::min(fill, siz - ix));
+        for (int last = std::min(siz, ix + fill); ix != last; ++ix)
+        {
+            b.sums.push_back(b.sum);
+            b.sum += vals[ix];
+        }
+        total += b.sum;
+    }
+    cnt = siz;
+}
+
+void PrefixSumList::values(std::vector<int> &result) const
+{
+    result.clear();
+    result.reserve(cnt);
+    for (const Block &b : blocks)
+    {
+        for (int ix = 0, siz = tosigned(b.sums.size()); ix != siz; ++ix)
+            result.push_back((ix == siz - 1 ? b.sum : b.sums[ix + 1]) - b.sums[ix]);
+    }
+}
+
+int PrefixSumList::value(int pos) const
+{
+#ifdef _DEBUG
+    if (pos < 0 || pos >= cnt)
+        throw "Position out of range.";
+#endif
+
+    const Block &b = blocks[blockOf(pos)];
+    return (pos == tosigned(b.sums.size()) - 1 ? b.sum : b.sums[pos + 1]) - b.sums[pos];
+}
+
+void PrefixSumList::setValue(int pos, int val)
+{
+#ifdef _DEBUG
+    if (pos < 0 || pos >= cnt || val < 0)
+        throw "Position or value out of range.";
+#endif
+
+    int bix = blockOf(pos);
+    Block &b = blocks[bix];
+    int siz = tosigned(b.sums.size());
+    int dif = val - ((pos == siz - 1 ? b.sum : b.sums[pos + 1]) - b.sums[pos]);
+    if (dif == 0)
+        return;
+
+    for (int ix = pos + 1; ix != siz; ++ix)
+        b.sums[ix] += dif;
+    b.sum += dif;
+    total += dif;
+
+    validcnt = std::min(validcnt, bix + 1);
+}
+
+int PrefixSumList::sumBefore(int pos) const
+{
+#ifdef _DEBUG
+    if (pos < 0 || pos > cnt)
+        throw "Position out of range.";
+#endif
+
+    if (pos == cnt)
+        return total;
+
+    int bix = blockOf(pos);
+    return blocksum[bix] + blocks[bix].sums[pos];
+}
+
+int PrefixSumList::find(int s) const
+{
+    if (s < 0 || s >= total)
+        return -1;
+
+    validate();
+
+    // Last block starting at or before s. Blocks with zero sum are skipped, because the
+    // next block starts at the same sum.
+    int bix = tosigned(std::upper_bound(blocksum.begin(), blocksum.end(), s) - blocksum.begin()) - 1;
+    const Block &b = blocks[bix];
+    int pos = tosigned(std::upper_bound(b.sums.begin(), b.sums.end(), s - blocksum[bix]) - b.sums.begin()) - 1;
+
+    return blockpos[bix] + pos;
+}
+
+void PrefixSumList::insert(int pos, int val)
+{
+#ifdef _DEBUG
+    if (pos < 0 || pos > cnt || val < 0)
+        throw "Position or value out of range.";
+#endif
+
+    ++cnt;
+    total += val;
+
+    if (blocks.empty())
+    {
+        blocks.push_back({ { 0 }, val });
+        return;
+    }
+
+    int bix = blockOf(pos);
+    Block &b = blocks[bix];
+    int siz = tosigned(b.sums.size());
+
+    b.sums.insert(b.sums.begin() + pos, pos == siz ? b.sum : b.sums[pos]);
+    for (int ix = pos + 1; ix != siz + 1; ++ix)
+        b.sums[ix] += val;
+    b.sum += val;
+
+    validcnt = std::min(validcnt, bix + 1);
+
+    splitBlock(bix);
+}
+
+void PrefixSumList::erase(int pos, int n)
+{
+#ifdef _DEBUG
+    if (pos < 0 || n < 0 || pos + n > cnt)
+        throw "Position out of range.";
+#endif
+
+    while (n != 0)
+    {
+        int bpos = pos;
+        int bix = blockOf(bpos);
+        Block &b = blocks[bix];
+        int siz = tosigned(b.sums.size());
+
+        int last = std::min(siz, bpos + n);
+        int dif = (last == siz ? b.sum : b.sums[last]) - b.sums[bpos];
+
+        b.sums.erase(b.sums.begin() + bpos, b.sums.begin() + last);
+        for (int ix = bpos, bsiz = tosigned(b.sums.size()); ix != bsiz; ++ix)
+            b.sums[ix] -= dif;
+        b.sum -= dif;
+
+        total -= dif;
+        cnt -= last - bpos;
+        n -= last - bpos;
+
+        if (b.sums.empty())
+        {
+            blocks.erase(blocks.begin() + bix);
+            validcnt = std::min(validcnt, bix);
+        }
+        else
+            validcnt = std::min(validcnt, bix + 1);
+    }
+}
+
+int PrefixSumList::blockOf(int &pos) const
+{
+    validate();
+
+    int bix = tosigned(std::upper_bound(blockpos.begin(), blockpos.end(), pos) - blockpos.begin()) - 1;
+    pos -= blockpos[bix];
+    return bix;
+}
+
+void PrefixSumList::validate() const
+{
+    int siz = tosigned(blocks.size());
+    if (validcnt == siz)
+        return;
+
+    blockpos.resize(siz);
+    blocksum.resize(siz);
+    for (int ix = validcnt; ix != siz; ++ix)
+    {
+        blockpos[ix] = ix == 0 ? 0 : blockpos[ix - 1] + tosigned(blocks[ix - 1].sums.size());
+        blocksum[ix] = ix == 0 ? 0 : blocksum[ix - 1] + blocks[ix - 1].sum;
+    }
+    validcnt = siz;
+}
+
+void PrefixSumList::splitBlock(int index)
+{
+    Block &b = blocks[index];
+    int siz = tosigned(b.sums.size());
+    if (siz <= maxBlockSize)
+        return;
+
+    int half = siz / 2;
+    int base = b.sums[half];
+
+    Block next;
+    next.sums.reserve(maxBlockSize);
+    for (int ix = half; ix != siz; ++ix)
+        next.sums.push_back(b.sums[ix] - base);
+    next.sum = b.sum - base;
+
+    b.sums.resize(half);
+    b.sum = base;
+
+    blocks.insert(blocks.begin() + (index + 1), std::move(next));
+    validcnt = std::min(validcnt, index + 1);
+}
+
+
+//-------------------------------------------------------------
+
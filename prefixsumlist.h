@@ -0,0 +1,87 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef PREFIXSUMLIST_H
+#define PREFIXSUMLIST_H
+
+#include <vector>
+
+// List of non-negative integer values, which can return the sum of the values before any
+// item, and find the item at a given sum.
+//
+// The values are stored in blocks of limited size. Each block holds the sums of its values
+// up to each item, and the blocks hold the number of items and the sum of all values before
+// them. Finding an item or a sum is a binary search among the blocks and inside a single
+// block. Inserting or removing items only updates the block of the items, and the blocks
+// after it.
+class PrefixSumList
+{
+public:
+    PrefixSumList();
+
+    void clear();
+    bool empty() const;
+    // Number of items in the list.
+    int size() const;
+    // Sum of every value in the list.
+    int sum() const;
+
+    // Replaces the items in the list with the values in vals.
+    void assign(const std::vector<int> &vals);
+    // Fills result with the value of every item.
+    void values(std::vector<int> &result) const;
+
+    // Value of the item at pos.
+    int value(int pos) const;
+    void setValue(int pos, int val);
+
+    // Returns the sum of the values of the items before pos. Pass size() to get the sum of
+    // every value.
+    int sumBefore(int pos) const;
+    // Returns the position of the item whose value covers s. The sum of the values before
+    // the item is not greater than s, and adding the item's value makes it greater. Items
+    // with zero value are never returned. Returns -1 if s is not smaller than sum().
+    int find(int s) const;
+
+    // Inserts an item with val in front of the item at pos.
+    void insert(int pos, int val);
+    // Removes cnt items starting at pos.
+    void erase(int pos, int cnt = 1);
+private:
+    struct Block
+    {
+        // Sum of the values in the block in front of each item.
+        std::vector<int> sums;
+        // Sum of every value in the block.
+        int sum;
+    };
+
+    // Returns the index of the block holding the item at pos, and sets pos to the item's
+    // position in the block. If pos is size(), returns the last block with pos set past its
+    // last item.
+    int blockOf(int &pos) const;
+
+    // Computes the item count and sum in front of the blocks that changed.
+    void validate() const;
+
+    // Splits the block at index into two if it has grown too large.
+    void splitBlock(int index);
+
+    std::vector<Block> blocks;
+
+    // [block index] Number of items in front of each block.
+    mutable std::vector<int> blockpos;
+    // [block index] Sum of the values in front of each block.
+    mutable std::vector<int> blocksum;
+    // Number of blocks at the front whose position and sum is up to date.
+    mutable int validcnt;
+
+    int cnt;
+    int total;
+};
+
+
+#endif // PREFIXSUMLIST_H
@@ -27,6 +27,8 @@
 
 #include "formstates.h"
 
+#include "perftrace.h"
+
 #include "checked_cast.h"
 
 //-------------------------------------------------------------
@@ -81,7 +83,7 @@ void PrintTextBlock::setMaxWidth(int width)
         setlist.clear();
         w = 0;
         h = 0;
-        setFuriWord(word, f, fm, furif, furifm, lh, desc, furih, furidesc);
+        setFuriWord(word, furigana, f, fm, furif, furifm, lh, desc, furih, furidesc);
         //furitext = false;
     }
 }
@@ -92,7 +94,7 @@ void PrintTextBlock::setLineAttr(int lineheight, int descent)
     desc = descent;
 }
 
-void PrintTextBlock::setFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int lineheight, int descent, int furiheight, int furidescent)
+void PrintTextBlock::setFuriWord(WordEntry *e, const std::vector<FuriganaData> &furi, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int lineheight, int descent, int furiheight, int furidescent)
 {
 #ifdef _DEBUG
     if (!furitext || !lines.empty())
@@ -100,6 +102,7 @@ void PrintTextBlock::setFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont
 #endif
 
     word = e;
+    furigana = furi;
     lh = lineheight;
     desc = descent;
     furih = furiheight;
@@ -125,8 +128,7 @@ void PrintTextBlock::setFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont
     {
         // Try to break up the word on furigana boundaries. Only the kanji of the data counts
         // as this is only for measuring.
-        std::vector<FuriganaData> fdat;
-        findFurigana(word->kanji, word->kana, fdat);
+        const std::vector<FuriganaData> &fdat = furigana;
 
         //int kanjisiz = word->kanji.size();
         //int kanasiz = word->kana.size();
@@ -184,7 +186,7 @@ void PrintTextBlock::setFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont
     }
 }
 
-void PrintTextBlock::addFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int furiheight, int furidescent)
+void PrintTextBlock::addFuriWord(WordEntry *e, const std::vector<FuriganaData> &furi, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int furiheight, int furidescent)
 {
 #ifdef _DEBUG
     if (furitext)
@@ -192,6 +194,7 @@ void PrintTextBlock::addFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont
 #endif
 
     word = e;
+    furigana = furi;
     frontword = tokens.empty();
     furih = furiheight;
     furidesc = furidescent;
@@ -398,8 +401,7 @@ void PrintTextBlock::paint(QPainter &p, int x, int y, bool rightalign)
     bool addfurispace = word != nullptr && (!frontword || (list.size() > 1 && list[1].tokenpos == 0));
     int furiextra = (!addfurispace && word == nullptr) ? 0 : furih;
 
-    std::vector<FuriganaData> fdat;
-    
+    const std::vector<FuriganaData> &fdat = furigana;
 
     if (!furitext)
     {
@@ -432,9 +434,6 @@ void PrintTextBlock::paint(QPainter &p, int x, int y, bool rightalign)
             {
                 // Draw furigana above kanji.
 
-                if (fdat.empty())
-                    findFurigana(word->kanji, word->kana, fdat);
-
                 int leftpos = 0;
                 int strpos = list[ix].pos == -1 ? 0 : list[ix].pos;
 
@@ -494,8 +493,7 @@ void PrintTextBlock::paint(QPainter &p, int x, int y, bool rightalign)
 
 void PrintTextBlock::paintKanjiFuri(QPainter &p, int x, int y, bool rightalign)
 {
-    std::vector<FuriganaData> fdat;
-    findFurigana(word->kanji, word->kana, fdat);
+    const std::vector<FuriganaData> &fdat = furigana;
 
     int kanjisiz = tosigned(word->kanji.size());
     //uint kanasiz = word->kana.size();
@@ -653,6 +651,97 @@ void PrintTextBlock::paintFurigana(QPainter &p, int x, int y, int width, int pos
 //-------------------------------------------------------------
 
 
+// Measured text blocks of the printed words and their positions on the pages. Measuring the
+// words is slow for long lists, so it's only done again for words that changed, or when the
+// printer or the settings change.
+struct PrintPreviewForm::PrintLayout
+{
+    // Printer, page rectangle and resolution the layout was computed for.
+    QPrinter *device;
+    QRect pagerect;
+    int resolution;
+
+    // Height of a single line of text.
+    double linesize;
+    int h;
+    // Height of the page number area at the bottom of the page.
+    int m;
+    int pagebottom;
+
+    // Space between printed columns in print units.
+    double colspacing;
+    int linespacing;
+    // Width of a single printed column in print units.
+    double colwidth;
+
+    // The top and left position of the rectangle, where the first word is printed on a
+    // page.
+    int basetop;
+    int baseleft;
+
+    // Kana font.
+    QFont kf;
+    // Font used for furigana.
+    QFont ff;
+    // Definition font.
+    QFont df;
+    // Type font.
+    QFont tf;
+    // Page number font
+    QFont pf;
+
+    // The text blocks keep references to the font metrics.
+    std::unique_ptr<QFontMetrics> kfm;
+    std::unique_ptr<QFontMetrics> ffm;
+    std::unique_ptr<QFontMetrics> dfm;
+    std::unique_ptr<QFontMetrics> tfm;
+
+    int spacewidth;
+    int fdesc;
+    int furidesc;
+
+    // Height of the furigana string above the kanji. The linesize at the kanji side includes
+    // this, while the other side is printed lower by this much.
+    int furilinesize;
+
+    // Whether to show furigana when the kanji is separately printed from the definition.
+    bool blockfuri;
+    // Whether to show furigana when the kanji and definition are printed together.
+    bool inlinefuri;
+
+    // Maximum width available for the kanji/kana text is around one third of the whole width
+    // of the column. If it takes up less space, the rest will go to the definition. This
+    // space will be extended during painting if the definition doesn't need all of the rest
+    // of the width.
+    int kmaxwidth;
+
+    struct Word
+    {
+        // Definition and the rest of the word if it's printed on the same side. Null when
+        // the word must be measured.
+        std::unique_ptr<PrintTextBlock> block;
+        // Text block for the separate kanji/kana side. Only used for separate printing.
+        std::unique_ptr<PrintTextBlock> kblock;
+
+        // The definition block is printed this much lower to line up with the kanji under
+        // the furigana.
+        int blockskip;
+        int blockh;
+
+        // Index of the page the word is printed on. With double pages, it's the index of the
+        // pair of pages.
+        int page;
+        int left;
+        int top;
+    };
+    std::vector<Word> words;
+
+    // The positions of the words are up to date.
+    bool paginated;
+    // Number of pages, counting pairs of pages once.
+    int pages;
+};
+
 PrintPreviewForm::PrintPreviewForm(QWidget *parent) : base(parent), ui(new Ui::PrintPreviewForm), printer(QPrinter::HighResolution), printing(false), pagecnt(0)
 {
     ui->setupUi(this);
@@ -716,7 +805,7 @@ PrintPreviewForm::PrintPreviewForm(QWidget *parent) : base(parent), ui(new Ui::P
 
     connect(preview, &QPrintPreviewWidget::paintRequested, this, &PrintPreviewForm::paintPages);
     connect(preview->findChild<QAbstractScrollArea*>()->verticalScrollBar(), &QScrollBar::valueChanged, this, &PrintPreviewForm::pageScrolled);
-    connect(gUI, &GlobalUI::settingsChanged, preview, &QPrintPreviewWidget::updatePreview);
+    connect(gUI, &GlobalUI::settingsChanged, this, &PrintPreviewForm::settingsChanged);
     connect(gUI, &GlobalUI::dictionaryToBeRemoved, this, &PrintPreviewForm::dictionaryToBeRemoved);
     connect(gUI, &GlobalUI::dictionaryReplaced, this, &PrintPreviewForm::dictionaryReplaced);
 
@@ -732,6 +821,7 @@ void PrintPreviewForm::exec(Dictionary *d, const std::vector<int> &wordlist)
 {
     dict = d;
     list = wordlist;
+    invalidateLayout();
 
     connect(d, &Dictionary::entryRemoved, this, &PrintPreviewForm::entryRemoved);
     connect(d, &Dictionary::entryChanged, this, &PrintPreviewForm::entryChanged);
@@ -763,6 +853,8 @@ void PrintPreviewForm::on_printButton_clicked()
         savePrinterSettings();
 
         printing = true;
+        // The fonts are measured again on the printer as set up in the dialog.
+        invalidateLayout();
         //paintPages(&printer);
         preview->print();
         close();
@@ -929,458 +1021,445 @@ void PrintPreviewForm::entryRemoved(int windex, int /*abcdeindex*/, int /*aiueoi
     if (wpos != -1)
     {
         list.erase(list.begin() + wpos);
+        if (layout != nullptr)
+        {
+            layout->words.erase(layout->words.begin() + wpos);
+            layout->paginated = false;
+        }
         preview->updatePreview();
     }
 }
 
 void PrintPreviewForm::entryChanged(int windex, bool /*studydef*/)
 {
-    if (std::find(list.begin(), list.end(), windex) != list.end())
+    bool found = false;
+    for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
+    {
+        if (list[ix] != windex)
+            continue;
+        found = true;
+
+        // Only the changed word is measured again.
+        if (layout != nullptr)
+        {
+            layout->words[ix].block.reset();
+            layout->words[ix].kblock.reset();
+        }
+    }
+
+    if (found)
         preview->updatePreview();
 }
 
 void PrintPreviewForm::paintPages(QPrinter *pr)
 {
-    // Current printed page. Indexed from 1 for display.
-    pagecnt = 1;
-
-    // Current word being printed.
-    int wordpos = 0;
-
-    // First word on the current page.
-    int pagepos = 0;
-
-    // Printing the second page of a double page layout.
-    bool secondpage = false;
-
-    // Saved line sizes for double page printing.
-    smartvector<PrintTextBlock> blocks;
-
-    QRect pagerect = pr->pageRect();
-
-    int pres = pr->resolution();
-
-    double sizes[] = { 0.16, 0.2, 0.24, 0.28, 0.32, 0.36, 0.4 };
-    double linesize = sizes[(int)Settings::print.linesize] * pres;
-    int h = std::ceil(linesize);
-
-    int m = 0.4 * pres;
-    if (Settings::print.pagenum)
-        pagerect.setBottom(pagerect.bottom() - m);
-    //pagerect.adjust(m, m, -m, -m * (Settings::print.pagenum ? 2 : 1));
-
-    int pagebottom = pagerect.height();
-
-    // Space between printed columns in print units.
-    double colspacing = linesize;
-
-    int linespacing = linesize * 0.8;
-
-    // Width of a single printed column in print units.
-    double colwidth = (pagerect.width() - (Settings::print.columns - 1) * colspacing) / Settings::print.columns;
-
-    // Column currently printed in.
-    int column = 0;
-
-    // Kana font.
-    QFont kf = QFont(Settings::printKanaFont(), pr);
-    // Font used for furigana.
-    QFont ff = QFont(Settings::printKanaFont(), pr);
-    // Definition font.
-    QFont df = QFont(Settings::printDefFont(), pr);
-    // Type font.
-    QFont tf = QFont(Settings::printInfoFont(), pr);
-
-    // Page number font
-    QFont pf = QFont(Settings::printDefFont(), pr);
+    PERFTRACE_SCOPE("PrintPreviewForm::paintPages");
 
     QPainter p;
     p.begin(pr);
 
-    // Determine the size of the fonts from the line size.
-    adjustFontSize(kf, linesize * 0.9, &p/*, QString(QChar(0x4e80))*/);
-    adjustFontSize(ff, linesize * 0.6, &p);
-    adjustFontSize(df, linesize, &p/*, QStringLiteral("mgMG")*/);
-    adjustFontSize(tf, linesize, &p);
-    adjustFontSize(pf, m * 0.6, &p);
-
-    p.setFont(kf);
-    QFontMetrics kfm = p.fontMetrics();
-    p.setFont(ff);
-    QFontMetrics ffm = p.fontMetrics();
-    p.setFont(df);
-    QFontMetrics dfm = p.fontMetrics();
-    p.setFont(tf);
-    QFontMetrics tfm = p.fontMetrics();
-
-    WordEntry *e;
+    if (layout == nullptr || layout->device != pr || layout->pagerect != pr->pageRect() || layout->resolution != pr->resolution())
+        createLayout(pr, p);
 
-    int spacewidth = dfm.width(' ');
-
-    int fdesc = mmin(kfm.descent(), dfm.descent(), tfm.descent());
-    int furidesc = ffm.descent();
+    int lsiz = tosigned(list.size());
+    for (int ix = 0; ix != lsiz; ++ix)
+    {
+        if (layout->words[ix].block == nullptr)
+        {
+            measureWord(ix);
+            layout->paginated = false;
+        }
+    }
 
-    // Height of the furigana string above the kanji. The linesize at the kanji side includes
-    // this, while the other side is printed lower by this much.
-    int furilinesize = std::ceil(linesize * 0.65);
+    if (!layout->paginated)
+        paginate();
 
-    // The top and left position of the rectangle, where the current word is printed.
-    int basetop = linespacing / 2;
-    int baseleft = colspacing / 4;
-    int top = basetop; //pagerect.top();
-    int left = baseleft; //pagerect.left();
+    const PrintLayout &l = *layout;
 
-    // Used for every printed string at every step.
-    QString str;
+    // Current printed page. Indexed from 1 for display.
+    pagecnt = 1;
 
-    p.setPen(QPen(p.pen().color(), std::max(0.1, 0.009 * pres)));
+    p.setPen(QPen(p.pen().color(), std::max(0.1, 0.009 * l.resolution)));
 
     if (!printing && Settings::print.doublepage)
     {
         QFont tmpf = QFont(Settings::printDefFont(), pr);
-        adjustFontSize(tmpf, pres * 0.65, &p/*, QStringLiteral("mgMG")*/);
+        adjustFontSize(tmpf, l.resolution * 0.65, &p/*, QStringLiteral("mgMG")*/);
 
         p.setFont(tmpf);
-        p.drawText(0, 0, pagerect.width(), pagerect.height(), Qt::AlignCenter | Qt::TextWordWrap, tr("This page won't be printed. It's only included here to allow the pages to face each other in the preview."));
+        p.drawText(0, 0, l.pagerect.width(), l.pagerect.height(), Qt::AlignCenter | Qt::TextWordWrap, tr("This page won't be printed. It's only included here to allow the pages to face each other in the preview."));
         pr->newPage();
     }
 
-    std::unique_ptr<PrintTextBlock> block;
-
-    // Whether to show furigana when the kanji is separately printed from the definition.
-    bool blockfuri = (Settings::print.doublepage || Settings::print.separated) && Settings::print.usekanji && Settings::print.readings == PrintSettings::ShowAbove;
-
-    // Whether to show furigana when the kanji and definition are printed together.
-    bool inlinefuri = !blockfuri && Settings::print.usekanji && Settings::print.readings == PrintSettings::ShowAbove;
-
-    // Text block for the separate kanji/kana side. Only used for separate printing.
-    std::unique_ptr<PrintTextBlock> kblock;
-
-    // Maximum width available for the kanji/kana text is around one third of the whole width
-    // of the column. If it takes up less space, the rest will go to the definition. This
-    // space will be extended during painting if the definition doesn't need all of the rest
-    // of the width.
-    int kmaxwidth = Settings::print.doublepage ? (colwidth - colspacing / 2) : std::ceil((colwidth - colspacing / 2) * 0.35);
-
-    int lsiz = tosigned(list.size());
-    while (wordpos != lsiz)
+    int wordpos = 0;
+    for (int page = 0; page != l.pages; ++page)
     {
-        e = dict->wordEntry(list[wordpos]);
-
-        // Measuring the space needed for the current word and printing if it fits on the
-        // current column. If it doesn't fit, it should go on the next one.
+        // First word on the current page.
+        int pagepos = wordpos;
+        while (wordpos != lsiz && l.words[wordpos].page == page)
+            ++wordpos;
 
-        if (!secondpage)
+        // The second page of a double page layout shows the other side of the same words.
+        for (int side = 0, sidecnt = Settings::print.doublepage && lsiz != 0 ? 2 : 1; side != sidecnt; ++side)
         {
-            block.reset(new PrintTextBlock(spacewidth, false));
-            kblock.reset(new PrintTextBlock(0, blockfuri));
-
-            // Measuring the space needed for the current word.
-
-            if (Settings::print.doublepage || Settings::print.separated)
+            if (page != 0 || side != 0)
             {
-                // Separate printing of kanji and definition if it's in its own column or on a
-                // separate page.
-
-                kblock->setMaxWidth(kmaxwidth);
-
-                // In case furigana is shown after the kanji, it must be included in the
-                // printed string. Otherwise use the kanji, and leave space for optional
-                // furigana above it.
-                if (blockfuri)
-                    kblock->setFuriWord(e, kf, kfm, ff, ffm, h, fdesc, furilinesize, furidesc);
-                else
-                {
-                    kblock->setLineAttr(h, fdesc);
-
-                    if (Settings::print.readings == PrintSettings::ShowAfter && Settings::print.usekanji && e->kanji != e->kana)
-                    {
-                        str = e->kanji.toQString() + QStringLiteral("(%1)").arg(e->kana.toQStringRaw());
-                        QCharTokenizer ktok(str.constData(), str.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
-                        kblock->addText(ktok, kf, kfm);
-                    }
-                    else
-                    {
-                        str = Settings::print.usekanji ? e->kanji.toQString() : e->kana.toQString();
-                        kblock->addText(str, kf, kfm);
-                    }
-                }
+                pr->newPage();
+                ++pagecnt;
             }
 
-            // Definition and the rest of the word if it's printed on the same side.
-
-            // Width available for the definition side.
-            int maxwidth = colwidth - colspacing / 2;
-            if (!kblock->empty())
-                maxwidth -= colspacing + kblock->width();
-
-            block->setMaxWidth(maxwidth);
-            block->setLineAttr(h, fdesc);
-
-            // Measure the kanji/kana + word types + definition in some order.
-
-            QString kanjistr;
-
-            // Build the string for the kanji/kana part.
-
-            if (!Settings::print.separated && !Settings::print.doublepage)
+            for (int ix = pagepos; ix != wordpos; ++ix)
             {
-                if (inlinefuri)
+                const PrintLayout::Word &w = l.words[ix];
+                int left = w.left;
+                int top = w.top;
+
+                if (Settings::print.separator || Settings::print.background)
                 {
-                    if (!Settings::print.reversed)
-                        block->addFuriWord(e, kf, kfm, ff, ffm, furilinesize, furidesc);
+                    if (Settings::print.background && (ix % 2) == 1)
+                        p.fillRect(QRect(left - l.colspacing / 4, top - l.linespacing / 2, l.colwidth, w.blockh + l.linespacing), qRgb(230, 230, 230));
+                    if (top != l.basetop && Settings::print.separator)
+                        p.drawLine(left - l.colspacing / 4, top - l.linespacing / 2, left + l.colwidth - l.colspacing / 4, top - l.linespacing / 2);
                 }
-                else if (Settings::print.readings == PrintSettings::ShowAfter && Settings::print.usekanji && e->kanji != e->kana)
+
+                if (side == 1)
+                    (!Settings::print.reversed ? w.block : w.kblock)->paint(p, left, top);
+                else if (!Settings::print.separated && !Settings::print.doublepage)
+                    w.block->paint(p, left, top);
+                else if (!Settings::print.reversed)
                 {
-                    kanjistr = e->kanji.toQString() + QStringLiteral("(%1)").arg(e->kana.toQStringRaw());
+                    // Kanji first.
 
-                    if (!Settings::print.reversed)
-                    {
-                        // Kanji/kana when it comes before the definition.
-                        QCharTokenizer ktok(kanjistr.constData(), kanjistr.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
-                        block->addText(ktok, kf, kfm);
-                    }
+                    w.kblock->paint(p, left, top);
+                    if (!Settings::print.doublepage)
+                        w.block->paint(p, left + l.colwidth - w.block->width() - l.colspacing / 2, top + w.blockskip, true);
                 }
                 else
                 {
-                    kanjistr = !Settings::print.usekanji ? e->kana.toQString() : e->kanji.toQString();
-                    if (!Settings::print.reversed)
-                        block->addText(kanjistr, kf, kfm);
+                    // Definition first.
+
+                    w.block->paint(p, left, top + w.blockskip);
+                    if (!Settings::print.doublepage)
+                        w.kblock->paint(p, left + l.colwidth - w.kblock->width() - l.colspacing / 2, top, true);
                 }
+            }
 
-                if (!Settings::print.reversed)
-                    block->addText("-", kf, kfm);
+            if (!list.empty() && Settings::print.pagenum)
+            {
+                p.setFont(l.pf);
+                p.drawText(QRect(0, l.pagebottom, l.pagerect.width(), l.m), Qt::AlignHCenter | Qt::AlignBottom, QString("%1").arg(pagecnt));
             }
+        }
+    }
 
-            // Definition has several parts:
-            // definition number, word type, definition text. If the word has a user defined
-            // definition, it's used together with all the word types specified for each
-            // definition.
+    p.end();
 
-            const QCharString *sdef = Settings::print.userdefs ? dict->studyDefinition(list[wordpos]) : nullptr;
-            if (sdef != nullptr)
-            {
-                // There was a user given definition for the word.
+    ui->pageLabel->setText(QStringLiteral("/ %1").arg(pagecnt));
+}
 
-                if (Settings::print.showtype)
-                {
-                    str = QString();
-                    for (int ix = 0, siz = tosigned(e->defs.size()); ix != siz; ++ix)
-                    {
-                        str += Strings::wordTypesText(e->defs[ix].attrib.types);
-                        if (ix != tosigned(e->defs.size()) - 1)
-                            str += "; ";
-                    }
-                    QCharTokenizer pttok(str.constData(), str.size(), qcharisspace);
-                    block->addText(pttok, tf, tfm);
-                }
+void PrintPreviewForm::settingsChanged()
+{
+    invalidateLayout();
+    preview->updatePreview();
+}
 
-                str = sdef->toQStringRaw();
-                QCharTokenizer stok(str.constData(), str.size(), qcharisspace);
+void PrintPreviewForm::invalidateLayout()
+{
+    layout.reset();
+}
 
-                block->addText(stok, df, dfm);
-            }
-            else
-            {
-                // No user definition. Use the word from the dictionary.
-                // Print each definition separately.
-                for (int ix = 0, siz = tosigned(e->defs.size()); ix != siz; ++ix)
-                {
-                    if (e->defs.size() != 1)
-                        block->addText(QStringLiteral("%1.").arg(ix + 1), df, dfm);
+void PrintPreviewForm::createLayout(QPrinter *pr, QPainter &p)
+{
+    layout.reset(new PrintLayout);
+    PrintLayout &l = *layout;
 
-                    if (Settings::print.showtype)
-                    {
-                        str = Strings::wordTypesText(e->defs[ix].attrib.types);
+    l.device = pr;
+    l.pagerect = pr->pageRect();
+    l.resolution = pr->resolution();
 
-                        QCharTokenizer pttok(str.constData(), str.size(), qcharisspace);
-                        block->addText(pttok, tf, tfm);
-                    }
+    int pres = l.resolution;
 
-                    str = e->defs[ix].def.toQStringRaw();
+    double sizes[] = { 0.16, 0.2, 0.24, 0.28, 0.32, 0.36, 0.4 };
+    l.linesize = sizes[(int)Settings::print.linesize] * pres;
+    l.h = std::ceil(l.linesize);
 
-                    QCharTokenizer stok(str.constData(), str.size(), qcharisspace);
-                    block->addText(stok, df, dfm);
-                }
-            }
+    l.m = 0.4 * pres;
+    QRect pagerect = l.pagerect;
+    if (Settings::print.pagenum)
+        pagerect.setBottom(pagerect.bottom() - l.m);
+    //pagerect.adjust(m, m, -m, -m * (Settings::print.pagenum ? 2 : 1));
 
-            if (!Settings::print.doublepage && Settings::print.reversed && !Settings::print.separated)
-            {
-                // Kanji/kana when printed after the definition.
+    l.pagebottom = pagerect.height();
 
-                block->addText("-", kf, kfm);
+    l.colspacing = l.linesize;
+    l.linespacing = l.linesize * 0.8;
+    l.colwidth = (pagerect.width() - (Settings::print.columns - 1) * l.colspacing) / Settings::print.columns;
 
-                if (inlinefuri)
-                    block->addFuriWord(e, kf, kfm, ff, ffm, furilinesize, furidesc);
-                else
-                {
-                    QCharTokenizer ktok(kanjistr.constData(), kanjistr.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
-                    block->addText(ktok, kf, kfm);
-                }
-            }
+    l.kf = QFont(Settings::printKanaFont(), pr);
+    l.ff = QFont(Settings::printKanaFont(), pr);
+    l.df = QFont(Settings::printDefFont(), pr);
+    l.tf = QFont(Settings::printInfoFont(), pr);
+    l.pf = QFont(Settings::printDefFont(), pr);
 
-            // Update the available width of the separate kanji text after the
-            // definition has been completed.
-            if (!Settings::print.doublepage && Settings::print.separated)
-                kblock->setMaxWidth(colwidth - colspacing / 2 - colspacing - block->width());
+    // Determine the size of the fonts from the line size.
+    adjustFontSize(l.kf, l.linesize * 0.9, &p/*, QString(QChar(0x4e80))*/);
+    adjustFontSize(l.ff, l.linesize * 0.6, &p);
+    adjustFontSize(l.df, l.linesize, &p/*, QStringLiteral("mgMG")*/);
+    adjustFontSize(l.tf, l.linesize, &p);
+    adjustFontSize(l.pf, l.m * 0.6, &p);
+
+    p.setFont(l.kf);
+    l.kfm.reset(new QFontMetrics(p.fontMetrics()));
+    p.setFont(l.ff);
+    l.ffm.reset(new QFontMetrics(p.fontMetrics()));
+    p.setFont(l.df);
+    l.dfm.reset(new QFontMetrics(p.fontMetrics()));
+    p.setFont(l.tf);
+    l.tfm.reset(new QFontMetrics(p.fontMetrics()));
+
+    l.spacewidth = l.dfm->width(' ');
+
+    l.fdesc = mmin(l.kfm->descent(), l.dfm->descent(), l.tfm->descent());
+    l.furidesc = l.ffm->descent();
+    l.furilinesize = std::ceil(l.linesize * 0.65);
+
+    l.basetop = l.linespacing / 2;
+    l.baseleft = l.colspacing / 4;
+
+    l.blockfuri = (Settings::print.doublepage || Settings::print.separated) && Settings::print.usekanji && Settings::print.readings == PrintSettings::ShowAbove;
+    l.inlinefuri = !l.blockfuri && Settings::print.usekanji && Settings::print.readings == PrintSettings::ShowAbove;
+
+    l.kmaxwidth = Settings::print.doublepage ? (l.colwidth - l.colspacing / 2) : std::ceil((l.colwidth - l.colspacing / 2) * 0.35);
+
+    l.words.resize(list.size());
+    l.paginated = false;
+    l.pages = 0;
+}
 
-            // Print after measurments are done.
+void PrintPreviewForm::measureWord(int wordpos)
+{
+    PrintLayout &l = *layout;
+    PrintLayout::Word &w = l.words[wordpos];
 
-            // The definition block should be printed a few pixels below
-            // to line up with the kanji under the furigana.
-            int blockskip = 0;
-            if (!Settings::print.doublepage && Settings::print.separated && Settings::print.usekanji && Settings::print.readings == PrintSettings::ShowAbove)
-                blockskip = furilinesize;
+    QFontMetrics &kfm = *l.kfm;
+    QFontMetrics &ffm = *l.ffm;
+    QFontMetrics &dfm = *l.dfm;
+    QFontMetrics &tfm = *l.tfm;
 
-            int blockh = std::max(kblock->height(), block->height() + blockskip);
+    WordEntry *e = dict->wordEntry(list[wordpos]);
 
-            if (top != basetop && top + blockh /*+ linespacing*/ > pagebottom)
-            {
-                top = basetop;
-                left += colwidth + colspacing;
-                ++column;
+    // Furigana data of the current word when it's printed with furigana.
+    std::vector<FuriganaData> furi;
+    if (l.blockfuri || l.inlinefuri)
+        dict->wordFurigana(list[wordpos], furi);
 
-                if (column >= Settings::print.columns)
-                {
-                    if (Settings::print.doublepage)
-                    {
-                        wordpos = pagepos;
-                        secondpage = true;
-                        continue;
-                    }
+    // Used for every printed string at every step.
+    QString str;
 
-                    left = baseleft;
-                    column = 0;
+    std::unique_ptr<PrintTextBlock> block(new PrintTextBlock(l.spacewidth, false));
+    std::unique_ptr<PrintTextBlock> kblock(new PrintTextBlock(0, l.blockfuri));
 
-                    if (Settings::print.pagenum)
-                    {
-                        p.setFont(pf);
-                        p.drawText(QRect(0, pagebottom, pagerect.width(), m), Qt::AlignHCenter | Qt::AlignBottom, QString("%1").arg(pagecnt));
-                    }
+    // Measuring the space needed for the current word.
 
-                    pr->newPage();
-                    ++pagecnt;
+    if (Settings::print.doublepage || Settings::print.separated)
+    {
+        // Separate printing of kanji and definition if it's in its own column or on a
+        // separate page.
 
-                    pagepos = wordpos + 1;
-                }
+        kblock->setMaxWidth(l.kmaxwidth);
 
-            }
-            if (Settings::print.separator || Settings::print.background)
-            {
-                if (Settings::print.background && (wordpos % 2) == 1)
-                    p.fillRect(QRect(left - colspacing / 4, top - linespacing / 2, colwidth, blockh + linespacing), qRgb(230, 230, 230));
-                if (top != basetop && Settings::print.separator)
-                    p.drawLine(left - colspacing / 4, top - linespacing / 2, left + colwidth - colspacing / 4, top - linespacing / 2);
-            }
+        // In case furigana is shown after the kanji, it must be included in the
+        // printed string. Otherwise use the kanji, and leave space for optional
+        // furigana above it.
+        if (l.blockfuri)
+            kblock->setFuriWord(e, furi, l.kf, kfm, l.ff, ffm, l.h, l.fdesc, l.furilinesize, l.furidesc);
+        else
+        {
+            kblock->setLineAttr(l.h, l.fdesc);
 
-            if (!Settings::print.separated && !Settings::print.doublepage)
-                block->paint(p, left, top);
-            else if (!Settings::print.reversed)
+            if (Settings::print.readings == PrintSettings::ShowAfter && Settings::print.usekanji && e->kanji != e->kana)
             {
-                // Kanji first.
-
-                kblock->paint(p, left, top);
-                if (!Settings::print.doublepage)
-                    block->paint(p, left + colwidth - block->width() - colspacing / 2, top + blockskip, true);
-                else
-                {
-                    block->setHeight(blockh);
-                    blocks.push_back(block.release());
-                }
+                str = e->kanji.toQString() + QStringLiteral("(%1)").arg(e->kana.toQStringRaw());
+                QCharTokenizer ktok(str.constData(), str.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
+                kblock->addText(ktok, l.kf, kfm);
             }
             else
             {
-                // Definition first.
-
-                block->paint(p, left, top + blockskip);
-                if (!Settings::print.doublepage)
-                    kblock->paint(p, left + colwidth - kblock->width() - colspacing / 2, top, true);
-                else
-                {
-                    kblock->setHeight(blockh);
-                    blocks.push_back(kblock.release());
-                }
+                str = Settings::print.usekanji ? e->kanji.toQString() : e->kana.toQString();
+                kblock->addText(str, l.kf, kfm);
             }
+        }
+    }
 
-            top += linespacing + blockh;
-            ++wordpos;
+    // Definition and the rest of the word if it's printed on the same side.
+
+    // Width available for the definition side.
+    int maxwidth = l.colwidth - l.colspacing / 2;
+    if (!kblock->empty())
+        maxwidth -= l.colspacing + kblock->width();
+
+    block->setMaxWidth(maxwidth);
+    block->setLineAttr(l.h, l.fdesc);
+
+    // Measure the kanji/kana + word types + definition in some order.
+
+    QString kanjistr;
+
+    // Build the string for the kanji/kana part.
+
+    if (!Settings::print.separated && !Settings::print.doublepage)
+    {
+        if (l.inlinefuri)
+        {
+            if (!Settings::print.reversed)
+                block->addFuriWord(e, furi, l.kf, kfm, l.ff, ffm, l.furilinesize, l.furidesc);
+        }
+        else if (Settings::print.readings == PrintSettings::ShowAfter && Settings::print.usekanji && e->kanji != e->kana)
+        {
+            kanjistr = e->kanji.toQString() + QStringLiteral("(%1)").arg(e->kana.toQStringRaw());
 
-            if (Settings::print.doublepage && !secondpage && wordpos == lsiz)
+            if (!Settings::print.reversed)
             {
-                wordpos = pagepos;
-                secondpage = true;
+                // Kanji/kana when it comes before the definition.
+                QCharTokenizer ktok(kanjistr.constData(), kanjistr.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
+                block->addText(ktok, l.kf, kfm);
             }
         }
         else
         {
-            left = baseleft;
-            top = basetop;
-            column = 0;
+            kanjistr = !Settings::print.usekanji ? e->kana.toQString() : e->kanji.toQString();
+            if (!Settings::print.reversed)
+                block->addText(kanjistr, l.kf, kfm);
+        }
 
-            if (Settings::print.pagenum)
+        if (!Settings::print.reversed)
+            block->addText("-", l.kf, kfm);
+    }
+
+    // Definition has several parts:
+    // definition number, word type, definition text. If the word has a user defined
+    // definition, it's used together with all the word types specified for each
+    // definition.
+
+    const QCharString *sdef = Settings::print.userdefs ? dict->studyDefinition(list[wordpos]) : nullptr;
+    if (sdef != nullptr)
+    {
+        // There was a user given definition for the word.
+
+        if (Settings::print.showtype)
+        {
+            str = QString();
+            for (int ix = 0, siz = tosigned(e->defs.size()); ix != siz; ++ix)
             {
-                p.setFont(pf);
-                p.drawText(QRect(0, pagebottom, pagerect.width(), m), Qt::AlignHCenter | Qt::AlignBottom, QString("%1").arg(pagecnt));
+                str += Strings::wordTypesText(e->defs[ix].attrib.types);
+                if (ix != tosigned(e->defs.size()) - 1)
+                    str += "; ";
             }
+            QCharTokenizer pttok(str.constData(), str.size(), qcharisspace);
+            block->addText(pttok, l.tf, tfm);
+        }
 
-            pr->newPage();
-            ++pagecnt;
+        str = sdef->toQStringRaw();
+        QCharTokenizer stok(str.constData(), str.size(), qcharisspace);
 
-            // Second page.
-            for (int ix = 0, siz = tosigned(blocks.size()); ix != siz; ++ix, ++wordpos)
-            {
-                PrintTextBlock *bl = blocks[ix];
-                int blockh = bl->height();
+        block->addText(stok, l.df, dfm);
+    }
+    else
+    {
+        // No user definition. Use the word from the dictionary.
+        // Print each definition separately.
+        for (int ix = 0, siz = tosigned(e->defs.size()); ix != siz; ++ix)
+        {
+            if (e->defs.size() != 1)
+                block->addText(QStringLiteral("%1.").arg(ix + 1), l.df, dfm);
 
-                if (top != basetop && top + bl->height() /*+ linespacing*/ > pagebottom)
-                {
-                    top = basetop;
-                    left += colwidth + colspacing;
-                }
-                if (Settings::print.separator || Settings::print.background)
-                {
-                    if (Settings::print.background && (wordpos % 2) == 1)
-                        p.fillRect(QRect(left - colspacing / 4, top - linespacing / 2, colwidth, blockh + linespacing), qRgb(230, 230, 230));
-                    if (top != basetop && Settings::print.separator)
-                        p.drawLine(left - colspacing / 4, top - linespacing / 2, left + colwidth - colspacing / 4, top - linespacing / 2);
-                }
+            if (Settings::print.showtype)
+            {
+                str = Strings::wordTypesText(e->defs[ix].attrib.types);
 
-                bl->paint(p, left, top);
-                top += linespacing + bl->height();
+                QCharTokenizer pttok(str.constData(), str.size(), qcharisspace);
+                block->addText(pttok, l.tf, tfm);
             }
 
-            column = 0;
-            top = basetop;
-            left = baseleft;
+            str = e->defs[ix].def.toQStringRaw();
 
-            blocks.clear();
+            QCharTokenizer stok(str.constData(), str.size(), qcharisspace);
+            block->addText(stok, l.df, dfm);
+        }
+    }
 
-            secondpage = false;
-            pagepos = wordpos;
+    if (!Settings::print.doublepage && Settings::print.reversed && !Settings::print.separated)
+    {
+        // Kanji/kana when printed after the definition.
 
-            if (wordpos != lsiz)
-            {
-                if (Settings::print.pagenum)
-                {
-                    p.setFont(pf);
-                    p.drawText(QRect(0, pagebottom, pagerect.width(), m), Qt::AlignHCenter | Qt::AlignBottom, QString("%1").arg(pagecnt));
-                }
+        block->addText("-", l.kf, kfm);
 
-                pr->newPage();
-                ++pagecnt;
-            }
+        if (l.inlinefuri)
+            block->addFuriWord(e, furi, l.kf, kfm, l.ff, ffm, l.furilinesize, l.furidesc);
+        else
+        {
+            QCharTokenizer ktok(kanjistr.constData(), kanjistr.size(), [](QChar ch) { if (ch == '(') return QCharKind::BreakBefore; return QCharKind::Normal; });
+            block->addText(ktok, l.kf, kfm);
         }
     }
 
-    if (!list.empty() && Settings::print.pagenum)
+    // Update the available width of the separate kanji text after the
+    // definition has been completed.
+    if (!Settings::print.doublepage && Settings::print.separated)
+        kblock->setMaxWidth(l.colwidth - l.colspacing / 2 - l.colspacing - block->width());
+
+    // The definition block should be printed a few pixels below
+    // to line up with the kanji under the furigana.
+    w.blockskip = 0;
+    if (!Settings::print.doublepage && Settings::print.separated && Settings::print.usekanji && Settings::print.readings == PrintSettings::ShowAbove)
+        w.blockskip = l.furilinesize;
+
+    w.blockh = std::max(kblock->height(), block->height() + w.blockskip);
+
+    // The side printed on the second page of double pages is as high as the word.
+    if (Settings::print.doublepage)
+        (!Settings::print.reversed ? block : kblock)->setHeight(w.blockh);
+
+    w.block = std::move(block);
+    w.kblock = std::move(kblock);
+}
+
+void PrintPreviewForm::paginate()
+{
+    PrintLayout &l = *layout;
+
+    int page = 0;
+    int column = 0;
+    int top = l.basetop;
+    int left = l.baseleft;
+
+    for (int ix = 0, siz = tosigned(l.words.size()); ix != siz; ++ix)
     {
-        p.setFont(pf);
-        p.drawText(QRect(0, pagebottom, pagerect.width(), m), Qt::AlignHCenter | Qt::AlignBottom, QString("%1").arg(pagecnt));
-    }
+        PrintLayout::Word &w = l.words[ix];
 
-    p.end();
+        if (top != l.basetop && top + w.blockh /*+ linespacing*/ > l.pagebottom)
+        {
+            top = l.basetop;
+            left += l.colwidth + l.colspacing;
+            ++column;
 
-    ui->pageLabel->setText(QStringLiteral("/ %1").arg(pagecnt));
+            if (column >= Settings::print.columns)
+            {
+                left = l.baseleft;
+                column = 0;
+                ++page;
+            }
+        }
+
+        w.page = page;
+        w.left = left;
+        w.top = top;
+
+        top += l.linespacing + w.blockh;
+    }
+
+    l.pages = page + 1;
+    l.paginated = true;
 }
 
 void PrintPreviewForm::dictionaryToBeRemoved(int /*index*/, int /*orderindex*/, Dictionary *d)
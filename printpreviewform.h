@@ -8,11 +8,13 @@
 #define PRINTPREVIEWFORM_H
 
 #include <QtCore>
+#include <memory>
 #include <QMainWindow>
 #include <QPrinter>
 #include <QFont>
 #include <QPrintPreviewWidget>
 #include "dialogwindow.h"
+#include "furigana.h"
 
 namespace Ui {
     class PrintPreviewForm;
@@ -39,9 +41,9 @@ public:
     // Should be called once before adding anything to the block.
     void setLineAttr(int lineheight, int descent);
 
-    void setFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int lineheight, int descent, int furiheight, int furidescent);
+    void setFuriWord(WordEntry *e, const std::vector<FuriganaData> &furi, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int lineheight, int descent, int furiheight, int furidescent);
 
-    void addFuriWord(WordEntry *e, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int furiheight, int furidescent);
+    void addFuriWord(WordEntry *e, const std::vector<FuriganaData> &furi, QFont &f, QFontMetrics &fm, QFont &ff, QFontMetrics &ffm, int furiheight, int furidescent);
 
     void addText(QCharTokenizer &tok, QFont &f, QFontMetrics &fm);
     void addText(const QString &str, QFont &f, QFontMetrics &fm);
@@ -127,6 +129,9 @@ private:
     // Word used for furigana printing.
     WordEntry *word;
 
+    // Furigana data of word.
+    std::vector<FuriganaData> furigana;
+
     // The word entry is printed at the front (or back) of the block in a flowing text.
     bool frontword;
 
@@ -187,7 +192,10 @@ protected slots:
     void entryRemoved(int windex, int abcdeindex, int aiueoindex);
     void entryChanged(int windex, bool studydef);
 
+    // Paints the pages of the printed words. The text of the words is measured and the page
+    // breaks computed once, and only updated when the words or the settings change.
     void paintPages(QPrinter *p);
+    void settingsChanged();
 
     void dictionaryToBeRemoved(int index, int orderindex, Dictionary *dict);
     void dictionaryReplaced(Dictionary *olddict, Dictionary *newdict, int index);
@@ -196,6 +204,17 @@ private:
     // changed.
     bool savePrinterSettings();
 
+    struct PrintLayout;
+
+    // Discards the measured words. They are measured again at the next paint.
+    void invalidateLayout();
+    // Creates an empty layout with the fonts and sizes used for printing on pr.
+    void createLayout(QPrinter *pr, QPainter &p);
+    // Measures the text blocks of the word at wordpos in list.
+    void measureWord(int wordpos);
+    // Computes the position of every measured word on the pages.
+    void paginate();
+
     Ui::PrintPreviewForm *ui;
 
     QPrinter printer;
@@ -213,6 +232,9 @@ private:
     // Number of pages.
     int pagecnt;
 
+    // Measured words and their positions from the last paint.
+    std::unique_ptr<PrintLayout> layout;
+
     typedef DialogWindow    base;
 };
 
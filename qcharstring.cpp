@@ -1266,16 +1266,63 @@ const QCharString* QCharStringListIterator::operator->() const
 //-------------------------------------------------------------
 
 
-QCharStringList::QCharStringList() : reserved(0), used(0), arr(nullptr)
+namespace
+{
+    // Number of characters in a block of QCharStringPool, unless a longer string is added.
+    const int poolBlockSize = 16384;
+}
+
+QCharStringPool::QCharStringPool() : blocksize(0), blockused(0)
+{
+
+}
+
+QCharStringPool::~QCharStringPool()
+{
+    for (QChar *block : blocks)
+        delete[] block;
+}
+
+QChar* QCharStringPool::add(const QChar *str, int length)
+{
+    if (length == -1)
+        length = tosigned(qcharlen(str));
+
+    auto it = strings.find(QString::fromRawData(str, length));
+    if (it != strings.end())
+        return const_cast<QChar*>(it->constData());
+
+    if (blocks.empty() || blockused + length + 1 > blocksize)
+    {
+        blocksize = std::max(poolBlockSize, length + 1);
+        blocks.push_back(new QChar[blocksize]);
+        blockused = 0;
+    }
+
+    QChar *result = blocks.back() + blockused;
+    memcpy(result, str, sizeof(QChar) * length);
+    result[length] = QChar(0);
+    blockused += length + 1;
+
+    strings.insert(QString::fromRawData(result, length));
+    return result;
+}
+
+
+//-------------------------------------------------------------
+
+
+QCharStringList::QCharStringList() : reserved(0), used(0), arr(nullptr), packed(false)
 {
     ;
 }
 
-QCharStringList::QCharStringList(QCharStringList &&src) : reserved(0), used(0), arr(nullptr)
+QCharStringList::QCharStringList(QCharStringList &&src) : reserved(0), used(0), arr(nullptr), packed(false)
 {
     std::swap(reserved, src.reserved);
     std::swap(used, src.used);
     std::swap(arr, src.arr);
+    std::swap(packed, src.packed);
 }
 
 QCharStringList& QCharStringList::operator=(QCharStringList &&src)
@@ -1283,10 +1330,11 @@ QCharStringList& QCharStringList::operator=(QCharStringList &&src)
     std::swap(reserved, src.reserved);
     std::swap(used, src.used);
     std::swap(arr, src.arr);
+    std::swap(packed, src.packed);
     return *this;
 }
 
-QCharStringList::QCharStringList(const QCharStringList &src) : reserved(src.reserved), used(src.used), arr(nullptr)
+QCharStringList::QCharStringList(const QCharStringList &src) : reserved(src.reserved), used(src.used), arr(nullptr), packed(false)
 {
     if (reserved == 0)
         return;
@@ -1298,10 +1346,15 @@ QCharStringList::QCharStringList(const QCharStringList &src) : reserved(src.rese
 
 QCharStringList& QCharStringList::operator=(const QCharStringList &src)
 {
+    if (&src == this)
+        return *this;
+
+    release();
+
     used = src.used;
     if (reserved != src.reserved)
     {
-        delete arr;
+        delete[] arr;
         reserved = src.reserved;
         if (reserved == 0)
         {
@@ -1319,6 +1372,7 @@ QCharStringList& QCharStringList::operator=(const QCharStringList &src)
 
 QCharStringList::~QCharStringList()
 {
+    release();
     delete[] arr;
 }
 
@@ -1342,7 +1396,7 @@ void QCharStringList::swap(QCharStringList &src)
     std::swap(reserved, src.reserved);
     std::swap(used, src.used);
     std::swap(arr, src.arr);
-
+    std::swap(packed, src.packed);
 }
 
 QCharStringList::iterator QCharStringList::begin()
@@ -1440,6 +1494,8 @@ void QCharStringList::add(const QChar *str, int length)
     if (length == -1)
         length = tosigned(qcharlen(str));
 
+    unpack();
+
     if (used == reserved)
         grow();
 
@@ -1454,6 +1510,8 @@ void QCharStringList::add(const QCharString &str, int length)
 
 void QCharStringList::add(QCharString &&str)
 {
+    unpack();
+
     if (used == reserved)
         grow();
     arr[used] = std::move(str);
@@ -1500,6 +1558,8 @@ bool QCharStringList::contains(const QChar *str, bool exact)
 
 void QCharStringList::copy(const QStringList &src)
 {
+    release();
+
     reserved = 0;
     used = 0;
     delete[] arr;
@@ -1524,8 +1584,25 @@ bool QCharStringList::empty() const
     return used == 0;
 }
 
+void QCharStringList::pack(QCharStringPool &pool)
+{
+    for (size_type ix = 0; ix != used; ++ix)
+    {
+        QCharString &str = arr[ix];
+        if (str.arr == nullptr)
+            continue;
+
+        QChar *pooled = pool.add(str.arr);
+        if (!packed)
+            delete[] str.arr;
+        str.arr = pooled;
+    }
+    packed = true;
+}
+
 void QCharStringList::clear()
 {
+    release();
     delete[] arr;
     arr = nullptr;
     used = 0;
@@ -1614,6 +1691,39 @@ void QCharStringList::grow()
     reserved += growsize;
 }
 
+void QCharStringList::release()
+{
+    if (!packed)
+        return;
+
+    for (size_type ix = 0; ix != used; ++ix)
+    {
+        arr[ix].arr = nullptr;
+#ifdef _DEBUG
+        arr[ix].siz = 0;
+#endif
+    }
+    packed = false;
+}
+
+void QCharStringList::unpack()
+{
+    if (!packed)
+        return;
+
+    packed = false;
+    for (size_type ix = 0; ix != used; ++ix)
+    {
+        QCharString &str = arr[ix];
+        if (str.arr == nullptr)
+            continue;
+
+        const QChar *pooled = str.arr;
+        str.arr = nullptr;
+        str.copy(pooled);
+    }
+}
+
 
 //-------------------------------------------------------------
 
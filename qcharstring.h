@@ -9,6 +9,8 @@
 
 #include <QChar>
 #include <QString>
+#include <QSet>
+#include <vector>
 
 enum class QCharKind;
 
@@ -255,6 +257,8 @@ public:
 private:
     QChar *arr;
 
+    friend class QCharStringList;
+
     template <typename STR>
     friend bool operator==(const STR &a, const QCharString &b);
     template <typename STR>
@@ -387,6 +391,35 @@ QCharStringListIterator operator+(QCharStringListIterator::difference_type n, co
 QCharStringListConstIterator operator+(QCharStringListConstIterator::difference_type n, const QCharStringListConstIterator &b);
 
 
+// Storage of null terminated strings placed after each other in large blocks of memory.
+// Identical strings are only stored once. The strings can't be changed or freed one by one,
+// only together when the pool is destroyed.
+class QCharStringPool
+{
+public:
+    QCharStringPool();
+    ~QCharStringPool();
+
+    // Returns a string in the pool matching the first length characters of str, adding it if
+    // it's not yet stored. If length is -1, str must be null terminated. The returned string
+    // must not be modified.
+    QChar* add(const QChar *str, int length = -1);
+private:
+    QCharStringPool(const QCharStringPool &) = delete;
+    QCharStringPool& operator=(const QCharStringPool &) = delete;
+
+    // Blocks of memory holding the strings. Only the last block has free space.
+    std::vector<QChar*> blocks;
+    // Number of characters in the last block.
+    int blocksize;
+    // Number of characters used in the last block.
+    int blockused;
+
+    // Every string in the pool, referencing the data in blocks without copying it.
+    QSet<QString> strings;
+};
+
+
 // Very simple class of holding QCharString objects that don't change after they have been
 // added. Uses 32 bit sizes instead of being platform dependent, to follow Qt standards.
 class QCharStringList
@@ -449,6 +482,12 @@ public:
     // Sets the contents to match src.
     void copy(const QStringList &src);
 
+    // Replaces the strings in the list with the same strings stored in pool. The strings of
+    // a packed list must not be modified, and the pool must be kept until the list is
+    // destroyed, cleared or its strings are packed in another pool. Adding strings to the
+    // list makes it hold its own copy of every string again.
+    void pack(QCharStringPool &pool);
+
     size_type size() const;
     bool empty() const;
     // Removes every element of the list and frees up the used space.
@@ -467,9 +506,18 @@ private:
     // is not optimized and can make it slow to insert many items.
     void grow();
 
+    // Forgets the strings of a packed list without freeing them, leaving empty strings in
+    // their place.
+    void release();
+    // Makes a packed list hold its own copy of each string.
+    void unpack();
+
     size_type reserved;
     size_type used;
     QCharString *arr;
+
+    // The strings in arr are stored in a QCharStringPool.
+    bool packed;
 };
 
 QDataStream& operator>>(QDataStream &stream, QCharStringList &list);
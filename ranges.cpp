@@ -20,6 +20,7 @@ RangeSelection::RangeSelection() : itcache(list.cend())
 
 void RangeSelection::clear()
 {
+    counts.clear();
     list.clear();
     itcache = list.cend();
 }
@@ -31,67 +32,14 @@ bool RangeSelection::empty() const
 
 int RangeSelection::size(int addfirst, int addlast) const
 {
-    //int cnt = 0;
-    //for (const Range *r : ranges)
-    //    cnt += r->last - r->first + 1;
+    updateCounts();
 
-    //return cnt;
+    int cnt = counts.back();
+    if (addfirst == -1 || addlast == -1 || addfirst > addlast)
+        return cnt;
 
-    bool validadd = addfirst != -1 && addlast != -1 && addfirst <= addlast;
-    if (list.empty())
-        return validadd ? addlast - addfirst + 1 : 0;
-
-    int cnt = 0;
-
-    // Last item in the previously counted  range.
-    int bottom = -1;
-
-    for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
-    {
-        const Range *r = list[ix];
-
-        int rtop = r->first;
-        int rbottom = r->last;
-
-        if (validadd && addfirst > bottom && addlast < rtop)
-        {
-            // The added range is between two ranges, not overlapping with them.
-            cnt += addlast - addfirst + 1;
-            validadd = false;
-        }
-        if (validadd && addlast < rtop)
-        {
-            // The added range overlapped the previous range and reaches below it, but doesn't
-            // overlap with the next range.
-
-            cnt += addlast - bottom;
-
-            validadd = false;
-        }
-
-        // The added range might start above the current range and overlaps with it
-        if (validadd && addlast >= rtop)
-            rtop = std::max(bottom + 1, std::min(rtop, addfirst));
-
-        cnt += rbottom - rtop + 1;
-
-        bottom = rbottom;
-
-        // Invalidate added range once we are finished with it;
-        if (validadd && addlast <= bottom)
-            validadd = false;
-    }
-
-    if (validadd)
-    {
-        // The added range reaches below the last range.
-
-        cnt += addlast - std::max(bottom + 1, addfirst) + 1;
-
-        validadd = false;
-    }
-
-    return cnt;
+    // Items of the added range are only counted once when they are also selected.
+    return cnt + (addlast - addfirst + 1) - (countBefore(addlast + 1) - countBefore(addfirst));
 }
 
 bool RangeSelection::singleSelected(int index) const
@@ -122,6 +70,8 @@ void RangeSelection::setSelected(int index, bool sel)
     if ((it == list.end() && !sel) || (it != list.end() && ((*it)->first <= index) == sel))
         return;
 
+    counts.clear();
+
     // Affected range containing or directly after index.
     Range *r = it != list.end() ? *it : nullptr;
     // Affected range directly in front of index.
@@ -195,68 +145,49 @@ void RangeSelection::setSelected(int index, bool sel)
 
 void RangeSelection::getSelection(std::vector<int> &result, int addfirst, int addlast) const
 {
-    bool validadd = addfirst != -1 && addlast != -1 && addfirst <= addlast;
-    if (list.empty())
-    {
-        for (int iy = addfirst; validadd && iy != addlast + 1; ++iy)
-            result.push_back(iy);
-        return;
-    }
-
-    result.reserve(size());
-
-    // Last item in the previously added range.
-    int bottom = -1;
+    result.reserve(result.size() + size(addfirst, addlast));
 
-    for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
-    {
-        const Range *r = list[ix];
+    forEachRange([&result](int first, int last) {
+        for (int ix = first; ix != last + 1; ++ix)
+            result.push_back(ix);
+    }, addfirst, addlast);
+}
 
-        int rtop = r->first;
-        int rbottom = r->last;
+void RangeSelection::forEachRange(const std::function<void(int, int)> &func, int addfirst, int addlast) const
+{
+    bool validadd = addfirst != -1 && addlast != -1 && addfirst <= addlast;
 
-        if (validadd && addfirst > bottom && addlast < rtop)
+    // The run of items not yet passed to func. Ranges touching or overlapping the run are
+    // joined with it.
+    int first = -1;
+    int last = -1;
+    auto add = [&func, &first, &last](int f, int l) {
+        if (first != -1 && f <= last + 1)
         {
-            // The added range is between two ranges, not overlapping with them.
-            for (int iy = addfirst; iy != addlast + 1; ++iy)
-                result.push_back(iy);
-
-            validadd = false;
+            last = std::max(last, l);
+            return;
         }
-        if (validadd && addlast < rtop)
-        {
-            // The added range overlapped the previous range and reaches below it, but doesn't
-            // overlap with the next range.
-
-            for (int iy = bottom + 1; iy != addlast + 1; ++iy)
-                result.push_back(iy);
+        if (first != -1)
+            func(first, last);
+        first = f;
+        last = l;
+    };
 
+    for (const Range *r : list)
+    {
+        if (validadd && addfirst < r->first)
+        {
+            add(addfirst, addlast);
             validadd = false;
         }
-
-        // The added range might start above the current range and overlaps with it
-        if (validadd && addlast >= rtop)
-            rtop = std::max(bottom + 1, std::min(rtop, addfirst));
-
-        for (int iy = rtop; iy != rbottom + 1; ++iy)
-            result.push_back(iy);
-
-        bottom = rbottom;
-
-        // Invalidate added range once we are finished with it;
-        if (validadd && addlast <= bottom)
-            validadd = false;
+        add(r->first, r->last);
     }
 
     if (validadd)
-    {
-        // The added range reaches below the last range.
-
-        for (int iy = std::max(bottom + 1, addfirst); iy != addlast + 1; ++iy)
-            result.push_back(iy);
+        add(addfirst, addlast);
 
-        validadd = false;
-    }
+    if (first != -1)
+        func(first, last);
 }
 
 void RangeSelection::selectedRanges(int first, int last, std::vector<Range const *> &result) const
@@ -275,6 +206,8 @@ void RangeSelection::selectedRanges(int first, int last, std::vector<Range const
 
 void RangeSelection::selectRange(int first, int last, bool sel)
 {
+    counts.clear();
+
     // Get the range touching index if selecting, so it can be extended. Either that, or the
     // next range will be returned here.
     auto it = search(sel ? std::max(0, first - 1) : first);
@@ -398,42 +331,40 @@ bool RangeSelection::rangeSelected(int first, int last) const
 
 int RangeSelection::selectedItems(int selindex, int addfirst, int addlast)  const
 {
-    if (selindex < 0)
+    if (selindex < 0 || selindex >= size(addfirst, addlast))
         return -1;
 
     bool validadd = addfirst != -1 && addlast != -1 && addfirst <= addlast;
-    if (list.empty())
+    if (!validadd)
     {
-        if (!validadd || selindex > addlast - addfirst)
-            return -1;
-        return addfirst + selindex;
+        // Last range with fewer selected items in front of it than selindex.
+        int ix = tosigned(std::upper_bound(counts.begin(), counts.end(), selindex) - counts.begin()) - 1;
+        return list[ix]->first + selindex - counts[ix];
     }
 
-    for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
+    // Number of items with a lower value than index in either the selection or the added
+    // range.
+    auto unionBefore = [this, addfirst, addlast](int index) {
+        if (index <= addfirst)
+            return countBefore(index);
+        int addcnt = std::min(index, addlast + 1) - addfirst;
+        return countBefore(index) + addcnt - (countBefore(addfirst + addcnt) - countBefore(addfirst));
+    };
+
+    // Binary search for the lowest value with selindex selected items in front of it and
+    // selected itself.
+    int lo = 0;
+    int hi = std::max(addlast, list.empty() ? 0 : list.back()->last);
+    while (lo < hi)
     {
-        const Range *r = list[ix];
-
-        if (validadd && addfirst < r->first)
-        {
-            if (selindex <= std::min(addlast, r->first - 1) - addfirst)
-                return selindex + addfirst;
-            selindex -= std::min(addlast, r->first - 1) - addfirst + 1;
-            addfirst = r->last + 1;
-        }
-
-        if (validadd && addlast <= r->last)
-            validadd = false;
-
-        if (r->last - r->first + 1 <= selindex)
-            selindex -= r->last - r->first + 1;
+        int mid = lo + (hi - lo) / 2;
+        if (unionBefore(mid + 1) > selindex)
+            hi = mid;
         else
-            return r->first + selindex;
+            lo = mid + 1;
     }
 
-    if (validadd && selindex <= addlast - addfirst)
-        return addfirst + selindex;
-
-    return -1;
+    return lo;
 }
 
 int RangeSelection::rangeCount() const
@@ -454,6 +385,8 @@ bool RangeSelection::insert(int index, int cnt)
     if (it == list.end() || cnt == 0)
         return false;
 
+    counts.clear();
+
     Range *r = *it;
     if (r->first < index)
     {
@@ -465,7 +398,9 @@ bool RangeSelection::insert(int index, int cnt)
         r2->last = r->last + cnt;
         r->last = index - 1;
 
-        itcache = it = std::next(list.insert(it, r2));
+        // The new range comes after r, and its position is already updated.
+        itcache = it = list.insert(std::next(it), r2);
+        ++it;
     }
 
     // Every range at and above it are to be moved up by cnt.
@@ -500,6 +435,8 @@ bool RangeSelection::remove(const Range &range)
     if (cnt <= 0)
         return false;
 
+    counts.clear();
+
     // Shrink range by the overlapping removed part.
 
     if (r->first < range.first)
@@ -548,6 +485,15 @@ bool RangeSelection::remove(const Range &range)
         r->last -= cnt;
     }
 
+    // The ranges before and after the removed items can touch, and must be joined.
+    it = search(range.first);
+    if (it != list.end() && it != list.begin() && (*std::prev(it))->last + 1 == (*it)->first)
+    {
+        (*std::prev(it))->last = (*it)->last;
+        list.erase(it);
+        itcache = list.cend();
+    }
+
     return true;
 }
 
@@ -565,6 +511,8 @@ bool RangeSelection::move(const Range &range, int newindex)
     if (newindex <= range.last + 1 && newindex >= range.first)
         return false;
 
+    counts.clear();
+
     // Getting the first range at or after the moved part.
 
     auto it = search(range.first);
@@ -824,6 +772,36 @@ auto RangeSelection::search(int index) const -> smartvector<Range>::const_iterat
     return itcache;
 }
 
+int RangeSelection::countBefore(int index) const
+{
+    updateCounts();
+
+    // First range not fully in front of index.
+    auto it = std::lower_bound(list.cbegin(), list.cend(), index, [](const Range *r, int val) {
+        return r->last < val;
+    });
+
+    int cnt = counts[it - list.cbegin()];
+    if (it != list.cend() && (*it)->first < index)
+        cnt += index - (*it)->first;
+    return cnt;
+}
+
+void RangeSelection::updateCounts() const
+{
+    if (!counts.empty())
+        return;
+
+    counts.reserve(list.size() + 1);
+    int cnt = 0;
+    for (const Range *r : list)
+    {
+        counts.push_back(cnt);
+        cnt += r->last - r->first + 1;
+    }
+    counts.push_back(cnt);
+}
+
 
 //-------------------------------------------------------------
 
@@ -57,6 +57,11 @@ public:
     // addlast are both specified (not -1), items between them will also be included in the
     // result. The result list will be ordered by value.
     void getSelection(std::vector<int> &result, int addfirst = -1, int addlast = -1) const;
+    // Calls func with the first and last item of every continuous run of selected items,
+    // ordered by value. If addfirst and addlast are both specified (not -1), items between
+    // them are also considered selected. Unlike getSelection(), this doesn't list every item
+    // of a large selection.
+    void forEachRange(const std::function<void(int, int)> &func, int addfirst = -1, int addlast = -1) const;
 
     // Fills result with the ranges that have parts in the range [first, last]. The
     // first and last ranges in result might only be partially in the passed range.
@@ -125,9 +130,19 @@ private:
     // if index comes after all the ranges, returns ranges.end().
     smartvector<Range>::const_iterator search(int index) const;
 
+    // Returns the number of selected items with a lower value than index.
+    int countBefore(int index) const;
+    // Fills counts if the selection changed since it was last computed.
+    void updateCounts() const;
+
     // Selection ranges. The list is ordered.
     smartvector<Range> list;
 
+    // [range index] Number of selected items in the ranges in front of each range, with the
+    // number of all selected items at the end. Cleared when the selection changes, and
+    // computed again when needed.
+    mutable std::vector<int> counts;
+
     // Used to store persistent model indexes of a model while its layout is changing. In any
     // other case this list should be empty.
     std::vector<QPersistentModelIndex> layoutindexes;
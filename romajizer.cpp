@@ -333,6 +333,29 @@ namespace
     //    "WI", "WE", "WO", "N", "VU"
     //};
 
+    // Length of each romaji syllable in kanatable.
+    const uchar kanatablelen[86] =
+    {
+        2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 2, 2, 2, 2, //14
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, //30
+        2, 2, 2, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, //46
+        2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, //62
+        2, 2, 2, 3, 2, 3, 2, 3, 2, 2, 2, 2, 2, 2, 3, 2, //78
+        3, 3, 2, 2, 2, 3, 3
+    };
+
+    // Whether a small tsu before the syllables in kanatable is written by doubling the first
+    // letter of the syllable. It's dropped before the others.
+    const bool kanatablegeminate[86] =
+    {
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, //14
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //30
+        1, 1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //46
+        1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, //62
+        1, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0, //78
+        0, 0, 0, 1, 0, 0, 0
+    };
+
     const ushort kanavowel[5] = { 0x3042, 0x3044, 0x3046, 0x3048, 0x304A, };
 
     const char vowelcolumn[84] =
@@ -393,79 +416,100 @@ QString romanize(const QCharString &str, int len)
     return romanize(str.data(), len == -1 ? str.size() : len);
 }
 
-QString romanize(const QChar *str, int len)
+namespace
 {
-    //if (len == 1 && KANA(str[0]))
-    //    return romanize(str[0]);
-
-    int i;
-
-    uint clen = len == -1 ? tounsigned(qcharlen(str)) : tounsigned(len);
-    char *conv = new char[clen * 3 + 1];
-    memset(conv, 0, clen * 3 + 1);
-
-    int convlen = 0;
-    for (unsigned int ix = 0; ix < clen; ++ix)
+    // Writes the romanized form of str to dest, which must have space for len * 3 characters.
+    // Returns the number of characters written.
+    int _romanize(const QChar *str, int len, QChar *dest)
     {
-        if (DASH(str[ix].unicode()) && convlen && KANAVOWEL(conv[convlen - 1]))
+        int convlen = 0;
+        for (int ix = 0; ix != len; ++ix)
         {
-            conv[convlen] = conv[convlen - 1];
-            convlen++;
-            continue;
-        }
+            ushort ch = str[ix].unicode();
 
-        if (MIDDOT(str[ix].unicode()))
-        {
-            //conv[convlen] = '/';
-            //convlen++;
-            continue;
-        }
+            // Long vowel mark repeats the last vowel.
+            if (DASH(ch))
+            {
+                if (convlen != 0 && KANAVOWEL(dest[convlen - 1].unicode()))
+                {
+                    dest[convlen] = dest[convlen - 1];
+                    ++convlen;
+                }
+                continue;
+            }
 
-        if (!KANA(str[ix].unicode())) // Skip unknown chars
-        {
-            if ((str[ix].unicode() >= 'A' && str[ix].unicode() <= 'Z') || (str[ix].unicode() >= 'a' && str[ix].unicode() <= 'z'))
+            // Skip unknown characters, including the middle dot.
+            if (!KANA(ch))
             {
-                conv[convlen] = (char)str[ix].unicode(); // Leave romaji there, maybe we will need it.
-                convlen++;
+                // Leave romaji there, maybe we will need it.
+                if ((ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z'))
+                    dest[convlen++] = QChar(ch);
+                continue;
             }
-            continue;
+
+            int i = ch - (KATAKANA(ch) ? 0x30A1 : 0x3041);
+            const char *syllable = kanatable[i];
+
+            if (convlen != 0 && dest[convlen - 1].unicode() == '+')
+            {
+                if (kanatablegeminate[i])
+                    dest[convlen - 1] = QChar(syllable[0]);
+                else // Error, remove doubling too.
+                    --convlen;
+            }
+
+            for (int iy = 0, siz = kanatablelen[i]; iy != siz; ++iy)
+                dest[convlen++] = QChar(syllable[iy]);
         }
-        if (KATAKANA(str[ix].unicode()))
-            i = str[ix].unicode() - 0x30A1;
-        else
-            i = str[ix].unicode() - 0x3041;
+        if (convlen != 0 && dest[convlen - 1].unicode() == '+')
+            --convlen;
 
-        if (kanatable[i][0] != '*')
+        return convlen;
+    }
+
+    // Writes the hiraganized form of str to dest, which must have space for len characters.
+    // Returns the number of characters written.
+    int _hiraganize(const QChar *str, int len, QChar *dest)
+    {
+        int hlen = 0;
+        for (int ix = 0; ix != len; ++ix)
         {
-            if (convlen && conv[convlen - 1] == '+')
+            ushort ch = str[ix].unicode();
+            if (DASH(ch))
             {
-                // Error, remove doubling too.
-                if (kanatable[i][0] == '+' || kanatable[i][0] == 'y' || kanatable[i][0] == 'Y' || kanatable[i][0] == 'w' ||
-                    kanatable[i][0] == 'v' || kanatable[i][0] == 'a' || kanatable[i][0] == 'i' || kanatable[i][0] == 'u' ||
-                    kanatable[i][0] == 'e' || kanatable[i][0] == 'o' || kanatable[i][0] == 'x' || kanatable[i][0] == 'W')
+                if (hlen != 0 && HIRAGANA(dest[hlen - 1].unicode()))
                 {
-                    convlen--;
-                    conv[convlen] = 0;
+                    char column = vowelcolumn[dest[hlen - 1].unicode() - 0x3041];
+                    if (column >= 0)
+                        dest[hlen++] = QChar(kanavowel[(unsigned char)column]);
                 }
-                else
-                    conv[convlen - 1] = kanatable[i][0];
-            }
-            int cl = 0;
-            while (kanatable[i][cl])
-            {
-                conv[convlen] = kanatable[i][cl++];
-                convlen++;
+                continue;
             }
+
+            if (KATAKANA(ch) && ch <= 0x30F4)
+                dest[hlen++] = QChar(ch - 0x60);
+            else
+                dest[hlen++] = str[ix];
         }
+        return hlen;
     }
-    if (convlen && conv[convlen - 1] == '+')
-        conv[--convlen] = 0;
+}
 
-    QString s(conv);
+QString romanize(const QChar *str, int len)
+{
+    TransliterationBuffer buf;
+    romanize(str, len, buf);
+    return QString(buf.constData(), buf.size());
+}
 
-    delete[] conv;
+void romanize(const QChar *str, int len, TransliterationBuffer &dest)
+{
+    if (len == -1)
+        len = tosigned(qcharlen(str));
 
-    return s;
+    // A single kana is at most 3 characters long in romaji.
+    dest.resize(len * 3);
+    dest.resize(_romanize(str, len, dest.data()));
 }
 
 QString hiraganize(const QString &str, int len)
@@ -480,30 +524,21 @@ QString hiraganize(const QCharString &str, int len)
 
 QString hiraganize(const QChar *str, int len)
 {
-    QString s;
     if (len == -1)
         len = tosigned(qcharlen(str));
 
-    for (int i = 0; i < len; i++)
-    {
-        if (DASH(str[i].unicode()))
-        {
-            if (!s.isEmpty() && HIRAGANA(s[s.size() - 1].unicode()))
-            {
-                ushort d = s[s.size() - 1].unicode() - 0x3041;
-                if (vowelcolumn[d] >= 0)
-                    s += QChar(kanavowel[(unsigned char)vowelcolumn[d]]);
-            }
-            continue;
-        }
+    QString s(len, Qt::Uninitialized);
+    s.resize(_hiraganize(str, len, s.data()));
+    return s;
+}
 
-        if (KATAKANA(str[i].unicode()) && str[i].unicode() <= 0x30F4)
-            s += QChar(str[i].unicode() - 0x60);
-        else
-            s += str[i];
-    }
+void hiraganize(const QChar *str, int len, TransliterationBuffer &dest)
+{
+    if (len == -1)
+        len = tosigned(qcharlen(str));
 
-    return s;
+    dest.resize(len);
+    dest.resize(_hiraganize(str, len, dest.data()));
 }
 
 namespace
@@ -889,10 +924,17 @@ namespace
         return _toKanaPicker(&ch, 0, useupper, upper);
     }
 
+    // Appends a syllable from kanaoutput to result, converted to katakana if kata is true.
+    inline void _toKanaAppend(TransliterationBuffer &result, const ushort *syllable, bool kata)
+    {
+        for (; *syllable != 0; ++syllable)
+            result.append(QChar(kata && HIRAGANA(*syllable) ? *syllable + 0x30a1 - 0x3041 : *syllable));
+    }
+
     template<typename T>
-    QString _toKana(const T *str, int len, bool uppertokata)
+    void _toKana(const T *str, int len, bool uppertokata, TransliterationBuffer &result)
     {
-        QString result;
+        result.clear();
 
         bool isupper;
 
@@ -910,37 +952,37 @@ namespace
             switch (ch.unicode())
             {
             case 'a':
-                result += !isupper ? QChar(0x3042) : QChar(0x30A2);
+                result.append(!isupper ? QChar(0x3042) : QChar(0x30A2));
                 ++str;
                 --len;
                 continue;
             case 'i':
-                result += !isupper ? QChar(0x3044) : QChar(0x30A4);
+                result.append(!isupper ? QChar(0x3044) : QChar(0x30A4));
                 ++str;
                 --len;
                 continue;
             case 'u':
-                result += !isupper ? QChar(0x3046) : QChar(0x30A6);
+                result.append(!isupper ? QChar(0x3046) : QChar(0x30A6));
                 ++str;
                 --len;
                 continue;
             case 'e':
-                result += !isupper ? QChar(0x3048) : QChar(0x30A8);
+                result.append(!isupper ? QChar(0x3048) : QChar(0x30A8));
                 ++str;
                 --len;
                 continue;
             case 'o':
-                result += !isupper ? QChar(0x304A) : QChar(0x30AA);
+                result.append(!isupper ? QChar(0x304A) : QChar(0x30AA));
                 ++str;
                 --len;
                 continue;
             case '-':
-                result += QChar(KDASH);
+                result.append(QChar(KDASH));
                 ++str;
                 --len;
                 continue;
             case '/':
-                result += QChar(MIDDLEDOT);
+                result.append(QChar(MIDDLEDOT));
                 ++str;
                 --len;
                 continue;
@@ -965,8 +1007,8 @@ namespace
             if (_toKanaPicker(str, -1, uppertokata, isupper) == _toKanaPicker(str, 0, uppertokata, isupper2) && ch.unicode() != 'n')
             {
                 kata = kata || isupper || isupper2;
-                if (result.isEmpty() || result.at(result.size() - 1) != QChar(MINITSU))
-                    result += kata ? QChar(MINITSUKATA) : QChar(MINITSU);
+                if (result.isEmpty() || result[result.size() - 1] != QChar(MINITSU))
+                    result.append(kata ? QChar(MINITSUKATA) : QChar(MINITSU));
                 continue;
             }
 
@@ -981,7 +1023,7 @@ namespace
                 {
                     found = true;
 
-                    result += !kata ? QString::fromUtf16(kanaoutput[ix]) : toKatakana(QString::fromUtf16(kanaoutput[ix]));
+                    _toKanaAppend(result, kanaoutput[ix], kata);
                     
                     //kata = false;
                     str += pos;
@@ -993,10 +1035,9 @@ namespace
             {
                 ++str;
                 --len;
-                result += !isupper ? QString::fromUtf16(kanaoutput[apos + asize - 1]) : toKatakana(QString::fromUtf16(kanaoutput[apos + asize - 1]));
+                _toKanaAppend(result, kanaoutput[apos + asize - 1], isupper);
             }
         }
-        return result;
     }
 }
 
@@ -1006,7 +1047,9 @@ QString toKana(const char *str, int len, bool uppertokata)
     if (len == -1)
         len = tosigned(strlen(str));
 
-    return _toKana<char>(str, len, uppertokata);
+    TransliterationBuffer buf;
+    _toKana<char>(str, len, uppertokata, buf);
+    return QString(buf.constData(), buf.size());
 }
 
 QString toKana(const QChar *str, int len, bool uppertokata)
@@ -1014,7 +1057,25 @@ QString toKana(const QChar *str, int len, bool uppertokata)
     if (len == -1)
         len = tosigned(qcharlen(str));
 
-    return _toKana<QChar>(str, len, uppertokata);
+    TransliterationBuffer buf;
+    _toKana<QChar>(str, len, uppertokata, buf);
+    return QString(buf.constData(), buf.size());
+}
+
+void toKana(const char *str, int len, bool uppertokata, TransliterationBuffer &dest)
+{
+    if (len == -1)
+        len = tosigned(strlen(str));
+
+    _toKana<char>(str, len, uppertokata, dest);
+}
+
+void toKana(const QChar *str, int len, bool uppertokata, TransliterationBuffer &dest)
+{
+    if (len == -1)
+        len = tosigned(qcharlen(str));
+
+    _toKana<QChar>(str, len, uppertokata, dest);
 }
 
 QChar hiraganaCh(const QChar *c, int ix)
@@ -10,6 +10,12 @@
 #include <QString>
 #include <QValidator>
 #include <QChar>
+#include <QVarLengthArray>
+
+// String for the transliteration functions below that write their result to a buffer
+// instead of returning a new QString. It only allocates memory on the heap for long strings,
+// so it can be used in frequently called code as a local variable. It's not null terminated.
+typedef QVarLengthArray<QChar, 128> TransliterationBuffer;
 
 // Converts HIRAGANA to KATAKANA.
 QString toKatakana(const QString &str, int len = -1);
@@ -26,6 +32,8 @@ QString romanize(const QCharString &str, int len = -1);
 // Converts japanese kana string to a form of romaji that the
 // program understands. It is not intended to be legible by humans.
 QString romanize(const QChar *str, int len = -1);
+// Converts japanese kana string to the romaji form of romanize(), writing the result to dest.
+void romanize(const QChar *str, int len, TransliterationBuffer &dest);
 
 // Converts KATAKANA to HIRAGANA. To convert romaji use toKana().
 QString hiraganize(const QString &str, int len = -1);
@@ -33,6 +41,8 @@ QString hiraganize(const QString &str, int len = -1);
 QString hiraganize(const QCharString &str, int len = -1);
 // Converts KATAKANA to HIRAGANA. To convert romaji use toKana().
 QString hiraganize(const QChar *str, int len = -1);
+// Converts KATAKANA to HIRAGANA, writing the result to dest.
+void hiraganize(const QChar *str, int len, TransliterationBuffer &dest);
 
 // Stores the unicode of a kana character in ch, which would be romanized as the
 // first few bytes of str. Sets chlen to the number of romaji characters needed for
@@ -49,6 +59,10 @@ QString toKana(const QChar *str, int len = -1, bool uppertokata = false);
 // Converts human readable romaji to hiragana, leaving out any invalid part of the input.
 // Set uppertokata to true to convert syllables with upper case romaji to katakana.
 QString toKana(const char *str, int len = -1, bool uppertokata = false);
+// Converts human readable romaji to hiragana like toKana() above, writing the result to dest.
+void toKana(const QChar *str, int len, bool uppertokata, TransliterationBuffer &dest);
+// Converts human readable romaji to hiragana like toKana() above, writing the result to dest.
+void toKana(const char *str, int len, bool uppertokata, TransliterationBuffer &dest);
 
 // Returns the hiragana equivalent of a katakana character, or the character
 // itself if it's not katakana. The function wants the whole string and the
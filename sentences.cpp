@@ -8,6 +8,7 @@
 #include "zkanjimain.h"
 #include "zui.h"
 #include "words.h"
+#include "perftrace.h"
 
 
 //-------------------------------------------------------------
@@ -24,6 +25,14 @@ Sentences::~Sentences()
 }
 
 void Sentences::reset()
+{
+    clearData();
+
+    ZKanji::commons.clearExamplesData();
+    ZKanji::wordexamples.reset();
+}
+
+void Sentences::clearData()
 {
     if (f.isOpen())
         f.close();
@@ -34,14 +43,15 @@ void Sentences::reset()
     usedsize = 0;
     creation = QDateTime();
     loaded = false;
-
-    ZKanji::commons.clearExamplesData();
-    ZKanji::wordexamples.reset();
 }
 
 void Sentences::load(const QString &filename)
 {
-    reset();
+    PERFTRACE_SCOPE("Sentences::load");
+
+    // The examples data in the commons tree is only replaced after the new data was read,
+    // to update the words that changed.
+    clearData();
 
     // File Format:
     // Header: 3 bytes id: "zex" + 3 bytes version number ('0' padded formatted string)
@@ -105,7 +115,10 @@ void Sentences::load(const QString &filename)
     {
         f.setFileName(filename);
         if (!f.open(QIODevice::ReadOnly))
+        {
+            reset();
             return;
+        }
 
         stream.setDevice(&f);
         stream.setVersion(QDataStream::Qt_5_5);
@@ -115,12 +128,12 @@ void Sentences::load(const QString &filename)
         tmp[6] = 0;
         stream.readRawData(tmp, 6);
 
-        if (strncmp(tmp, "zex", 3))
-            return;
-
         int ver = atol(tmp + 3);
-        if (ver != 2)
+        if (strncmp(tmp, "zex", 3) || ver != 2)
+        {
+            reset();
             return;
+        }
 
         stream >> make_zdate(creation);
         stream >> make_zstr(prgversion, ZStrFormat::Byte);
@@ -146,15 +159,15 @@ void Sentences::load(const QString &filename)
             blockpos[ix] = getInt(data, pos);
         blockpos[blockpos.size() - 1] = stpos;
 
-        QCharString kanji;
-        QCharString kana;
+        smartvector<WordCommons> words;
         // TODO: check for premature end of data.
         while (pos != data.size())
         {
-            kanji = getByteArrayString(data, pos);
-            kana = getByteArrayString(data, pos);
-
-            WordCommons *dat = ZKanji::commons.addWord(kanji.data(), kana.data());
+            WordCommons *dat = new WordCommons;
+            dat->kanji = getByteArrayString(data, pos);
+            dat->kana = getByteArrayString(data, pos);
+            dat->jlptn = 0;
+            words.push_back(dat);
 
             dat->examples.resize(getShort(data, pos));
             for (int ix = 0; ix != dat->examples.size(); ++ix)
@@ -166,7 +179,9 @@ void Sentences::load(const QString &filename)
             }
         }
 
-        ZKanji::commons.rebuild(true);
+        // The words are merged into the commons tree in the background while the rest of
+        // the file is read.
+        ZKanji::commons.startExamplesData(std::move(words));
 
         // Reading ids.
 
@@ -190,20 +205,15 @@ void Sentences::load(const QString &filename)
         if (f.pos() != ui)
             reset();
         else
+        {
             loaded = true;
-
-        ZKanji::wordexamples.rebuild();
+            ZKanji::wordexamples.rebuild();
+            ZKanji::commons.finishExamplesData();
+        }
     }
     catch (...)
     {
-        usedsize = 0;
-        blockpos.clear();
-        blocks.clear();
-        ids.clear();
-        creation = QDateTime();
-        ZKanji::commons.clearExamplesData();
-        ZKanji::wordexamples.reset();
-        f.close();
+        reset();
         QMessageBox::warning(nullptr, "zkanji", qApp->translate("", "The example sentences data file is corrupted."));
     }
 }
@@ -262,6 +272,8 @@ bool Sentences::isLoaded() const
 
 void Sentences::loadBlock(ushort index, ExampleBlock &block)
 {
+    PERFTRACE_SCOPE("Sentences::loadBlock");
+
     block.block = index;
     block.size = 0;
 
@@ -71,6 +71,10 @@ public:
 
     bool isLoaded() const;
 private:
+    // Closes the file and clears the loaded data, without touching the examples data of the
+    // words.
+    void clearData();
+
     void loadBlock(ushort index, ExampleBlock &block);
 
     // Helper function for loadBlock. Takes two bytes from arr at pos and returns them as a
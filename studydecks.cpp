@@ -12,6 +12,7 @@
 #include "zkanjimain.h"
 #include "zui.h"
 #include "studysettings.h"
+#include "perftrace.h"
 
 #include "checked_cast.h"
 
@@ -472,7 +473,7 @@ QDataStream& operator>>(QDataStream &stream, DeckDayStat &s)
 //-------------------------------------------------------------
 
 
-DeckDayStatList::DeckDayStatList()
+DeckDayStatList::DeckDayStatList() : validcnt(0)
 {
     ;
 }
@@ -480,6 +481,7 @@ DeckDayStatList::DeckDayStatList()
 void DeckDayStatList::load(QDataStream &stream)
 {
     stream >> make_zvec<qint32, DeckDayStat>(list);
+    invalidate(0);
 }
 
 void DeckDayStatList::save(QDataStream &stream) const
@@ -494,6 +496,7 @@ void DeckDayStatList::fixStats(const std::vector<std::tuple<StudyCard*, int, boo
 
     std::vector<DeckDayStat> tmp;
     std::swap(tmp, list);
+    invalidate(0);
 
     QSet<StudyCard*> added;
     int statpos = 0;
@@ -569,6 +572,7 @@ bool DeckDayStatList::empty() const
 
 DeckDayStat& DeckDayStatList::back()
 {
+    invalidate(tosigned(list.size()) - 1);
     return list.back();
 }
 
@@ -589,12 +593,14 @@ const DeckDayStat& DeckDayStatList::items(int index) const
 
 DeckDayStat& DeckDayStatList::items(int index)
 {
+    invalidate(index);
     return list[index];
 }
 
 void DeckDayStatList::clear()
 {
     list.clear();
+    invalidate(0);
 }
 
 void DeckDayStatList::createUndo(QDate testdate)
@@ -610,6 +616,7 @@ void DeckDayStatList::revertUndo()
         throw "Undo data not saved.";
 #endif
     list.back() = undo;
+    invalidate(tosigned(list.size()) - 1);
 }
 
 void DeckDayStatList::newCard(QDate testdate, bool newgroup)
@@ -636,6 +643,7 @@ void DeckDayStatList::cardDeleted(QDate testdate, bool grouplast, bool learned)
 void DeckDayStatList::cardTested(QDate testdate, int timespent, bool wrong, bool newcard, bool orilearned, bool newlearned)
 {
     addDay(testdate);
+    invalidate(tosigned(list.size()) - 1);
 
     DeckDayStat &stat = list.back();
     stat.timespent += timespent;
@@ -660,6 +668,52 @@ void DeckDayStatList::groupsMerged()
     --list.back().groupcount;
 }
 
+DeckDayTotals DeckDayStatList::totals() const
+{
+    if (list.empty())
+        return DeckDayTotals { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    validate();
+    return sums.back();
+}
+
+void DeckDayStatList::invalidate(int index)
+{
+    validcnt = std::max(0, std::min(validcnt, index));
+}
+
+void DeckDayStatList::validate() const
+{
+    int siz = tosigned(list.size());
+    if (validcnt == siz)
+        return;
+
+    sums.resize(siz);
+    for (int ix = validcnt; ix != siz; ++ix)
+    {
+        const DeckDayStat &stat = list[ix];
+        DeckDayTotals &t = sums[ix];
+        if (ix == 0)
+            t = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        else
+            t = sums[ix - 1];
+
+        t.timespent += stat.timespent;
+        t.testcount += stat.testcount;
+        t.testednew += stat.testednew;
+        t.testwrong += stat.testwrong;
+        t.testlearned += stat.testlearned;
+        if (stat.testcount != 0)
+            ++t.testdays;
+        if (stat.timespent != 0)
+        {
+            ++t.studydays;
+            t.studytests += stat.testcount;
+        }
+    }
+    validcnt = siz;
+}
+
 void DeckDayStatList::addDay(QDate testdate)
 {
 #ifdef _DEBUG
@@ -776,7 +830,7 @@ size_t StudyDeckIdHash::operator()(const StudyDeckId &id) const
 
 StudyDeck::StudyDeck(StudyDeckList *owner, StudyDeckId id) : owner(owner), id(id)
 {
-
+    undodata.card = nullptr;
 }
 
 StudyDeck::~StudyDeck()
@@ -822,6 +876,8 @@ void StudyDeck::load(QDataStream &stream)
     }
 
     stream >> make_zvec<qint32, qint32>(testcards);
+
+    countLevels();
 }
 
 void StudyDeck::save(QDataStream &stream) const
@@ -886,6 +942,8 @@ void StudyDeck::copy(StudyDeck *src, std::map<CardId*, CardId*> &map)
                 c->next = list[csrc->next->index];
         }
     }
+
+    levelcounts = src->levelcounts;
 }
 
 const DeckDayStatList& StudyDeck::dayStats() const
@@ -1110,6 +1168,7 @@ CardId* StudyDeck::createCard(CardId *cardid_group, intptr_t data)
     //else
     //    card->id = CardId(list.back()->id.data + 1);
     card->index = tosigned(list.size()); // id.reset(new CardId(list.size()));
+    countCardLevel(card, 1);
 
     if (group != nullptr)
     {
@@ -1158,6 +1217,7 @@ CardId* StudyDeck::deleteCard(CardId *cardid)
 
     if (card->level >= 3)
         ZKanji::profile().removeMultiplier(card->multiplier);
+    countCardLevel(card, -1);
 
     if (rindex > cardix)
         --rindex;
@@ -1210,6 +1270,7 @@ void StudyDeck::deleteCardGroup(CardId *cardid)
         //owner->changeAnswerRatio(-card->answercnt, -card->wrongcnt);
         if (card->level >= 3)
             ZKanji::profile().removeMultiplier(card->multiplier);
+        countCardLevel(card, -1);
 
         daystats.cardDeleted(ltDay(QDateTime::currentDateTimeUtc()), card->next == first, card->learned);
 
@@ -1306,6 +1367,11 @@ const DeckDayStat& StudyDeck::dayStat(int index) const
     return daystats.items(index);
 }
 
+const std::vector<int>& StudyDeck::levelCounts() const
+{
+    return levelcounts;
+}
+
 
 //int StudyDeck::cardCount()
 //{
@@ -1456,7 +1522,9 @@ void StudyDeck::increaseSpacingLevel(CardId *cardid)
     quint32 spacing = card->spacing * card->multiplier;
     fixCardSpacing(card, card->testdate, card->level + 1, spacing);
     card->spacing = spacing;
+    countCardLevel(card, -1);
     ++card->level;
+    countCardLevel(card, 1);
     card->nexttestdate = QDateTime();
 
     if (card->level >= 3)
@@ -1478,7 +1546,9 @@ void StudyDeck::decreaseSpacingLevel(CardId *cardid)
     quint32 spacing = std::max<quint32>(card->spacing / card->multiplier, 24 * 60 * 60);
     fixCardSpacing(card, card->testdate, card->level - 1, spacing);
     card->spacing = spacing;
+    countCardLevel(card, -1);
     --card->level;
+    countCardLevel(card, 1);
     card->nexttestdate = QDateTime();
 
     if (card->level >= 3)
@@ -1503,7 +1573,9 @@ void StudyDeck::resetCardStudyData(CardId *cardid)
     memset(card->answers, 0, sizeof(uchar) * 4);
     card->spacing = 0;
     card->repeats = 0;
+    countCardLevel(card, -1);
     card->level = 0;
+    countCardLevel(card, 1);
     card->multiplier = ZKanji::profile().baseMultiplier();
     card->testlevel = 0;
     card->timespent = 0;
@@ -1549,11 +1621,12 @@ quint32 StudyDeck::newCardEta() const
     return timestats.estimate(0, 0);
 }
 
-bool StudyDeck::startTestDay()
+bool StudyDeck::startTestDay(QDateTime now)
 {
     // TODO: don't allow testing if the dates are invalid compared to past statistics.
 
-    QDateTime now = QDateTime::currentDateTimeUtc();
+    if (!now.isValid())
+        now = QDateTime::currentDateTimeUtc();
     QDate testday = ltDay(now);
     if (testdate.isValid() && ltDay(testdate).daysTo(testday) <= 0)
         return false;
@@ -1613,8 +1686,11 @@ CardId* StudyDeck::testCard(int index) const
     return const_cast<CardId*>(ids[testcards[index]]);
 }
 
-quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answertime, /*bool &postponed,*/ bool simulate)
+quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answertime, /*bool &postponed,*/ bool simulate, QDateTime now)
 {
+    if (!now.isValid())
+        now = QDateTime::currentDateTimeUtc();
+
     if (simulate && (a == StudyCard::Wrong || a == StudyCard::Retry))
         throw "Don't simulate in case of negative answer.";
 
@@ -1642,11 +1718,11 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
 
         // The card's testlevel is set above, which is the only data that must be changed
         // before saving the card as undo data.
-        createUndo(card, a, answertime);
+        createUndo(card, a, answertime, now);
 
         card->answers[(int)a] = std::min(255, card->answers[(int)a] + 1);
 
-        card->itemdate = QDateTime::currentDateTimeUtc();
+        card->itemdate = now;
 
         timestats.addTime(card->testlevel, card->repeats, answertime / 100);
         if (a == StudyCard::Easy || a == StudyCard::Correct)
@@ -1701,7 +1777,9 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
         {
             card->testdate = testdate;
             //card->inclusion = 1;
+            countCardLevel(card, -1);
             card->level = 1;
+            countCardLevel(card, 1);
             card->spacing = cardspacing;
             card->multiplier = cardmulti;
             card->nexttestdate = QDateTime();
@@ -1789,7 +1867,9 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
             card->spacing = cardspacing;
             card->multiplier = cardmulti;
             card->nexttestdate = QDateTime();
+            countCardLevel(card, -1);
             card->level = cardlevel;
+            countCardLevel(card, 1);
 
             if (card->level >= 3)
                 ZKanji::profile().addMultiplier(cardmulti);
@@ -1864,6 +1944,7 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
 
     card->learned = false;
     card->testdate = testdate;
+    countCardLevel(card, -1);
     if (a == StudyCard::Retry)
     {
         card->spacing /= card->multiplier;
@@ -1900,6 +1981,7 @@ quint32 StudyDeck::answer(CardId *cardid, StudyCard::AnswerType a, qint64 answer
         card->level = 1;
         card->spacing = s_1_day;
     }
+    countCardLevel(card, 1);
 
     fixCardSpacing(card, testdate, card->level, card->spacing);
 
@@ -1935,7 +2017,12 @@ StudyCard::AnswerType StudyDeck::lastAnswer() const
 void StudyDeck::changeLastAnswer(StudyCard::AnswerType a)
 {
     revertUndo();
-    answer(ids[undodata.card->index] /*d.get()*/, a, undodata.answertime);
+    answer(ids[undodata.card->index] /*d.get()*/, a, undodata.answertime, false, undodata.answerdate);
+}
+
+bool StudyDeck::canChangeLastAnswer() const
+{
+    return undodata.card != nullptr;
 }
 
 const CardId* StudyDeck::lastCard() const
@@ -1943,6 +2030,11 @@ const CardId* StudyDeck::lastCard() const
     return ids[undodata.card->index]; /*d.get()*/;
 }
 
+void StudyDeck::clearUndo()
+{
+    undodata.card = nullptr;
+}
+
 const StudyCard* StudyDeck::fromId(const CardId *cardid) const
 {
     int ix = posFromId(cardid);
@@ -1981,7 +2073,7 @@ int StudyDeck::posFromId(const CardId *cardid) const
     //return ix;
 }
 
-void StudyDeck::createUndo(StudyCard *card, StudyCard::AnswerType a, qint64 answertime)
+void StudyDeck::createUndo(StudyCard *card, StudyCard::AnswerType a, qint64 answertime, const QDateTime &answerdate)
 {
     ZKanji::profile().createUndo();
 
@@ -1991,6 +2083,7 @@ void StudyDeck::createUndo(StudyCard *card, StudyCard::AnswerType a, qint64 answ
     undodata.card = card;
     undodata.cardundo = *card;
     undodata.answertime = answertime;
+    undodata.answerdate = answerdate;
     undodata.lastanswer = a;
 }
 
@@ -2001,7 +2094,9 @@ void StudyDeck::revertUndo()
     timestats.revertUndo(undodata.card->testlevel);
     daystats.revertUndo();
 
+    countCardLevel(undodata.card, -1);
     *undodata.card = undodata.cardundo;
+    countCardLevel(undodata.card, 1);
 }
 
 void StudyDeck::updateCardStat(StudyCard *card, /*StudyCard::AnswerType a,*/ int time)
@@ -2016,6 +2111,20 @@ void StudyDeck::updateCardStat(StudyCard *card, /*StudyCard::AnswerType a,*/ int
     cardstat.timespent = std::min<ushort>(65535, cardstat.timespent + time);
 }
 
+void StudyDeck::countCardLevel(const StudyCard *card, int diff)
+{
+    if (tosigned(levelcounts.size()) <= card->level)
+        levelcounts.resize(card->level + 1, 0);
+    levelcounts[card->level] += diff;
+}
+
+void StudyDeck::countLevels()
+{
+    levelcounts.clear();
+    for (const StudyCard *card : list)
+        countCardLevel(card, 1);
+}
+
 void StudyDeck::fixCardSpacing(const StudyCard *card, QDateTime cardtestdate, uchar cardlevel, quint32 &cardspacing) const
 {
     if (card->next == card || card->next == nullptr)
@@ -2293,6 +2402,8 @@ StudentProfile::StudentProfile() : mod(false), cardcount(0), multiaverage(2.5) /
 
 void StudentProfile::load(const QString &filename)
 {
+    PERFTRACE_SCOPE("StudentProfile::load");
+
     QFile f(filename);
 
     if (!f.open(QIODevice::ReadOnly))
@@ -275,6 +275,23 @@ struct DeckDayStat // - ex TDayStat
 QDataStream& operator<<(QDataStream &stream, const DeckDayStat &s);
 QDataStream& operator>>(QDataStream &stream, DeckDayStat &s);
 
+// Sums of the statistics of consecutive days in a DeckDayStatList.
+struct DeckDayTotals
+{
+    // Length of the tests in tenth seconds.
+    int timespent;
+    int testcount;
+    int testednew;
+    int testwrong;
+    int testlearned;
+    // Number of days when at least one item was tested.
+    int testdays;
+    // Number of days with time spent on the test.
+    int studydays;
+    // Count of items tested on the days with time spent on the test.
+    int studytests;
+};
+
 class DeckDayStatList  // -ex TDayStatList
 {
 public:
@@ -318,7 +335,15 @@ public:
     // Decrements the group count of the last test day. Does not create an extra empty day
     // stat for today if it doesn't exist.
     void groupsMerged();
+
+    // Returns the sums of the statistics of every day.
+    DeckDayTotals totals() const;
 private:
+    // Marks the running totals invalid from the day at index.
+    void invalidate(int index);
+    // Computes the running totals of the days that changed.
+    void validate() const;
+
     // Creates statistics for the day of testdate. The date must match or come later than the
     // last existing date. If the dates match the function returns leaving the list unchanged,
     // otherwise every item that doesn't refer to today's test is copied.
@@ -328,6 +353,12 @@ private:
     DeckDayStat undo;
 
     std::vector<DeckDayStat> list;
+
+    // [day index] Sums of the statistics of every day up to and including each day. Only
+    // the first validcnt items are up to date. Days can only change at the end of the list
+    // during tests, so the totals are only updated for the last day.
+    mutable std::vector<DeckDayTotals> sums;
+    mutable int validcnt;
 };
 
 class StudyDeck;
@@ -448,6 +479,10 @@ public:
     // Returns a day statistic for the given index. 
     const DeckDayStat& dayStat(int index) const;
 
+    // Number of cards at each level in the deck, with the level as the index. The list is
+    // at least one longer than the highest level of any card.
+    const std::vector<int>& levelCounts() const;
+
     // Number of study cards stored in the deck.
     //int cardCount();
 
@@ -517,7 +552,8 @@ public:
     // Must be called when the test starts for the day. It's not an error to call this
     // repeatedly in the same day but it only has an effect the first time.
     // Returns whether a new test day was started, and not just testing again on the same day.
-    bool startTestDay();
+    // The test day is started at the time in now, or at the current time if it's invalid.
+    bool startTestDay(QDateTime now = QDateTime());
 
     // Returns the number of days passed since the last time new items have been included.
     // Returns -1 if the statistics don't have a day when items were included.
@@ -544,7 +580,8 @@ public:
     // -1. Its value is ignored when simulating.
     // When simulating and the answer was wrong, the returned value should be ignored and only
     // the new value of postponed should be used.
-    quint32 answer(CardId *cardid, StudyCard::AnswerType a, qint64 answertime, /*bool &postponed,*/ bool simulate = false);
+    // The answer is registered at the time in now, or at the current time if it's invalid.
+    quint32 answer(CardId *cardid, StudyCard::AnswerType a, qint64 answertime, /*bool &postponed,*/ bool simulate = false, QDateTime now = QDateTime());
 
     // Returns the answer passed to answer() the last time it was called during the current
     // running test. Only valid when a test is running and answer() was called at least once
@@ -556,8 +593,16 @@ public:
     // session. (Suspended tests lose the needed data.)
     void changeLastAnswer(StudyCard::AnswerType a);
 
+    // Returns whether answer() was called in the current session, and its result can be
+    // changed with changeLastAnswer().
+    bool canChangeLastAnswer() const;
+
     // Returns the id of the card last answered.
     const CardId* lastCard() const;
+
+    // Forgets the data saved for changeLastAnswer(), as if no answer was given in the
+    // current session.
+    void clearUndo();
 private:
     // Returns the card by its id. Passing an invalid id results in undefined behavior.
     const StudyCard* fromId(const CardId *cardid) const;
@@ -569,7 +614,7 @@ private:
 
     // Saves everything about the last item so its data can be changed. The data saved is only
     // usable in the same study session. It becomes invalid on suspend or when the test ends.
-    void createUndo(StudyCard *card, StudyCard::AnswerType a, qint64 answertime);
+    void createUndo(StudyCard *card, StudyCard::AnswerType a, qint64 answertime, const QDateTime &answerdate);
 
     // Reverts the data saved with createUndo(). Only valid during a study session
     // and not for the first item in the session.
@@ -587,6 +632,12 @@ private:
     // be tested on the day.
     void fixCardSpacing(const StudyCard *card, QDateTime cardtestdate, uchar cardlevel, quint32 &cardspacing) const;
 
+    // Adds diff to the number of cards at the level of card. Call with -1 before changing
+    // the level of a card, and with 1 after it.
+    void countCardLevel(const StudyCard *card, int diff);
+    // Counts the cards at each level from scratch.
+    void countLevels();
+
     // Temporary container of undo data.
     struct Undo
     {
@@ -596,6 +647,8 @@ private:
         StudyCard cardundo;
 
         qint64 answertime;
+        // Time when the answer was given.
+        QDateTime answerdate;
 
         StudyCard::AnswerType lastanswer;
     };
@@ -627,6 +680,9 @@ private:
     DeckTimeStatList timestats; 
     DeckDayStatList daystats;
 
+    // Number of cards at each level. Updated every time the level of a card changes.
+    std::vector<int> levelcounts;
+
 };
 
 // Only a single student object should exist while the program is running.
@@ -96,6 +96,7 @@ void DeckDayStatList::loadLegacy(QDataStream &stream, int /*version*/)
 
         list.push_back(item);
     }
+    invalidate(0);
 }
 
 void StudyDeck::loadLegacy(QDataStream &stream, int version)
@@ -245,6 +246,8 @@ void StudyDeck::loadLegacy(QDataStream &stream, int version)
 
     timestats.loadLegacy(stream, version);
     daystats.loadLegacy(stream, version);
+
+    countLevels();
 }
 
 void StudyDeckList::loadDecksLegacy(QDataStream &stream, int version)
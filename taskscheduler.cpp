@@ -0,0 +1,243 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <QThreadPool>
+#include <QSemaphore>
+#include <QMutexLocker>
+#include "taskscheduler.h"
+
+
+//-------------------------------------------------------------
+
+
+CancelToken::CancelToken()
+{
+    flag = false;
+}
+
+void CancelToken::cancel()
+{
+    flag = true;
+}
+
+void CancelToken::reset()
+{
+    flag = false;
+}
+
+bool CancelToken::cancelled() const
+{
+    return flag;
+}
+
+
+//-------------------------------------------------------------
+
+
+TaskProgress::TaskProgress()
+{
+    tot = 0;
+    cnt = 0;
+}
+
+void TaskProgress::reset(int total)
+{
+    tot = total;
+    cnt = 0;
+}
+
+void TaskProgress::advance(int num)
+{
+    cnt += num;
+}
+
+int TaskProgress::total() const
+{
+    return tot;
+}
+
+int TaskProgress::processed() const
+{
+    return cnt;
+}
+
+int TaskProgress::percent() const
+{
+    int t = tot;
+    if (t <= 0)
+        return 0;
+    return std::min<int>(100, qint64(cnt) * 100 / t);
+}
+
+
+//-------------------------------------------------------------
+
+
+BackgroundTask::BackgroundTask() : base(), running(false)
+{
+    finished = false;
+    setAutoDelete(false);
+}
+
+BackgroundTask::~BackgroundTask()
+{
+    // The derived object is already destroyed at this point, so it's too late to stop a
+    // running task here. Owners must call cancel() and wait() before deleting the task.
+}
+
+void BackgroundTask::start()
+{
+    {
+        QMutexLocker locker(&mutex);
+        if (running)
+            return;
+        running = true;
+    }
+
+    finished = false;
+    canceltoken.reset();
+    QThreadPool::globalInstance()->start(this);
+}
+
+void BackgroundTask::cancel()
+{
+    canceltoken.cancel();
+}
+
+void BackgroundTask::wait()
+{
+    QMutexLocker locker(&mutex);
+    while (running)
+        stopped.wait(&mutex);
+}
+
+bool BackgroundTask::isRunning() const
+{
+    QMutexLocker locker(&mutex);
+    return running;
+}
+
+bool BackgroundTask::isFinished() const
+{
+    return finished;
+}
+
+bool BackgroundTask::isCancelled() const
+{
+    return canceltoken.cancelled();
+}
+
+const CancelToken& BackgroundTask::token() const
+{
+    return canceltoken;
+}
+
+void BackgroundTask::run()
+{
+    bool result = execute();
+    finished = result && !canceltoken.cancelled();
+
+    QMutexLocker locker(&mutex);
+    running = false;
+    stopped.wakeAll();
+}
+
+
+//-------------------------------------------------------------
+
+
+namespace
+{
+    // Shared state of the threads working on the same parallelFor() call.
+    struct ParallelForData
+    {
+        ParallelForData(int begin, int end, int chunk, const std::function<void(int, int)> &func, const CancelToken *token, TaskProgress *progress) :
+            begin(begin), end(end), chunk(chunk), func(func), token(token), progress(progress)
+        {
+            next = 0;
+        }
+
+        // Processes intervals until none is left or the task is cancelled.
+        void work()
+        {
+            int chunkcnt = (end - begin + chunk - 1) / chunk;
+            int ix;
+            while ((token == nullptr || !token->cancelled()) && (ix = next.fetch_add(1)) < chunkcnt)
+            {
+                int first = begin + ix * chunk;
+                int last = std::min(end, first + chunk);
+                func(first, last);
+                if (progress != nullptr)
+                    progress->advance(last - first);
+            }
+        }
+
+        const int begin;
+        const int end;
+        const int chunk;
+        const std::function<void(int, int)> &func;
+        const CancelToken *token;
+        TaskProgress *progress;
+
+        // Index of the next interval to be processed.
+        std::atomic_int next;
+
+        // Released by each helper thread when it has no more work.
+        QSemaphore helpersdone;
+    };
+
+    class ParallelForHelper : public QRunnable
+    {
+    public:
+        ParallelForHelper(ParallelForData &data) : data(data) { setAutoDelete(true); }
+        virtual void run() override
+        {
+            data.work();
+            data.helpersdone.release();
+        }
+    private:
+        ParallelForData &data;
+    };
+}
+
+int parallelThreadCount()
+{
+    return std::max(1, QThreadPool::globalInstance()->maxThreadCount());
+}
+
+bool parallelFor(int begin, int end, int chunk, const std::function<void(int, int)> &func, const CancelToken *token, TaskProgress *progress)
+{
+    if (end <= begin)
+        return token == nullptr || !token->cancelled();
+
+    chunk = std::max(1, chunk);
+    ParallelForData data(begin, end, chunk, func, token, progress);
+
+    // Helpers are only started on idle threads of the pool. Waiting for queued helpers could
+    // dead-lock when the calling thread itself belongs to a full pool. The calling thread
+    // processes all intervals if no thread is free.
+    int chunkcnt = (end - begin + chunk - 1) / chunk;
+    int helpers = 0;
+    for (int ix = 0, siz = std::min(chunkcnt, parallelThreadCount()) - 1; ix < siz; ++ix)
+    {
+        ParallelForHelper *h = new ParallelForHelper(data);
+        if (!QThreadPool::globalInstance()->tryStart(h))
+        {
+            delete h;
+            break;
+        }
+        ++helpers;
+    }
+
+    data.work();
+    data.helpersdone.acquire(helpers);
+
+    return token == nullptr || !token->cancelled();
+}
+
+
+//-------------------------------------------------------------
+
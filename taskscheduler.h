@@ -0,0 +1,187 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "zkanjimain.h"
+
+// Flag polled by long running calculations to find out whether they should be abandoned.
+// Can be set from any thread.
+class CancelToken
+{
+public:
+    CancelToken();
+
+    // Asks every task using this token to stop as soon as possible.
+    void cancel();
+    // Clears the flag so the token can be used for a new task.
+    void reset();
+    bool cancelled() const;
+private:
+    CancelToken(const CancelToken&) = delete;
+    CancelToken& operator=(const CancelToken&) = delete;
+
+    std::atomic_bool flag;
+};
+
+// Counter of the processed work items of a running task. The task advances it from any of its
+// threads, and it can be read at the same time, for example to update a progress bar.
+class TaskProgress
+{
+public:
+    TaskProgress();
+
+    // Sets the number of items to process and clears the processed count.
+    void reset(int total);
+    // Adds cnt to the number of processed items.
+    void advance(int cnt);
+
+    int total() const;
+    int processed() const;
+    // Returns the processed items in percent of the total, between 0 and 100.
+    int percent() const;
+private:
+    TaskProgress(const TaskProgress&) = delete;
+    TaskProgress& operator=(const TaskProgress&) = delete;
+
+    std::atomic_int tot;
+    std::atomic_int cnt;
+};
+
+// Base class of calculations running in the global thread pool that are started and
+// possibly abandoned by the main thread. Derived classes implement execute() and should check
+// isCancelled() regularly, or pass token() to the parallel functions below.
+// The task must not be destroyed while it's running. Call cancel() and wait() first.
+class BackgroundTask : protected QRunnable
+{
+public:
+    BackgroundTask();
+    virtual ~BackgroundTask();
+
+    // Queues the task in the global thread pool. Does nothing if the task is running.
+    void start();
+    // Asks the running task to stop. Returns immediately. Use wait() to make sure the task
+    // has stopped.
+    void cancel();
+    // Blocks the calling thread until the task has stopped running. Returns immediately if
+    // the task is not running.
+    void wait();
+
+    // The task was started and hasn't stopped yet.
+    bool isRunning() const;
+    // The task has finished its calculation without being cancelled.
+    bool isFinished() const;
+    bool isCancelled() const;
+protected:
+    // Runs the calculation. Return false if the calculation was abandoned.
+    virtual bool execute() = 0;
+
+    const CancelToken& token() const;
+private:
+    virtual void run() override;
+
+    CancelToken canceltoken;
+
+    mutable QMutex mutex;
+    QWaitCondition stopped;
+    bool running;
+    std::atomic_bool finished;
+
+    typedef QRunnable   base;
+};
+
+// Returns the number of threads the parallel functions can run on, counting the calling
+// thread.
+int parallelThreadCount();
+
+// Calls func(first, last) for consecutive [first, last) intervals of at most chunk items,
+// covering [begin, end). The intervals are processed by the calling thread and idle threads
+// of the global thread pool. Each thread takes the next unprocessed interval when it's done
+// with its previous one, so no thread waits for another while there is work left.
+// Returns after every interval was processed, or after the token was cancelled. Returns
+// false in the latter case.
+// The progress, if specified, is advanced by the size of every processed interval.
+bool parallelFor(int begin, int end, int chunk, const std::function<void(int, int)> &func, const CancelToken *token = nullptr, TaskProgress *progress = nullptr);
+
+// Calls map(first, last) for the intervals of [begin, end) as parallelFor(), which returns a
+// partial result for the interval. The partial results are combined with reduce(a, b) in the
+// order of their intervals, starting with init. The result is undefined if the token was
+// cancelled.
+template<typename T, typename Map, typename Reduce>
+T parallelReduce(int begin, int end, int chunk, T init, Map map, Reduce reduce, const CancelToken *token = nullptr, TaskProgress *progress = nullptr)
+{
+    if (end <= begin)
+        return init;
+
+    chunk = std::max(1, chunk);
+    int cnt = (end - begin + chunk - 1) / chunk;
+    // Not a vector, because each part is written by a different thread, and the items of
+    // std::vector<bool> are not separate objects.
+    std::unique_ptr<T[]> parts(new T[cnt]);
+    if (!parallelFor(begin, end, chunk, [&parts, &map, begin, chunk](int first, int last) {
+        parts[(first - begin) / chunk] = map(first, last);
+    }, token, progress))
+        return init;
+
+    for (int ix = 0; ix != cnt; ++ix)
+        init = reduce(init, parts[ix]);
+    return init;
+}
+
+// Sorts [begin, end) with the cmp function on several threads. The items are sorted in
+// separate parts first, and the parts are merged in rounds. Returns false if the token was
+// cancelled, leaving the items in an undefined order.
+template<typename Iter, typename Comp>
+bool parallelSort(Iter begin, Iter end, Comp cmp, const CancelToken *token = nullptr)
+{
+    int siz = tosigned(std::distance(begin, end));
+    if (siz < 2)
+        return true;
+
+    // Parts smaller than this are not worth sorting on another thread.
+    const int minpart = 4096;
+
+    int parts = std::max(1, std::min(parallelThreadCount() * 2, siz / minpart));
+    int partsize = (siz + parts - 1) / parts;
+
+    if (!parallelFor(0, siz, partsize, [&begin, &cmp, token](int first, int last) {
+        interruptSort(std::next(begin, first), std::next(begin, last), [&cmp, token](const typename std::iterator_traits<Iter>::value_type &a, const typename std::iterator_traits<Iter>::value_type &b, bool &stop) {
+            stop = token != nullptr && token->cancelled();
+            return !stop && cmp(a, b);
+        });
+    }, token, nullptr))
+        return false;
+
+    // Merge neighboring sorted parts until a single one remains.
+    for (; partsize < siz; partsize *= 2)
+    {
+        int pairs = (siz + partsize * 2 - 1) / (partsize * 2);
+        if (!parallelFor(0, pairs, 1, [&begin, &cmp, siz, partsize](int first, int last) {
+            for (int ix = first; ix != last; ++ix)
+            {
+                int mid = std::min(siz, ix * partsize * 2 + partsize);
+                int hi = std::min(siz, ix * partsize * 2 + partsize * 2);
+                std::inplace_merge(std::next(begin, ix * partsize * 2), std::next(begin, mid), std::next(begin, hi), cmp);
+            }
+        }, token, nullptr))
+            return false;
+    }
+
+    return token == nullptr || !token->cancelled();
+}
+
+
+#endif // TASKSCHEDULER_H
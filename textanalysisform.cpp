@@ -0,0 +1,286 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <QPushButton>
+#include <QUrl>
+#include <map>
+#include "textanalysisform.h"
+#include "ui_textanalysisform.h"
+#include "zdictionarymodel.h"
+#include "zdictionarylistview.h"
+#include "words.h"
+#include "furigana.h"
+#include "globalui.h"
+#include "zkanjimain.h"
+#include "zui.h"
+#include "fontsettings.h"
+#include "dialogs.h"
+
+#include "checked_cast.h"
+
+
+//-------------------------------------------------------------
+
+
+TextAnalysisForm::TextAnalysisForm(QWidget *parent) : base(parent), ui(new Ui::TextAnalysisForm), dict(nullptr), wmodel(nullptr)
+{
+    ui->setupUi(this);
+    setAttribute(Qt::WA_DeleteOnClose);
+
+    gUI->scaleWidget(this);
+
+    ui->splitter->setStretchFactor(0, 2);
+    ui->splitter->setStretchFactor(1, 3);
+    ui->splitter->setStretchFactor(2, 4);
+
+    ui->dictWidget->setListMode(DictionaryWidget::Filtered);
+    ui->dictWidget->setExamplesVisible(false);
+    ui->dictWidget->setMultilineVisible(false);
+    ui->dictWidget->setSelectionType(ListSelectionType::Extended);
+    ui->dictWidget->showStatusBar();
+
+    settingsChanged();
+
+    connect(ui->readingText, &QTextBrowser::anchorClicked, this, &TextAnalysisForm::readingLinkClicked);
+    connect(ui->closeButton, &QPushButton::clicked, this, &TextAnalysisForm::close);
+
+    connect(gUI, &GlobalUI::settingsChanged, this, &TextAnalysisForm::settingsChanged);
+    connect(gUI, &GlobalUI::dictionaryToBeRemoved, this, &TextAnalysisForm::dictionaryToBeRemoved);
+    connect(gUI, &GlobalUI::dictionaryReplaced, this, &TextAnalysisForm::dictionaryReplaced);
+}
+
+TextAnalysisForm::~TextAnalysisForm()
+{
+    delete ui;
+}
+
+void TextAnalysisForm::exec(Dictionary *d, const QString &str)
+{
+    ui->dictCBox->setCurrentIndex(ZKanji::dictionaryOrder(ZKanji::dictionaryIndex(d)));
+    // Setting the index of the combo box only changes the dictionary if it's not the first.
+    if (dict == nullptr)
+        on_dictCBox_currentIndexChanged(ui->dictCBox->currentIndex());
+
+    translateTexts();
+
+    if (!str.isEmpty())
+    {
+        ui->textEdit->setPlainText(str);
+        analyze();
+    }
+
+    show();
+}
+
+bool TextAnalysisForm::event(QEvent *e)
+{
+    if (e->type() == QEvent::LanguageChange)
+        translateTexts();
+
+    return base::event(e);
+}
+
+void TextAnalysisForm::on_analyzeButton_clicked()
+{
+    analyze();
+}
+
+void TextAnalysisForm::on_dictCBox_currentIndexChanged(int index)
+{
+    Dictionary *d = ZKanji::dictionary(ZKanji::dictionaryPosition(index));
+    if (dict == d)
+        return;
+
+    if (dict != nullptr)
+        disconnect(dict, nullptr, this, nullptr);
+    dict = d;
+    if (dict != nullptr)
+    {
+        connect(dict, &Dictionary::dictionaryReset, this, &TextAnalysisForm::dictionaryChanged);
+        connect(dict, &Dictionary::entryAdded, this, &TextAnalysisForm::dictionaryChanged);
+        connect(dict, &Dictionary::entryRemoved, this, &TextAnalysisForm::dictionaryChanged);
+        connect(dict, &Dictionary::entryChanged, this, &TextAnalysisForm::dictionaryChanged);
+    }
+
+    segmenter.setDictionary(dict);
+    ui->dictWidget->setDictionary(dict);
+
+    if (!text.isEmpty())
+        analyze();
+    else
+    {
+        if (wmodel != nullptr)
+            wmodel->deleteLater();
+        wmodel = new DictionaryWordListItemModel(this);
+        wmodel->setWordList(dict, std::vector<int>());
+        ui->dictWidget->setModel(wmodel);
+    }
+}
+
+void TextAnalysisForm::readingLinkClicked(const QUrl &url)
+{
+    bool ok;
+    int row = url.toString().toInt(&ok);
+    if (!ok || wmodel == nullptr || row < 0 || row >= wmodel->rowCount())
+        return;
+
+    ui->dictWidget->view()->setCurrentRow(row);
+    ui->dictWidget->view()->scrollToRow(row);
+}
+
+void TextAnalysisForm::settingsChanged()
+{
+    ui->textEdit->setFont(Settings::kanaFont());
+    ui->readingText->setFont(Settings::kanaFont());
+    updateReadingText();
+}
+
+void TextAnalysisForm::dictionaryChanged()
+{
+    // Word indexes in the segments are invalid after the dictionary changed, and the listed
+    // definitions can be out of date.
+    segmenter.reset();
+    if (!text.isEmpty())
+        analyze();
+}
+
+void TextAnalysisForm::dictionaryToBeRemoved(int /*index*/, int orderindex, Dictionary *d)
+{
+    if (dict == d)
+        ui->dictCBox->setCurrentIndex(orderindex == 0 ? 1 : 0);
+}
+
+void TextAnalysisForm::dictionaryReplaced(Dictionary *old, Dictionary * /*newdict*/, int /*index*/)
+{
+    if (dict == old)
+        close();
+}
+
+void TextAnalysisForm::analyze()
+{
+    text = ui->textEdit->toPlainText();
+    segmenter.segment(text, segments);
+
+    // Each word is listed once, at the position of its first appearance in the text.
+    std::vector<int> words;
+    std::map<int, int> wordrows;
+    rows.resize(segments.size());
+    for (int ix = 0, siz = tosigned(segments.size()); ix != siz; ++ix)
+    {
+        int windex = segments[ix].windex;
+        if (windex == -1)
+        {
+            rows[ix] = -1;
+            continue;
+        }
+
+        auto it = wordrows.find(windex);
+        if (it == wordrows.end())
+        {
+            it = wordrows.insert(std::make_pair(windex, tosigned(words.size()))).first;
+            words.push_back(windex);
+        }
+        rows[ix] = it->second;
+    }
+
+    if (wmodel != nullptr)
+        wmodel->deleteLater();
+    wmodel = new DictionaryWordListItemModel(this);
+    wmodel->setWordList(dict, std::move(words));
+    ui->dictWidget->setModel(wmodel);
+
+    ui->countLabel->setText(tr("Words found: %1").arg(wmodel->rowCount()));
+
+    updateReadingText();
+}
+
+void TextAnalysisForm::updateReadingText()
+{
+    if (dict == nullptr || segments.empty())
+    {
+        ui->readingText->clear();
+        return;
+    }
+
+    // The reading of every kanji part of a word is shown after it in a smaller font. The
+    // readings of the word's dictionary form are valid for the text until the first
+    // character that was changed by inflections.
+
+    QString linkstyle = QString("text-decoration: none; color: %1").arg(ui->readingText->palette().color(QPalette::Text).name());
+    QString readingstyle = QString("font-size: small; color: %1").arg(ui->readingText->palette().color(QPalette::Disabled, QPalette::Text).name());
+
+    auto addText = [](QString &html, const QString &str) {
+        html += str.toHtmlEscaped().replace(QChar('\n'), QStringLiteral("<br>"));
+    };
+
+    QString html;
+    std::vector<FuriganaData> furi;
+    for (int ix = 0, siz = tosigned(segments.size()); ix != siz; ++ix)
+    {
+        const TextSegment &s = segments[ix];
+        QString str = text.mid(s.pos, s.length);
+        if (s.windex == -1)
+        {
+            addText(html, str);
+            continue;
+        }
+
+        html += QString("<a href=\"%1\" style=\"%2\">").arg(rows[ix]).arg(linkstyle);
+
+        const WordEntry *e = dict->wordEntry(s.windex);
+        if (s.kana || qcharcmp(e->kanji.data(), e->kana.data()) == 0)
+        {
+            addText(html, str);
+            html += "</a>";
+            continue;
+        }
+
+        int same = 0;
+        while (same != str.size() && e->kanji.data()[same] == str.at(same))
+            ++same;
+
+        dict->wordFurigana(s.windex, furi);
+
+        int pos = 0;
+        for (const FuriganaData &f : furi)
+        {
+            if (f.kanji.pos + f.kanji.len > same)
+                break;
+            addText(html, str.mid(pos, f.kanji.pos - pos));
+            addText(html, str.mid(f.kanji.pos, f.kanji.len));
+            html += QString("<span style=\"%1\">(").arg(readingstyle);
+            addText(html, e->kana.toQString(f.kana.pos, f.kana.len));
+            html += ")</span>";
+            pos = f.kanji.pos + f.kanji.len;
+        }
+        addText(html, str.mid(pos));
+
+        html += "</a>";
+    }
+
+    ui->readingText->setHtml(html);
+}
+
+void TextAnalysisForm::translateTexts()
+{
+    ui->retranslateUi(this);
+    if (wmodel != nullptr && !text.isEmpty())
+        ui->countLabel->setText(tr("Words found: %1").arg(wmodel->rowCount()));
+}
+
+
+//-------------------------------------------------------------
+
+
+void analyzeText(Dictionary *d, const QString &text)
+{
+    TextAnalysisForm *f = new TextAnalysisForm((QWidget*)gUI->activeMainForm());
+    f->exec(d, text);
+}
+
+
+//-------------------------------------------------------------
+
@@ -0,0 +1,72 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef TEXTANALYSISFORM_H
+#define TEXTANALYSISFORM_H
+
+#include <vector>
+#include "dialogwindow.h"
+#include "textsegmenter.h"
+
+namespace Ui {
+    class TextAnalysisForm;
+}
+
+class Dictionary;
+class DictionaryWordListItemModel;
+class QUrl;
+
+// Window for reading Japanese text. The text entered by the user is split into the words
+// of the selected dictionary. The text is shown with the readings of the found words, and
+// the words are listed below it in the order they appear in the text.
+class TextAnalysisForm : public DialogWindow
+{
+    Q_OBJECT
+public:
+    TextAnalysisForm(QWidget *parent = nullptr);
+    virtual ~TextAnalysisForm();
+
+    // Shows the window with words from the dictionary d. The text is analyzed right away if
+    // it's not empty.
+    void exec(Dictionary *d, const QString &text);
+protected:
+    virtual bool event(QEvent *e) override;
+protected slots:
+    void on_analyzeButton_clicked();
+    void on_dictCBox_currentIndexChanged(int index);
+    void readingLinkClicked(const QUrl &url);
+    void settingsChanged();
+
+    // The words of the dictionary changed. The text must be analyzed again.
+    void dictionaryChanged();
+    void dictionaryToBeRemoved(int index, int orderindex, Dictionary *dict);
+    void dictionaryReplaced(Dictionary *old, Dictionary *newdict, int index);
+private:
+    // Splits the analyzed text into words and lists them.
+    void analyze();
+    // Shows the analyzed text with the readings of the found words.
+    void updateReadingText();
+
+    void translateTexts();
+
+    Ui::TextAnalysisForm *ui;
+
+    Dictionary *dict;
+    DictionaryWordListItemModel *wmodel;
+
+    TextSegmenter segmenter;
+
+    // The last analyzed text and its segments.
+    QString text;
+    std::vector<TextSegment> segments;
+    // Row of the word of each segment in the word list. -1 for segments without words.
+    std::vector<int> rows;
+
+    typedef DialogWindow    base;
+};
+
+
+#endif // TEXTANALYSISFORM_H
@@ -0,0 +1,345 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#include "textsegmenter.h"
+#include "words.h"
+#include "grammar.h"
+#include "grammar_enums.h"
+#include "zkanjimain.h"
+#include "taskscheduler.h"
+#include "perftrace.h"
+
+#include "checked_cast.h"
+
+
+//-------------------------------------------------------------
+
+
+namespace
+{
+    // Score of a character that is not part of any word found in the text.
+    const int unknownScore = -1000;
+
+    // Number of characters at the end of a word that can be changed by inflections. Texts
+    // that are longer than this after the longest word stem are not deinflected.
+    const int maxInflectionLength = 12;
+
+    // Characters that can be part of the words in the text.
+    bool wordChar(ushort ch)
+    {
+        return KANJI(ch) || VALIDKANA(ch) || ch == KURIKAESHI;
+    }
+}
+
+TextSegmenter::TextSegmenter(Dictionary *dict) : dict(dict), built(false)
+{
+
+}
+
+TextSegmenter::~TextSegmenter()
+{
+
+}
+
+Dictionary* TextSegmenter::dictionary() const
+{
+    return dict;
+}
+
+void TextSegmenter::setDictionary(Dictionary *d)
+{
+    if (dict == d)
+        return;
+    dict = d;
+    reset();
+}
+
+void TextSegmenter::reset()
+{
+    kanjiorder.clear();
+    kanjiorder.shrink_to_fit();
+    kanaorder.clear();
+    kanaorder.shrink_to_fit();
+    built = false;
+}
+
+void TextSegmenter::segment(const QString &text, std::vector<TextSegment> &result)
+{
+    result.clear();
+    if (dict == nullptr || text.isEmpty())
+        return;
+
+    PERFTRACE_SCOPE("TextSegmenter::segment");
+
+    if (!built)
+        build();
+
+    // Words can't contain characters other than kanji and kana, so the text is split up at
+    // those first. The runs of Japanese text are independent from each other.
+    struct Run
+    {
+        int pos;
+        int length;
+        bool word;
+    };
+    std::vector<Run> runs;
+
+    const QChar *str = text.constData();
+    for (int pos = 0, siz = text.size(); pos != siz;)
+    {
+        bool word = wordChar(str[pos].unicode());
+        int end = pos + 1;
+        while (end != siz && wordChar(str[end].unicode()) == word)
+            ++end;
+        runs.push_back({ pos, end - pos, word });
+        pos = end;
+    }
+
+    std::vector<std::vector<TextSegment>> parts(runs.size());
+    parallelFor(0, tosigned(runs.size()), 8, [this, str, &runs, &parts](int first, int last) {
+        for (int ix = first; ix != last; ++ix)
+        {
+            const Run &r = runs[ix];
+            if (r.word)
+                segmentPart(str + r.pos, r.length, r.pos, parts[ix]);
+            else
+                parts[ix].push_back({ r.pos, r.length, -1, false, std::vector<InfTypes>() });
+        }
+    });
+
+    for (std::vector<TextSegment> &p : parts)
+        result.insert(result.end(), std::make_move_iterator(p.begin()), std::make_move_iterator(p.end()));
+
+    PERFTRACE_COUNT("TextSegmenter segments", tosigned(result.size()));
+}
+
+void TextSegmenter::build()
+{
+    PERFTRACE_SCOPE("TextSegmenter::build");
+
+    kanjiorder.clear();
+    kanaorder.clear();
+
+    for (int ix = 0, siz = dict->entryCount(); ix != siz; ++ix)
+    {
+        const WordEntry *e = dict->wordEntry(ix);
+        if (e->kanji.empty() || e->kana.empty())
+            continue;
+        kanjiorder.push_back(ix);
+        if (qcharcmp(e->kanji.data(), e->kana.data()) != 0)
+            kanaorder.push_back(ix);
+    }
+
+    const Dictionary *d = dict;
+    parallelSort(kanjiorder.begin(), kanjiorder.end(), [d](int a, int b) {
+        return qcharcmp(d->wordEntry(a)->kanji.data(), d->wordEntry(b)->kanji.data()) < 0;
+    });
+    parallelSort(kanaorder.begin(), kanaorder.end(), [d](int a, int b) {
+        return qcharcmp(d->wordEntry(a)->kana.data(), d->wordEntry(b)->kana.data()) < 0;
+    });
+
+    built = true;
+}
+
+void TextSegmenter::segmentPart(const QChar *str, int len, int pos, std::vector<TextSegment> &result) const
+{
+    // Viterbi pass over the lattice of the words found at each position. The best split of
+    // the first ix characters has the score best[ix], and the word ending it is last[ix],
+    // starting at from[ix].
+    std::vector<int> best(len + 1, std::numeric_limits<int>::min());
+    std::vector<int> from(len + 1, -1);
+    std::vector<Edge> last(len + 1);
+
+    std::vector<std::vector<InfTypes>> inflist;
+    std::vector<Edge> edges;
+
+    best[0] = 0;
+    for (int ix = 0; ix != len; ++ix)
+    {
+        edges.clear();
+        findWords(str + ix, len - ix, edges, inflist);
+        // Characters can always be skipped, at a high cost.
+        edges.push_back({ 1, -1, false, -1, unknownScore });
+
+        for (const Edge &e : edges)
+        {
+            int score = best[ix] + e.score;
+            if (score <= best[ix + e.length])
+                continue;
+            best[ix + e.length] = score;
+            from[ix + e.length] = ix;
+            last[ix + e.length] = e;
+        }
+    }
+
+    std::vector<TextSegment> segments;
+    for (int ix = len; ix != 0; ix = from[ix])
+    {
+        const Edge &e = last[ix];
+        // Neighboring characters without words are placed in a single segment.
+        if (e.windex == -1 && !segments.empty() && segments.back().windex == -1)
+        {
+            segments.back().pos = pos + from[ix];
+            segments.back().length += e.length;
+            continue;
+        }
+        segments.push_back({ pos + from[ix], e.length, e.windex, e.kana, e.inf == -1 ? std::vector<InfTypes>() : inflist[e.inf] });
+    }
+
+    result.insert(result.end(), std::make_move_iterator(segments.rbegin()), std::make_move_iterator(segments.rend()));
+}
+
+void TextSegmenter::findWords(const QChar *str, int len, std::vector<Edge> &edges, std::vector<std::vector<InfTypes>> &inflist) const
+{
+    std::vector<int> found;
+
+    // Length of the longest start of str that is the start of any word.
+    int prefix = 0;
+
+    for (int k = 0; k != 2; ++k)
+    {
+        bool kana = k == 1;
+        int first = 0;
+        int last = tosigned(kana ? kanaorder.size() : kanjiorder.size());
+        for (int l = 1; l <= len; ++l)
+        {
+            found.clear();
+            if (!narrow(str, l, kana, first, last, found))
+                break;
+            prefix = std::max(prefix, l);
+            for (int windex : found)
+                edges.push_back({ l, windex, kana, -1, wordScore(windex, l, kana, false) });
+        }
+    }
+
+    if (prefix == 0)
+        return;
+
+    // Inflections only change the kana at the end of words. The text is deinflected where it
+    // ends in kana, and the deinflected forms are looked up as the dictionary forms of words.
+    smartvector<InflectionForm> deinfs;
+    for (int l = 2, lim = std::min(len, prefix + maxInflectionLength); l <= lim; ++l)
+    {
+        ushort ch = str[l - 1].unicode();
+        if (!VALIDKANA(ch))
+        {
+            // Characters after the word stem can only be kana.
+            if (l > prefix)
+                break;
+            continue;
+        }
+
+        deinfs.clear();
+        deinflect(QString(str, l), deinfs);
+
+        for (const InflectionForm *f : deinfs)
+        {
+            for (int k = 0; k != 2; ++k)
+            {
+                bool kana = k == 1;
+                found.clear();
+                findExact(f->form, kana, found);
+                for (int windex : found)
+                {
+                    const WordEntry *e = dict->wordEntry(windex);
+                    bool match = false;
+                    for (int ix = 0, siz = tosigned(e->defs.size()); !match && ix != siz; ++ix)
+                        match = (e->defs[ix].attrib.types & (1 << (int)f->type)) != 0;
+                    if (!match)
+                        continue;
+
+                    inflist.push_back(f->inf);
+                    edges.push_back({ l, windex, kana, tosigned(inflist.size()) - 1, wordScore(windex, l, kana, true) });
+                }
+            }
+        }
+    }
+}
+
+bool TextSegmenter::narrow(const QChar *str, int len, bool kana, int &first, int &last, std::vector<int> &found) const
+{
+    const std::vector<int> &order = kana ? kanaorder : kanjiorder;
+    const Dictionary *d = dict;
+
+    // Every word in the range starts with the first len - 1 characters of str, so reading
+    // their character at len - 1 is safe. It's 0 for words of len - 1 characters, which come
+    // first in the range. The range is sorted by this character.
+    auto charAt = [d, kana](int windex, int pos) {
+        const WordEntry *e = d->wordEntry(windex);
+        return (kana ? e->kana.data() : e->kanji.data())[pos].unicode();
+    };
+
+    ushort ch = str[len - 1].unicode();
+    auto lo = std::lower_bound(order.begin() + first, order.begin() + last, ch, [&charAt, len](int windex, ushort val) {
+        return charAt(windex, len - 1) < val;
+    });
+    auto hi = std::upper_bound(lo, order.begin() + last, ch, [&charAt, len](ushort val, int windex) {
+        return val < charAt(windex, len - 1);
+    });
+
+    first = lo - order.begin();
+    last = hi - order.begin();
+    if (first == last)
+        return false;
+
+    // Words of exactly len characters are at the front of the new range.
+    for (auto it = lo; it != hi && charAt(*it, len) == 0; ++it)
+        found.push_back(*it);
+
+    return true;
+}
+
+void TextSegmenter::findExact(const QString &str, bool kana, std::vector<int> &found) const
+{
+    const std::vector<int> &order = kana ? kanaorder : kanjiorder;
+    const Dictionary *d = dict;
+
+    auto formOf = [d, kana](int windex) {
+        const WordEntry *e = d->wordEntry(windex);
+        return kana ? e->kana.data() : e->kanji.data();
+    };
+
+    auto lo = std::lower_bound(order.begin(), order.end(), str.constData(), [&formOf](int windex, const QChar *val) {
+        return qcharcmp(formOf(windex), val) < 0;
+    });
+    auto hi = std::upper_bound(lo, order.end(), str.constData(), [&formOf](const QChar *val, int windex) {
+        return qcharcmp(val, formOf(windex)) < 0;
+    });
+    found.insert(found.end(), lo, hi);
+}
+
+int TextSegmenter::wordScore(int windex, int length, bool kana, bool inflected) const
+{
+    const WordEntry *e = dict->wordEntry(windex);
+
+    // Long words are preferred to splitting them up into shorter words. The frequency only
+    // decides between splits with similar lengths.
+    int score = length * length * 100 + std::min<int>(e->freq, 5000) / 10;
+
+    // Words written with kanji are less likely to be found in kana in the text, unless they
+    // are usually written in kana.
+    if (kana)
+    {
+        bool kanaonly = false;
+        for (int ix = 0, siz = tosigned(e->defs.size()); !kanaonly && ix != siz; ++ix)
+            kanaonly = (e->defs[ix].attrib.notes & (1 << (int)WordNotes::KanaOnly)) != 0;
+        if (!kanaonly)
+            score -= length * length * 50;
+    }
+
+    if (inflected)
+        score -= 20;
+
+    return score;
+}
+
+
+//-------------------------------------------------------------
+
@@ -0,0 +1,111 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef TEXTSEGMENTER_H
+#define TEXTSEGMENTER_H
+
+#include <QString>
+#include <vector>
+
+enum class InfTypes;
+class Dictionary;
+
+// A part of a text split up by TextSegmenter.
+struct TextSegment
+{
+    // Position and length of the segment in the text.
+    int pos;
+    int length;
+    // Index of the dictionary word found at the segment. -1 if the segment is not a word.
+    int windex;
+    // The segment is the kana form of a word written with kanji in the dictionary.
+    bool kana;
+    // Inflections changing the dictionary form of the word to the form in the text. Empty
+    // when the text has the dictionary form.
+    std::vector<InfTypes> inf;
+};
+
+// Splits Japanese text into the words of a dictionary.
+//
+// Every word of the dictionary starting at each position of the text is looked up in sorted
+// indexes of the kanji and kana forms of the words. Inflected words are found by
+// deinflecting the text following a word stem. The best split of the text is selected from
+// the found words with a Viterbi pass, preferring long and frequent words.
+//
+// The word indexes are built at the first split of a text, and must be discarded with
+// reset() when the words of the dictionary change.
+class TextSegmenter
+{
+public:
+    TextSegmenter(Dictionary *dict = nullptr);
+    ~TextSegmenter();
+
+    Dictionary* dictionary() const;
+    // Changes the dictionary used for splitting the text and discards the word indexes.
+    void setDictionary(Dictionary *d);
+
+    // Discards the word indexes. They are built again when the next text is split.
+    void reset();
+
+    // Splits text into segments that cover the whole text. Japanese text is split into
+    // dictionary words, and into segments of single characters where no word was found.
+    // Other characters are kept together in segments that are not words. The runs of
+    // Japanese text between other characters are split in parallel.
+    void segment(const QString &text, std::vector<TextSegment> &result);
+private:
+    TextSegmenter(const TextSegmenter&) = delete;
+    TextSegmenter& operator=(const TextSegmenter&) = delete;
+
+    // A word found in the text while building the lattice of words.
+    struct Edge
+    {
+        int length;
+        int windex;
+        bool kana;
+        // Index of the inflections in the list of the inflections of the words found, or
+        // -1 if the word is not inflected.
+        int inf;
+        int score;
+    };
+
+    // Builds the sorted word indexes of the dictionary.
+    void build();
+
+    // Splits the Japanese text of len characters in str, found at pos in the whole text.
+    // The segments are added to result.
+    void segmentPart(const QChar *str, int len, int pos, std::vector<TextSegment> &result) const;
+
+    // Adds the edges of the words starting at the start of str, which has len characters.
+    // The inflections of the inflected words are added to inflist.
+    void findWords(const QChar *str, int len, std::vector<Edge> &edges, std::vector<std::vector<InfTypes>> &inflist) const;
+
+    // Adds the words in order whose form is exactly the first len characters of str. Set kana
+    // to look at the kana index instead of the kanji. The words' index must be narrowed down
+    // to the range between first and last, where each word starts with the first len - 1
+    // characters of str. The range is updated to hold the words starting with len
+    // characters of str. Returns false if there are no such words.
+    bool narrow(const QChar *str, int len, bool kana, int &first, int &last, std::vector<int> &found) const;
+
+    // Adds words to found from the words in order, whose form is exactly str.
+    void findExact(const QString &str, bool kana, std::vector<int> &found) const;
+
+    // Returns the score of a word found in the text. The higher the score, the more likely
+    // the word is part of the best split.
+    int wordScore(int windex, int length, bool kana, bool inflected) const;
+
+    Dictionary *dict;
+
+    // Indexes of the words in the dictionary, sorted by their kanji form.
+    std::vector<int> kanjiorder;
+    // Indexes of the words in the dictionary that have kanji, sorted by their kana form.
+    // Words written in kana are only listed in kanjiorder.
+    std::vector<int> kanaorder;
+
+    bool built;
+};
+
+
+#endif // TEXTSEGMENTER_H
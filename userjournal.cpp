@@ -0,0 +1,646 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <QFileInfo>
+#include <QDataStream>
+
+#include "userjournal.h"
+#include "zkanjimain.h"
+#include "words.h"
+#include "groups.h"
+#include "worddeck.h"
+#include "kanji.h"
+#include "ranges.h"
+#include "studydecks.h"
+
+#include "checked_cast.h"
+
+
+// WARNING: none of these strings should be longer than 255 bytes.
+
+static char ZKANJI_JOURNAL_FILE_VERSION[] = "001";
+
+
+//-------------------------------------------------------------
+
+
+// Sets up stream to read or write data in the same format as the journal file.
+static void setupStream(QDataStream &stream)
+{
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+}
+
+static void writeRanges(QDataStream &stream, const smartvector<Range> &ranges)
+{
+    stream << (qint32)ranges.size();
+    for (const Range *r : ranges)
+    {
+        stream << (qint32)r->first;
+        stream << (qint32)r->last;
+    }
+}
+
+// Reads ranges written with writeRanges(). Returns false if the ranges are not ordered or
+// don't fit in a list of size items.
+static bool readRanges(QDataStream &stream, smartvector<Range> &ranges, int size)
+{
+    qint32 cnt;
+    stream >> cnt;
+    if (stream.status() != QDataStream::Ok || cnt <= 0 || cnt > size)
+        return false;
+
+    ranges.reserve(cnt);
+    int prev = -1;
+    for (int ix = 0; ix != cnt; ++ix)
+    {
+        qint32 first;
+        qint32 last;
+        stream >> first;
+        stream >> last;
+        if (first <= prev || last < first || last >= size)
+            return false;
+        ranges.push_back(Range{ first, last });
+        prev = last;
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+static WordDeck* deckAt(Dictionary *dict, int index)
+{
+    if (index < 0 || index >= tosigned(dict->wordDecks()->size()))
+        return nullptr;
+    return dict->wordDecks()->items(index);
+}
+
+// Returns whether two paths point to the same file.
+static bool samePath(const QString &a, const QString &b)
+{
+    return QFileInfo(a).absoluteFilePath() == QFileInfo(b).absoluteFilePath();
+}
+
+
+//-------------------------------------------------------------
+
+
+UserDataJournal::Scope::Scope(UserDataJournal *journal) : journal(journal)
+{
+    ++journal->depth;
+}
+
+UserDataJournal::Scope::~Scope()
+{
+    --journal->depth;
+}
+
+
+//-------------------------------------------------------------
+
+
+UserDataJournal::UserDataJournal(Dictionary *dict) : dict(dict), covered(false), depth(0), replaying(false)
+{
+
+}
+
+UserDataJournal::~UserDataJournal()
+{
+    close();
+}
+
+QString UserDataJournal::fileName(const QString &userfile)
+{
+    QFileInfo inf(userfile);
+    return inf.path() + "/" + inf.completeBaseName() + ".zkjournal";
+}
+
+int UserDataJournal::replay(const QString &path)
+{
+    close();
+
+    file.setFileName(fileName(path));
+    if (!file.exists())
+    {
+        covered = create(path);
+        return 0;
+    }
+
+    if (!file.open(QIODevice::ReadWrite))
+        return 0;
+
+    QDataStream stream(&file);
+    setupStream(stream);
+
+    char tmp[7];
+    tmp[6] = 0;
+
+    if (stream.readRawData(tmp, 6) != 6 || strncmp("zjr", tmp, 3) != 0 || strtol(tmp + 3, 0, 10) > strtol(ZKANJI_JOURNAL_FILE_VERSION, 0, 10) || !checkStamp(stream, path))
+    {
+        // The journal was written for a different state of the user data file, which means
+        // the changes in it were saved or lost already.
+        covered = create(path);
+        return 0;
+    }
+
+    userfile = path;
+
+    int cnt = 0;
+    int skipped = 0;
+    bool failed = false;
+
+    // Position after the last complete record.
+    qint64 validpos = file.pos();
+
+    replaying = true;
+    try
+    {
+        while (!stream.atEnd())
+        {
+            quint8 type;
+            quint32 siz;
+            stream >> type;
+            stream >> siz;
+            if (stream.status() != QDataStream::Ok || siz > file.size() - file.pos())
+                break;
+
+            QByteArray payload(tosigned(siz), 0);
+            if (stream.readRawData(payload.data(), tosigned(siz)) != tosigned(siz))
+                break;
+
+            quint16 checksum;
+            stream >> checksum;
+            if (stream.status() != QDataStream::Ok || checksum != qChecksum(payload.constData(), siz))
+                break;
+
+            // The record was written completely, but it doesn't match the loaded user data.
+            // It's skipped and the rest are still applied.
+            if (!apply((RecordType)type, payload))
+                ++skipped;
+            else
+                ++cnt;
+
+            validpos = file.pos();
+        }
+    }
+    catch (...)
+    {
+        failed = true;
+    }
+    replaying = false;
+
+    // The last answers replayed can't be changed in the new session.
+    for (int ix = 0, siz = tosigned(dict->wordDecks()->size()); ix != siz; ++ix)
+        dict->wordDecks()->items(ix)->studyDeck()->clearUndo();
+
+    // A damaged record at the end is the sign of an interrupted write. It's removed so new
+    // records can follow the valid ones. When replaying stopped for any other reason,
+    // nothing is known about the rest of the file, so it's kept as it is and no records
+    // are added until the next full save.
+    if (failed)
+        file.close();
+    else if (!file.resize(validpos) || !file.seek(validpos))
+    {
+        file.close();
+        failed = true;
+    }
+
+    if (skipped != 0)
+    {
+        qWarning("%d records in the user data journal %s couldn't be applied.", skipped, qPrintable(file.fileName()));
+        failed = true;
+    }
+
+    // If a record couldn't be applied, the user data in memory doesn't match the journal
+    // any more. The full user data must be saved on the next autosave.
+    covered = !failed;
+
+    return cnt;
+}
+
+void UserDataJournal::userDataSaved(const QString &path)
+{
+    if (!samePath(path, dictionaryUserFile()))
+        return;
+
+    covered = create(path);
+}
+
+void UserDataJournal::close()
+{
+    if (file.isOpen())
+        file.close();
+    covered = false;
+}
+
+bool UserDataJournal::covers() const
+{
+    return covered && file.isOpen() && file.size() < checkpointSize && samePath(userfile, dictionaryUserFile());
+}
+
+void UserDataJournal::userDataModified()
+{
+    if (depth == 0 && !replaying)
+        covered = false;
+}
+
+void UserDataJournal::deckStartTest(WordDeck *deck, const QDateTime &now)
+{
+    if (!canWrite())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setupStream(stream);
+
+    stream << (qint32)dict->wordDecks()->indexOf(deck);
+    stream << (qint64)now.toMSecsSinceEpoch();
+
+    write(RecordType::DeckStartTest, payload);
+}
+
+void UserDataJournal::deckNewStudy(WordDeck *deck, int num)
+{
+    if (!canWrite())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setupStream(stream);
+
+    stream << (qint32)dict->wordDecks()->indexOf(deck);
+    stream << (qint32)num;
+
+    write(RecordType::DeckNewStudy, payload);
+}
+
+void UserDataJournal::deckAnswer(WordDeck *deck, int freeindex, int lockedindex, StudyCard::AnswerType a, qint64 answertime, const QDateTime &now)
+{
+    if (!canWrite())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setupStream(stream);
+
+    stream << (qint32)dict->wordDecks()->indexOf(deck);
+    stream << (qint32)freeindex;
+    stream << (qint32)lockedindex;
+    stream << (quint8)a;
+    stream << (qint64)answertime;
+    stream << (qint64)now.toMSecsSinceEpoch();
+
+    write(RecordType::DeckAnswer, payload);
+}
+
+void UserDataJournal::deckChangeAnswer(WordDeck *deck, StudyCard::AnswerType a)
+{
+    if (!canWrite())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setupStream(stream);
+
+    stream << (qint32)dict->wordDecks()->indexOf(deck);
+    stream << (quint8)a;
+
+    write(RecordType::DeckChangeAnswer, payload);
+}
+
+void UserDataJournal::wordGroupInsert(WordGroup *group, const std::vector<int> &windexes, int pos)
+{
+    if (!canWrite())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setupStream(stream);
+
+    QString name = group->fullEncodedName();
+    stream << make_zstr(name, ZStrFormat::Word);
+    stream << (qint32)pos;
+    stream << make_zvec<qint32, qint32>(windexes);
+
+    write(RecordType::WordGroupInsert, payload);
+}
+
+void UserDataJournal::wordGroupRemove(WordGroup *group, const smartvector<Range> &ranges)
+{
+    if (!canWrite())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setupStream(stream);
+
+    QString name = group->fullEncodedName();
+    stream << make_zstr(name, ZStrFormat::Word);
+    writeRanges(stream, ranges);
+
+    write(RecordType::WordGroupRemove, payload);
+}
+
+void UserDataJournal::wordGroupRemove(WordGroup *group, int first, int last)
+{
+    smartvector<Range> ranges;
+    ranges.push_back(Range{ first, last });
+    wordGroupRemove(group, ranges);
+}
+
+void UserDataJournal::wordGroupMove(WordGroup *group, const smartvector<Range> &ranges, int pos)
+{
+    if (!canWrite())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setupStream(stream);
+
+    QString name = group->fullEncodedName();
+    stream << make_zstr(name, ZStrFormat::Word);
+    writeRanges(stream, ranges);
+    stream << (qint32)pos;
+
+    write(RecordType::WordGroupMove, payload);
+}
+
+void UserDataJournal::kanjiGroupInsert(KanjiGroup *group, const std::vector<ushort> &kindexes, int pos)
+{
+    if (!canWrite())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setupStream(stream);
+
+    QString name = group->fullEncodedName();
+    stream << make_zstr(name, ZStrFormat::Word);
+    stream << (qint32)pos;
+    stream << make_zvec<qint32, quint16>(kindexes);
+
+    write(RecordType::KanjiGroupInsert, payload);
+}
+
+void UserDataJournal::kanjiGroupRemove(KanjiGroup *group, const smartvector<Range> &ranges)
+{
+    if (!canWrite())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setupStream(stream);
+
+    QString name = group->fullEncodedName();
+    stream << make_zstr(name, ZStrFormat::Word);
+    writeRanges(stream, ranges);
+
+    write(RecordType::KanjiGroupRemove, payload);
+}
+
+void UserDataJournal::kanjiGroupRemove(KanjiGroup *group, int first, int last)
+{
+    smartvector<Range> ranges;
+    ranges.push_back(Range{ first, last });
+    kanjiGroupRemove(group, ranges);
+}
+
+void UserDataJournal::kanjiGroupMove(KanjiGroup *group, const smartvector<Range> &ranges, int pos)
+{
+    if (!canWrite())
+        return;
+
+    QByteArray payload;
+    QDataStream stream(&payload, QIODevice::WriteOnly);
+    setupStream(stream);
+
+    QString name = group->fullEncodedName();
+    stream << make_zstr(name, ZStrFormat::Word);
+    writeRanges(stream, ranges);
+    stream << (qint32)pos;
+
+    write(RecordType::KanjiGroupMove, payload);
+}
+
+QString UserDataJournal::dictionaryUserFile() const
+{
+    return ZKanji::userFolder() + QString("/data/%1.zkuser").arg(dict->name());
+}
+
+bool UserDataJournal::canWrite() const
+{
+    // Records can depend on changes of the dictionary itself, which are not in the journal.
+    return depth == 1 && !replaying && covered && file.isOpen() && !dict->isModified();
+}
+
+bool UserDataJournal::create(const QString &path)
+{
+    if (file.isOpen())
+        file.close();
+
+    file.setFileName(fileName(path));
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QDataStream stream(&file);
+    setupStream(stream);
+
+    stream.writeRawData("zjr", 3);
+    stream.writeRawData(ZKANJI_JOURNAL_FILE_VERSION, 3);
+    writeStamp(stream, path);
+
+    if (stream.status() != QDataStream::Ok || !file.flush())
+    {
+        file.close();
+        file.remove();
+        return false;
+    }
+
+    userfile = path;
+    return true;
+}
+
+void UserDataJournal::write(RecordType type, const QByteArray &payload)
+{
+    QDataStream stream(&file);
+    setupStream(stream);
+
+    stream << (quint8)type;
+    stream << (quint32)payload.size();
+    stream.writeRawData(payload.constData(), payload.size());
+    stream << (quint16)qChecksum(payload.constData(), tounsigned(payload.size()));
+
+    if (stream.status() != QDataStream::Ok || !file.flush())
+    {
+        // The record might only be partially written. It'll be ignored when replaying, but
+        // nothing can be appended after it. The user data will be saved in full instead.
+        file.close();
+        covered = false;
+    }
+}
+
+bool UserDataJournal::apply(RecordType type, const QByteArray &payload)
+{
+    QDataStream stream(payload);
+    setupStream(stream);
+
+    qint32 deckix;
+    qint32 pos;
+    quint8 a;
+    qint64 msecs;
+    QString name;
+    smartvector<Range> ranges;
+
+    switch (type)
+    {
+    case RecordType::DeckStartTest:
+    {
+        stream >> deckix;
+        stream >> msecs;
+        WordDeck *deck = deckAt(dict, deckix);
+        if (stream.status() != QDataStream::Ok || deck == nullptr)
+            return false;
+        deck->replayStartTest(QDateTime::fromMSecsSinceEpoch(msecs, Qt::UTC));
+        return true;
+    }
+    case RecordType::DeckNewStudy:
+    {
+        qint32 num;
+        stream >> deckix;
+        stream >> num;
+        WordDeck *deck = deckAt(dict, deckix);
+        if (stream.status() != QDataStream::Ok || deck == nullptr || num < 0)
+            return false;
+        deck->initNewStudy(num);
+        return true;
+    }
+    case RecordType::DeckAnswer:
+    {
+        qint32 freeindex;
+        qint32 lockedindex;
+        qint64 answertime;
+        stream >> deckix;
+        stream >> freeindex;
+        stream >> lockedindex;
+        stream >> a;
+        stream >> answertime;
+        stream >> msecs;
+        WordDeck *deck = deckAt(dict, deckix);
+        if (stream.status() != QDataStream::Ok || deck == nullptr || a > (int)StudyCard::Easy)
+            return false;
+        return deck->replayAnswer(freeindex, lockedindex, (StudyCard::AnswerType)a, answertime, QDateTime::fromMSecsSinceEpoch(msecs, Qt::UTC));
+    }
+    case RecordType::DeckChangeAnswer:
+    {
+        stream >> deckix;
+        stream >> a;
+        WordDeck *deck = deckAt(dict, deckix);
+        if (stream.status() != QDataStream::Ok || deck == nullptr || a > (int)StudyCard::Easy)
+            return false;
+        return deck->replayChangeLastAnswer((StudyCard::AnswerType)a);
+    }
+    case RecordType::WordGroupInsert:
+    {
+        std::vector<int> windexes;
+        stream >> make_zstr(name, ZStrFormat::Word);
+        stream >> pos;
+        stream >> make_zvec<qint32, qint32>(windexes);
+        WordGroup *group = dict->wordGroups().groupFromEncodedName(name);
+        if (stream.status() != QDataStream::Ok || group == nullptr || pos < -1 || pos > tosigned(group->size()))
+            return false;
+        for (int windex : windexes)
+            if (windex < 0 || windex >= dict->entryCount())
+                return false;
+        group->insert(windexes, pos);
+        return true;
+    }
+    case RecordType::WordGroupRemove:
+    case RecordType::WordGroupMove:
+    {
+        stream >> make_zstr(name, ZStrFormat::Word);
+        WordGroup *group = dict->wordGroups().groupFromEncodedName(name);
+        if (stream.status() != QDataStream::Ok || group == nullptr || !readRanges(stream, ranges, tosigned(group->size())))
+            return false;
+        if (type == RecordType::WordGroupRemove)
+        {
+            group->remove(ranges);
+            return true;
+        }
+        stream >> pos;
+        if (stream.status() != QDataStream::Ok || pos < -1 || pos > tosigned(group->size()))
+            return false;
+        group->move(ranges, pos);
+        return true;
+    }
+    case RecordType::KanjiGroupInsert:
+    {
+        std::vector<ushort> kindexes;
+        stream >> make_zstr(name, ZStrFormat::Word);
+        stream >> pos;
+        stream >> make_zvec<qint32, quint16>(kindexes);
+        KanjiGroup *group = dict->kanjiGroups().groupFromEncodedName(name);
+        if (stream.status() != QDataStream::Ok || group == nullptr || pos < -1 || pos > tosigned(group->size()))
+            return false;
+        for (ushort kindex : kindexes)
+            if (kindex >= ZKanji::kanjis.size())
+                return false;
+        group->insert(kindexes, pos);
+        return true;
+    }
+    case RecordType::KanjiGroupRemove:
+    case RecordType::KanjiGroupMove:
+    {
+        stream >> make_zstr(name, ZStrFormat::Word);
+        KanjiGroup *group = dict->kanjiGroups().groupFromEncodedName(name);
+        if (stream.status() != QDataStream::Ok || group == nullptr || !readRanges(stream, ranges, tosigned(group->size())))
+            return false;
+        if (type == RecordType::KanjiGroupRemove)
+        {
+            group->remove(ranges);
+            return true;
+        }
+        stream >> pos;
+        if (stream.status() != QDataStream::Ok || pos < -1 || pos > tosigned(group->size()))
+            return false;
+        group->move(ranges, pos);
+        return true;
+    }
+    }
+
+    // Unknown record type from a newer version.
+    return false;
+}
+
+void UserDataJournal::writeStamp(QDataStream &stream, const QString &path)
+{
+    QFileInfo inf(path);
+    if (!inf.exists())
+    {
+        stream << (qint64)-1;
+        stream << (qint64)0;
+        return;
+    }
+
+    stream << (qint64)inf.size();
+    stream << (qint64)inf.lastModified().toMSecsSinceEpoch();
+}
+
+bool UserDataJournal::checkStamp(QDataStream &stream, const QString &path)
+{
+    qint64 siz;
+    qint64 msecs;
+    stream >> siz;
+    stream >> msecs;
+
+    if (stream.status() != QDataStream::Ok)
+        return false;
+
+    QFileInfo inf(path);
+    if (!inf.exists())
+        return siz == -1;
+
+    return siz == inf.size() && msecs == inf.lastModified().toMSecsSinceEpoch();
+}
+
@@ -0,0 +1,154 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef USERJOURNAL_H
+#define USERJOURNAL_H
+
+#include <QFile>
+#include <QDateTime>
+#include <vector>
+
+#include "smartvector.h"
+#include "studydecks.h"
+
+class Dictionary;
+class WordDeck;
+class WordGroup;
+class KanjiGroup;
+struct Range;
+
+// Append-only write-ahead log of the user data changes made to a dictionary since its user
+// data file was last written. Every study answer and group item edit adds a small record to
+// the journal file, which is flushed immediately. The journal is replayed at startup on top
+// of the loaded user data, and it's emptied each time the full user data is saved.
+//
+// Only the changes listed in RecordType are written to the journal. Any other user data
+// change (i.e. creating a group or editing a deck's item list) makes the journal incomplete,
+// and the next autosave writes the whole user data again as before.
+//
+// Journal file format:
+//  Header: "zjr" + 3 byte version, then the size and last modification date of the user
+//      data file the journal belongs to. A journal of a different file is ignored.
+//  Records: [quint8 type][quint32 payload size][payload][quint16 checksum of payload].
+//      Reading stops at the first incomplete or damaged record, which is cut off the file.
+class UserDataJournal
+{
+public:
+    // Journal files larger than this are folded into the user data file at the next autosave.
+    static const qint64 checkpointSize = 1024 * 1024;
+
+    // Type of a single record in the journal. The values are saved in the file and mustn't
+    // change.
+    enum class RecordType : quint8 {
+        DeckStartTest = 1, DeckNewStudy = 2, DeckAnswer = 3, DeckChangeAnswer = 4,
+        WordGroupInsert = 10, WordGroupRemove = 11, WordGroupMove = 12,
+        KanjiGroupInsert = 20, KanjiGroupRemove = 21, KanjiGroupMove = 22
+    };
+
+    // Create a scope object in functions that write a journal record. Changes to the user
+    // data made inside the scope are not treated as missing from the journal, and records
+    // are only written by the outermost scope, when such functions call each other.
+    class Scope
+    {
+    public:
+        Scope(UserDataJournal *journal);
+        ~Scope();
+    private:
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+        UserDataJournal *journal;
+    };
+
+    UserDataJournal(Dictionary *dict);
+    ~UserDataJournal();
+
+    // Returns the journal file name belonging to the passed user data file.
+    static QString fileName(const QString &userfile);
+
+    // Applies the records in the journal of userfile to the already loaded user data of the
+    // dictionary, and opens the journal to append new records. Returns the number of records
+    // that were applied. Records that don't match the user data are skipped with a warning,
+    // and the full user data will be saved on the next autosave.
+    int replay(const QString &userfile);
+
+    // Notifies the journal that the full user data was written to userfile. If userfile is
+    // the dictionary's own user data file, the journal is emptied and the new records will
+    // be relative to the saved data.
+    void userDataSaved(const QString &userfile);
+
+    // Closes the journal file without changing it. No records are written until the next
+    // replay() or userDataSaved().
+    void close();
+
+    // Returns whether every change made to the user data since it was last saved is in the
+    // journal, and the journal is not too large. The full user data doesn't have to be saved
+    // in that case on autosave.
+    bool covers() const;
+
+    // Called by the dictionary every time its user data is modified. Changes made outside a
+    // journal scope can't be replayed, so the journal stops covering the user data.
+    void userDataModified();
+
+    // Record writing functions. Call them after the change has been made, inside a Scope.
+
+    void deckStartTest(WordDeck *deck, const QDateTime &now);
+    void deckNewStudy(WordDeck *deck, int num);
+    void deckAnswer(WordDeck *deck, int freeindex, int lockedindex, StudyCard::AnswerType a, qint64 answertime, const QDateTime &now);
+    void deckChangeAnswer(WordDeck *deck, StudyCard::AnswerType a);
+
+    void wordGroupInsert(WordGroup *group, const std::vector<int> &windexes, int pos);
+    void wordGroupRemove(WordGroup *group, const smartvector<Range> &ranges);
+    void wordGroupRemove(WordGroup *group, int first, int last);
+    void wordGroupMove(WordGroup *group, const smartvector<Range> &ranges, int pos);
+
+    void kanjiGroupInsert(KanjiGroup *group, const std::vector<ushort> &kindexes, int pos);
+    void kanjiGroupRemove(KanjiGroup *group, const smartvector<Range> &ranges);
+    void kanjiGroupRemove(KanjiGroup *group, int first, int last);
+    void kanjiGroupMove(KanjiGroup *group, const smartvector<Range> &ranges, int pos);
+private:
+    UserDataJournal(const UserDataJournal&) = delete;
+    UserDataJournal& operator=(const UserDataJournal&) = delete;
+
+    // Returns the path of the user data file of the dictionary with its current name.
+    QString dictionaryUserFile() const;
+
+    // Returns whether a record should be written at this point.
+    bool canWrite() const;
+
+    // Creates an empty journal file for userfile, overwriting the old one.
+    bool create(const QString &userfile);
+
+    // Appends a record to the journal file and flushes it.
+    void write(RecordType type, const QByteArray &payload);
+
+    // Applies a single record to the dictionary's user data. Returns false if the record
+    // couldn't be applied.
+    bool apply(RecordType type, const QByteArray &payload);
+
+    // Writes or reads the identifying data of the user data file.
+    static void writeStamp(QDataStream &stream, const QString &userfile);
+    static bool checkStamp(QDataStream &stream, const QString &userfile);
+
+    Dictionary *dict;
+
+    QFile file;
+
+    // The user data file the journal records are relative to.
+    QString userfile;
+
+    // Every change since the last save of the user data has been written to the journal.
+    bool covered;
+
+    // Number of nested scopes currently open.
+    int depth;
+
+    // Records are being applied from the journal. Nothing is written in this state.
+    bool replaying;
+};
+
+
+#endif // USERJOURNAL_H
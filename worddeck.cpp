@@ -17,6 +17,7 @@
 #include "furigana.h"
 #include "studysettings.h"
 #include "ranges.h"
+#include "userjournal.h"
 //#include "groupstudy.h"
 
 #include "checked_cast.h"
@@ -457,7 +458,7 @@ void ReadingTestList::add(int windex, bool newitem, bool failed, bool undo)
     // The furigana of the word is looked up to avoid calling it every time
     // findKanjiReading() is called.
     std::vector<FuriganaData> fdat;
-    findFurigana(e->kanji, e->kana, fdat);
+    owner->dictionary()->wordFurigana(windex, fdat);
 
     int len = e->kanji.size();
 
@@ -623,7 +624,7 @@ bool ReadingTestList::readingMatches(QString answer)
     for (int ix = 0, siz = tosigned(list.front()->words.size()); ix != siz; ++ix)
     {
         WordEntry *w = owner->dictionary()->wordEntry(list.front()->words[ix]->windex);
-        findFurigana(w->kanji, w->kana, fdat);
+        owner->dictionary()->wordFurigana(list.front()->words[ix]->windex, fdat);
 
         for (int iy = 0, sizy = tosigned(w->kanji.size()); iy != sizy; ++iy)
         {
@@ -1505,8 +1506,12 @@ void WordDeck::initNewStudy(int num)
     if (num == 0)
         return;
 
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     newcnt += std::min(tosigned(freeitems.size()), num);
     dictionary()->setToUserModified();
+
+    dictionary()->userJournal()->deckNewStudy(this, num);
 }
 
 WordDeckWord* WordDeck::wordFromIndex(int windex)
@@ -1542,6 +1547,22 @@ void WordDeck::itemsToWords(const std::vector<int> &items, bool queue, std::vect
 }
 
 void WordDeck::startTest()
+{
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
+    QDateTime now = QDateTime::currentDateTimeUtc();
+    if (!doStartTest(now))
+        return;
+
+    dictionary()->userJournal()->deckStartTest(this, now);
+}
+
+bool WordDeck::replayStartTest(const QDateTime &now)
+{
+    return doStartTest(now);
+}
+
+bool WordDeck::doStartTest(const QDateTime &now)
 {
     //sortDueList();
 
@@ -1550,8 +1571,8 @@ void WordDeck::startTest()
     currentix.reset();
     nextix.reset();
 
-    if (!study->startTestDay())
-        return;
+    if (!study->startTestDay(now))
+        return false;
 
 #ifdef _DEBUG
     //sortDueList();
@@ -1581,6 +1602,8 @@ void WordDeck::startTest()
     lastday = study->testDay();
 
     dictionary()->setToUserModified();
+
+    return true;
 }
 
 int WordDeck::daysSinceLastInclude() const
@@ -1636,54 +1659,23 @@ int WordDeck::totalTime() const
 {
     if (!deckid.valid())
         return 0;
-    const StudyDeck *study = studyDeck();
-    if (study->dayStatSize() == 0)
-        return 0;
-    int sum = 0;
-    for (int ix = 0, siz = study->dayStatSize(); ix != siz; ++ix)
-        sum += study->dayStat(ix).timespent;
-
-    return sum;
+    return studyDeck()->dayStats().totals().timespent;
 }
 
 int WordDeck::studyAverage() const
 {
     if (!deckid.valid())
         return 0;
-    const StudyDeck *study = studyDeck();
-    if (study->dayStatSize() == 0)
-        return 0;
-
-    int sum = 0;
-    int cnt = 0;
-    for (int ix = 0, siz = study->dayStatSize(); ix != siz; ++ix)
-    {
-        int spent = study->dayStat(ix).timespent;
-        if (spent != 0)
-        {
-            sum += study->dayStat(ix).timespent;
-            ++cnt;
-        }
-    }
-
-    return cnt == 0 ? 0 : sum / cnt;
+    DeckDayTotals totals = studyDeck()->dayStats().totals();
+    return totals.studydays == 0 ? 0 : totals.timespent / totals.studydays;
 }
 
 int WordDeck::answerAverage() const
 {
-    int sum = totalTime();
-    if (totalTime() == 0)
+    if (!deckid.valid())
         return 0;
-
-    int itemcnt = 0;
-
-    const StudyDeck *study = studyDeck();
-    for (int ix = 0, siz = study->dayStatSize(); ix != siz; ++ix)
-    {
-        if (study->dayStat(ix).timespent != 0)
-            itemcnt += study->dayStat(ix).testcount;
-    }
-    return sum / itemcnt;
+    DeckDayTotals totals = studyDeck()->dayStats().totals();
+    return totals.studytests == 0 ? 0 : totals.timespent / totals.studytests;
 }
 
 int WordDeck::queueSize() const
@@ -2073,18 +2065,7 @@ int WordDeck::testDayCount() const
 {
     if (!deckid.valid())
         return 0;
-    const StudyDeck *study = studyDeck();
-    if (study->dayStatSize() == 0)
-        return 0;
-
-    int r = 0;
-    for (int ix = 0, siz = study->dayStatSize(); ix != siz; ++ix)
-    {
-        const DeckDayStat &stat = study->dayStat(ix);
-        if (stat.testcount != 0)
-            ++r;
-    }
-    return r;
+    return studyDeck()->dayStats().totals().testdays;
 }
 
 int WordDeck::skippedDayCount() const
@@ -2404,8 +2385,42 @@ void WordDeck::generateNextItem()
 
 void WordDeck::answer(StudyCard::AnswerType a, qint64 answertime)
 {
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     waitForNextItem();
 
+    // The current index changes when a new item is answered.
+    FLIndex answered = currentix;
+    QDateTime now = QDateTime::currentDateTimeUtc();
+
+    doAnswer(a, answertime, now);
+
+    dictionary()->userJournal()->deckAnswer(this, answered.free, answered.locked, a, answertime, now);
+}
+
+bool WordDeck::replayAnswer(int freeindex, int lockedindex, StudyCard::AnswerType a, qint64 answertime, const QDateTime &now)
+{
+    if (freeindex < -1 || lockedindex < -1 || (freeindex == -1) == (lockedindex == -1) || freeindex >= tosigned(freeitems.size()) || lockedindex >= tosigned(lockitems.size()))
+        return false;
+
+    // A locked item must be in one of the lists to be answered.
+    if (lockedindex != -1 && dueIndex(lockedindex) < 0 && std::find(failedlist.begin(), failedlist.end(), lockedindex) == failedlist.end())
+        return false;
+
+    currentix.free = freeindex;
+    currentix.locked = lockedindex;
+    nextix.reset();
+
+    doAnswer(a, answertime, now);
+
+    currentix.reset();
+    nextix.reset();
+
+    return true;
+}
+
+void WordDeck::doAnswer(StudyCard::AnswerType a, qint64 answertime, const QDateTime &now)
+{
     // If the next item is the same as the current item, it means that the thread looking for
     // the next one couldn't find anything else. As it couldn't tell what the answer will be,
     // it assumed the current item failed and will have to be repeated.
@@ -2417,7 +2432,7 @@ void WordDeck::answer(StudyCard::AnswerType a, qint64 answertime)
     StudyDeck *study = studyDeck();
 
     WordDeckItem *current = currentItem();
-    current->data->lastinclude = QDateTime::currentDateTimeUtc();
+    current->data->lastinclude = now;
 
     // If a new item was tested, it has to be "converted" to a locked item and added to
     // lockitems. Existing items will be removed from either the failedlist or duelist.
@@ -2483,7 +2498,7 @@ void WordDeck::answer(StudyCard::AnswerType a, qint64 answertime)
 #ifdef _DEBUG
     checkDueList();
 #endif
-    study->answer(item->cardid, a, answertime);
+    study->answer(item->cardid, a, answertime, false, now);
 
     if (a == StudyCard::Correct || a == StudyCard::Easy)
     {
@@ -2523,8 +2538,28 @@ StudyCard::AnswerType WordDeck::lastAnswer() const
 
 void WordDeck::changeLastAnswer(StudyCard::AnswerType a)
 {
+    UserDataJournal::Scope scope(dictionary()->userJournal());
+
     abortGenerateNextItem();
 
+    doChangeLastAnswer(a);
+
+    dictionary()->userJournal()->deckChangeAnswer(this, a);
+
+    generateNextItem();
+}
+
+bool WordDeck::replayChangeLastAnswer(StudyCard::AnswerType a)
+{
+    if (!studyDeck()->canChangeLastAnswer())
+        return false;
+
+    doChangeLastAnswer(a);
+    return true;
+}
+
+void WordDeck::doChangeLastAnswer(StudyCard::AnswerType a)
+{
     StudyDeck *study = studyDeck();
 
     LockedWordDeckItem *item = (LockedWordDeckItem*)study->cardData(study->lastCard());
@@ -2558,7 +2593,6 @@ void WordDeck::changeLastAnswer(StudyCard::AnswerType a)
     else
         failedlist.push_back(lastindex);
 
-    generateNextItem();
     dictionary()->setToUserModified();
 }
 
@@ -646,6 +646,13 @@ public:
     // the current item is not the same as the previous one.
     bool canUndo() const;
 
+    // Functions that repeat a change written to the user data journal, when it's replayed
+    // at startup. Return false if the passed values are invalid and nothing was changed.
+
+    bool replayStartTest(const QDateTime &now);
+    bool replayAnswer(int freeindex, int lockedindex, StudyCard::AnswerType a, qint64 answertime, const QDateTime &now);
+    bool replayChangeLastAnswer(StudyCard::AnswerType a);
+
     // Returns the index of the kanji to be tested next in a kanji reading
     // practice.
     int nextPracticeKanji();
@@ -688,6 +695,13 @@ private:
     // nextitem and nextindex to -1. Call generateNextItem() in either case.
     void abortGenerateNextItem();
 
+    // Implementation of startTest(), answer() and changeLastAnswer() without the thread
+    // computing the next item, and without writing to the journal. The test day is started
+    // or the answer is registered at the time in now.
+    bool doStartTest(const QDateTime &now);
+    void doAnswer(StudyCard::AnswerType a, qint64 answertime, const QDateTime &now);
+    void doChangeLastAnswer(StudyCard::AnswerType a);
+
     // Computes the item to be shown next in a word test. It is called from
     // a separate thread and should only change the value of nextitem and
     // nextindex.
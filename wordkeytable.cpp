@@ -0,0 +1,118 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#include <algorithm>
+#include "wordkeytable.h"
+#include "words.h"
+#include "taskscheduler.h"
+#include "perftrace.h"
+
+#include "checked_cast.h"
+
+
+//-------------------------------------------------------------
+
+
+namespace
+{
+    // FNV-1a hash parameters.
+    const quint64 keyOffset = 14695981039346656037ULL;
+    const quint64 keyPrime = 1099511628211ULL;
+
+    quint64 addToKey(quint64 key, const QChar *str, int len)
+    {
+        for (int ix = 0; ix != len; ++ix)
+        {
+            ushort u = str[ix].unicode();
+            key = (key ^ (u & 0xff)) * keyPrime;
+            key = (key ^ (u >> 8)) * keyPrime;
+        }
+        return key;
+    }
+}
+
+quint64 wordKey(const QChar *kanji, int kanjilen, const QChar *kana, int kanalen)
+{
+    // A zero character is hashed between the strings, so moving characters from one string
+    // to the other changes the key.
+    quint64 key = addToKey(keyOffset, kanji, kanjilen);
+    key = (key ^ 0) * keyPrime;
+    key = (key ^ 0) * keyPrime;
+    return addToKey(key, kana, kanalen);
+}
+
+quint64 wordKey(const QString &kanji, const QString &kana)
+{
+    return wordKey(kanji.constData(), kanji.size(), kana.constData(), kana.size());
+}
+
+
+//-------------------------------------------------------------
+
+
+WordKeyTable::WordKeyTable() : dict(nullptr)
+{
+
+}
+
+bool WordKeyTable::build(const Dictionary *d, const CancelToken *token)
+{
+    PERFTRACE_SCOPE("WordKeyTable::build");
+
+    clear();
+    dict = d;
+
+    int cnt = dict->entryCount();
+    keys.resize(cnt);
+    if (!parallelFor(0, cnt, 4096, [this](int first, int last) {
+        for (int ix = first; ix != last; ++ix)
+        {
+            const WordEntry *e = dict->wordEntry(ix);
+            keys[ix] = std::make_pair(wordKey(e->kanji.data(), e->kanji.size(), e->kana.data(), e->kana.size()), ix);
+        }
+    }, token) || !parallelSort(keys.begin(), keys.end(), [](const std::pair<quint64, int> &a, const std::pair<quint64, int> &b) {
+        return a.first < b.first;
+    }, token))
+    {
+        clear();
+        return false;
+    }
+
+    return true;
+}
+
+void WordKeyTable::clear()
+{
+    dict = nullptr;
+    keys.clear();
+    keys.shrink_to_fit();
+}
+
+int WordKeyTable::find(quint64 key, const QChar *kanji, int kanjilen, const QChar *kana, int kanalen) const
+{
+    auto it = std::lower_bound(keys.begin(), keys.end(), key, [](const std::pair<quint64, int> &item, quint64 val) {
+        return item.first < val;
+    });
+
+    // Different words can have the same key.
+    for (; it != keys.end() && it->first == key; ++it)
+    {
+        const WordEntry *e = dict->wordEntry(it->second);
+        if (e->kanji.size() == kanjilen && e->kana.size() == kanalen &&
+            qcharncmp(e->kanji.data(), kanji, kanjilen) == 0 && qcharncmp(e->kana.data(), kana, kanalen) == 0)
+            return it->second;
+    }
+    return -1;
+}
+
+int WordKeyTable::find(const QString &kanji, const QString &kana) const
+{
+    return find(wordKey(kanji, kana), kanji.constData(), kanji.size(), kana.constData(), kana.size());
+}
+
+
+//-------------------------------------------------------------
+
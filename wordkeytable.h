@@ -0,0 +1,48 @@
+/*
+** Copyright 2007-2013, 2017-2018 Sólyom Zoltán
+** This file is part of zkanji, a free software released under the terms of the
+** GNU General Public License version 3. See the file LICENSE for details.
+**/
+
+#ifndef WORDKEYTABLE_H
+#define WORDKEYTABLE_H
+
+#include <QString>
+#include <vector>
+
+class Dictionary;
+class CancelToken;
+
+// Returns a hash of the written form and kana reading of a word. The hash only depends on
+// the characters of the two strings, and can be saved to files to identify words in any
+// dictionary.
+quint64 wordKey(const QChar *kanji, int kanjilen, const QChar *kana, int kanalen);
+quint64 wordKey(const QString &kanji, const QString &kana);
+
+// Sorted list of the word keys of every word in a dictionary, for finding a large number of
+// words by their written form and kana reading. Finding a word is a binary search by its key,
+// instead of searching the dictionary's kana tree.
+// The table must be rebuilt when words are added to or removed from the dictionary.
+class WordKeyTable
+{
+public:
+    WordKeyTable();
+
+    // Computes the key of every word in dict on several threads. Returns false if the token
+    // was cancelled, leaving the table empty.
+    bool build(const Dictionary *dict, const CancelToken *token = nullptr);
+    void clear();
+
+    // Returns the index of the word with the written form and kana reading, or -1 if it's not
+    // in the dictionary. The key must be computed with wordKey(). Can be called from several
+    // threads at once.
+    int find(quint64 key, const QChar *kanji, int kanjilen, const QChar *kana, int kanalen) const;
+    int find(const QString &kanji, const QString &kana) const;
+private:
+    const Dictionary *dict;
+    // Keys of the words paired with their index, sorted by key.
+    std::vector<std::pair<quint64, int>> keys;
+};
+
+
+#endif // WORDKEYTABLE_H
@@ -39,6 +39,10 @@
 #include "datasettings.h"
 #include "sentences.h"
 #include "zui.h"
+#include "userjournal.h"
+#include "taskscheduler.h"
+#include "perftrace.h"
+#include "wordkeytable.h"
 
 #include "checked_cast.h"
 
@@ -48,10 +52,13 @@
 extern char ZKANJI_PROGRAM_VERSION[];
 
 static char ZKANJI_BASE_FILE_VERSION[] = "002";
-static char ZKANJI_DICTIONARY_FILE_VERSION[] = "001";
+static char ZKANJI_DICTIONARY_FILE_VERSION[] = "002";
 
 static char ZKANJI_GROUP_FILE_VERSION[] = "003";
 
+// When changed: also update doImportUserDataBinary() in import.cpp.
+static char ZKANJI_USER_EXPORT_FILE_VERSION[] = "001";
+
 // Separator character between variants of the same word definition.
 const QChar GLOSS_SEP_CHAR = QChar(0x0082);
 
@@ -319,6 +326,8 @@ namespace ZKanji
 
     void saveUserData(bool forced)
     {
+        PERFTRACE_SCOPE("saveUserData");
+
         if (forced || ZKanji::profile().isModified())
             ZKanji::profile().save(userFolder() + "/data/student.zkp");
 
@@ -373,6 +382,31 @@ namespace ZKanji
         }
     }
 
+    bool userDataJournaled()
+    {
+        // The student profile is only modified together with the study decks. Its changes
+        // are restored when the answers in the journals are replayed.
+        bool journaled = false;
+        for (Dictionary *d : dictionaries)
+        {
+            if (d->isModified())
+                return false;
+            if (!d->isUserModified())
+                continue;
+            if (!d->userJournal()->covers())
+                return false;
+            journaled = true;
+        }
+
+        return journaled;
+    }
+
+    void replayUserJournals()
+    {
+        for (Dictionary *d : dictionaries)
+            d->userJournal()->replay(userFolder() + QString("/data/%1.zkuser").arg(d->name()));
+    }
+
     void backupUserData()
     {
         if (!Settings::data.backup)
@@ -1138,12 +1172,12 @@ bool definitionsMatch(WordEntry *e1, WordEntry *e2)
 //
 //}
 
-WordResultList::WordResultList(Dictionary *dict) : dict(dict)
+WordResultList::WordResultList(Dictionary *dict) : dict(dict), similar(false)
 {
 
 }
 
-WordResultList::WordResultList(WordResultList &&src) : dict(nullptr)
+WordResultList::WordResultList(WordResultList &&src) : dict(nullptr), similar(false)
 {
     *this = std::forward<WordResultList>(src);
 }
@@ -1153,6 +1187,7 @@ WordResultList& WordResultList::operator=(WordResultList &&src)
     std::swap(dict, src.dict);
     std::swap(indexes, src.indexes);
     std::swap(infs, src.infs);
+    std::swap(similar, src.similar);
 
     return *this;
 }
@@ -1179,12 +1214,14 @@ void WordResultList::set(const std::vector<int> &wordindexes)
 {
     indexes = wordindexes;
     infs.clear();
+    similar = false;
 }
 
 void WordResultList::set(std::vector<int> &&wordindexes)
 {
     std::swap(indexes, wordindexes);
     infs.clear();
+    similar = false;
 }
 
 inline WordEntry* WordResultList::items(int ix)
@@ -1219,6 +1256,17 @@ void WordResultList::clear()
 {
     indexes.clear();
     infs.clear();
+    similar = false;
+}
+
+bool WordResultList::similarWords() const
+{
+    return similar;
+}
+
+void WordResultList::setSimilarWords(bool newsimilar)
+{
+    similar = newsimilar;
 }
 
 bool WordResultList::empty() const
@@ -1319,6 +1367,13 @@ void WordResultList::sortByIndex()
 
 void WordResultList::jpSort(std::vector<int> *pindexes)
 {
+    // Similar words are already ordered by their distance from the search string.
+    if (similar)
+        return;
+
+    PERFTRACE_SCOPE("WordResultList::jpSort");
+    PERFTRACE_COUNT("jpSort items", tosigned(indexes.size()));
+
     // When changing, also change jpInsertPos().
 
     std::vector<int> list;
@@ -1597,6 +1652,14 @@ void WordResultList::add(int wordindex, const std::vector<InfTypes> &inf)
 //-------------------------------------------------------------
 
 
+// Returns whether the hiragana form of the null terminated str is the same as ref.
+static bool hiraganaEquals(const QChar *str, const QStringRef &ref)
+{
+    TransliterationBuffer buf;
+    hiraganize(str, -1, buf);
+    return buf.size() == ref.size() && qcharncmp(buf.constData(), ref.constData(), buf.size()) == 0;
+}
+
 TextSearchTree::TextSearchTree(Dictionary *dict, bool kana, bool reversed) : base(/*true,*/), dict(dict), kana(kana), reversed(reversed)
 {
     //if (kana && reversed)
@@ -1641,6 +1704,8 @@ void TextSearchTree::copy(TextSearchTree *src)
                                
 void TextSearchTree::findWords(std::vector<int> &result, QString search, bool exact, bool sameform, const std::vector<int> *wordpool, const WordFilterConditions *conditions, int infsize) 
 {
+    PERFTRACE_SCOPE(conditions != nullptr ? "TextSearchTree::findWords filtered" : "TextSearchTree::findWords");
+
     // When changing this: update wordMatches() as well.
 
     // Warning: the result list is not erased since conditions were added. If any error occurs
@@ -1857,10 +1922,10 @@ void TextSearchTree::findWords(std::vector<int> &result, QString search, bool ex
             (reversed && qcharncmp(search.constData(), word + wlen - search.size(), search.size()))))
             ;// result.erase(result.begin() + ix);
         else if ((sameform && infsize > 0 && search.size() > infsize) &&
-            ((exact && (qcharncmp(word, search.constData(), wlen - infsize) || hiraganize(word + wlen - infsize) != search.rightRef(infsize))) ||
+            ((exact && (qcharncmp(word, search.constData(), wlen - infsize) || !hiraganaEquals(word + wlen - infsize, search.rightRef(infsize)))) ||
             (!reversed && !exact /* in theory reversed is always true, because only word endings are checked when deinflecting. */) ||
             ((reversed || exact) && (qcharncmp(search.constData(), word + wlen - search.size(), search.size() - infsize) ||
-            search.rightRef(infsize) != hiraganize(word + wlen - infsize)))))
+            !hiraganaEquals(word + wlen - infsize, search.rightRef(infsize))))))
             ;// result.erase(result.begin() + ix);
         else
             result.push_back(windex);
@@ -1934,10 +1999,10 @@ bool TextSearchTree::wordMatches(int windex, QString search, bool exact, bool sa
         (reversed && qcharncmp(search.constData(), word + wlen - search.size(), search.size()))))
         return false;// result.erase(result.begin() + ix);
     else if ((sameform && infsize > 0 && search.size() > infsize) &&
-        ((exact && (qcharncmp(word, search.constData(), wlen - infsize) || hiraganize(word + wlen - infsize) != search.rightRef(infsize))) ||
+        ((exact && (qcharncmp(word, search.constData(), wlen - infsize) || !hiraganaEquals(word + wlen - infsize, search.rightRef(infsize)))) ||
         (!reversed && !exact /* in theory reversed is always true, because only word endings are checked when deinflecting. */) ||
         ((reversed || exact) && (qcharncmp(search.constData(), word + wlen - search.size(), search.size() - infsize) ||
-        search.rightRef(infsize) != hiraganize(word + wlen - infsize)))))
+        !hiraganaEquals(word + wlen - infsize, search.rightRef(infsize))))))
         return false;// result.erase(result.begin() + ix);
     //else
 
@@ -1946,6 +2011,197 @@ bool TextSearchTree::wordMatches(int windex, QString search, bool exact, bool sa
     //return false;
 }
 
+namespace
+{
+    // Cost of an ordinary edit when looking for similar words. Typical misspellings of romaji
+    // cost half as much.
+    const int similarEditCost = 2;
+    const int similarCheapCost = 1;
+
+    bool romajiVowel(ushort ch)
+    {
+        return ch == 'a' || ch == 'i' || ch == 'u' || ch == 'e' || ch == 'o';
+    }
+
+    // Returns whether the character at pos in the romanized str can be left out or added by
+    // mistake. These are long vowels (oo, ou, ee, ei), doubled consonants from small tsu,
+    // the n' of syllable-final n, and the x of small kana (kixyo, kiyo).
+    bool romajiCheapInsert(const QChar *str, int pos)
+    {
+        ushort ch = str[pos].unicode();
+        if (ch == 'x')
+            return true;
+        if (pos == 0)
+            return false;
+        ushort prev = str[pos - 1].unicode();
+
+        if (romajiVowel(ch))
+            return ch == prev || (ch == 'u' && prev == 'o') || (ch == 'i' && prev == 'e');
+        return ch == prev || (ch == '\'' && prev == 'n') || (ch == 'n' && prev == '\'');
+    }
+
+    // Returns whether writing the character at qpos in q instead of the character at kpos
+    // in key is a typical mistake. These are the second vowel of long vowels (oo/ou, ee/ei)
+    // and the kana with the same sound (zi/di, zu/du).
+    bool romajiCheapSubstitute(const QChar *q, int qpos, const QChar *key, int kpos)
+    {
+        ushort a = q[qpos].unicode();
+        ushort b = key[kpos].unicode();
+        if (a > b)
+            std::swap(a, b);
+
+        if ((a == 'o' && b == 'u') || (a == 'e' && b == 'i'))
+            return qpos != 0 && kpos != 0 && q[qpos - 1] == key[kpos - 1] && q[qpos - 1].unicode() == (a == 'o' ? 'o' : 'e');
+        return a == 'd' && b == 'z';
+    }
+
+    // Walks the nodes of a kana search tree, computing the weighted edit distance between a
+    // romanized search string and the start of the labels of the nodes. Branches that can't
+    // contain words similar to the search string are skipped.
+    class SimilarWordWalker
+    {
+    public:
+        SimilarWordWalker(const Dictionary *dict, const QString &search, int maxdist, std::vector<std::pair<int, int>> &result) :
+            dict(dict), q(search.constData()), qlen(search.size()), maxdist(maxdist), result(result)
+        {
+            // Row 0 holds the cost of removing the characters of the search string.
+            rows.resize(1);
+            rows[0].resize(qlen + 1);
+            rows[0][0] = 0;
+            for (int j = 1; j <= qlen; ++j)
+                rows[0][j] = rows[0][j - 1] + (romajiCheapInsert(q, j - 1) ? similarCheapCost : similarEditCost);
+            pathbest.push_back(rows[0][qlen]);
+        }
+
+        void walk(const TextNode *node)
+        {
+            int len = tosigned(qcharlen(node->label.data()));
+            int parentlen = node->parent == nullptr ? 0 : tosigned(qcharlen(node->parent->label.data()));
+            for (int k = parentlen + 1; k <= len; ++k)
+            {
+                if (!computeRow(node->label.data(), k))
+                {
+                    // Longer keys can't get closer to the search string, but every word
+                    // below the node starts with the first k characters of the label.
+                    if (pathbest[k] <= maxdist)
+                        collect(node, pathbest[k]);
+                    return;
+                }
+            }
+
+            for (int line : node->lines)
+            {
+                const QChar *key = dict->wordEntry(line)->romaji.data();
+                int keylen = tosigned(qcharlen(key));
+
+                int k = len + 1;
+                while (k <= keylen && computeRow(key, k))
+                    ++k;
+
+                int dist = pathbest[std::min(k, keylen)];
+                if (dist <= maxdist)
+                    result.push_back(std::make_pair(line, dist));
+            }
+
+            for (int ix = 0, siz = tosigned(node->nodes.size()); ix != siz; ++ix)
+                walk(node->nodes.items(ix));
+        }
+    private:
+        // Adds every word of node and its child nodes to the result with the same distance.
+        void collect(const TextNode *node, int dist)
+        {
+            for (int line : node->lines)
+                result.push_back(std::make_pair(line, dist));
+            for (int ix = 0, siz = tosigned(node->nodes.size()); ix != siz; ++ix)
+                collect(node->nodes.items(ix), dist);
+        }
+
+        // Fills the row of the distances for the first k characters of key. The rows before
+        // it must be valid for key. Returns false if every distance in the row is too large.
+        bool computeRow(const QChar *key, int k)
+        {
+            if (tosigned(rows.size()) <= k)
+            {
+                rows.resize(k + 1);
+                rows[k].resize(qlen + 1);
+                pathbest.resize(k + 1);
+            }
+
+            const std::vector<int> &prev = rows[k - 1];
+            std::vector<int> &row = rows[k];
+
+            ushort ch = key[k - 1].unicode();
+            int inscost = romajiCheapInsert(key, k - 1) ? similarCheapCost : similarEditCost;
+
+            row[0] = prev[0] + inscost;
+            int rowmin = row[0];
+            for (int j = 1; j <= qlen; ++j)
+            {
+                int val = prev[j] + inscost;
+                val = std::min(val, row[j - 1] + (romajiCheapInsert(q, j - 1) ? similarCheapCost : similarEditCost));
+                if (ch == q[j - 1].unicode())
+                    val = std::min(val, prev[j - 1]);
+                else
+                    val = std::min(val, prev[j - 1] + (romajiCheapSubstitute(q, j - 1, key, k - 1) ? similarCheapCost : similarEditCost));
+                // Swapped letters.
+                if (k > 1 && j > 1 && ch == q[j - 2].unicode() && key[k - 2] == q[j - 1])
+                    val = std::min(val, rows[k - 2][j - 2] + similarEditCost);
+
+                row[j] = val;
+                rowmin = std::min(rowmin, val);
+            }
+
+            pathbest[k] = std::min(pathbest[k - 1], row[qlen]);
+
+            return rowmin <= maxdist;
+        }
+
+        const Dictionary *dict;
+        const QChar *q;
+        int qlen;
+        int maxdist;
+        std::vector<std::pair<int, int>> &result;
+
+        // Distances between the start of the search string and the first k characters of
+        // the current key in rows[k].
+        std::vector<std::vector<int>> rows;
+        // Smallest distance between the whole search string and the first k or fewer
+        // characters of the current key.
+        std::vector<int> pathbest;
+    };
+}
+
+void TextSearchTree::findSimilarWords(std::vector<std::pair<int, int>> &result, QString search, int maxdist)
+{
+#ifdef _DEBUG
+    if (!kana || reversed)
+        throw "Only search for similar words in the kana tree that is not reversed.";
+#endif
+
+    if (search.isEmpty())
+        return;
+
+    PERFTRACE_SCOPE("TextSearchTree::findSimilarWords");
+
+    // The branches of the tree below the top nodes are walked in parallel. Each walker adds
+    // its results to a separate list.
+    TextNodeList &nodes = getNodes();
+    int cnt = tosigned(nodes.size());
+    std::vector<std::vector<std::pair<int, int>>> parts(cnt);
+    parallelFor(0, cnt, 1, [this, &nodes, &parts, &search, maxdist](int first, int last) {
+        for (int ix = first; ix != last; ++ix)
+        {
+            SimilarWordWalker walker(dict, search, maxdist, parts[ix]);
+            walker.walk(nodes.items(ix));
+        }
+    });
+
+    for (const std::vector<std::pair<int, int>> &p : parts)
+        result.insert(result.end(), p.begin(), p.end());
+
+    PERFTRACE_COUNT("findSimilarWords results", tosigned(result.size()));
+}
+
 bool TextSearchTree::isKana() const
 {
     return kana;
@@ -2325,22 +2581,150 @@ std::vector<std::pair<int, QCharString>>::const_iterator StudyDefinitionTree::wo
 //-------------------------------------------------------------
 
 
+namespace
+{
+    // Number of words added to or removed from the commons tree, above which the tree is
+    // rebuilt instead of being updated in place. Every single update walks the whole tree.
+    const int commonsUpdateLimit = 256;
+}
+
+// Merges the new examples data with a snapshot of the words in the commons tree. Builds the
+// replacement tree as well if too many words were added or removed.
+class WordCommonsMerge : public BackgroundTask
+{
+public:
+    WordCommonsMerge(const smartvector<WordCommons> &current, smartvector<WordCommons> &&data);
+    virtual ~WordCommonsMerge();
+protected:
+    virtual bool execute() override;
+private:
+    // Copy of the words and their JLPT data in the commons tree when the merge started.
+    smartvector<WordCommons> snapshot;
+    // The new examples data.
+    smartvector<WordCommons> examples;
+
+    // The merged words in the sorted order of the commons tree.
+    smartvector<WordCommons> result;
+    // Indexes of words in the snapshot not found in the result, in ascending order.
+    std::vector<int> removed;
+    // Indexes of words in the result not found in the snapshot, in ascending order.
+    std::vector<int> added;
+
+    // Built tree when there were too many changes to update the original tree in place.
+    std::unique_ptr<WordCommonsTree> tree;
+
+    friend class WordCommonsTree;
+
+    typedef BackgroundTask  base;
+};
+
+WordCommonsMerge::WordCommonsMerge(const smartvector<WordCommons> &current, smartvector<WordCommons> &&data) : base(), examples(std::move(data))
+{
+    snapshot.reserve(current.size());
+    for (const WordCommons *w : current)
+    {
+        WordCommons *c = new WordCommons;
+        c->kanji = w->kanji;
+        c->kana = w->kana;
+        c->jlptn = w->jlptn;
+        snapshot.push_back(c);
+    }
+}
+
+WordCommonsMerge::~WordCommonsMerge()
+{
+}
+
+bool WordCommonsMerge::execute()
+{
+    PERFTRACE_SCOPE("WordCommonsMerge::execute");
+
+    if (!parallelSort(examples.begin(), examples.end(), [](const WordCommons *a, const WordCommons *b) {
+        return wordcompare(a->kanji.data(), a->kana.data(), b->kanji.data(), b->kana.data()) < 0;
+    }, &token()))
+        return false;
+
+    // The snapshot and the examples are both sorted. Walking them together, words are only
+    // kept from the snapshot if they have JLPT data, and the examples data of the same word
+    // is merged into a single item.
+
+    result.reserve(snapshot.size() + examples.size());
+    int spos = 0;
+    int epos = 0;
+    for (int ssiz = tosigned(snapshot.size()), esiz = tosigned(examples.size()); spos != ssiz || epos != esiz;)
+    {
+        if (token().cancelled())
+            return false;
+
+        WordCommons *s = spos != ssiz ? snapshot[spos] : nullptr;
+        WordCommons *e = epos != esiz ? examples[epos] : nullptr;
+        int cmp = s == nullptr ? 1 : e == nullptr ? -1 : wordcompare(s->kanji.data(), s->kana.data(), e->kanji.data(), e->kana.data());
+
+        if (cmp < 0)
+        {
+            if (s->jlptn != 0)
+            {
+                result.push_back(s);
+                snapshot[spos] = nullptr;
+            }
+            else
+                removed.push_back(spos);
+            ++spos;
+            continue;
+        }
+
+        if (cmp == 0)
+        {
+            e->jlptn = s->jlptn;
+            ++spos;
+        }
+        else
+            added.push_back(tosigned(result.size()));
+
+        result.push_back(e);
+        examples[epos] = nullptr;
+
+        for (++epos; epos != esiz && wordcompare(e->kanji.data(), e->kana.data(), examples[epos]->kanji.data(), examples[epos]->kana.data()) == 0; ++epos)
+            e->examples.append(examples[epos]->examples);
+    }
+
+    PERFTRACE_COUNT("Commons words added", tosigned(added.size()));
+    PERFTRACE_COUNT("Commons words removed", tosigned(removed.size()));
+
+    if (tosigned(added.size() + removed.size()) <= commonsUpdateLimit)
+        return true;
+
+    tree.reset(new WordCommonsTree);
+    tree->list.swap(result);
+    tree->rebuild(false, [this]() { return !token().cancelled(); });
+
+    return !token().cancelled();
+}
+
+
+//-------------------------------------------------------------
+
+
 WordCommonsTree::WordCommonsTree() : base(/*false,*/)
 {
 }
 
 WordCommonsTree::~WordCommonsTree()
 {
+    cancelExamplesData();
 }
 
 void WordCommonsTree::clear()
 {
+    cancelExamplesData();
     list.clear();
     base::clear();
 }
 
 void WordCommonsTree::load(QDataStream &stream)
 {
+    cancelExamplesData();
+
     quint32 cnt;
 
     stream >> cnt;
@@ -2383,8 +2767,10 @@ void WordCommonsTree::save(QDataStream &stream) const
 
 void WordCommonsTree::clearJLPTData()
 {
+    finishExamplesData();
+
     int cnt = tosigned(list.size());
-    bool erased = false;
+    std::vector<int> erased;
     for (int ix = cnt - 1; ix >= 0; --ix)
     {
         WordCommons *w = list[ix];
@@ -2392,20 +2778,21 @@ void WordCommonsTree::clearJLPTData()
             continue;
         if (w->examples.empty())
         {
-            erased = true;
+            erased.push_back(ix);
             list.erase(list.begin() + ix);
         }
         else
             w->jlptn = 0;
     }
-    if (erased)
-        rebuild(false);
+    removeLines(erased);
 }
 
 void WordCommonsTree::clearExamplesData()
 {
+    cancelExamplesData();
+
     int cnt = tosigned(list.size());
-    bool erased = false;
+    std::vector<int> erased;
     for (int ix = cnt - 1; ix >= 0; --ix)
     {
         WordCommons *w = list[ix];
@@ -2413,18 +2800,57 @@ void WordCommonsTree::clearExamplesData()
             continue;
         if (w->jlptn == 0)
         {
-            erased = true;
+            erased.push_back(ix);
             list.erase(list.begin() + ix);
         }
         else
             w->examples.clear();
     }
-    if (erased)
-        rebuild(false);
+    removeLines(erased);
+}
+
+void WordCommonsTree::startExamplesData(smartvector<WordCommons> &&examples)
+{
+    finishExamplesData();
+
+    merge.reset(new WordCommonsMerge(list, std::move(examples)));
+    merge->start();
+}
+
+void WordCommonsTree::finishExamplesData()
+{
+    if (merge == nullptr)
+        return;
+
+    PERFTRACE_SCOPE("WordCommonsTree::finishExamplesData");
+
+    merge->wait();
+    std::unique_ptr<WordCommonsMerge> m = std::move(merge);
+    if (!m->isFinished())
+        return;
+
+    if (m->tree != nullptr)
+    {
+        list.swap(m->tree->list);
+        base::swap(*m->tree);
+        return;
+    }
+
+    // The words in the result keep the order of the words of the snapshot. The lines of the
+    // removed words are removed from the tree first, and then the lines of the added words
+    // are inserted in increasing order, which shifts the lines of the words after them.
+
+    list.swap(m->result);
+    for (auto it = m->removed.rbegin(); it != m->removed.rend(); ++it)
+        removeLine(*it, true);
+    for (int ix : m->added)
+        doExpand(ix, true);
 }
 
 int WordCommonsTree::addJLPTN(const QChar *kanji, const QChar *kana, int jlptN, bool insertsorted)
 {
+    finishExamplesData();
+
     int ix = tosigned(list.size());
     
     WordCommons *wc = nullptr;
@@ -2461,6 +2887,8 @@ bool WordCommonsTree::removeJLPTN(int commonsindex)
         throw "Index out of bounds.";
 #endif
 
+    finishExamplesData();
+
     WordCommons *wc = list[commonsindex];
     wc->jlptn = 0;
     if (!wc->examples.empty())
@@ -2474,6 +2902,8 @@ bool WordCommonsTree::removeJLPTN(int commonsindex)
 
 int WordCommonsTree::addExample(const QChar *kanji, const QChar *kana, const WordCommonsExample &data)
 {
+    finishExamplesData();
+
     int ix = -1;
 
     if (!insertIndex(kanji, kana, ix))
@@ -2500,6 +2930,8 @@ int WordCommonsTree::addExample(const QChar *kanji, const QChar *kana, const Wor
 
 void WordCommonsTree::rebuild(bool checkandsort, const std::function<bool()> &callback)
 {
+    finishExamplesData();
+
     if (checkandsort && list.size() > 1)
     {
 
@@ -2565,11 +2997,11 @@ WordCommons* WordCommonsTree::findWord(const QChar *kanji, const QChar *kana, co
     if (kanji == nullptr || kana == nullptr)
         return nullptr;
 
-    QString r;
+    TransliterationBuffer r;
     if (romaji == nullptr)
-        r = romanize(kana);
+        romanize(kana, -1, r);
     else
-        r = QString(romaji);
+        r.append(romaji, tosigned(qcharlen(romaji)));
     TextNode *n;
     findContainer(r.constData(), r.size(), n);
 
@@ -2589,6 +3021,8 @@ WordCommons* WordCommonsTree::findWord(const QChar *kanji, const QChar *kana, co
 
 WordCommons* WordCommonsTree::addWord(const QChar *kanji, const QChar *kana)
 {
+    finishExamplesData();
+
     WordCommons *dat = new WordCommons;
     dat->kanji.copy(kanji);
     dat->kana.copy(kana);
@@ -2613,6 +3047,31 @@ WordCommonsTree::size_type WordCommonsTree::size() const
     return list.size();
 }
 
+void WordCommonsTree::cancelExamplesData()
+{
+    if (merge == nullptr)
+        return;
+
+    merge->cancel();
+    merge->wait();
+    merge.reset();
+}
+
+void WordCommonsTree::removeLines(const std::vector<int> &lines)
+{
+    if (lines.empty())
+        return;
+
+    if (tosigned(lines.size()) > commonsUpdateLimit)
+    {
+        base::rebuild();
+        return;
+    }
+
+    for (int line : lines)
+        removeLine(line, true);
+}
+
 bool WordCommonsTree::insertIndex(const QChar *kanji, const QChar *kana, int &index) const
 {
     auto it = std::lower_bound(list.begin(), list.end(), nullptr, [kanji, kana](const WordCommons *c, void *) {
@@ -2730,6 +3189,8 @@ void WordExamplesTree::reset()
 
 void WordExamplesTree::rebuild()
 {
+    PERFTRACE_SCOPE("WordExamplesTree::rebuild");
+
     const auto &ids = ZKanji::sentences.getIdList();
     if (ids.empty())
     {
@@ -2740,35 +3201,37 @@ void WordExamplesTree::rebuild()
     std::vector<int> order;
     order.resize(ids.size());
     std::iota(order.begin(), order.end(), 0);
-    std::sort(order.begin(), order.end(), [&ids](int a, int b) {
+    parallelSort(order.begin(), order.end(), [&ids](int a, int b) {
         int dif = ids[a].first - ids[b].first;
         if (dif != 0)
             return dif < 0;
         return ids[a].second < ids[b].second;
     });
 
-    for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
-    {
-        auto &arr = list[ix]->data;
-        auto pos = order.begin();
-        for (int iy = 0, siz2 = tosigned(arr.size()); iy != siz2; ++iy)
+    // Only the current example indexes change. The words and the tree stay the same, so the
+    // tree is not rebuilt.
+    parallelFor(0, tosigned(list.size()), 1024, [this, &ids, &order](int first, int last) {
+        for (int ix = first; ix != last; ++ix)
         {
-            auto it = std::lower_bound(pos, order.end(), arr[iy], [&ids](int o, const std::tuple<int, int, int> &val) {
-                int dif = ids[o].first - std::get<0>(val);
-                if (dif != 0)
-                    return dif < 0;
-                return ids[o].second < std::get<1>(val);
-            });
-
-            if (ids[*it].first == std::get<0>(arr[iy]) && ids[*it].second == std::get<1>(arr[iy]))
-                std::get<2>(arr[iy]) = *it;
-            else
-                std::get<2>(arr[iy]) = -1;
-            pos = it;
+            auto &arr = list[ix]->data;
+            auto pos = order.begin();
+            for (int iy = 0, siz2 = tosigned(arr.size()); iy != siz2; ++iy)
+            {
+                auto it = std::lower_bound(pos, order.end(), arr[iy], [&ids](int o, const std::tuple<int, int, int> &val) {
+                    int dif = ids[o].first - std::get<0>(val);
+                    if (dif != 0)
+                        return dif < 0;
+                    return ids[o].second < std::get<1>(val);
+                });
+
+                if (it != order.end() && ids[*it].first == std::get<0>(arr[iy]) && ids[*it].second == std::get<1>(arr[iy]))
+                    std::get<2>(arr[iy]) = *it;
+                else
+                    std::get<2>(arr[iy]) = -1;
+                pos = it;
+            }
         }
-    }
-
-    base::rebuild();
+    });
 }
 
 void WordExamplesTree::linkExample(const QChar *kanji, const QChar *kana, int exampleindex, bool set)
@@ -2861,15 +3324,19 @@ int WordExamplesTree::findWordIndex(const QChar *kanji, const QChar *kana, const
     if (kanji == nullptr || kana == nullptr)
         return -1;
 
-    QString r;
+    TransliterationBuffer r;
+    int romajilen;
     if (romaji == nullptr)
     {
-        r = romanize(kana);
+        romanize(kana, -1, r);
         romaji = r.constData();
+        romajilen = r.size();
     }
+    else
+        romajilen = tosigned(qcharlen(romaji));
 
     const TextNode *n;
-    findContainer(romaji, tosigned(qcharlen(romaji)), n);
+    findContainer(romaji, romajilen, n);
 
     if (n == nullptr)
         return -1;
@@ -2889,7 +3356,7 @@ int WordExamplesTree::findWordIndex(const QChar *kanji, const QChar *kana, const
 //-------------------------------------------------------------
 
 
-Dictionary::Dictionary() : mod(false), usermod(false), dtree(this, false, false), ktree(this, true, false), btree(this, true, true), wordstudydefs(this), studydecks(new StudyDeckList)
+Dictionary::Dictionary() : mod(false), usermod(false), dtree(this, false, false), ktree(this, true, false), btree(this, true, true), wordstudydefs(this), studydecks(new StudyDeckList), journal(new UserDataJournal(this))
 {
     groups = new Groups(this);
 
@@ -2907,7 +3374,7 @@ Dictionary::Dictionary() : mod(false), usermod(false), dtree(this, false, false)
 Dictionary::Dictionary(smartvector<WordEntry> &&words, TextSearchTree &&dtree, TextSearchTree &&ktree, TextSearchTree &&btree,
     smartvector<KanjiDictData> &&kanjidata, std::map<ushort, std::vector<int>> &&symdata, std::map<ushort, std::vector<int>> &&kanadata,
     std::vector<int> &&abcde, std::vector<int> &&aiueo) : words(std::move(words)), dtree(this, std::move(dtree)), ktree(this, std::move(ktree)), btree(this, std::move(btree)),
-    kanjidata(std::move(kanjidata)), symdata(std::move(symdata)), kanadata(std::move(kanadata)), abcde(std::move(abcde)), aiueo(std::move(aiueo)), wordstudydefs(this), studydecks(new StudyDeckList)
+    kanjidata(std::move(kanjidata)), symdata(std::move(symdata)), kanadata(std::move(kanadata)), abcde(std::move(abcde)), aiueo(std::move(aiueo)), wordstudydefs(this), studydecks(new StudyDeckList), journal(new UserDataJournal(this))
 {
     groups = new Groups(this);
     decks = new WordDeckList(this);
@@ -2943,6 +3410,8 @@ Dictionary::~Dictionary()
 
 void Dictionary::loadBaseFile(const QString &filename)
 {
+    PERFTRACE_SCOPE("Dictionary::loadBaseFile");
+
     QFile f(filename);
 
     if (!f.open(QIODevice::ReadOnly))
@@ -3086,6 +3555,7 @@ void Dictionary::loadBase(QDataStream &stream)
         stream >> k->meanings;
     }
 
+    ZKanji::packKanjiText();
     ZKanji::generateValidKanji();
 
     quint16 u16;
@@ -3119,6 +3589,8 @@ void Dictionary::loadBase(QDataStream &stream)
 
 void Dictionary::loadFile(const QString &filename, bool maindict, bool skiporiginals)
 {
+    PERFTRACE_SCOPE("Dictionary::loadFile");
+
     QFile f(filename);
 
     setName(QFileInfo(filename).baseName());
@@ -3147,6 +3619,9 @@ void Dictionary::loadFile(const QString &filename, bool maindict, bool skiporigi
     if (!good || (oldver && version < 10))
         throw ZException("Invalid or corrupted dictionary file version.");
 
+    furigana.clear();
+    kanjireadings.clear();
+
     if (oldver)
         loadLegacy(stream, version, maindict, skiporiginals);
     else
@@ -3348,6 +3823,11 @@ void Dictionary::load(QDataStream &stream)
         aiueo[ix] = i32;
     }
 
+    if (version >= 2)
+        furigana.load(dstream, tosigned(words.size()));
+    else
+        furigana.clear();
+
     if (!dstream.atEnd())
     {
         QByteArray arr;
@@ -3365,6 +3845,11 @@ void Dictionary::load(QDataStream &stream)
 
 void Dictionary::loadUserDataFile(const QString &filename, bool emitreset)
 {
+    PERFTRACE_SCOPE("Dictionary::loadUserDataFile");
+
+    // The journal only belongs to the user data that was loaded at startup.
+    journal->close();
+
     QFile f(filename);
 
     if (!f.open(QIODevice::ReadOnly))
@@ -3953,6 +4438,10 @@ Error Dictionary::save(const QString &filename)
 
         errorcode = 10;
 
+        // Furigana of every word, computed for words not in the cache yet.
+        furigana.build(words);
+        furigana.save(dstream);
+
         // The dictionary flag SVG image data if present. This must come at the end of the
         // uncompressed data, because it is missing for dictionaries with no image.
 
@@ -4109,6 +4598,11 @@ Error Dictionary::saveUserData(const QString &filename)
         return Error(Error::Write, errorcode);
     }
 
+    // The journal must be restarted after the file is closed, to match its final size and
+    // modification date.
+    f.close();
+    journal->userDataSaved(filename);
+
     // Update modified status.
     usermod = false;
     emit userDataModified(false);
@@ -4116,10 +4610,16 @@ Error Dictionary::saveUserData(const QString &filename)
     return true;
 }
 
-void Dictionary::exportUserData(const QString &filename, std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings)
+void Dictionary::exportUserData(const QString &filename, std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings, bool binary)
 {
     // TODO: error reporting to users, generally in every file operation.
 
+    if (binary)
+    {
+        exportUserDataBinary(filename, kgroups, kexamples, wgroups, usermeanings);
+        return;
+    }
+
     QFile f(filename);
     if (!f.open(QIODevice::WriteOnly | QIODevice::Text))
         return;
@@ -4186,63 +4686,10 @@ void Dictionary::exportUserData(const QString &filename, std::vector<KanjiGroup*
     // Word indexes paired with their user definition string. Each item is
     // unique.
     std::vector<std::pair<int, const QCharString&>> defs;
-    // Indexes of words already checked for user definition. If the index is
-    // in found, it shouldn't be added to defs.
-    std::set<int> found;
-
     // Word examples selected for kanji. The numbers in the pair are:
     // <kanji_index, word_index_list>
     std::vector<std::pair<int, const std::vector<int>&>> kwords;
-    // Indexes of kanji already checked for example words.
-    std::set<int> kfound;
-
-    // Check if there are words as kanji examples, and whether there are user definitions for
-    // them (unless usermeanings is false).
-    for (int ix = 0, siz = tosigned(kgroups.size()); (kexamples || usermeanings) && ix != siz; ++ix)
-    {
-        KanjiGroup *g = kgroups[ix];
-        for (int iy = 0, sizy = tosigned(g->size()); (kexamples || usermeanings) && iy != sizy; ++iy)
-        {
-            int kix = g->items(iy)->index;
-            const std::vector<int> &ex = kanjidata[kix]->ex;
-
-            if (kexamples && !kfound.count(kix))
-            {
-                kfound.insert(kix);
-                kwords.push_back(std::make_pair(kix, ex));
-            }
-
-            for (int iz = 0, sizz = tosigned(ex.size()); usermeanings && iz != sizz; ++iz)
-            {
-                int wix = ex[iz];
-                if (found.count(wix) != 0)
-                    continue;
-                found.insert(wix);
-                const QCharString *str = wordstudydefs.itemDef(wix);
-                if (str == nullptr)
-                    continue;
-                defs.push_back(std::pair<int, const QCharString&>(wix, *str));
-            }
-        }
-    }
-
-    // Check for user definitions for words in words list.
-    for (int ix = 0, siz = tosigned(wgroups.size()); usermeanings && ix != siz; ++ix)
-    {
-        WordGroup *g = wgroups[ix];
-        const std::vector<int> &indexes = g->getIndexes();
-        for (int iy = 0, sizy = tosigned(indexes.size()); iy != sizy; ++iy)
-        {
-            int wix = indexes[iy];
-            if (found.count(wix))
-                continue;
-            found.insert(wix);
-            const QCharString *str = wordstudydefs.itemDef(wix);
-            if (str == nullptr)
-                continue;
-            defs.push_back(std::pair<int, const QCharString&>(wix, *str));
-        }
-    }
+    userExportData(kgroups, kexamples, wgroups, usermeanings, defs, kwords);
 
     if (!defs.empty())
     {
@@ -4335,6 +4782,189 @@ void Dictionary::exportUserData(const QString &filename, std::vector<KanjiGroup*
     }
 }
 
+void Dictionary::exportUserDataBinary(const QString &filename, std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings)
+{
+    // Binary user data export format:
+    //
+    // The file starts with "zux" and the 3 character file version. ("zud" is taken by the
+    // user data files.) The rest of the file is a list of sections, each starting with a
+    // byte of UserExportSection. The End section closes the file. Study decks are not
+    // exported, the same as in the text format.
+    // The Words section lists every exported word once, in chunks of at most
+    // userExportChunkSize words. Each chunk starts with the number of words in it, and an
+    // empty chunk ends the section. A word is its wordKey() hash, followed by the written
+    // form and kana reading. The other sections refer to the words by their position in
+    // this list.
+    // The Definitions section is the number of definitions, then for each the word position
+    // and the user definition.
+    // The KanjiExamples section is the number of kanji, then for each the kanji character
+    // and the number and positions of its example words.
+    // The KanjiGroups section is the number of groups, then for each the full encoded group
+    // name and the number of kanji and the kanji characters in it.
+    // The WordGroups section is the same, with word positions instead of kanji.
+
+    QFile f(filename);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return;
+
+    QDataStream stream(&f);
+    stream.setVersion(QDataStream::Qt_5_5);
+    stream.setByteOrder(QDataStream::LittleEndian);
+
+    stream.writeRawData("zux", 3);
+    stream.writeRawData(ZKANJI_USER_EXPORT_FILE_VERSION, 3);
+
+    std::vector<std::pair<int, const QCharString&>> defs;
+    std::vector<std::pair<int, const std::vector<int>&>> kwords;
+    userExportData(kgroups, kexamples, wgroups, usermeanings, defs, kwords);
+
+    // Position of each word in the written word list, or -1 for words not exported.
+    std::vector<int> wordpos(words.size(), -1);
+    // Indexes of the exported words in the order they are written.
+    std::vector<int> wlist;
+    auto listWord = [&wordpos, &wlist](int windex) {
+        if (wordpos[windex] != -1)
+            return;
+        wordpos[windex] = tosigned(wlist.size());
+        wlist.push_back(windex);
+    };
+
+    for (const std::pair<int, const QCharString&> &d : defs)
+        listWord(d.first);
+    for (const std::pair<int, const std::vector<int>&> &k : kwords)
+        for (int windex : k.second)
+            listWord(windex);
+    for (const WordGroup *g : wgroups)
+        for (int windex : g->getIndexes())
+            listWord(windex);
+
+    stream << (quint8)UserExportSection::Words;
+    for (int ix = 0, siz = tosigned(wlist.size()); ix != siz;)
+    {
+        int last = std::min(siz, ix + userExportChunkSize);
+        stream << (qint32)(last - ix);
+        for (; ix != last; ++ix)
+        {
+            WordEntry *w = words[wlist[ix]];
+            stream << (quint64)wordKey(w->kanji.data(), w->kanji.size(), w->kana.data(), w->kana.size());
+            stream << make_zstr(w->kanji, ZStrFormat::Byte);
+            stream << make_zstr(w->kana, ZStrFormat::Byte);
+        }
+    }
+    stream << (qint32)0;
+
+    if (!defs.empty())
+    {
+        stream << (quint8)UserExportSection::Definitions;
+        stream << (qint32)defs.size();
+        for (const std::pair<int, const QCharString&> &d : defs)
+            stream << (qint32)wordpos[d.first] << make_zstr(d.second, ZStrFormat::Int);
+    }
+
+    if (!kwords.empty())
+    {
+        stream << (quint8)UserExportSection::KanjiExamples;
+        stream << (qint32)kwords.size();
+        for (const std::pair<int, const std::vector<int>&> &k : kwords)
+        {
+            stream << (quint16)ZKanji::kanjis[k.first]->ch.unicode();
+            stream << (qint32)k.second.size();
+            for (int windex : k.second)
+                stream << (qint32)wordpos[windex];
+        }
+    }
+
+    if (!kgroups.empty())
+    {
+        stream << (quint8)UserExportSection::KanjiGroups;
+        stream << (qint32)kgroups.size();
+        for (const KanjiGroup *g : kgroups)
+        {
+            QString name = g->fullEncodedName();
+            stream << make_zstr(name, ZStrFormat::Int);
+            const std::vector<ushort> &indexes = g->getIndexes();
+            stream << (qint32)indexes.size();
+            for (ushort kindex : indexes)
+                stream << (quint16)ZKanji::kanjis[kindex]->ch.unicode();
+        }
+    }
+
+    if (!wgroups.empty())
+    {
+        stream << (quint8)UserExportSection::WordGroups;
+        stream << (qint32)wgroups.size();
+        for (const WordGroup *g : wgroups)
+        {
+            QString name = g->fullEncodedName();
+            stream << make_zstr(name, ZStrFormat::Int);
+            const std::vector<int> &indexes = g->getIndexes();
+            stream << (qint32)indexes.size();
+            for (int windex : indexes)
+                stream << (qint32)wordpos[windex];
+        }
+    }
+
+    stream << (quint8)UserExportSection::End;
+}
+
+void Dictionary::userExportData(std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings, std::vector<std::pair<int, const QCharString&>> &defs, std::vector<std::pair<int, const std::vector<int>&>> &kwords)
+{
+    // Indexes of words already checked for user definition. If the index is
+    // in found, it shouldn't be added to defs.
+    std::set<int> found;
+
+    // Indexes of kanji already checked for example words.
+    std::set<int> kfound;
+
+    // Check if there are words as kanji examples, and whether there are user definitions for
+    // them (unless usermeanings is false).
+    for (int ix = 0, siz = tosigned(kgroups.size()); (kexamples || usermeanings) && ix != siz; ++ix)
+    {
+        KanjiGroup *g = kgroups[ix];
+        for (int iy = 0, sizy = tosigned(g->size()); (kexamples || usermeanings) && iy != sizy; ++iy)
+        {
+            int kix = g->items(iy)->index;
+            const std::vector<int> &ex = kanjidata[kix]->ex;
+
+            if (kexamples && !kfound.count(kix))
+            {
+                kfound.insert(kix);
+                kwords.push_back(std::make_pair(kix, ex));
+            }
+
+            for (int iz = 0, sizz = tosigned(ex.size()); usermeanings && iz != sizz; ++iz)
+            {
+                int wix = ex[iz];
+                if (found.count(wix) != 0)
+                    continue;
+                found.insert(wix);
+                const QCharString *str = wordstudydefs.itemDef(wix);
+                if (str == nullptr)
+                    continue;
+                defs.push_back(std::pair<int, const QCharString&>(wix, *str));
+            }
+        }
+    }
+
+    // Check for user definitions for words in words list.
+    for (int ix = 0, siz = tosigned(wgroups.size()); usermeanings && ix != siz; ++ix)
+    {
+        WordGroup *g = wgroups[ix];
+        const std::vector<int> &indexes = g->getIndexes();
+        for (int iy = 0, sizy = tosigned(indexes.size()); iy != sizy; ++iy)
+        {
+            int wix = indexes[iy];
+            if (found.count(wix))
+                continue;
+            found.insert(wix);
+            const QCharString *str = wordstudydefs.itemDef(wix);
+            if (str == nullptr)
+                continue;
+            defs.push_back(std::pair<int, const QCharString&>(wix, *str));
+        }
+    }
+}
+
 void Dictionary::exportDictionary(const QString &filename, bool limit, const std::vector<ushort> &kanjilimit, const std::vector<int> wordlimit)
 {
     // TODO: error reporting to users, generally in every file operation.
@@ -4433,16 +5063,31 @@ void Dictionary::exportDictionary(const QString &filename, bool limit, const std
     if (!limit || !wordlimit.empty())
         stream << "[Words]\n";
 
-    for (int ix = 0, siz = tosigned(!limit ? words.size() : wordlimit.size()); ix != siz; ++ix)
+    // The paragraphs of the words are formatted in parallel in blocks, and each block is
+    // written in order before the next one is formatted.
+    const int blocksize = 16384;
+    std::vector<QString> paragraphs;
+    for (int pos = 0, siz = tosigned(!limit ? words.size() : wordlimit.size()); pos < siz; pos += blocksize)
     {
-        WordEntry *e = words[!limit ? ix : wordlimit[ix]];
-        stream << QString("%1(%2) %3 %4\n").arg(e->kanji.toQStringRaw()).arg(e->kana.toQStringRaw()).arg(e->freq).arg(Strings::wordInfoTags(e->inf));
+        int blockend = std::min(siz, pos + blocksize);
+        paragraphs.resize(blockend - pos);
+        parallelFor(pos, blockend, 512, [this, limit, &wordlimit, &paragraphs, pos](int first, int last) {
+            for (int ix = first; ix != last; ++ix)
+            {
+                WordEntry *e = words[!limit ? ix : wordlimit[ix]];
+                QString &str = paragraphs[ix - pos];
+                str = QString("%1(%2) %3 %4\n").arg(e->kanji.toQStringRaw()).arg(e->kana.toQStringRaw()).arg(e->freq).arg(Strings::wordInfoTags(e->inf));
 
-        for (int iy = 0, siy = tounsigned(e->defs.size()); iy != siy; ++iy)
-        {
-            auto &def = e->defs[iy];
-            stream << QString("D: %1%2%3%4\t%5\n").arg(Strings::wordTypeTags(def.attrib.types)).arg(Strings::wordNoteTags(def.attrib.notes)).arg(Strings::wordFieldTags(def.attrib.fields)).arg(Strings::wordDialectTags(def.attrib.dialects)).arg(def.def.toQStringRaw());
-        }
+                for (int iy = 0, siy = tounsigned(e->defs.size()); iy != siy; ++iy)
+                {
+                    auto &def = e->defs[iy];
+                    str += QString("D: %1%2%3%4\t%5\n").arg(Strings::wordTypeTags(def.attrib.types)).arg(Strings::wordNoteTags(def.attrib.notes)).arg(Strings::wordFieldTags(def.attrib.fields)).arg(Strings::wordDialectTags(def.attrib.dialects)).arg(def.def.toQStringRaw());
+                }
+            }
+        });
+
+        for (const QString &str : paragraphs)
+            stream << str;
     }
 
     if (!limit || !kanjilimit.empty())
@@ -4676,6 +5321,8 @@ void Dictionary::swapDictionaries(Dictionary *src, std::map<int, int> &changes)
     std::swap(kanadata, src->kanadata);
     std::swap(abcde, src->abcde);
     std::swap(aiueo, src->aiueo);
+    furigana.swap(src->furigana);
+    kanjireadings.swap(src->kanjireadings);
     // Saving user data in the source dictionary, to be able to restore them on an error.
     src->wordstudydefs.copy(&wordstudydefs);
     src->groups->copy(groups);
@@ -4725,6 +5372,8 @@ void Dictionary::restoreChanges(Dictionary *src)
     std::swap(kanadata, src->kanadata);
     std::swap(abcde, src->abcde);
     std::swap(aiueo, src->aiueo);
+    furigana.swap(src->furigana);
+    kanjireadings.swap(src->kanjireadings);
     // Saving user data in the source dictionary, to be able to restore them on an error.
     wordstudydefs.copy(&src->wordstudydefs);
     groups->copy(src->groups);
@@ -4755,6 +5404,8 @@ bool Dictionary::isUserModified() const
 
 void Dictionary::setToUserModified()
 {
+    journal->userDataModified();
+
     if (usermod)
         return;
 
@@ -4816,6 +5467,8 @@ void Dictionary::removeEntry(int windex)
     decks->processRemovedWord(windex);
 
     words.erase(words.begin() + windex);
+    furigana.erase(windex);
+    kanjireadings.clear();
 
     emit entryRemoved(windex, abcdeix, aiueoix);
 
@@ -4862,6 +5515,23 @@ StudyDeckList* Dictionary::studyDecks()
     return studydecks.get();
 }
 
+UserDataJournal* Dictionary::userJournal()
+{
+    return journal.get();
+}
+
+void Dictionary::wordFurigana(int windex, std::vector<FuriganaData> &result)
+{
+    furigana.get(windex, words[windex], result);
+}
+
+const KanjiReadingIndex& Dictionary::kanjiReadingIndex()
+{
+    if (!kanjireadings.isBuilt())
+        kanjireadings.build(words, furigana);
+    return kanjireadings;
+}
+
 //int Dictionary::wordDeckCount() const
 //{
 //    return worddecks.size();
@@ -5081,7 +5751,7 @@ void Dictionary::setKanjiMeaning(short ix, QStringList &list)
 //    return std::move(result);
 //}
 
-void Dictionary::findWords(WordResultList &result, SearchMode searchmode, QString search, SearchWildcards wildcards, bool sameform, bool inflections, bool studydefs, const std::vector<int> *wordpool, const WordFilterConditions *conditions)
+void Dictionary::findWords(WordResultList &result, SearchMode searchmode, QString search, SearchWildcards wildcards, bool sameform, bool inflections, bool studydefs, const std::vector<int> *wordpool, const WordFilterConditions *conditions, bool similar)
 {
 #ifdef _DEBUG
     if (searchmode == SearchMode::Browse)
@@ -5091,6 +5761,8 @@ void Dictionary::findWords(WordResultList &result, SearchMode searchmode, QStrin
     if (search.isEmpty())
         return;
 
+    PERFTRACE_SCOPE("Dictionary::findWords");
+
     std::vector<int> wpool;
     if (wordpool != nullptr)
     {
@@ -5126,6 +5798,19 @@ void Dictionary::findWords(WordResultList &result, SearchMode searchmode, QStrin
         else
             findKanaWords(lines, search, wildcards, sameform, wordpool != nullptr ? &wpool : nullptr, conditions);
 
+        // A kana search can find nothing because of a typing mistake. Words with a similar
+        // kana form are listed instead in that case, if the caller asked for it. Exact
+        // searches never list similar words.
+        bool findsimilar = similar && !kanjisearch && !sameform && (wildcards & SearchWildcard::AnyBefore) == 0 && (wildcards & SearchWildcard::AnyAfter) != 0;
+        auto addSimilar = [&]() {
+            if (!findsimilar || !result.empty())
+                return;
+            std::vector<int> similarwords;
+            findSimilarKanaWords(similarwords, search, wordpool != nullptr ? &wpool : nullptr, conditions);
+            result.set(std::move(similarwords));
+            result.setSimilarWords(true);
+        };
+
         // Searching for deinflected results must end with the deinflected form.
         wildcards &= ~(int)SearchWildcard::AnyAfter;
 
@@ -5135,7 +5820,11 @@ void Dictionary::findWords(WordResultList &result, SearchMode searchmode, QStrin
 
         result.set(lines);
         if (deinfs.empty())
+        {
+            addSimilar();
+            PERFTRACE_COUNT("findWords results", tosigned(result.size()));
             return;
+        }
 
         for (int ix = 0, siz = tosigned(deinfs.size()); ix != siz; ++ix)
         {
@@ -5176,6 +5865,8 @@ void Dictionary::findWords(WordResultList &result, SearchMode searchmode, QStrin
             }
         }
 
+        addSimilar();
+        PERFTRACE_COUNT("findWords results", tosigned(result.size()));
         //if (sort)
         //    result.jpSort();
         return;
@@ -5245,6 +5936,7 @@ void Dictionary::findWords(WordResultList &result, SearchMode searchmode, QStrin
         }
 
         result.set(lines);
+        PERFTRACE_COUNT("findWords results", tosigned(result.size()));
         //if (sort)
         //    result.defSort(search);
         return;
@@ -5370,6 +6062,8 @@ bool Dictionary::wordMatches(int windex, SearchMode searchmode, QString search,
 
 void Dictionary::findKanjiWords(std::vector<int> &result, QString search, SearchWildcards wildcards, bool sameform, const std::vector<int> *wordpool, const WordFilterConditions *conditions, int infsize) const
 {
+    PERFTRACE_SCOPE("Dictionary::findKanjiWords");
+
     // When changing this, also update wordMatchesKanjiSearch().
 
     // List of words for the top 3 kanji or symbol with the least number of words.
@@ -5559,6 +6253,8 @@ bool Dictionary::wordMatchesKanjiSearch(int windex, QString search, SearchWildca
 
 void Dictionary::findKanaWords(std::vector<int> &result, QString search, SearchWildcards wildcards, bool sameform, const std::vector<int> *wordpool, const WordFilterConditions *conditions, int infsize)
 {
+    PERFTRACE_SCOPE("Dictionary::findKanaWords");
+
     // When changing this, also update wordMatchesKanaSearch().
 
 
@@ -5708,13 +6404,56 @@ bool Dictionary::wordMatchesKanaSearch(int windex, QString search, SearchWildcar
     return false;
 }
 
+void Dictionary::findSimilarKanaWords(std::vector<int> &result, QString search, const std::vector<int> *wordpool, const WordFilterConditions *conditions)
+{
+    PERFTRACE_SCOPE("Dictionary::findSimilarKanaWords");
+
+    QString romaji = romanize(search);
+
+    // Short search strings are similar to too many words to be useful.
+    if (romaji.size() < 3)
+        return;
+
+    // Longer search strings can have more mistakes. An ordinary edit costs 2.
+    int maxdist = romaji.size() < 5 ? 2 : romaji.size() < 9 ? 3 : 4;
+
+    std::vector<std::pair<int, int>> found;
+    ktree.findSimilarWords(found, romaji, maxdist);
+
+    // Only the smallest distance of each word is kept.
+    std::sort(found.begin(), found.end());
+    found.resize(std::unique(found.begin(), found.end(), [](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+        return a.first == b.first;
+    }) - found.begin());
+
+    if (wordpool != nullptr || conditions != nullptr)
+    {
+        found.resize(std::remove_if(found.begin(), found.end(), [this, wordpool, conditions](const std::pair<int, int> &p) {
+            return (wordpool != nullptr && !std::binary_search(wordpool->begin(), wordpool->end(), p.first)) ||
+                (conditions != nullptr && !ZKanji::wordfilters().match(words[p.first], conditions));
+        }) - found.begin());
+    }
+
+    std::sort(found.begin(), found.end(), [this](const std::pair<int, int> &a, const std::pair<int, int> &b) {
+        if (a.second != b.second)
+            return a.second < b.second;
+        if (words[a.first]->freq != words[b.first]->freq)
+            return words[a.first]->freq > words[b.first]->freq;
+        return a.first < b.first;
+    });
+
+    result.reserve(result.size() + found.size());
+    for (const std::pair<int, int> &p : found)
+        result.push_back(p.first);
+}
+
 int Dictionary::findKanjiKanaWord(const QChar *kanji, const QChar *kana, const QChar *romaji, int kanjilen, int kanalen, int romajilen)
 {
-    QCharString tmp;
+    TransliterationBuffer tmp;
     if (romaji == nullptr)
     {
-        tmp.copy(romanize(kana, kanalen).constData());
-        romaji = tmp.data();
+        romanize(kana, kanalen, tmp);
+        romaji = tmp.constData();
         romajilen = tmp.size();
     }
 
@@ -5770,7 +6509,9 @@ std::function<bool(int, const QChar*)> Dictionary::browseOrderCompareFunc(Browse
     return [this](int a, const QChar *rb) {
         //QString tmpa;
         //const QChar *ra = a == -1 ? r.constData() : (tmpa = hiraganize(words[a]->kana)).constData();
-        QString tmpa = hiraganize(words[a]->kana);
+        TransliterationBuffer tmpa;
+        hiraganize(words[a]->kana.data(), words[a]->kana.size(), tmpa);
+        tmpa.append(QChar(0));
         const QChar *ra = tmpa.constData();
     
         return qcharcmp(ra, rb) < 0;
@@ -5791,12 +6532,19 @@ std::function<bool(int, int, const QChar*, const QChar*)> Dictionary::browseOrde
 
     return [this](int a, int b, const QChar *astr, const QChar *bstr) {
 
-        QString tmpa;
+        // The buffers are null terminated for the comparison.
+        TransliterationBuffer tmpa;
         if (!astr)
-            tmpa = hiraganize(words[a]->kana);
-        QString tmpb;
+        {
+            hiraganize(words[a]->kana.data(), words[a]->kana.size(), tmpa);
+            tmpa.append(QChar(0));
+        }
+        TransliterationBuffer tmpb;
         if (!bstr)
-            tmpb = hiraganize(words[b]->kana);
+        {
+            hiraganize(words[b]->kana.data(), words[b]->kana.size(), tmpb);
+            tmpb.append(QChar(0));
+        }
         const QChar *ra = astr ? astr : tmpa.constData();
         const QChar *rb = bstr ? bstr : tmpb.constData();
 
@@ -6152,21 +6900,76 @@ void Dictionary::listUsedWords(std::vector<int> &result)
     if (result.empty())
         return;
 
-    std::sort(result.begin(), result.end());
+    parallelSort(result.begin(), result.end(), std::less<int>());
     result.resize(std::unique(result.begin(), result.end()) - result.begin());
 }
 
+namespace
+{
+    // Hash of the kanji and kana of a word, used for matching the words of two dictionaries.
+    uint writtenFormHash(const WordEntry *e)
+    {
+        uint h = qHashBits(e->kanji.data(), e->kanji.size() * sizeof(QChar));
+        return qHashBits(e->kana.data(), e->kana.size() * sizeof(QChar), h);
+    }
+}
+
 std::map<int, int> Dictionary::mapWords(Dictionary *src, const std::vector<int> &wlist)
 {
-    std::map<int, int> tmp;
-    //tmp.reserve(wlist.size());
+    PERFTRACE_SCOPE("Dictionary::mapWords");
+
+    // The words are matched with a hash join. Every word of this dictionary is placed in an
+    // open addressing table by the hash of its kanji and kana, and the words of wlist are
+    // looked up in the table in parallel.
+
+    int siz = tosigned(words.size());
+    std::vector<uint> hashes(siz);
+    parallelFor(0, siz, 4096, [this, &hashes](int first, int last) {
+        for (int ix = first; ix != last; ++ix)
+            hashes[ix] = writtenFormHash(words[ix]);
+    });
 
-    for (int ix = 0, siz = tosigned(wlist.size()); ix != siz; ++ix)
+    // The table is at most half full, which keeps the probe sequences short.
+    uint tablesize = 1;
+    while (tablesize < tounsigned(siz) * 2)
+        tablesize <<= 1;
+    uint mask = tablesize - 1;
+
+    std::vector<int> table(tablesize, -1);
+    for (int ix = 0; ix != siz; ++ix)
     {
-        WordEntry *e = src->wordEntry(wlist[ix]);
-        tmp.insert(std::make_pair(wlist[ix], findKanjiKanaWord(e)));
+        uint pos = hashes[ix] & mask;
+        while (table[pos] != -1)
+            pos = (pos + 1) & mask;
+        table[pos] = ix;
     }
 
+    int lsiz = tosigned(wlist.size());
+    std::vector<int> found(lsiz);
+    parallelFor(0, lsiz, 1024, [this, src, &wlist, &hashes, &table, mask, &found](int first, int last) {
+        for (int ix = first; ix != last; ++ix)
+        {
+            const WordEntry *e = src->words[wlist[ix]];
+            uint h = writtenFormHash(e);
+
+            int windex = -1;
+            for (uint pos = h & mask; table[pos] != -1 && windex == -1; pos = (pos + 1) & mask)
+            {
+                int tix = table[pos];
+                const WordEntry *w = words[tix];
+                if (hashes[tix] == h && w->kanji == e->kanji && w->kana == e->kana)
+                    windex = tix;
+            }
+            found[ix] = windex;
+        }
+    });
+
+    std::map<int, int> tmp;
+    for (int ix = 0; ix != lsiz; ++ix)
+        tmp.emplace_hint(tmp.end(), wlist[ix], found[ix]);
+
+    PERFTRACE_COUNT("Dictionary::mapWords missing", std::count(found.begin(), found.end(), -1));
+
     return tmp;
 }
 
@@ -6202,26 +7005,24 @@ void Dictionary::diff(Dictionary *other, std::vector<std::pair<int, int>> &resul
     //int siz = std::min(lsiz, osiz);
     result.reserve(std::max(lsiz, osiz) * 1.2);
 
-    std::map<QCharString, QString> hira;
-    QString lstr;
-    QString ostr;
+    // Hiragana form of every word's kana in both dictionaries, converted in parallel before
+    // the comparison.
+    std::vector<QString> lhira(lsiz);
+    std::vector<QString> ohira(osiz);
+    parallelFor(0, lsiz, 4096, [this, &lhira](int first, int last) {
+        for (int ix = first; ix != last; ++ix)
+            lhira[ix] = hiraganize(words[ix]->kana);
+    });
+    parallelFor(0, osiz, 4096, [other, &ohira](int first, int last) {
+        for (int ix = first; ix != last; ++ix)
+            ohira[ix] = hiraganize(other->words[ix]->kana);
+    });
+
     while (lpos != lsiz && opos != osiz)
     {
         int d = qcharcmp(l->romaji.data(), o->romaji.data());
         if (d == 0)
-        {
-            auto it = hira.find(l->kana);
-            if (it == hira.end())
-                hira[l->kana] = lstr = hiraganize(l->kana);
-            else
-                lstr = it->second;
-            it = hira.find(o->kana);
-            if (it == hira.end())
-                hira[o->kana] = ostr = hiraganize(o->kana);
-            else
-                ostr = it->second;
-            d = qcharcmp(lstr.constData(), ostr.constData());
-        }
+            d = qcharcmp(lhira[abcde[lpos]].constData(), ohira[other->abcde[opos]].constData());
         if (d == 0)
             d = qcharcmp(l->kana.data(), o->kana.data());
         if (d == 0)
@@ -6275,6 +7076,7 @@ int Dictionary::addWordCopy(WordEntry *src, bool originals)
     ZKanji::cloneWordData(w, src, true);
 
     words.push_back(w);
+    kanjireadings.clear();
 
     // Insert word into aiueo and abcde ordered lists.
     addWordData();
@@ -6307,6 +7109,8 @@ void Dictionary::cloneWordData(int windex, WordEntry *src, bool originals, bool
 
     dtree.removeLine(windex, false);
     dtree.expandWith(windex, false);
+    furigana.invalidate(windex);
+    kanjireadings.clear();
 
     emit entryChanged(windex, false);
 
@@ -6326,6 +7130,8 @@ void Dictionary::revertEntry(int windex)
 
     dtree.removeLine(windex, false);
     dtree.expandWith(windex, false);
+    furigana.invalidate(windex);
+    kanjireadings.clear();
 
     emit entryChanged(windex, false);
 
@@ -19,6 +19,7 @@
 #include "zkanjimain.h"
 #include "fastarray.h"
 #include "searchtree.h"
+#include "furigana.h"
 
 // Parts of a word entry used as flags. Default is only used for main hints.
 enum class WordPartBits : uchar { Kanji = 0x01, Kana = 0x02, Definition = 0x04, Default = 0x08, AllParts = Kanji | Kana | Definition };
@@ -341,8 +342,15 @@ public:
     // Sorts indexes by value. The corresponding elements in infs will be sorted the same way.
     void sortByIndex();
 
+    // Whether the list holds words found by Dictionary::findSimilarKanaWords(), which are
+    // ordered by their distance from the search string. Setting or clearing the list resets
+    // this.
+    bool similarWords() const;
+    void setSimilarWords(bool similar);
+
     // Sort list of results using the words' kanji, kana and frequency. Pass a vector with
-    // indexes, and the indexes will be converted to their new sorted position.
+    // indexes, and the indexes will be converted to their new sorted position. Lists of
+    // similar words are not sorted.
     void jpSort(std::vector<int> *pindexes = nullptr); 
     // Returns the insert position of windex with the passed inflections using the same
     // conditions as jpSort(). If passed, the value of oldpos is updated to the current
@@ -376,6 +384,8 @@ private:
     smartvector<std::vector<InfTypes>> infs;
 
     Dictionary *dict;
+
+    bool similar;
 };
 
 
@@ -415,6 +425,12 @@ public:
     // for a single value, but it's slow to use in place of findWords(). Pass a boolean
     // value's address in found to check whether the given windex was found in the tree.
     bool wordMatches(int windex, QString search, bool exact, bool sameform, int infsize = 0, bool *found = nullptr);
+    // Adds the index and distance of words to result, whose romanized kana form is at most
+    // maxdist edits away from the romanized search string. The search string is compared
+    // with the start of the words. Typical mistakes, like missing long vowels or small tsu,
+    // cost 1, other edits cost 2. The result is not sorted and might contain duplicates.
+    // Only valid for the kana tree that is not reversed.
+    void findSimilarWords(std::vector<std::pair<int, int>> &result, QString search, int maxdist);
 
 
     virtual bool isKana() const override;
@@ -541,6 +557,7 @@ struct WordCommons
     fastarray<WordCommonsExample, ushort> examples;
 };
 
+class WordCommonsMerge;
 class WordCommonsTree : public TextSearchTreeBase
 {
 public:
@@ -561,6 +578,18 @@ public:
     void clearJLPTData();
     void clearExamplesData();
 
+    // Starts replacing the examples data of every word with the data in examples. The words
+    // can be in any order and can contain duplicates. They are sorted and merged with a
+    // snapshot of the current words in the global thread pool, while the tree stays usable
+    // with the old data. Only the words added or removed by the change are updated in the
+    // tree, unless so many changed that building a new tree in the background is faster.
+    // Call finishExamplesData() to publish the new data. Functions that modify the tree
+    // publish it first, apart from clear() and clearExamplesData() which abandon it.
+    void startExamplesData(smartvector<WordCommons> &&examples);
+    // Waits for the data passed to startExamplesData() and replaces the tree's data with it.
+    // Does nothing if no replacement was started.
+    void finishExamplesData();
+
     // Adds a word with jlpt data to the list. This can cause duplicates, and wrong sort
     // order. The tree is not expanded unless insertsorted is set to true. After finishing
     // with the last word, it must be rebuilt either with rebuild() or with a TreeBuilder that
@@ -606,11 +635,24 @@ protected:
 private:
     smartvector<WordCommons> list;
 
+    // Replacement of the examples data being built in the background.
+    std::unique_ptr<WordCommonsMerge> merge;
+
+    // Stops building the replacement examples data and discards it.
+    void cancelExamplesData();
+
+    // Removes the lines from the tree after the words at those indexes were erased from the
+    // list. The lines must be in descending order. The tree is rebuilt instead when there
+    // are too many lines to remove.
+    void removeLines(const std::vector<int> &lines);
+
     // Stores the index where a word with the kanji and kana is found or would be inserted to
     // if not found, when the tree has a sorted list. Returns false if the word was found at
     // index and shouldn't be inserted again.
     bool insertIndex(const QChar *kanji, const QChar *kana, int &index) const;
 
+    friend class WordCommonsMerge;
+
     typedef TextSearchTreeBase base;
 };
 
@@ -694,7 +736,13 @@ enum class BrowseOrder : uchar;
 enum class SearchWildcard : uchar { AnyBefore = 0x0001, AnyAfter = 0x0002 };
 Q_DECLARE_FLAGS(SearchWildcards, SearchWildcard);
 
+// Sections of the binary user data export file. See Dictionary::exportUserData().
+enum class UserExportSection : uchar { End = 0, Words = 1, Definitions = 2, KanjiExamples = 3, KanjiGroups = 4, WordGroups = 5 };
+// Maximum number of words in a chunk of the word list in binary user data export files.
+const int userExportChunkSize = 4096;
+
 class StudyDeckList;
+class UserDataJournal;
 class Dictionary : public QObject
 {
     Q_OBJECT
@@ -794,8 +842,9 @@ public:
     // Writes an export file of user data that can be imported later.  Pass the kanji groups
     // to write in kgroups and the words groups to write in wgroups. Set kexamples to true to
     // write the word examples selected for the kanji in the groups. Set usermeanings to true
-    // to write the user defined word meanings.
-    void exportUserData(const QString &filename, std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings);
+    // to write the user defined word meanings. Set binary to true to write the file in the
+    // binary export format instead of text.
+    void exportUserData(const QString &filename, std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings, bool binary = false);
 
     // Writes a full or partial dictionary export to file. When limit is true, the export is
     // only partial with the kanji and words found in the passed lists. The items in the lists
@@ -890,6 +939,16 @@ public:
     WordDeckList *wordDecks();
     StudyDeckList *studyDecks();
 
+    // Journal of the user data changes made since the user data was last saved.
+    UserDataJournal* userJournal();
+
+    // Fills furigana with the furigana data of the word at windex. The data is taken from
+    // the dictionary's furigana cache, and only computed if the word is not cached yet.
+    void wordFurigana(int windex, std::vector<FuriganaData> &furigana);
+    // Returns the lists of words containing kanji with given readings and positions. The
+    // index is built on first use after the words change, which can take a while.
+    const KanjiReadingIndex& kanjiReadingIndex();
+
     // Returns the definitions of a word without grammar tags separated by comma. Set numbers
     // to true to use numbers as the separator.
     QString wordDefinitionString(int windex, bool numbers) const;
@@ -970,7 +1029,9 @@ public:
     // dictionary version is not checked.
     // WARNING: Passing a search string made with QString::fromRawData() might not be null
     // terminated, or the null might come too late. In that case this function can fail.
-    void findWords(WordResultList &result, SearchMode searchmode, QString search, SearchWildcards wildcards, bool sameform, bool inflections, bool studydefs, const std::vector<int> *wordpool, const WordFilterConditions *conditions);
+    // Set similar to true to list words with a similar kana form when a non-exact kana search
+    // finds nothing. Only meant for interactive searches typed by the user.
+    void findWords(WordResultList &result, SearchMode searchmode, QString search, SearchWildcards wildcards, bool sameform, bool inflections, bool studydefs, const std::vector<int> *wordpool, const WordFilterConditions *conditions, bool similar = false);
 
     // Determines whether the passed word index would be listed in the result of findWords(),
     // if searching with the same parameters. Fills inftypes with the inflections affecting
@@ -1004,6 +1065,12 @@ public:
     // Returns whether the result of findKanaWords() would contain windex. This check is fast
     // for a single value, but much slower than findKanaWords() when filling a results list.
     bool wordMatchesKanaSearch(int windex, QString search, SearchWildcards wildcards, bool sameform, const int infsize = 0);
+    // Returns a list of words with a kana form similar to the kana search string, to be used
+    // when the search found nothing because of a typing mistake. The words are ordered by
+    // their distance from the search string, then by frequency. Only words starting with a
+    // form similar to the search string are listed. Pass a list of word indexes in wordpool
+    // to limit the possible results to the words in that list. This list must be sorted.
+    void findSimilarKanaWords(std::vector<int> &result, QString search, const std::vector<int> *wordpool, const WordFilterConditions *conditions);
 
 
     // Returns the index of the word with the exact kanji, kana and romaji. Romaji must
@@ -1143,6 +1210,12 @@ private:
     // aiueo indexes to the word's index in these lists.
     void removeWordData(int index, int &abcdeindex, int &aiueoindex);
 
+    // Writes the export file of exportUserData() in the binary format.
+    void exportUserDataBinary(const QString &filename, std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings);
+    // Collects the user definitions in defs and the kanji example words in kwords that are
+    // exported by exportUserData() with the passed groups.
+    void userExportData(std::vector<KanjiGroup*> &kgroups, bool kexamples, std::vector<WordGroup*> &wgroups, bool usermeanings, std::vector<std::pair<int, const QCharString&>> &defs, std::vector<std::pair<int, const std::vector<int>&>> &kwords);
+
     //// Sets the kanji and kana strings to those found in line starting at pos up to len
     //// characters. The format of the line's substring should be kanji(kana). Returns whether
     //// the strings were found and filled correctly.
@@ -1215,6 +1288,16 @@ private:
 
     WordDeckList *decks;
     std::unique_ptr<StudyDeckList> studydecks;
+
+    std::unique_ptr<UserDataJournal> journal;
+
+    // Furigana of the words. Saved with the dictionary, and filled for changed words when
+    // their furigana is needed.
+    FuriganaCache furigana;
+
+    // Words by kanji, reading and position. Cleared when words change and rebuilt when
+    // requested.
+    KanjiReadingIndex kanjireadings;
 };
 
 Q_DECLARE_OPERATORS_FOR_FLAGS(SearchWildcards)
@@ -1310,6 +1393,16 @@ namespace ZKanji
     // to save unmodified data too.
     void saveUserData(bool forced = false);
 
+    // Returns whether every unsaved change of the user data is written to the journals of
+    // the dictionaries, and the dictionaries themselves are unmodified. The user data
+    // doesn't have to be saved in full in that case.
+    bool userDataJournaled();
+
+    // Applies the changes in the user data journals of every dictionary, which were made
+    // after the last time the user data was saved. Call after the user data and the profile
+    // have been loaded.
+    void replayUserJournals();
+
     // Checks whether the user data files should be backed up according to the user settings,
     // and creates a backup of the current files in so. Removes any extra backup files first,
     // if necessary.
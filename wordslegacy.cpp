@@ -403,6 +403,7 @@ void Dictionary::loadBaseLegacy(QDataStream &stream, int version)
         k->meanings.copy(meaning.split(", ", QString::SkipEmptyParts));
     }
 
+    ZKanji::packKanjiText();
     ZKanji::generateValidKanji();
 
     quint16 cc;
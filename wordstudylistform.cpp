@@ -151,14 +151,9 @@ QString WordStudyTestsModel::tooltip(int col) const
 
 WordStudyLevelsModel::WordStudyLevelsModel(WordDeck *deck, QObject *parent) : base(parent), deck(deck), maxval(0)
 {
-    list.resize(12);
-    for (int ix = 0, siz = deck->studySize(); ix != siz; ++ix)
-    {
-        int lv = deck->studyLevel(ix);
-        if (tosigned(list.size()) <= lv)
-            list.resize(lv + 1);
-        ++list[lv];
-    }
+    list = deck->getStudyDeck()->levelCounts();
+    if (tosigned(list.size()) < 12)
+        list.resize(12, 0);
 
     for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
         maxval = std::max(maxval, list[ix]);
@@ -881,7 +876,8 @@ void WordStudyListForm::on_tabWidget_currentChanged(int index)
 
         model = new StudyListModel(deck, this);
         ui->dictWidget->setModel(model);
-        ui->dictWidget->setSortFunction([this](DictionaryItemModel * /*d*/, int c, int a, int b) { return model->sortOrder(c, a, b); });
+        ui->dictWidget->setSortFunction([this](DictionaryItemModel * /*d*/, int c, int a, int b) { return model->sortOrder(c, a, b); },
+                [this](DictionaryItemModel * /*d*/, int c, int row, ProxySortKey &key) { model->sortKey(c, row, key); });
 
         connect(ui->dictWidget, &DictionaryWidget::rowSelectionChanged, this, &WordStudyListForm::rowSelectionChanged);
         connect(ui->dictWidget, &DictionaryWidget::sortIndicatorChanged, this, &WordStudyListForm::headerSortChanged);
@@ -9,6 +9,7 @@
 #include "ui_wordtestsettingsform.h"
 #include "zkanjimain.h"
 #include "zlistview.h"
+#include "zproxytablemodel.h"
 #include "groups.h"
 #include "words.h"
 #include "wordstudyform.h"
@@ -551,6 +552,29 @@ bool TestWordsItemModel::sortOrder(int c, int a, int b) const
     return list[a] < list[b];
 }
 
+void TestWordsItemModel::sortKey(int c, int row, ProxySortKey &key) const
+{
+    // Rows that compare equal are ordered by their item index in list, like in sortOrder().
+    // The rows are not in the same order as list when conflicts are shown.
+    const WordStudyItem &item = items[list[row]];
+    key.nums[7] = list[row];
+
+    // Score. Ordered by higher score, then number of times it was tested.
+    if (c == 1)
+    {
+        key.nums[0] = -(item.correct - item.incorrect);
+        key.nums[1] = -(item.correct + item.incorrect);
+        return;
+    }
+
+    Dictionary *d = group->dictionary();
+
+    if (c == 2)
+        key.text = d->wordEntry(item.windex)->kanji.toQString();
+    else if (c == 3)
+        key.text = d->wordEntry(item.windex)->kana.toQString();
+}
+
 void TestWordsItemModel::entryRemoved(int /*windex*/, int /*abcdeindex*/, int /*aiueoindex*/)
 {
     ;
@@ -981,7 +1005,8 @@ void WordTestSettingsForm::exec()
     ui->dictWidget->setSelectionType(ListSelectionType::Extended);
     ui->dictWidget->setSortIndicatorVisible(true);
     ui->dictWidget->setInflButtonVisible(false);
-    ui->dictWidget->setSortFunction([this](DictionaryItemModel * /*d*/, int c, int a, int b){ return model->sortOrder(c, a, b); });
+    ui->dictWidget->setSortFunction([this](DictionaryItemModel * /*d*/, int c, int a, int b){ return model->sortOrder(c, a, b); },
+            [this](DictionaryItemModel * /*d*/, int c, int row, ProxySortKey &key){ model->sortKey(c, row, key); });
     ui->dictWidget->setSortIndicator(0, Qt::AscendingOrder);
 
     adjustSize();
@@ -1198,7 +1223,8 @@ void WordTestSettingsForm::on_displayBox_currentIndexChanged(int index)
     if (index == 0)
     {
         ui->dictWidget->setSortIndicator(scolumn, sorder);
-        ui->dictWidget->setSortFunction([this](DictionaryItemModel * /*d*/, int c, int a, int b){ return model->sortOrder(c, a, b); });
+        ui->dictWidget->setSortFunction([this](DictionaryItemModel * /*d*/, int c, int a, int b){ return model->sortOrder(c, a, b); },
+            [this](DictionaryItemModel * /*d*/, int c, int row, ProxySortKey &key){ model->sortKey(c, row, key); });
     }
     else
         ui->dictWidget->setSortFunction(nullptr);
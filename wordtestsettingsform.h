@@ -19,6 +19,7 @@ namespace Ui {
 }
 
 class WordGroup;
+struct ProxySortKey;
 
 enum class TestWordsDisplay { All, WrittenConflict, KanaConflict, DefinitionConflict };
 enum class TestWordsColumnTypes { Order = (int)DictColumnTypes::Last, Score };
@@ -81,6 +82,9 @@ public:
     //void removeRows(int from, int to);
 
     bool sortOrder(int c, int a, int b) const;
+    // Fills key with the values of row that give the same ordering as sortOrder() when
+    // sorting by column c.
+    void sortKey(int c, int row, ProxySortKey &key) const;
 protected slots:
     virtual void entryRemoved(int windex, int abcdeindex, int aiueoindex) override;
     virtual void entryChanged(int windex, bool studydef) override;
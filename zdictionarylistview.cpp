@@ -623,10 +623,27 @@ void ZDictionaryListView::signalSelectionChanged()
 
 void ZDictionaryListView::settingsChanged()
 {
+    if (itemDelegate() != nullptr)
+        itemDelegate()->clearLayoutCache();
     base::settingsChanged();
     setAutoSizeColumns(Settings::dictionary.autosize);
 }
 
+void ZDictionaryListView::reset()
+{
+    if (itemDelegate() != nullptr)
+        itemDelegate()->clearLayoutCache();
+    base::reset();
+}
+
+void ZDictionaryListView::rowsRemoved(const smartvector<Range> &ranges)
+{
+    // The cached layouts might refer to deleted words.
+    if (itemDelegate() != nullptr)
+        itemDelegate()->clearLayoutCache();
+    base::rowsRemoved(ranges);
+}
+
 void ZDictionaryListView::multiSelRemoved(const smartvector<Range> &ranges)
 {
     base::selRemoved(ranges);
@@ -872,6 +889,13 @@ int ZDictionaryListView::dropRow(int ypos) const
 //    base::keyPressEvent(e);
 //}
 
+void ZDictionaryListView::dataChanged(const QModelIndex &topleft, const QModelIndex &bottomright, const QVector<int> &roles)
+{
+    if (itemDelegate() != nullptr)
+        itemDelegate()->clearLayoutCache();
+    base::dataChanged(topleft, bottomright, roles);
+}
+
 bool ZDictionaryListView::viewportEvent(QEvent *e)
 {
     switch (e->type())
@@ -1717,7 +1741,7 @@ void ZDictionaryListView::showPopup(const QPoint &pos, QModelIndex index, QStrin
 //QImage* DictionaryListDelegate::midpop = nullptr;
 //QImage* DictionaryListDelegate::unpop = nullptr;
 
-DictionaryListDelegate::DictionaryListDelegate(ZDictionaryListView *parent) : base(parent), showgroup(false)
+DictionaryListDelegate::DictionaryListDelegate(ZDictionaryListView *parent) : base(parent), layoutheight(-1), layoutspace(0), showgroup(false)
 {
 
 }
@@ -2018,6 +2042,12 @@ void DictionaryListDelegate::setGroupDisplay(bool val)
     showgroup = val;
 }
 
+void DictionaryListDelegate::clearLayoutCache()
+{
+    layouts.clear();
+    layoutheight = -1;
+}
+
 void DictionaryListDelegate::paintDefinition(QPainter *painter, QColor textcolor, QRect r, int y, WordEntry *e, std::vector<InfTypes> *inf, int defix, bool selected) const
 {
     // Painting word definition is done in several steps.
@@ -2028,100 +2058,111 @@ void DictionaryListDelegate::paintDefinition(QPainter *painter, QColor textcolor
     // with small font. This is repeated for each definition.
     // In case only a single definition is drawn on the line, the number is omitted.
     // (Unless using multiple table lines.)
-
-    //bool multidef = e->defs.size() > 1;
+    // The texts are prepared in definitionLayout() and only the inflection text, which
+    // depends on the current row, is created here.
 
     if (selected)
         painter->setPen(textcolor);
 
-    // Main definition font.
-    QFont f = Settings::mainFont();
-    f.setPixelSize(r.height() * defRowSize/* / 2 + 1*/);
-    //f.setPointSize(r.height() / 2 + 1);
-    // Small font for word notes text.
-    QFont fs = Settings::notesFont();
-    fs.setPixelSize(r.height() * notesRowSize /*/ 2 - 2*/);
-    //fs.setPointSize(r.height() / 2 - 2);
-    // Font used for drawing def number.
-    QFont fsf = Settings::mainFont();
-    fsf.setPixelSize(f.pixelSize());
-    QFont fse = Settings::extraFont();
-    fse.setPixelSize(f.pixelSize());
-
-    QFontMetrics fmet{ f };
-    QFontMetrics fsmet{ fs };
-    QFontMetrics fsfmet{ fsf };
-    QFontMetrics fsemet{ fse };
-
-    QString str;
+    const DefinitionLayout &layout = definitionLayout(e, defix, r.height());
 
-    int spacewidth = fmet.averageCharWidth();
-
-    QColor textcol = painter->pen().color();
+    painter->save();
+    painter->setClipRect(r);
 
+    int left = r.left();
     if (inf != nullptr)
     {
-        painter->setFont(fse);
-        str = Strings::wordInflectionText(*inf);
-        drawTextBaseline(painter, r.left(), y, false, r, str);
-        //painter->drawText(r.left(), y, str);
-        r.setLeft(r.left() + fsemet.boundingRect(str).width() + spacewidth);
+        painter->setFont(layoutfonts[ExtraFont]);
+        QString str = Strings::wordInflectionText(*inf);
+        painter->drawText(left, y, str);
+        left += QFontMetrics(layoutfonts[ExtraFont]).boundingRect(str).width() + layoutspace;
     }
 
-    // Looking for JLPT data in the commons tree.
-    if (Settings::dictionary.showjlpt && (Settings::dictionary.jlptcolumn == DictionarySettings::Definition || Settings::dictionary.jlptcolumn == DictionarySettings::Both))
+    int font = -1;
+    for (const DefinitionPart &part : layout.parts)
     {
-        WordCommons *c = ZKanji::commons.findWord(e->kanji.data(), e->kana.data(), e->romaji.data());
-        if (c != nullptr && c->jlptn != 0)
+        int x = left + part.left;
+        if (x > r.right())
+            break;
+
+        if (part.font != font)
         {
-            painter->setFont(fs);
+            font = part.font;
+            painter->setFont(layoutfonts[font]);
+        }
+        if (!selected)
+            painter->setPen(part.color == -1 ? textcolor : Settings::uiColor((ColorSettings::UIColorTypes)part.color));
+        painter->drawStaticText(x, y - layoutascent[font], part.text);
+    }
 
-            if (!selected)
-            {
-                switch (c->jlptn)
-                {
-                case 1:
-                    painter->setPen(Settings::uiColor(ColorSettings::N1));
-                    break;
-                case 2:
-                    painter->setPen(Settings::uiColor(ColorSettings::N2));
-                    break;
-                case 3:
-                    painter->setPen(Settings::uiColor(ColorSettings::N3));
-                    break;
-                case 4:
-                    painter->setPen(Settings::uiColor(ColorSettings::N4));
-                    break;
-                case 5:
-                    painter->setPen(Settings::uiColor(ColorSettings::N5));
-                    break;
-                }
-            }
-            else
-                painter->setPen(textcol);
+    painter->restore();
+}
 
-            str = QString("N%1").arg((int)c->jlptn);
-            //drawTextBaseline(painter, r.left(), y, false, r, str);
-            painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth);
-        }
+const DictionaryListDelegate::DefinitionLayout& DictionaryListDelegate::definitionLayout(WordEntry *e, int defix, int height) const
+{
+    if (layoutheight != height)
+    {
+        layouts.clear();
+        layoutheight = height;
+
+        // Main definition font.
+        layoutfonts[MainFont] = Settings::mainFont();
+        layoutfonts[MainFont].setPixelSize(height * defRowSize);
+        // Small font for word notes text.
+        layoutfonts[NotesFont] = Settings::notesFont();
+        layoutfonts[NotesFont].setPixelSize(height * notesRowSize);
+        layoutfonts[ExtraFont] = Settings::extraFont();
+        layoutfonts[ExtraFont].setPixelSize(layoutfonts[MainFont].pixelSize());
+
+        for (int ix = 0; ix != LayoutFontCount; ++ix)
+            layoutascent[ix] = QFontMetrics(layoutfonts[ix]).ascent();
+        layoutspace = QFontMetrics(layoutfonts[MainFont]).averageCharWidth();
     }
 
-    // Drawing the global word info field.
+    auto key = std::make_pair((const WordEntry*)e, defix);
+    auto it = layouts.find(key);
+    if (it != layouts.end() && it->second.defs == e->defs.data() && it->second.defcount == tosigned(e->defs.size()) && it->second.inf == e->inf)
+        return it->second;
 
-    str = Strings::wordInfoText(e->inf);
+    // Only the rows painted recently are needed. Start over instead of tracking their use.
+    if (it == layouts.end() && layouts.size() >= 2048)
+        layouts.clear();
 
-    if (!str.isEmpty())
-    {
-        painter->setFont(fs);
-        if (!selected)
-            painter->setPen(Settings::uiColor(ColorSettings::Attrib));
+    DefinitionLayout &layout = layouts[key];
+    layout.defs = e->defs.data();
+    layout.defcount = tosigned(e->defs.size());
+    layout.inf = e->inf;
+    layout.parts.clear();
+
+    const QFontMetrics metrics[LayoutFontCount] = { QFontMetrics(layoutfonts[MainFont]), QFontMetrics(layoutfonts[NotesFont]), QFontMetrics(layoutfonts[ExtraFont]) };
+    int spacewidth = layoutspace;
 
-        drawTextBaseline(painter, r.left(), y, false, r, str);
-        //painter->drawText(r.left(), y, str);
-        r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth / 2);
+    int x = 0;
+    auto addPart = [this, &layout, &metrics, &x](const QString &str, LayoutFonts font, int color, int spacing) {
+        DefinitionPart part;
+        part.text.setTextFormat(Qt::PlainText);
+        part.text.setText(str);
+        part.text.prepare(QTransform(), layoutfonts[font]);
+        part.font = font;
+        part.color = color;
+        part.left = x;
+        layout.parts.push_back(std::move(part));
+        x += metrics[font].boundingRect(str).width() + spacing;
+    };
+
+    // Looking for JLPT data in the commons tree.
+    if (Settings::dictionary.showjlpt && (Settings::dictionary.jlptcolumn == DictionarySettings::Definition || Settings::dictionary.jlptcolumn == DictionarySettings::Both))
+    {
+        WordCommons *c = ZKanji::commons.findWord(e->kanji.data(), e->kana.data(), e->romaji.data());
+        if (c != nullptr && c->jlptn >= 1 && c->jlptn <= 5)
+            addPart(QString("N%1").arg((int)c->jlptn), NotesFont, (int)ColorSettings::N5 + 5 - c->jlptn, spacewidth);
     }
 
+    // The global word info field.
+    QString str = Strings::wordInfoText(e->inf);
+    if (!str.isEmpty())
+        addPart(str, NotesFont, (int)ColorSettings::Attrib, spacewidth / 2);
+
     QString separator = qApp->translate("Dictionary", ", ");
 
     int ix;
@@ -2141,92 +2182,28 @@ void DictionaryListDelegate::paintDefinition(QPainter *painter, QColor textcolor
 
     for (; ix != siz; ++ix)
     {
-        painter->setFont(fsf);
         if (siz > 1 || defix != -1)
-        {
-            str = QStringLiteral("%1.").arg(ix + 1);
-            if (!selected)
-                painter->setPen(textcolor);
-            drawTextBaseline(painter, r.left(), y, false, r, str);
-            //painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsfmet.boundingRect(str).width() + spacewidth);
-        }
-        if (r.left() > r.right())
-            break;
-
-        painter->setFont(fs);
+            addPart(QStringLiteral("%1.").arg(ix + 1), MainFont, -1, spacewidth);
 
         WordDefinition &def = e->defs[ix];
         if (def.attrib.types != 0)
-        {
-            str = Strings::wordTypesText(def.attrib.types) + " ";
-            if (!selected)
-                painter->setPen(Settings::uiColor(ColorSettings::Types));
-
-            drawTextBaseline(painter, r.left(), y, false, r, str);
-            //painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth / 2);
-        }
-        if (r.left() > r.right())
-            break;
-
+            addPart(Strings::wordTypesText(def.attrib.types) + " ", NotesFont, (int)ColorSettings::Types, spacewidth / 2);
         if (def.attrib.notes != 0)
-        {
-            str = Strings::wordNotesText(def.attrib.notes) + " ";
-
-            if (!selected)
-                painter->setPen(Settings::uiColor(ColorSettings::Notes));
-
-            drawTextBaseline(painter, r.left(), y, false, r, str);
-            //painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth / 2);
-        }
-        if (r.left() > r.right())
-            break;
-
+            addPart(Strings::wordNotesText(def.attrib.notes) + " ", NotesFont, (int)ColorSettings::Notes, spacewidth / 2);
 
-        painter->setFont(f);
         str = def.def.toQStringRaw();
         str.replace(GLOSS_SEP_CHAR, separator);
-        if (!selected)
-            painter->setPen(textcolor);
-        drawTextBaseline(painter, r.left(), y, false, r, str);
-        //painter->drawText(r.left(), y, str);
-        r.setLeft(r.left() + fmet.boundingRect(str).width() + spacewidth / 2);
-        if (r.left() > r.right())
-            break;
-
-        painter->setFont(fs);
+        addPart(str, MainFont, -1, spacewidth / 2);
 
         if (def.attrib.fields != 0)
-        {
-            str = Strings::wordFieldsText(def.attrib.fields) + " ";
-
-            if (!selected)
-                painter->setPen(Settings::uiColor(ColorSettings::Fields));
-
-            drawTextBaseline(painter, r.left(), y, false, r, str);
-            //painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth / 2);
-        }
-
+            addPart(Strings::wordFieldsText(def.attrib.fields) + " ", NotesFont, (int)ColorSettings::Fields, spacewidth / 2);
         if (def.attrib.dialects != 0)
-        {
-            str = Strings::wordDialectsText(def.attrib.dialects) + " ";
+            addPart(Strings::wordDialectsText(def.attrib.dialects) + " ", NotesFont, (int)ColorSettings::Dialects, spacewidth / 2);
 
-            if (!selected)
-                painter->setPen(Settings::uiColor(ColorSettings::Dialects));
-
-            drawTextBaseline(painter, r.left(), y, false, r, str);
-            //painter->drawText(r.left(), y, str);
-            r.setLeft(r.left() + fsmet.boundingRect(str).width() + spacewidth / 2);
-        }
-
-        r.setLeft(r.left() + spacewidth);
-
-        if (r.left() > r.right())
-            break;
+        x += spacewidth;
     }
+
+    return layout;
 }
 
 void DictionaryListDelegate::paintKanji(QPainter *painter, const QModelIndex &index, int left, int /*top*/, int basey, QRect r) const
@@ -8,7 +8,10 @@
 #define ZDICTIONARYLISTVIEW_H
 
 #include <QMenu>
+#include <QStaticText>
+#include <QFont>
 #include <memory>
+#include <map>
 #include "zlistview.h"
 #include "zlistviewitemdelegate.h"
 #include "smartvector.h"
@@ -18,6 +21,7 @@ class WordGroup;
 class MultiLineDictionaryItemModel;
 class RangeSelection;
 struct WordEntry;
+struct WordDefinition;
 class DictionaryItemModel;
 class Dictionary;
 class DictionaryListDelegate;
@@ -167,6 +171,8 @@ public:
     virtual void signalSelectionChanged() override;
 public slots:
     virtual void settingsChanged() override;
+    virtual void reset() override;
+    virtual void rowsRemoved(const smartvector<Range> &ranges) override;
 
     void multiSelRemoved(const smartvector<Range> &ranges);
     void multiSelInserted(const smartvector<Interval> &intervals);
@@ -212,6 +218,8 @@ protected:
 
     virtual bool viewportEvent(QEvent *e) override;
 
+    virtual void dataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles = QVector<int>()) override;
+
     virtual void mouseDoubleClickEvent(QMouseEvent *e) override;
     virtual void mouseMoveEvent(QMouseEvent *e) override;
     virtual void mousePressEvent(QMouseEvent *e) override;
@@ -329,6 +337,10 @@ public:
     // returns true, the main settings can override it to be hidden.
     void setGroupDisplay(bool val);
 
+    // Discards the definition texts prepared for painting. Call when the words or the
+    // settings affecting their display change.
+    void clearLayoutCache();
+
     // Paints the definition text of an entry. If selected is true, the text is painted with
     // textcolor, otherwise only the main definition is using it.
     virtual void paintDefinition(QPainter *painter, QColor textcolor, QRect r, int y, WordEntry *e, std::vector<InfTypes> *inf, int defix, bool selected) const;
@@ -357,6 +369,46 @@ private:
     // for drawing the selected part. Font and other attributes should already be set.
     void drawSelectionText(QPainter *p, int x, int basey, const QRect &clip, QString str) const;
 
+    enum LayoutFonts { MainFont, NotesFont, ExtraFont, LayoutFontCount };
+
+    // Text of the definition column painted with a single font and color.
+    struct DefinitionPart
+    {
+        QStaticText text;
+        LayoutFonts font;
+        // Color of the text when the row is not selected. A ColorSettings::UIColorTypes
+        // value, or -1 for the text color of the row.
+        int color;
+        // Position of the part relative to the start of the definition.
+        int left;
+    };
+
+    // Definition column of a word, split into parts prepared for painting. The parts are not
+    // limited to the column width. Painting stops at the first part outside the column.
+    struct DefinitionLayout
+    {
+        // Values of the word when the layout was created, to detect words that changed
+        // without notifying the view.
+        const WordDefinition *defs;
+        int defcount;
+        uchar inf;
+
+        std::vector<DefinitionPart> parts;
+    };
+
+    // Returns the definition layout of e for a row of the given height. Pass the definition
+    // index in defix, or -1 for every definition of the word.
+    const DefinitionLayout& definitionLayout(WordEntry *e, int defix, int height) const;
+
+    // Row height the cached layouts and fonts were made for.
+    mutable int layoutheight;
+    mutable QFont layoutfonts[LayoutFontCount];
+    mutable int layoutascent[LayoutFontCount];
+    // Space between the definition parts.
+    mutable int layoutspace;
+    // Cached layouts of the definitions painted, by word and definition index.
+    mutable std::map<std::pair<const WordEntry*, int>, DefinitionLayout> layouts;
+
     bool showgroup;
 
     typedef ZListViewItemDelegate base;
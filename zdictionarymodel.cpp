@@ -975,7 +975,7 @@ void DictionarySearchResultItemModel::search(SearchMode mode, Dictionary *dict,
     list.reset(new WordResultList(dict));
 
     beginResetModel();
-    sdict->findWords(*list, mode, searchstr, wildcards, strict, inflections, studydefs, nullptr, cond);
+    sdict->findWords(*list, mode, searchstr, wildcards, strict, inflections, studydefs, nullptr, cond, true);
     if (smode == SearchMode::Japanese)
         list->jpSort();
     else if (smode == SearchMode::Definition)
@@ -334,7 +334,7 @@ void ZExamplePopup::mouseDoubleClickEvent(QMouseEvent *e)
 
 
 ZExampleStrip::ZExampleStrip(QWidget *parent) : base(parent), dict(nullptr), display(ExampleDisplay::Both), wordindex(-1), dirty(false),
-        block(0), line(0), wordpos((uchar)-1), common(nullptr), current(-1), hovered(-1), interactible(true), jpwidth(-1), trwidth(-1)
+        block(0), line(0), wordpos((uchar)-1), common(nullptr), current(-1), hovered(-1), interactible(true)
 {
     //setBackgroundRole(QPalette::Base);
     setAutoFillBackground(false);
@@ -469,9 +469,8 @@ void ZExampleStrip::setDisplayed(ExampleDisplay newdisp)
         wordrect.clear();
         popup.reset();
         hovered = -1;
-        jpwidth = -1;
-        trwidth = -1;
     }
+    layout.height = -1;
 
     update();
 }
@@ -636,56 +635,33 @@ void ZExampleStrip::paintEvent(QPaintEvent *e)
     int gap = Settings::scaled(4);
     int x = -scrollPos() + gap;
 
-    QFont jf = Settings::kanaFont();
-    QFont tf = Settings::mainFont();
-    if (display == ExampleDisplay::Both)
-    {
-        adjustFontSize(jf, (r.height() - gap) * 0.5);
-        adjustFontSize(tf, (r.height() - gap) * 0.38);
-    }
-    else
-    {
-        adjustFontSize(jf, r.height() * 0.54);
-        adjustFontSize(tf, r.height() * 0.4);
-    }
-
-    QFontMetrics jfm(jf);
-    QFontMetrics tfm(tf);
-
-    int jh = jfm.height() - jfm.descent() + Settings::scaled(3);
-    int th = tfm.height();
-
-    int flags = Qt::AlignLeft | Qt::AlignTop | Qt::TextDontClip | Qt::TextSingleLine;
-
-    QPalette pal;
+    const TextLayout &l = textLayout();
 
     if (display == ExampleDisplay::Both)
     {
-        int jtop = std::max(r.top() + gap / 2, r.top() + (r.height() - jh - th - Settings::scaled(2)) / 2);
-        int ttop = jtop + jh + gap / 2;
+        int jtop = std::max(r.top() + gap / 2, r.top() + (r.height() - l.jheight - l.theight - Settings::scaled(2)) / 2);
+        int ttop = jtop + l.jheight + gap / 2;
 
-        painter.setFont(jf);
-        //painter.drawText(QRect(x, jtop, 1, 1), flags, sentence.japanese.toQStringRaw());
-        paintJapanese(&painter, jfm, jtop);
+        painter.setFont(l.jfont);
+        paintJapanese(&painter, jtop);
 
         painter.setPen(Settings::textColor(this, ColorSettings::Text));
-        painter.setFont(tf);
-        painter.drawText(QRect(x, ttop, 1, 1), flags, sentence.translated.toQStringRaw());
+        painter.setFont(l.tfont);
+        painter.drawStaticText(x, ttop, l.translated);
     }
     else if (display == ExampleDisplay::Japanese)
     {
-        int jtop = r.top() + (r.height() - jh) / 2;
+        int jtop = r.top() + (r.height() - l.jheight) / 2;
         painter.setPen(Settings::textColor(this, ColorSettings::Text));
-        painter.setFont(jf);
-        //painter.drawText(QRect(x, jtop, 1, 1), flags, sentence.japanese.toQStringRaw());
-        paintJapanese(&painter, jfm, jtop);
+        painter.setFont(l.jfont);
+        paintJapanese(&painter, jtop);
     }
     else
     {
-        int ttop = r.top() + (r.height() - th) / 2;
+        int ttop = r.top() + (r.height() - l.theight) / 2;
         painter.setPen(Settings::textColor(this, ColorSettings::Text));
-        painter.setFont(tf);
-        painter.drawText(QRect(x, ttop, 1, 1), flags, sentence.translated.toQStringRaw());
+        painter.setFont(l.tfont);
+        painter.drawStaticText(x, ttop, l.translated);
     }
 }
 
@@ -826,42 +802,14 @@ int ZExampleStrip::scrollMax() const
     if (wordindex == -1)
         return 0;
 
-    int gap = Settings::scaled(4);
-    if ((display == ExampleDisplay::Japanese && jpwidth == -1) || (display == ExampleDisplay::Translated && trwidth == -1) || (display == ExampleDisplay::Both && (trwidth == -1 || jpwidth == -1)))
-    {
-        QFont jf = Settings::kanaFont();
-        QFont tf = Settings::mainFont();
-
-        QRect r = drawArea();
-
-        if (display == ExampleDisplay::Both)
-        {
-            adjustFontSize(jf, (r.height() - gap) * 0.5);
-            adjustFontSize(tf, (r.height() - gap) * 0.38);
-        }
-        else
-        {
-            adjustFontSize(jf, r.height() * 0.54);
-            adjustFontSize(tf, r.height() * 0.4);
-        }
-
-        QFontMetrics jfm(jf);
-        QFontMetrics tfm(tf);
-
-        //int jh = jfm.height();
-        //int th = tfm.height();
-        if (display == ExampleDisplay::Both || display == ExampleDisplay::Japanese)
-            jpwidth = jfm.boundingRect(sentence.japanese.toQStringRaw()).width();
-        if (display == ExampleDisplay::Both || display == ExampleDisplay::Translated)
-            trwidth = tfm.boundingRect(sentence.translated.toQStringRaw()).width();
-    }
+    const TextLayout &l = textLayout();
 
     if (display == ExampleDisplay::Both)
-        return std::max(jpwidth, trwidth) + Settings::scaled(8);
+        return std::max(l.jpwidth, l.trwidth) + Settings::scaled(8);
     else if (display == ExampleDisplay::Japanese)
-        return jpwidth + Settings::scaled(8);
+        return l.jpwidth + Settings::scaled(8);
     else
-        return trwidth + Settings::scaled(8);
+        return l.trwidth + Settings::scaled(8);
 }
 
 int ZExampleStrip::scrollPage() const
@@ -902,6 +850,8 @@ void ZExampleStrip::dictionaryChanged()
 
     QMouseEvent e = QMouseEvent(QEvent::MouseMove, mapFromGlobal(QCursor::pos()), Qt::NoButton, Qt::NoButton, Qt::KeyboardModifiers());
     wordrect.clear();
+    // The words found in the dictionary are saved in the layout.
+    layout.height = -1;
     if (rect().contains(e.pos()))
     {
         fillWordRects();
@@ -920,8 +870,7 @@ void ZExampleStrip::updateSentence()
     wordrect.clear();
 
     hovered = -1;
-    jpwidth = -1;
-    trwidth = -1;
+    layout.height = -1;
 
     sentence.japanese.clear();
     sentence.translated.clear();
@@ -967,85 +916,126 @@ void ZExampleStrip::fillWordRects()
     hovered = -1;
 
     QRect r = drawArea();
-
-    QFont jf = Settings::kanaFont();
-    QFont tf = Settings::mainFont();
+    const TextLayout &l = textLayout();
 
     int gap = Settings::scaled(4);
-    if (display == ExampleDisplay::Both)
-    {
-        adjustFontSize(jf, (r.height() - gap) * 0.5);
-        adjustFontSize(tf, (r.height() - gap) * 0.38);
-    }
-    else
-    {
-        adjustFontSize(jf, r.height() * 0.54);
-        adjustFontSize(tf, r.height() * 0.4);
-    }
-
-    QFontMetrics fm(jf);
-    QFontMetrics tfm(tf);
-
-    int jh = fm.height() - fm.descent() + Settings::scaled(3);
-    int th = tfm.height();
 
     int y = 0;
     if (display == ExampleDisplay::Both)
-        y = std::max(r.top() + gap / 2, r.top() + (r.height() - jh - th - gap / 2) / 2);
+        y = std::max(r.top() + gap / 2, r.top() + (r.height() - l.jheight - l.theight - gap / 2) / 2);
     else if (display == ExampleDisplay::Japanese)
-        y = r.top() + (r.height() - jh) / 2;
-
+        y = r.top() + (r.height() - l.jheight) / 2;
 
     int x = -scrollPos() + gap;
 
-    // Currently word.
-    int pos = 0;
+    for (int pos : l.wordparts)
+    {
+        const TextLayout::Part &part = l.parts[pos];
+        if (part.found)
+            wordrect.push_back(QRect(x + part.left, y, part.width, l.jheight));
+        else
+            wordrect.push_back(QRect(-1, -1, 0, 0));
+    }
+}
+
+const ZExampleStrip::TextLayout& ZExampleStrip::textLayout() const
+{
+    QRect r = drawArea();
+    if (layout.height == r.height())
+        return layout;
 
-    while (pos != sentence.words.size())
+    layout.height = r.height();
+    layout.parts.clear();
+    layout.wordparts.clear();
+    layout.translated = QStaticText();
+
+    layout.jfont = Settings::kanaFont();
+    layout.tfont = Settings::mainFont();
+
+    int gap = Settings::scaled(4);
+    if (display == ExampleDisplay::Both)
     {
-        int gappos = 0;
-        int gaplen = sentence.words[pos].pos;
+        adjustFontSize(layout.jfont, (r.height() - gap) * 0.5);
+        adjustFontSize(layout.tfont, (r.height() - gap) * 0.38);
+    }
+    else
+    {
+        adjustFontSize(layout.jfont, r.height() * 0.54);
+        adjustFontSize(layout.tfont, r.height() * 0.4);
+    }
 
-        if (pos != 0)
-        {
-            gappos = sentence.words[pos - 1].pos + sentence.words[pos - 1].len;
-            gaplen = sentence.words[pos].pos - gappos;
-        }
+    QFontMetrics jfm(layout.jfont);
+    QFontMetrics tfm(layout.tfont);
 
-        // Non-word part of sentence between two words.
-        if (gaplen != 0)
-        {
-            QString str = sentence.japanese.toQString(gappos, gaplen);
-            x += fm.width(str);
-        }
+    layout.jheight = jfm.height() - jfm.descent() + Settings::scaled(3);
+    layout.theight = tfm.height();
+    layout.jpwidth = 0;
+    layout.trwidth = 0;
 
-        QString str = sentence.japanese.toQString(sentence.words[pos].pos, sentence.words[pos].len);
+    if (wordindex == -1)
+        return layout;
 
-        int w = fm.width(str);
+    if (display == ExampleDisplay::Both || display == ExampleDisplay::Japanese)
+    {
+        int x = 0;
+        auto addPart = [this, &jfm, &x](int pos, int len, int word) {
+            TextLayout::Part part;
+            QString str = sentence.japanese.toQString(pos, len);
+            part.text.setTextFormat(Qt::PlainText);
+            part.text.setText(str);
+            part.text.prepare(QTransform(), layout.jfont);
+            part.left = x;
+            part.width = jfm.width(str);
+            part.word = word;
+            part.found = false;
+            if (word != -1)
+            {
+                // Only words and word forms present in the current dictionary get a word
+                // rectangle.
+                const ExampleWordsData &w = sentence.words[word];
+                for (int ix = 0; ix != w.forms.size() && !part.found; ++ix)
+                    part.found = dict->findKanjiKanaWord(w.forms[ix].kanji, w.forms[ix].kana) != -1;
+                layout.wordparts.push_back(tosigned(layout.parts.size()));
+            }
+            x += part.width;
+            layout.parts.push_back(std::move(part));
+        };
 
-        bool found = false;
-        for (int ix = 0; ix != sentence.words[pos].forms.size() && !found; ++ix)
+        int gappos = 0;
+        for (int pos = 0, siz = sentence.words.size(); pos != siz; ++pos)
         {
-            const ExampleWordsData::Form &f = sentence.words[pos].forms[ix];
-            found = dict->findKanjiKanaWord(f.kanji, f.kana) != -1;
+            // Non-word part of sentence between two words.
+            const ExampleWordsData &w = sentence.words[pos];
+            if (w.pos > gappos)
+                addPart(gappos, w.pos - gappos, -1);
+            addPart(w.pos, w.len, pos);
+            gappos = w.pos + w.len;
         }
+        // Last part of the sentence after the words.
+        if (gappos < tosigned(sentence.japanese.size()))
+            addPart(gappos, tosigned(sentence.japanese.size()) - gappos, -1);
 
-        if (found)
-            wordrect.push_back(QRect(x, y, w, fm.height() - fm.descent() + Settings::scaled(3)));
-        else
-            wordrect.push_back(QRect(-1, -1, 0, 0));
-
-        x += w;
+        layout.jpwidth = jfm.boundingRect(sentence.japanese.toQStringRaw()).width();
+    }
 
-        ++pos;
+    if (display == ExampleDisplay::Both || display == ExampleDisplay::Translated)
+    {
+        layout.translated.setTextFormat(Qt::PlainText);
+        layout.translated.setText(sentence.translated.toQStringRaw());
+        layout.translated.prepare(QTransform(), layout.tfont);
+        layout.trwidth = tfm.boundingRect(sentence.translated.toQStringRaw()).width();
     }
+
+    return layout;
 }
 
-void ZExampleStrip::paintJapanese(QPainter *p, QFontMetrics &fm, int y)
+void ZExampleStrip::paintJapanese(QPainter *p, int y)
 {
     if (wordindex == -1)
         return;
 
+    const TextLayout &l = textLayout();
+
     bool fillrects = wordrect.empty();
 
     // Sometimes the rectangles are not yet set but hovered is set to wordrect.size() because
@@ -1057,76 +1047,26 @@ void ZExampleStrip::paintJapanese(QPainter *p, QFontMetrics &fm, int y)
     int gap = Settings::scaled(4);
     int x = -scrollPos() + gap;
 
-    int flags = Qt::AlignLeft | Qt::AlignTop | Qt::TextDontClip | Qt::TextSingleLine;
-
-    // Currently drawn word.
-    int pos = 0;
+    QColor textcolor = Settings::textColor(this, ColorSettings::Text);
+    QColor wordcolor = Settings::uiColor(ColorSettings::SentenceWord);
 
-    QPalette pal;
-
-    while (pos != sentence.words.size())
+    for (const TextLayout::Part &part : l.parts)
     {
-        // Drawing two sentence parts. One before the current word but after the previous, and
-        // the word at position.
-
-        int gappos = 0;
-        int gaplen = sentence.words[pos].pos;
-
-        if (pos != 0)
-        {
-            gappos = sentence.words[pos - 1].pos + sentence.words[pos - 1].len;
-            gaplen = sentence.words[pos].pos - gappos;
-        }
-
-        // Non-word part of sentence between two words.
-        if (gaplen != 0)
-        {
-            QString str = sentence.japanese.toQString(gappos, gaplen);
-            p->setPen(Settings::textColor(this, ColorSettings::Text));
-            p->drawText(x, y, 1, 1, flags, str);
-            x += fm.width(str);
-        }
-
-        QString str = sentence.japanese.toQString(sentence.words[pos].pos, sentence.words[pos].len);
         // Skip the hovered word because it will be drawn separately below, so the drawn
         // bounding rectangle can cover neighbouring words.
-        if (hovered != pos)
+        if (part.word == -1 || hovered != part.word)
         {
-            p->setPen(wordpos == pos ? Settings::uiColor(ColorSettings::SentenceWord) : Settings::textColor(this, ColorSettings::Text));
-            p->drawText(x, y, 1, 1, flags, str);
+            p->setPen(part.word != -1 && wordpos == part.word ? wordcolor : textcolor);
+            p->drawStaticText(x + part.left, y, part.text);
         }
-        int w = fm.width(str);
 
-        if (fillrects)
+        if (fillrects && part.word != -1)
         {
-            // Only add rectangle to words and word forms present in the current dictionary.
-
-            bool found = false;
-            for (int ix = 0; ix != sentence.words[pos].forms.size() && !found; ++ix)
-            {
-                const ExampleWordsData::Form &f = sentence.words[pos].forms[ix];
-                found = dict->findKanjiKanaWord(f.kanji, f.kana) != -1;
-            }
-
-            if (found)
-                wordrect.push_back(QRect(x, y, w, fm.height() - fm.descent() + Settings::scaled(3)));
+            if (part.found)
+                wordrect.push_back(QRect(x + part.left, y, part.width, l.jheight));
             else
                 wordrect.push_back(QRect(-1, -1, 0, 0));
         }
-        x += w;
-
-        ++pos;
-    }
-
-    p->setPen(Settings::textColor(this, ColorSettings::Text));
-
-    // Last part of the sentence without a word rectangle.
-    int gappos = sentence.words[pos - 1].pos + sentence.words[pos - 1].len;
-    if (gappos < tosigned(sentence.japanese.size()))
-    {
-        int gaplen = sentence.japanese.size() - gappos;
-        QString str = sentence.japanese.toQString(gappos, gaplen);
-        p->drawText(x, y, 1, 1, flags, str);
     }
 
     // Hovered word is painted last with its selection rectangle.
@@ -1134,21 +1074,19 @@ void ZExampleStrip::paintJapanese(QPainter *p, QFontMetrics &fm, int y)
     {
         QRectF r = wordrect[hovered];
         r.adjust(-1.5, -1.5, 1.5, 1.5);
-        p->setPen(Settings::textColor(this, ColorSettings::Text));
+        p->setPen(textcolor);
         p->drawRect(r);
         r.adjust(0, 0, -1, -1);
         p->fillRect(r, Settings::textColor(this, ColorSettings::Bg));
 
-        QString str = sentence.japanese.toQString(sentence.words[hovered].pos, sentence.words[hovered].len);
-
-        p->setPen(wordpos == hovered ? Settings::uiColor(ColorSettings::SentenceWord) : Settings::textColor(this, ColorSettings::Text));
-        p->drawText(wordrect[hovered].left(), y, 1, 1, flags, str);
+        p->setPen(wordpos == hovered ? wordcolor : textcolor);
+        p->drawStaticText(wordrect[hovered].left(), y, l.parts[l.wordparts[hovered]].text);
     }
 
     // Paint dotted line below the words.
     if (hovered != -1)
     {
-        QPen pen(Settings::textColor(this, ColorSettings::Text));
+        QPen pen(textcolor);
         pen.setDashPattern({ 1, 1 });
         p->setPen(pen);
 
@@ -1162,7 +1100,7 @@ void ZExampleStrip::paintJapanese(QPainter *p, QFontMetrics &fm, int y)
 
     }
 
-    p->setPen(Settings::textColor(this, ColorSettings::Text));
+    p->setPen(textcolor);
 }
 
 void ZExampleStrip::updateWordRect(int ind)
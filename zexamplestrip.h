@@ -8,6 +8,7 @@
 #define ZEXAMPLESTRIP_H
 
 #include <QBasicTimer>
+#include <QStaticText>
 #include <memory>
 #include "zscrollarea.h"
 #include "sentences.h"
@@ -150,7 +151,7 @@ private:
 
     // Draws the Japanese text on the strip at the current scroll position. Fills the wordrect
     // list if necessary.
-    void paintJapanese(QPainter *p, QFontMetrics &fm, int y);
+    void paintJapanese(QPainter *p, int y);
 
     // Tells the widget to repaint one of its word rectangles.
     void updateWordRect(int index);
@@ -167,6 +168,46 @@ private:
     // the rectangles are needed.
     void fillWordRects();
 
+    // Fonts, sizes and prepared texts of the current sentence, laid out for the size of the
+    // strip and the display mode.
+    struct TextLayout
+    {
+        // Height of the drawing area the layout was made for. The layout is only valid while
+        // this matches the current height and is set to -1 when the layout must be rebuilt.
+        int height = -1;
+
+        QFont jfont;
+        QFont tfont;
+        // Height of the Japanese and translated lines.
+        int jheight;
+        int theight;
+
+        // Width of the Japanese and translated text when drawn on the strip.
+        int jpwidth;
+        int trwidth;
+
+        // Part of the Japanese sentence, either a word or the text between two words.
+        struct Part
+        {
+            QStaticText text;
+            // Distance of the part from the start of the sentence.
+            int left;
+            int width;
+            // Index of the word in the sentence, or -1 if the part is not a word.
+            int word;
+            // Whether any form of the word is in the current dictionary.
+            bool found;
+        };
+        std::vector<Part> parts;
+        // Index of the part in parts for each word.
+        std::vector<int> wordparts;
+
+        QStaticText translated;
+    };
+
+    // Returns the layout of the current sentence, creating it first if it is not valid.
+    const TextLayout& textLayout() const;
+
     // Dictionary of the word.
     Dictionary *dict;
 
@@ -212,13 +253,9 @@ private:
 
     bool interactible;
 
-    // Width of the Japanese text when drawn on the strip. Passed to scrollMax() when
-    // requested.
-    mutable int jpwidth;
-
-    // Width of the translated text when drawn on the strip. Passed to scrollMax() when
-    // requested.
-    mutable int trwidth;
+    // Layout of the sentence used in painting and for the word rectangles. Created on first
+    // use.
+    mutable TextLayout layout;
 
     friend class ZExamplePopup;
 
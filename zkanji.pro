@@ -32,6 +32,7 @@ SOURCES += \
     Qxt/qxtglobal.cpp \
     Qxt/qxtglobalshortcut.cpp \
     Qxt/qxtglobalshortcut_x11.cpp \
+    benchmark.cpp \
     bits.cpp \
     collectwordsform.cpp \
     definitionwidget.cpp \
@@ -66,11 +67,15 @@ SOURCES += \
     kanjilegacy.cpp \
     kanjireadingpracticeform.cpp \
     kanjisearchwidget.cpp \
+    kanjisimilarity.cpp \
     kanjistrokes.cpp \
     kanjitogroupform.cpp \
     kanjitooltipwidget.cpp \
+    lookupserver.cpp \
+    perftrace.cpp \
     popupdict.cpp \
     popupkanjisearch.cpp \
+    prefixsumlist.cpp \
     printpreviewform.cpp \
     qcharstring.cpp \
     radform.cpp \
@@ -86,13 +91,18 @@ SOURCES += \
     sites.cpp \
     studydecks.cpp \
     studydeckslegacy.cpp \
+    taskscheduler.cpp \
+    textanalysisform.cpp \
+    textsegmenter.cpp \
     treebuilder.cpp \
+    userjournal.cpp \
     wordattribwidget.cpp \
     worddeck.cpp \
     worddeckform.cpp \
     worddecklegacy.cpp \
     wordeditorform.cpp \
     wordgroupwidget.cpp \
+    wordkeytable.cpp \
     words.cpp \
     wordslegacy.cpp \
     wordstudyform.cpp \
@@ -151,6 +161,7 @@ HEADERS += \
     Qxt/qxtglobal.h \
     Qxt/qxtglobalshortcut.h \
     Qxt/qxtglobalshortcut_p.h \
+    benchmark.h \
     bits.h \
     collectwordsform.h \
     colorsettings.h \
@@ -193,12 +204,16 @@ HEADERS += \
     kanjireadingpracticeform.h \
     kanjisearchwidget.h \
     kanjisettings.h \
+    kanjisimilarity.h \
     kanjistrokes.h \
     kanjitogroupform.h \
     kanjitooltipwidget.h \
+    lookupserver.h \
+    perftrace.h \
     popupdict.h \
     popupkanjisearch.h \
     popupsettings.h \
+    prefixsumlist.h \
     printpreviewform.h \
     printsettings.h \
     qcharstring.h \
@@ -218,12 +233,17 @@ HEADERS += \
     smartvector.h \
     studydecks.h \
     studysettings.h \
+    taskscheduler.h \
+    textanalysisform.h \
+    textsegmenter.h \
     treebuilder.h \
+    userjournal.h \
     wordattribwidget.h \
     worddeck.h \
     worddeckform.h \
     wordeditorform.h \
     wordgroupwidget.h \
+    wordkeytable.h \
     words.h \
     wordstudyform.h \
     wordstudylistform.h \
@@ -310,6 +330,7 @@ FORMS += \
     recognizer.ui \
     selectdictionarydialog.ui \
     settingsform.ui \
+    textanalysisform.ui \
     wordattribwidget.ui \
     worddeckform.ui \
     wordeditorform.ui \
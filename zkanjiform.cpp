@@ -956,6 +956,14 @@ void ZKanjiForm::showDictionaryInfo()
     showDictionaryStats(dictindex);
 }
 
+void ZKanjiForm::showTextAnalysis()
+{
+    int dictindex = 0;
+    if (activewidget != nullptr)
+        dictindex = activewidget->dictionaryIndex();
+    analyzeText(ZKanji::dictionary(dictindex), QString());
+}
+
 bool ZKanjiForm::event(QEvent *e)
 {
     if (e->type() == QEvent::LanguageChange)
@@ -1525,6 +1533,9 @@ void ZKanjiForm::fillMainMenu()
     a = dictmenu->addAction(tr("Dictionary &information..."));
     connect(a, &QAction::triggered, this, &ZKanjiForm::showDictionaryInfo);
 
+    a = dictmenu->addAction(tr("&Analyze text..."));
+    connect(a, &QAction::triggered, this, &ZKanjiForm::showTextAnalysis);
+
     //dictmenu->addSeparator();
 
     //a = dictmenu->addAction(tr("New word to dictionary..."));
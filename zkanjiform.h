@@ -160,6 +160,8 @@ public:
     void switchToDictionary(int index);
 protected:
     void showDictionaryInfo();
+    // Opens a window for splitting Japanese text into the words of the active dictionary.
+    void showTextAnalysis();
 
     //virtual void focusInEvent(QFocusEvent *e) override;
     virtual bool event(QEvent *e) override;
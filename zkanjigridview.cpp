@@ -212,6 +212,7 @@ void ZKanjiGridView::settingsChanged()
     Settings::updatePalette(this);
 
     cellsize = Settings::scaled(std::ceil(Settings::fonts.kanjifontsize / 0.7));
+    celltexts.clear();
     recompute(viewport()->size());
     recompute(viewport()->size());
     recomputeScrollbar(viewport()->size());
@@ -1090,6 +1091,8 @@ void ZKanjiGridView::paintEvent(QPaintEvent *event)
     int drawpos = top * cols;
 
     QFont kfont = Settings::kanjiFont();
+    QFontMetrics kfm(kfont);
+    int kascent = kfm.ascent();
 
     p.setFont(kfont);
 
@@ -1156,7 +1159,28 @@ void ZKanjiGridView::paintEvent(QPaintEvent *event)
             p.fillRect(QRect(x + cellsize * 0.8, y + cellsize * 0.8, cellsize * 0.2 - 1, cellsize * 0.2 - 1), QBrush(grad));
         }
 
-        drawTextBaseline(&p, x, y + cellsize * 0.86, true, QRect(x, y, cellsize - 1, cellsize - 1), ZKanji::kanjis[itemmodel->kanjiAt(drawpos)]->ch);
+        QChar ch = ZKanji::kanjis[itemmodel->kanjiAt(drawpos)]->ch;
+        auto it = celltexts.find(ch.unicode());
+        if (it == celltexts.end())
+        {
+            CellText ct;
+            ct.text.setTextFormat(Qt::PlainText);
+            ct.text.setText(QString(ch));
+            ct.text.prepare(QTransform(), kfont);
+            ct.width = kfm.width(ch);
+            it = celltexts.insert(ch.unicode(), ct);
+        }
+
+        // Same position as drawTextBaseline() would use, but the painter is only clipped
+        // when the kanji doesn't fit in its cell.
+        int kx = x + (cellsize - 1 - it->width) / 2;
+        int ky = y + cellsize * 0.86 - kascent;
+        bool clip = it->width > cellsize - 1 || ky < y || ky + kfm.height() > y + cellsize - 1;
+        if (clip)
+            p.setClipRect(QRect(x, y, cellsize - 1, cellsize - 1));
+        p.drawStaticText(kx, ky, it->text);
+        if (clip)
+            p.setClipping(false);
 
         if (current == drawpos && hasFocus())
         {
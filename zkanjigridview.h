@@ -10,6 +10,8 @@
 #include <QAbstractScrollArea>
 #include <QMenu>
 #include <QBasicTimer>
+#include <QStaticText>
+#include <QHash>
 
 #include <list>
 #include <map>
@@ -252,6 +254,15 @@ private:
     // Width and height of a single grid square.
     int cellsize;
 
+    // Kanji prepared for drawing in the cells with the kanji font, and their width. Cleared
+    // when the settings change.
+    struct CellText
+    {
+        QStaticText text;
+        int width;
+    };
+    QHash<ushort, CellText> celltexts;
+
     // Number of pixels near edge of view where auto scroll can start during drag and drop.
     int autoscrollmargin;
     // Amount to scroll when auto scrolling. Gradually increased.
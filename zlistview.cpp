@@ -411,17 +411,26 @@ void ZListView::selectedRows(std::vector<int> &result) const
     //    result.push_back(list[ix].row());
 }
 
-QModelIndexList ZListView::selectedIndexes() const
+void ZListView::selectedRanges(const std::function<void(int, int)> &func) const
 {
-    std::vector<int> rows;
-    selectedRows(rows);
+    int pivotfirst = currentrow == -1 ? -1 : selpivot;
+    int pivotlast = pivotfirst == -1 ? -1 : mapToSelection(currentrow);
+    if (pivotlast < pivotfirst)
+        std::swap(pivotfirst, pivotlast);
+
+    selection->forEachRange(func, pivotfirst, pivotlast);
+}
 
+QModelIndexList ZListView::selectedIndexes() const
+{
     auto m = model();
 
     QModelIndexList result;
-    result.reserve(tosigned(rows.size()));
-    for (int r : rows)
-        result << m->index(r, 0);
+    result.reserve(selectionSize());
+    selectedRanges([m, &result](int first, int last) {
+        for (int ix = first; ix != last + 1; ++ix)
+            result << m->index(ix, 0);
+    });
 
     return result;
 }
@@ -11,6 +11,7 @@
 #include <QAbstractItemModel>
 #include <QBasicTimer>
 #include <memory>
+#include <functional>
 #include "smartvector.h"
 
 class ZListViewItemDelegate;
@@ -190,6 +191,10 @@ public:
     // ZDictionaryListView this bypasses the multi line model and returns indexes to its
     // source model.
     void selectedRows(std::vector<int> &result) const;
+    // Calls func with the first and last row of every continuous run of selected rows, in
+    // the same order and with the same indexes as selectedRows() would list them. Used for
+    // large selections, where listing every row is slow.
+    void selectedRanges(const std::function<void(int, int)> &func) const;
 
     // Returns a list of model indexes for the first column of the selected rows. Used in
     // functions that require model indexes instead of rows.
@@ -262,7 +267,7 @@ public slots:
     //void rowsInserted(const QModelIndex &parent, int first, int last);
     //void rowsRemoved(const QModelIndex &parent, int first, int last);
     //void rowsMoved(const QModelIndex &parent, int start, int end, const QModelIndex &destination, int row);
-    void rowsRemoved(const smartvector<Range> &ranges);
+    virtual void rowsRemoved(const smartvector<Range> &ranges);
     void rowsInserted(const smartvector<Interval> &intervals);
     void rowsMoved(const smartvector<Range> &ranges, int pos);
 
@@ -6,6 +6,9 @@
 
 #include <QMessageBox>
 #include <QApplication>
+#include <QDateTime>
+#include <limits>
+#include <cstring>
 //#include <QElapsedTimer>
 
 #include "zproxytablemodel.h"
@@ -18,6 +21,48 @@
 //-------------------------------------------------------------
 
 
+ProxySortKey::ProxySortKey()
+{
+    std::fill(nums, nums + 8, 0);
+}
+
+int ProxySortKey::compare(const ProxySortKey &other) const
+{
+    int r = text.compare(other.text);
+    if (r != 0)
+        return r;
+
+    for (int ix = 0; ix != 8; ++ix)
+        if (nums[ix] != other.nums[ix])
+            return nums[ix] < other.nums[ix] ? -1 : 1;
+    return 0;
+}
+
+qint64 ProxySortKey::fromFloat(float val)
+{
+    // The bits of a float compare the same as signed integers, except that negative values
+    // are in reverse order.
+    qint32 bits;
+    memcpy(&bits, &val, sizeof(qint32));
+    if (bits < 0)
+        bits ^= 0x7fffffff;
+    return bits;
+}
+
+qint64 ProxySortKey::fromDate(const QDate &val)
+{
+    return val.isValid() ? val.toJulianDay() : std::numeric_limits<qint64>::min();
+}
+
+qint64 ProxySortKey::fromDateTime(const QDateTime &val)
+{
+    return val.isValid() ? val.toMSecsSinceEpoch() : std::numeric_limits<qint64>::min();
+}
+
+
+//-------------------------------------------------------------
+
+
 DictionarySearchFilterProxyModel::DictionarySearchFilterProxyModel(QObject *parent) : base(parent), sortcolumn(-1), sortorder(Qt::AscendingOrder)/*, sdict(nullptr)*/
 {
     connect(&ZKanji::wordfilters(), &WordAttributeFilterList::filterMoved, this, &DictionarySearchFilterProxyModel::filterMoved);
@@ -109,11 +154,15 @@ void DictionarySearchFilterProxyModel::filter(SearchMode mode, QString searchstr
     fillLists(sourceModel());
 }
 
-void DictionarySearchFilterProxyModel::sortBy(int column, Qt::SortOrder order, ProxySortFunction func)
+void DictionarySearchFilterProxyModel::sortBy(int column, Qt::SortOrder order, ProxySortFunction func, ProxySortKeyFunction keyfunc)
 {
-    if (sortcolumn == column && sortorder == order && sortfunc.target<bool(*)(DictionaryItemModel*, int, int, int)>() == func.target<bool(*)(DictionaryItemModel*, int, int, int)>())
+    if (!func)
+        keyfunc = nullptr;
+
+    if (sortcolumn == column && sortorder == order && sortfunc.target<bool(*)(DictionaryItemModel*, int, int, int)>() == func.target<bool(*)(DictionaryItemModel*, int, int, int)>() && !sortkeyfunc == !keyfunc)
     {
         preparedsortfunc = sortfunc;
+        preparedsortkeyfunc = sortkeyfunc;
         return;
     }
 
@@ -122,6 +171,7 @@ void DictionarySearchFilterProxyModel::sortBy(int column, Qt::SortOrder order, P
         sortcolumn = column;
         sortorder = order;
         preparedsortfunc = sortfunc = func;
+        preparedsortkeyfunc = sortkeyfunc = keyfunc;
 
         return;
     }
@@ -144,7 +194,9 @@ void DictionarySearchFilterProxyModel::sortBy(int column, Qt::SortOrder order, P
     sortcolumn = column;
     sortorder = order;
     preparedsortfunc = sortfunc = func;
+    preparedsortkeyfunc = sortkeyfunc = keyfunc;
 
+    rebuildSortKeys(sourceModel());
 
     // Rebuilding srclist.
     auto endit = srclist.begin() + list.size();
@@ -156,7 +208,7 @@ void DictionarySearchFilterProxyModel::sortBy(int column, Qt::SortOrder order, P
     {
         DictionaryItemModel *source = sourceModel();
         std::sort(list.begin(), list.end(), [this, source](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) {
-            return sortfunc(source, sortcolumn, a.first, b.first) != (sortorder == Qt::DescendingOrder);
+            return sortLess(source, a.first, b.first) != (sortorder == Qt::DescendingOrder);
         });
 
         std::sort(srclist.begin(), srclist.begin() + list.size(), [this](int a, int b) { return list[a].first < list[b].first; });
@@ -171,9 +223,10 @@ void DictionarySearchFilterProxyModel::sortBy(int column, Qt::SortOrder order, P
     emit layoutChanged();
 }
 
-void DictionarySearchFilterProxyModel::prepareSortFunction(ProxySortFunction func)
+void DictionarySearchFilterProxyModel::prepareSortFunction(ProxySortFunction func, ProxySortKeyFunction keyfunc)
 {
     preparedsortfunc = func;
+    preparedsortkeyfunc = func ? keyfunc : nullptr;
 }
 
 DictionaryItemModel* DictionarySearchFilterProxyModel::sourceModel()
@@ -204,6 +257,8 @@ void DictionarySearchFilterProxyModel::setSourceModel(DictionaryItemModel *newmo
 
     sortfunc = nullptr;
     preparedsortfunc = nullptr;
+    sortkeyfunc = nullptr;
+    preparedsortkeyfunc = nullptr;
     fillLists(newmodel);
     base::setSourceModel(newmodel);
 
@@ -339,6 +394,19 @@ void DictionarySearchFilterProxyModel::sourceDataChanged(const QModelIndex &sour
 
     Dictionary *dict = source->dictionary();
 
+    int top = source_top_left.row();
+    int bottom = source_bottom_right.row();
+
+    // Only the changed rows need new sort keys.
+    if (sortkeyfunc)
+    {
+        for (int ix = top; ix != bottom + 1; ++ix)
+        {
+            sortkeys[ix] = ProxySortKey();
+            sortkeyfunc(source, sortcolumn, ix, sortkeys[ix]);
+        }
+    }
+
     // Data change can cause words to be excluded from list, other words to be included, and
     // the rest to be sorted differently.
 
@@ -350,8 +418,6 @@ void DictionarySearchFilterProxyModel::sourceDataChanged(const QModelIndex &sour
     // [source model index, inflections] Words listed that must be updated.
     std::vector<std::pair<int, InfVector*>> toupdate;
 
-    int top = source_top_left.row();
-    int bottom = source_bottom_right.row();
     auto srcit = std::lower_bound(srclist.begin(), srclist.end(), top, [this](int src, int top) { return list[src].first < top; });
 
     // Check what to do with the changed rows and put them in the appropriate list.
@@ -455,7 +521,7 @@ void DictionarySearchFilterProxyModel::sourceDataChanged(const QModelIndex &sour
         // that the remaining values in list are correct, and they were ordered by sortfunc.
 
         std::sort(toupdate.begin(), toupdate.end(), [source, this](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) {
-            bool v = sortfunc(source, sortcolumn, a.first, b.first);
+            bool v = sortLess(source, a.first, b.first);
             if (sortorder == Qt::DescendingOrder)
                 return !v;
             return v;
@@ -464,7 +530,7 @@ void DictionarySearchFilterProxyModel::sourceDataChanged(const QModelIndex &sour
         for (int ix = 0, siz = tosigned(toupdate.size()); ix != siz; ++ix)
         {
             auto listit = std::upper_bound(list.begin(), list.end(), toupdate[ix].first, [this, source](int srcindex, const std::pair<int, InfVector*> &listitem) {
-                return sortfunc(source, sortcolumn, srcindex, listitem.first) != (sortorder == Qt::DescendingOrder);
+                return sortLess(source, srcindex, listitem.first) != (sortorder == Qt::DescendingOrder);
             });
             list.insert(listit, toupdate[ix]);
         }
@@ -513,16 +579,16 @@ void DictionarySearchFilterProxyModel::sourceDataChanged(const QModelIndex &sour
         //srclist.resize(list.size() + toadd.size());
 
         std::sort(toadd.begin(), toadd.end(), [source, this](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) {
-            return sortfunc(source, sortcolumn, a.first, b.first) != (sortorder == Qt::DescendingOrder);
+            return sortLess(source, a.first, b.first) != (sortorder == Qt::DescendingOrder);
         });
 
         auto endit = std::upper_bound(list.begin(), list.end(), toadd.back().first, [this, source](int srcindex, const std::pair<int, InfVector*> &listitem) { 
-            return sortfunc(source, sortcolumn, srcindex, listitem.first) != (sortorder == Qt::DescendingOrder);
+            return sortLess(source, srcindex, listitem.first) != (sortorder == Qt::DescendingOrder);
         });
         for (int pos = tosigned(toadd.size()) - 1, prev = pos - 1; pos != -1; --prev)
         {
             auto newendit = prev == -1 ? endit : std::upper_bound(list.begin(), endit, toadd[prev].first, [this, source](int srcindex, const std::pair<int, InfVector*> &listitem) {
-                return sortfunc(source, sortcolumn, srcindex, listitem.first) != (sortorder == Qt::DescendingOrder);
+                return sortLess(source, srcindex, listitem.first) != (sortorder == Qt::DescendingOrder);
             });
 
             if (prev == -1 || newendit != endit)
@@ -686,6 +752,21 @@ void DictionarySearchFilterProxyModel::sourceRowsInserted(const smartvector<Inte
     Dictionary *dict = source->dictionary();
     //int insertcnt = end - start + 1;
 
+    if (sortkeyfunc)
+    {
+        // Computing the sort keys of the inserted rows only. The keys of the other rows are
+        // moved to their new source model indexes.
+        int ipos = 0;
+        for (int ix = 0, siz = tosigned(intervals.size()); ix != siz; ++ix)
+        {
+            const Interval *i = intervals[ix];
+            sortkeys.insert(sortkeys.begin() + (ipos + i->index), i->count, ProxySortKey());
+            for (int iy = 0; iy != i->count; ++iy)
+                sortkeyfunc(source, sortcolumn, ipos + i->index + iy, sortkeys[ipos + i->index + iy]);
+            ipos += i->count;
+        }
+    }
+
     //qint64 startuptime = 0;
     //qint64 sorttime = 0;
     //qint64 begintime = 0;
@@ -910,7 +991,7 @@ void DictionarySearchFilterProxyModel::sourceRowsInserted(const smartvector<Inte
         return;
 
     std::sort(toadd.begin(), toadd.end(), [source, this](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) {
-        bool v = sortfunc(source, sortcolumn, a.first, b.first);
+        bool v = sortLess(source, a.first, b.first);
         if (sortorder == Qt::DescendingOrder)
             return !v;
         return v;
@@ -923,7 +1004,7 @@ void DictionarySearchFilterProxyModel::sourceRowsInserted(const smartvector<Inte
 
     // Insert position of toadd items in list.
     int insertpos = std::upper_bound(list.begin(), list.end(), toadd.back().first, [source, this](int start, const std::pair<int, InfVector*> &item) {
-        bool v = sortfunc(source, sortcolumn, start, item.first);
+        bool v = sortLess(source, start, item.first);
         if (sortorder == Qt::DescendingOrder)
             return !v;
         return v;
@@ -931,13 +1012,13 @@ void DictionarySearchFilterProxyModel::sourceRowsInserted(const smartvector<Inte
 
     for (int pos = tosigned(toadd.size()) - 1, prev = pos - 1; pos != -1; --prev)
     {
-        if (prev == -1 || (insertpos != 0 && (sortfunc(source, sortcolumn, toadd[prev].first, list[insertpos - 1].first) != (sortorder == Qt::DescendingOrder))))
+        if (prev == -1 || (insertpos != 0 && (sortLess(source, toadd[prev].first, list[insertpos - 1].first) != (sortorder == Qt::DescendingOrder))))
         {
             list.insert(list.begin() + insertpos, toadd.begin() + (prev + 1), toadd.begin() + (pos + 1));
             inserted.insert(inserted.begin(), { insertpos, pos - prev });
             if (prev != -1)
                 insertpos = std::upper_bound(list.begin(), list.begin() + insertpos, toadd[prev].first, [this, source](int start, const std::pair<int, InfVector*> &item) { 
-                return sortfunc(source, sortcolumn, start, item.first) != (sortorder == Qt::DescendingOrder);
+                return sortLess(source, start, item.first) != (sortorder == Qt::DescendingOrder);
             }) - list.begin();
             pos = prev;
         }
@@ -1149,6 +1230,12 @@ void DictionarySearchFilterProxyModel::sourceRowsRemoved(const smartvector<Range
         return;
     }
 
+    if (sortkeyfunc)
+    {
+        for (int ix = tosigned(ranges.size()) - 1; ix != -1; --ix)
+            sortkeys.erase(sortkeys.begin() + ranges[ix]->first, sortkeys.begin() + (ranges[ix]->last + 1));
+    }
+
     if (!sortfunc)
     {
         // Updating source model indexes in list, marking with -1 those that are to be removed.
@@ -1367,6 +1454,10 @@ void DictionarySearchFilterProxyModel::sourceRowsMoved(const smartvector<Range>
         return;
     }
 
+    // The sort keys follow the rows to their new source model indexes.
+    if (sortkeyfunc)
+        _moveRanges(ranges, pos, sortkeys);
+
     //pos = _fixMovePos(ranges, pos);
 
     if (!sortfunc)
@@ -1675,6 +1766,7 @@ void DictionarySearchFilterProxyModel::fillLists(DictionaryItemModel *source)
         delete p.second;
 
     sortfunc = preparedsortfunc;
+    sortkeyfunc = preparedsortkeyfunc;
     std::vector<std::pair<int, InfVector*>>().swap(list);
     int cnt = source == nullptr ? 0 : source->rowCount();
 
@@ -1782,16 +1874,45 @@ void DictionarySearchFilterProxyModel::fillLists(DictionaryItemModel *source)
     for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
         srclist[ix] = ix;
 
+    rebuildSortKeys(source);
+
     if (sortfunc)
     {
         std::sort(list.begin(), list.end(), [this, source](const std::pair<int, InfVector*> &a, const std::pair<int, InfVector*> &b) {
-            return sortfunc(source, sortcolumn, a.first, b.first) != (sortorder == Qt::DescendingOrder);
+            return sortLess(source, a.first, b.first) != (sortorder == Qt::DescendingOrder);
         });
 
         std::sort(srclist.begin(), srclist.end(), [this](int a, int b) { return list[a].first < list[b].first; });
     }
 }
 
+bool DictionarySearchFilterProxyModel::sortLess(DictionaryItemModel *source, int a, int b) const
+{
+    if (!sortkeyfunc)
+        return sortfunc(source, sortcolumn, a, b);
+
+    int r = sortkeys[a].compare(sortkeys[b]);
+    if (r != 0)
+        return r < 0;
+    return a < b;
+}
+
+void DictionarySearchFilterProxyModel::rebuildSortKeys(DictionaryItemModel *source)
+{
+    if (!sortkeyfunc || source == nullptr)
+    {
+        std::vector<ProxySortKey>().swap(sortkeys);
+        return;
+    }
+
+    // Each key is computed once here, instead of fetching the row data from the source model
+    // in every comparison while sorting.
+    int cnt = source->rowCount();
+    sortkeys.assign(cnt, ProxySortKey());
+    for (int ix = 0; ix != cnt; ++ix)
+        sortkeyfunc(source, sortcolumn, ix, sortkeys[ix]);
+}
+
 
 //-------------------------------------------------------------
 
@@ -1890,7 +2011,7 @@ QModelIndexList MultiLineDictionaryItemModel::uniqueSourceIndexes(const QModelIn
 
 QModelIndex	MultiLineDictionaryItemModel::mapFromSource(const QModelIndex &sourceIndex) const
 {
-    if (!sourceIndex.isValid() || rowcount == 0)
+    if (!sourceIndex.isValid() || list.sum() == 0)
         return QModelIndex();
 
     return createIndex(mapFromSourceRow(sourceIndex.row()), sourceIndex.column());
@@ -1898,7 +2019,7 @@ QModelIndex	MultiLineDictionaryItemModel::mapFromSource(const QModelIndex &sourc
 
 QModelIndex	MultiLineDictionaryItemModel::mapToSource(const QModelIndex &proxyIndex) const
 {
-    if (!proxyIndex.isValid() || rowcount == 0)
+    if (!proxyIndex.isValid() || list.sum() == 0)
         return QModelIndex();
 
     return sourceModel()->index(mapToSourceRow(proxyIndex.row()), proxyIndex.column());
@@ -1906,51 +2027,50 @@ QModelIndex	MultiLineDictionaryItemModel::mapToSource(const QModelIndex &proxyIn
 
 int MultiLineDictionaryItemModel::mapFromSourceRow(int sourcerow) const
 {
-    if (sourcerow < 0 || rowcount == 0)
+    if (sourcerow < 0 || list.sum() == 0)
         return -1;
 
-    return list[sourcerow];
+    return list.sumBefore(sourcerow);
 }
 
 int MultiLineDictionaryItemModel::mapToSourceRow(int proxyrow) const
 {
-    if (proxyrow < 0 || rowcount == 0)
+    if (proxyrow < 0 || list.sum() == 0)
         return -1;
 
-    // Binary search for the row value in list, or the highest value not larger than row.
-    cachePosition(proxyrow);
-
-    return cachepos;
+    // Rows past the end belong to the last item.
+    return list.find(std::min(proxyrow, list.sum() - 1));
 }
 
 int MultiLineDictionaryItemModel::mappedRowSize(int sourcerow) const
 {
 #ifdef _DEBUG
-    if (sourcerow < 0 || sourcerow >= tosigned(list.size()))
+    if (sourcerow < 0 || sourcerow >= list.size())
         throw "Source row out of range.";
 #endif
-    return (sourcerow == tosigned(list.size()) - 1 ? rowcount : list[sourcerow + 1]) - list[sourcerow];
+    return list.value(sourcerow);
 }
 
 int MultiLineDictionaryItemModel::roundRow(int proxyrow) const
 {
-    if (proxyrow == rowcount)
-        return rowcount;
+    if (proxyrow == list.sum())
+        return proxyrow;
 
     int row = mapToSourceRow(proxyrow);
 
-    // Distance from the word starting row.
-    int start = proxyrow - list[row];
-    // Distance from the starting row of the next word, or to the end of the items.
-    int end = (row < tosigned(list.size()) - 1 ? list[row + 1] : rowcount) - proxyrow;
-    if (start <= end)
-        return list[row];
-    return row < tosigned(list.size()) - 1 ? list[row + 1] : rowcount;
+    int first = list.sumBefore(row);
+    int next = first + list.value(row);
+
+    // Distance from the word starting row, and from the starting row of the next word, or
+    // to the end of the items.
+    if (proxyrow - first <= next - proxyrow)
+        return first;
+    return next;
 }
 
 int MultiLineDictionaryItemModel::rowCount(const QModelIndex &/*parent*/) const
 {
-    return rowcount;
+    return list.sum();
 }
 
 int MultiLineDictionaryItemModel::columnCount(const QModelIndex &parent) const
@@ -1963,7 +2083,7 @@ int MultiLineDictionaryItemModel::columnCount(const QModelIndex &parent) const
 
 QModelIndex MultiLineDictionaryItemModel::index(int row, int column, const QModelIndex &parent) const
 {
-    if (parent.isValid() || row < 0 || row >= rowcount)
+    if (parent.isValid() || row < 0 || row >= list.sum())
         return QModelIndex();
 
     return createIndex(row, column);
@@ -2008,71 +2128,30 @@ QMimeData* MultiLineDictionaryItemModel::mimeData(const QModelIndexList& indexes
     return sourceModel()->mimeData(uniqueSourceIndexes(indexes));
 }
 
-void MultiLineDictionaryItemModel::cachePosition(int index) const
+void MultiLineDictionaryItemModel::resetData(ZAbstractTableModel *m)
 {
-    if (cachepos >= tosigned(list.size()))
-        cachepos = tosigned(list.size()) / 2;
+    int cnt = m != nullptr ? m->rowCount() : 0;
 
-    // We were lucky and requested the same value as before.
-    if (list[cachepos] == index || (list[cachepos] < index && (cachepos == tosigned(list.size()) - 1 || list[cachepos + 1] > index)))
-        return;
+    std::vector<int> sizes;
+    sizes.reserve(cnt);
+    for (int ix = 0; ix != cnt; ++ix)
+        sizes.push_back(tosigned(m->data(m->index(ix, 0), (int)DictRowRoles::WordEntry).value<WordEntry*>()->defs.size()));
 
-    // Feeling lucky, guessing that the next or previous row is what we were looking for.
-    if (cachepos != tosigned(list.size()) - 1 && (list[cachepos + 1] == index || (list[cachepos + 1] < index && (cachepos + 1 == tosigned(list.size()) - 1 || list[cachepos + 2] > index))))
-    {
-        ++cachepos;
-        return;
-    }
-    if (cachepos != 0 && (list[cachepos - 1] == index || (list[cachepos] > index && list[cachepos - 1] < index)))
-    {
-        --cachepos;
-        return;
-    }
-
-    // Finally get the value with binary search.
-
-    int left = list[cachepos] > index ? 0 : cachepos;
-    int right = list[cachepos] > index ? cachepos : tosigned(list.size()) - 1;
-    auto it = std::upper_bound(list.begin() + left, list.begin() + (right + 1), index);
-    if (it == list.begin() + (right + 1))
-        cachepos = tosigned(list.size()) - 1;
-    else
-        cachepos = (it - list.begin()) - 1;
+    list.assign(sizes);
 }
 
-void MultiLineDictionaryItemModel::resetData(ZAbstractTableModel *m)
+int MultiLineDictionaryItemModel::sourceRowSize(int row) const
 {
-    if (m != nullptr)
-        rowcount = m->rowCount();
-    else
-        rowcount = 0;
-
-    list.clear();
-
-    if (rowcount != 0)
-    {
-        list.reserve(rowcount);
-        int prev = 0;
-        list.push_back(0);
-        for (int ix = 1; ix != rowcount; ++ix)
-        {
-            prev += tosigned(m->data(m->index(ix - 1, 0), (int)DictRowRoles::WordEntry).value<WordEntry*>()->defs.size());
-            list.push_back(prev);
-        }
-
-        cachepos = tosigned(list.size()) / 2;
-
-        rowcount = list.back() + tosigned(m->data(m->index(rowcount - 1, 0), (int)DictRowRoles::WordEntry).value<WordEntry*>()->defs.size());
-    }
+    ZAbstractTableModel *m = sourceModel();
+    return tosigned(m->data(m->index(row, 0), (int)DictRowRoles::WordEntry).value<WordEntry*>()->defs.size());
 }
 
 int MultiLineDictionaryItemModel::definitionIndex(int index) const
 {
-    if (index < 0 || index >= rowcount)
+    if (index < 0 || index >= list.sum())
         return 0;
-    cachePosition(index);
 
-    return index - list[cachepos];
+    return index - list.sumBefore(list.find(index));
 }
 
 void MultiLineDictionaryItemModel::sourceDataChanged(const QModelIndex &topLeft, const QModelIndex &bottomRight, const QVector<int> &roles)
@@ -2080,8 +2159,6 @@ void MultiLineDictionaryItemModel::sourceDataChanged(const QModelIndex &topLeft,
     if (sourceModel() == nullptr || !topLeft.isValid() || !bottomRight.isValid() || topLeft.parent().isValid() || bottomRight.parent().isValid())
         return;
 
-    QAbstractItemModel *m = sourceModel();
-
     int top = topLeft.row();
     int bottom = bottomRight.row();
     int left = topLeft.column();
@@ -2095,46 +2172,43 @@ void MultiLineDictionaryItemModel::sourceDataChanged(const QModelIndex &topLeft,
         smartvector<Range> removed;
 
         // There can be both removals and insertions. The list is first updated after removals
-        // and the remove signal is sent. The inserted list is filled but it's only signalled
-        // below.
-        int dif = 0;
-        for (int ix = top, siz = tosigned(list.size()); ix != bottom + 1; ++ix)
+        // and the remove signal is sent. The insertions are only applied and signalled after
+        // that.
+        std::vector<int> sizes;
+        sizes.reserve(bottom - top + 1);
+        for (int ix = top; ix != bottom + 1; ++ix)
         {
-            WordEntry *e = m->data(m->index(top, 0), (int)DictRowRoles::WordEntry).value<WordEntry*>();
-            int oldsiz = (ix == siz - 1 ? rowcount : list[ix + 1]) - list[ix];
-            int newsiz = tosigned(e->defs.size());
+            int oldsiz = list.value(ix);
+            int newsiz = sourceRowSize(ix);
+            sizes.push_back(newsiz);
 
-            list[ix] -= dif;
             if (newsiz < oldsiz)
             {
-                removed.push_back({ list[ix] + dif + newsiz, list[ix] + dif + oldsiz - 1 });
-                dif += oldsiz - newsiz;
+                int first = list.sumBefore(ix);
+                removed.push_back({ first + newsiz, first + oldsiz - 1 });
             }
-            if (newsiz > oldsiz)
-                inserted.push_back({ list[ix] + oldsiz, newsiz - oldsiz });
         }
-        for (int ix = bottom + 1, siz = tosigned(list.size()); ix != siz; ++ix)
-            list[ix] -= dif;
-        rowcount -= dif;
 
         if (!removed.empty())
+        {
+            for (int ix = top; ix != bottom + 1; ++ix)
+                if (sizes[ix - top] < list.value(ix))
+                    list.setValue(ix, sizes[ix - top]);
             signalRowsRemoved(removed);
+        }
 
-        if (!inserted.empty())
+        for (int ix = top; ix != bottom + 1; ++ix)
         {
-            dif = _intervalSize(inserted);
-            int inspos = tosigned(inserted.size()) - 1;
-            rowcount += dif;
-            for (int ix = tosigned(list.size()) - 1; ix != -1 && dif != 0; --ix)
-            {
-                if (list[ix] < inserted[inspos]->index)
-                {
-                    dif -= inserted[inspos]->count;
-                    --inspos;
-                }
-                list[ix] += dif;
-            }
+            int oldsiz = list.value(ix);
+            if (sizes[ix - top] > oldsiz)
+                inserted.push_back({ list.sumBefore(ix) + oldsiz, sizes[ix - top] - oldsiz });
+        }
 
+        if (!inserted.empty())
+        {
+            for (int ix = top; ix != bottom + 1; ++ix)
+                if (sizes[ix - top] > list.value(ix))
+                    list.setValue(ix, sizes[ix - top]);
             signalRowsInserted(inserted);
         }
 
@@ -2214,12 +2288,12 @@ void MultiLineDictionaryItemModel::sourceDataChanged(const QModelIndex &topLeft,
         //return;
     }
 
-    emit dataChanged(createIndex(0/*list[top]*/, left), createIndex(rowcount /*(bottom == rowcount - 1 ? rowcount : list[bottom + 1])*/ - 1, right), roles);
+    emit dataChanged(createIndex(0/*list.sumBefore(top)*/, left), createIndex(list.sum() /*list.sumBefore(bottom + 1)*/ - 1, right), roles);
 }
 
 void MultiLineDictionaryItemModel::sourceHeaderDataChanged(Qt::Orientation orientation, int first, int last)
 {
-    emit headerDataChanged(orientation, list[first], (last != tosigned(list.size()) - 1 ? list[last + 1] : rowcount) - 1);
+    emit headerDataChanged(orientation, list.sumBefore(first), list.sumBefore(last + 1) - 1);
 }
 
 //void MultiLineDictionaryItemModel::sourceRowsAboutToBeInserted(const QModelIndex &parent, int start, int end)
@@ -2233,44 +2307,31 @@ void MultiLineDictionaryItemModel::sourceRowsInserted(const smartvector<Interval
     if (intervals.empty())
         return;
 
-    int listsiz = tosigned(list.size());
-
-    // Adding fake item to make the algorithm simpler. It is removed afterwards.
-    list.push_back(rowcount);
-
     smartvector<Interval> inserted;
 
-    ZAbstractTableModel *source = sourceModel();
-
-    int dif = 0;
+    // Number of source items and rows inserted before the current interval.
     int idif = 0;
+    int dif = 0;
     for (int ix = 0, siz = tosigned(intervals.size()); ix != siz; ++ix)
     {
         const Interval *i = intervals[ix];
+        int pos = i->index + idif;
 
-        inserted.push_back({ i->index == listsiz ? rowcount : (list[i->index + idif] - dif), 0 });
+        // The inserted intervals are at their position before the insertion.
+        inserted.push_back({ list.sumBefore(pos) - dif, 0 });
 
         for (int iy = 0; iy != i->count; ++iy)
         {
-            WordEntry *e = source->data(source->index(i->index + idif + iy, 0), (int)DictRowRoles::WordEntry).value<WordEntry*>();
-            int cnt = tosigned(e->defs.size());
+            int cnt = sourceRowSize(pos + iy);
+            list.insert(pos + iy, cnt);
 
             inserted.back()->count += cnt;
-            list.insert(list.begin() + (i->index + idif + iy + 1), list[i->index + idif + iy] + cnt);
-
             dif += cnt;
         }
 
         idif += i->count;
-
-        int next = ix == siz - 1 ? tosigned(list.size()) : (intervals[ix + 1]->index + idif + 1);
-        for (int iy = i->index + idif + 1; iy != next; ++iy)
-            list[iy] += dif;
     }
 
-    rowcount += dif;
-    list.pop_back();
-
     if (!inserted.empty())
         signalRowsInserted(inserted);
     emit selectionWasInserted(intervals);
@@ -2335,40 +2396,12 @@ void MultiLineDictionaryItemModel::sourceRowsRemoved(const smartvector<Range> &r
         return;
 
     smartvector<Range> removed;
+    for (const Range *r : ranges)
+        removed.push_back({ list.sumBefore(r->first), list.sumBefore(r->last + 1) - 1 });
 
-    int rnextpos = 1;
-    const Range *r = ranges.front();
-    const Range *rnext = ranges.size() == 1 ? nullptr : ranges[1];
-
-    int f = list[r->first];
-    int l = (r->last + 1 < tosigned(list.size()) ? list[r->last + 1] : rowcount) - 1;
-    removed.push_back({ list[r->first], (r->last + 1 < tosigned(list.size()) ? list[r->last + 1] : rowcount) - 1 });
-
-    int cnt = l - f + 1;
-
-    for (int ix = r->first, siz = tosigned(list.size()); ix != siz; ++ix)
-    {
-        if (rnext && ix == rnext->first)
-        {
-            r = rnext;
-
-            f = list[r->first];
-            l = (r->last + 1 < tosigned(list.size()) ? list[r->last + 1] : rowcount) - 1;
-            removed.push_back({ f, l });
-
-            cnt += l - f + 1;
-            ++rnextpos;
-            rnext = tosigned(ranges.size()) <= rnextpos ? nullptr : ranges[rnextpos];
-        }
-        if (r != nullptr && ix <= r->last)
-            list[ix] = -1;
-        else
-            list[ix] -= cnt;
-        continue;
-    }
-
-    list.resize(std::remove(list.begin(), list.end(), -1) - list.begin());
-    rowcount -= cnt;
+    // Erasing from the back keeps the positions of the earlier ranges valid.
+    for (int ix = tosigned(ranges.size()) - 1; ix != -1; --ix)
+        list.erase(ranges[ix]->first, ranges[ix]->last - ranges[ix]->first + 1);
 
     if (!removed.empty())
         signalRowsRemoved(removed);
@@ -2415,28 +2448,20 @@ void MultiLineDictionaryItemModel::sourceRowsMoved(const smartvector<Range> &ran
         return;
 
     smartvector<Range> moved;
-    int movepos = pos >= tosigned(list.size()) ? rowcount : list[pos];
+    int movepos = list.sumBefore(std::min(pos, list.size()));
 
     for (int ix = 0, siz = tosigned(ranges.size()); ix != siz; ++ix)
     {
         const Range *r = ranges[ix];
-        moved.push_back({ list[r->first], (r->last + 1 == tosigned(list.size()) ? rowcount : list[r->last + 1]) - 1 });
+        moved.push_back({ list.sumBefore(r->first), list.sumBefore(r->last + 1) - 1 });
     }
 
-    // Convert list to hold the number of definitions of each source row temporarily.
-    for (int ix = 0, siz = tosigned(list.size()); ix != siz; ++ix)
-        list[ix] = (ix == siz - 1 ? rowcount : list[ix + 1]) - list[ix];
-
-    _moveRanges(ranges, pos, list);
-
-    // Restore list after the move.
-    int prev = 0;
-    std::swap(prev, list[0]);
-    for (int ix = 1, siz = tosigned(list.size()); ix != siz; ++ix)
-    {
-        std::swap(prev, list[ix]);
-        list[ix] += list[ix - 1];
-    }
+    // The number of definitions of each source row are moved, and the list is rebuilt from
+    // them.
+    std::vector<int> sizes;
+    list.values(sizes);
+    _moveRanges(ranges, pos, sizes);
+    list.assign(sizes);
 
     if (!moved.empty())
         signalRowsMoved(moved, movepos);
@@ -2520,7 +2545,7 @@ void MultiLineDictionaryItemModel::sourceLayoutChanged(const QList<QPersistentMo
     {
         QModelIndex dest;
         // mapFromSourceRow(sourceIndex.row()), sourceIndex.column()
-        if (ind.first.isValid() && rowcount != 0)
+        if (ind.first.isValid() && list.sum() != 0)
             dest = createIndex(mapFromSourceRow(ind.first.row()) + ind.second, ind.first.column());
         destindexes.push_back(dest);
     }
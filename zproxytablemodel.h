@@ -11,8 +11,11 @@
 #include <memory>
 #include "zabstracttablemodel.h"
 #include "smartvector.h"
+#include "prefixsumlist.h"
 
 class QModelIndex;
+class QDate;
+class QDateTime;
 enum class InfTypes;
 enum class SearchMode : uchar;
 enum class SearchWildcard : uchar;
@@ -28,6 +31,31 @@ struct Range;
 // no further conversion needed.
 typedef std::function<bool(DictionaryItemModel*, int, /*Qt::SortOrder,*/ int, int)> ProxySortFunction;
 
+// Comparable sort key of a source model row, computed once for every row instead of calling
+// a ProxySortFunction for each comparison while sorting. Keys are ordered by text first,
+// then by the values in nums in order. Rows with equal keys are ordered by their position
+// in the source model. Unused values should be left empty.
+struct ProxySortKey
+{
+    QString text;
+    qint64 nums[8];
+
+    ProxySortKey();
+
+    // Returns a negative value if this key comes before other, a positive value if after,
+    // and 0 if they are equal.
+    int compare(const ProxySortKey &other) const;
+
+    // Conversions of values to numbers with the same ordering. Invalid dates come first.
+    static qint64 fromFloat(float val);
+    static qint64 fromDate(const QDate &val);
+    static qint64 fromDateTime(const QDateTime &val);
+};
+
+// (Model, Column index, row, key) - The row is for the source model before filtering. The
+// function should fill key with the values that the row is sorted by in the column.
+typedef std::function<void(DictionaryItemModel*, int, int, ProxySortKey&)> ProxySortKeyFunction;
+
 // Model to filter a DictionaryItemModel. Don't set any other model type as the source.
 // Does similar filtering to DictionarySearchResultItemModel. But while that works on the
 // dictionary itself, this model filters other models. Don't pass a model of type
@@ -50,12 +78,15 @@ public:
     // Sorts the source model by the given parameters using the passed function. Changing the
     // source model disables sorting and the function must be called again. Keeps the model
     // sorted when the source model rows change.
-    void sortBy(int column, Qt::SortOrder order, ProxySortFunction func);
+    // If keyfunc is set, it's used to compute the sort key of each source row once, and the
+    // rows are sorted by comparing the keys. The keys must give the same ordering as func.
+    // Only the keys of rows that changed in the source model are computed again.
+    void sortBy(int column, Qt::SortOrder order, ProxySortFunction func, ProxySortKeyFunction keyfunc = nullptr);
 
     // Sets the sort function without sorting the model. The next time the whole source model
     // is reset, this function will be used. In case sortBy is called first, this function
     // will be ignored.
-    void prepareSortFunction(ProxySortFunction func);
+    void prepareSortFunction(ProxySortFunction func, ProxySortKeyFunction keyfunc = nullptr);
 
     DictionaryItemModel* sourceModel();
     const DictionaryItemModel* sourceModel() const;
@@ -110,6 +141,14 @@ private:
     // sourceModel() or the model which is about to be set as sourceModel().
     void fillLists(DictionaryItemModel *model);
 
+    // Returns whether the source model row a is in front of row b when sorting with the
+    // current sort function, without taking the sort order into account.
+    bool sortLess(DictionaryItemModel *source, int a, int b) const;
+
+    // Computes the sort key of every row in the source model. Call when a key function is
+    // set and the whole list is sorted again.
+    void rebuildSortKeys(DictionaryItemModel *source);
+
     // [Source model index, Inflection types] Mapping from this model to the source model. The list
     // may be sorted by a sorting function.
     std::vector<std::pair<int, InfVector*>> list;
@@ -137,6 +176,16 @@ private:
     // not filter the whole source again won't use this function.
     ProxySortFunction preparedsortfunc;
 
+    // Function computing the sort keys of source rows. Only used together with sortfunc.
+    ProxySortKeyFunction sortkeyfunc;
+    // Key function to be used the next time the source model is reset, with
+    // preparedsortfunc.
+    ProxySortKeyFunction preparedsortkeyfunc;
+
+    // [source model index] Sort key of every row in the source model while sortkeyfunc is
+    // set. Empty otherwise.
+    std::vector<ProxySortKey> sortkeys;
+
     QModelIndexList persistentsource;
     std::vector<QPersistentModelIndex> persistentdest;
 
@@ -197,16 +246,12 @@ public:
     // the call to the underlying source model. Make sure the passed indexes are sorted.
     virtual QMimeData* mimeData(const QModelIndexList& indexes) const override;
 private:
-    // Searches the list for a matching value and sets cachepos to it. The position set should
-    // match the requirement:
-    // list[cachepos] <= index and list[cachepos + 1] > index (unless cachepos is at the end
-    // of the list.)
-    void cachePosition(int index) const;
-
-    // Builds the mapping of this table to model, filling list and rowcount with the correct
-    // values.
+    // Builds the mapping of this table to model, filling list with the correct values.
     void resetData(ZAbstractTableModel *model);
 
+    // Returns the number of definitions of the word at row in the source model.
+    int sourceRowSize(int row) const;
+
     // Returns the index of the displayed word definition at the given index. This index is 0
     // based.
     int definitionIndex(int index) const;
@@ -230,16 +275,10 @@ private:
     void sourceModelAboutToBeReset();
     void sourceModelReset();
 
-    // Contains the first row index of each source item in this model. A source item takes up
-    // as many rows as its definition count, so multiple row indexes refer to the same item.
-    std::vector<int> list;
-
-    // The sum of the count of all rows displayed in the model.
-    int rowcount;
-
-    // Cached position in list of the last requested row for fast lookup. Doesn't change the
-    // perceivable inner change of the model. If invalid, it's recomputed.
-    mutable int cachepos;
+    // Number of rows taken up by each source item in this model. A source item takes up as
+    // many rows as its definition count, so multiple row indexes refer to the same item. The
+    // first row of an item is the sum of the rows before it.
+    PrefixSumList list;
 
     // Persistent indexes saved at the beginning of a layout change to be passed to
     // changePersistentIndexList() as first parameter.
@@ -7,6 +7,7 @@
 #include <QMimeData>
 #include <memory>
 #include "zstudylistmodel.h"
+#include "zproxytablemodel.h"
 #include "zkanjimain.h"
 #include "worddeck.h"
 #include "wordtodeckform.h"
@@ -517,6 +518,134 @@ bool StudyListModel::sortOrder(int column, int rowa, int rowb)
     return false;
 }
 
+void StudyListModel::sortKey(int column, int row, ProxySortKey &key)
+{
+    // Rows with equal keys are ordered by their row, which is the same order as the items
+    // in the deck for the queued and studied items.
+    row = list[row];
+
+    int type = headerData(column, Qt::Horizontal, (int)DictColumnRoles::Type).toInt();
+
+    if (mode == DeckItemViewModes::Queued)
+    {
+        FreeWordDeckItem *item = deck->queuedItems(row);
+        switch (type)
+        {
+        case (int)DeckColumnTypes::AddedDate:
+            key.nums[0] = ProxySortKey::fromDateTime(item->added);
+            break;
+        case (int)DeckColumnTypes::Priority:
+            // Higher priority comes first.
+            key.nums[0] = -(qint64)item->priority;
+            break;
+        case (int)DeckColumnTypes::StudiedPart:
+            key.nums[0] = (uchar)item->questiontype;
+            key.nums[1] = (uchar)item->mainhint;
+            break;
+        case (int)DictColumnTypes::Kanji:
+            key.text = dictionary()->wordEntry(item->data->index)->kanji.toQString();
+            break;
+        case (int)DictColumnTypes::Kana:
+            key.text = dictionary()->wordEntry(item->data->index)->kana.toQString();
+            break;
+        }
+    }
+    else if (mode == DeckItemViewModes::Studied)
+    {
+        LockedWordDeckItem *item = deck->studiedItems(row);
+        StudyDeck *study = deck->getStudyDeck();
+
+        // Position in key.nums of the next value, when the columns are compared by multiple
+        // values.
+        int pos = 0;
+        switch (type)
+        {
+        case (int)DeckColumnTypes::AddedDate:
+            key.nums[0] = ProxySortKey::fromDateTime(item->added);
+            break;
+        case (int)DeckColumnTypes::Level:
+            key.nums[pos++] = study->cardLevel(item->cardid);
+            // To the next case:
+        case (int)DeckColumnTypes::Tries:
+            key.nums[pos++] = study->cardInclusion(item->cardid);
+            // To the next case:
+        case (int)DeckColumnTypes::FirstDate:
+            key.nums[pos++] = ProxySortKey::fromDate(study->cardFirstStatDate(item->cardid));
+            // To the next case:
+        case (int)DeckColumnTypes::LastDate:
+            key.nums[pos++] = ProxySortKey::fromDateTime(study->cardTestDate(item->cardid));
+            // To the next case:
+        case (int)DeckColumnTypes::NextDate:
+            key.nums[pos++] = ProxySortKey::fromDateTime(study->cardNextTestDate(item->cardid));
+            // To the next case:
+        case (int)DeckColumnTypes::Interval:
+            key.nums[pos++] = study->cardSpacing(item->cardid);
+            break;
+        case (int)DeckColumnTypes::Multiplier:
+            key.nums[0] = ProxySortKey::fromFloat(study->cardMultiplier(item->cardid));
+            break;
+        case (int)DeckColumnTypes::StudiedPart:
+            key.nums[0] = (uchar)item->questiontype;
+            break;
+        case (int)DictColumnTypes::Kanji:
+            key.text = dictionary()->wordEntry(item->data->index)->kanji.toQString();
+            break;
+        case (int)DictColumnTypes::Kana:
+            key.text = dictionary()->wordEntry(item->data->index)->kana.toQString();
+            break;
+        }
+    }
+    else if (mode == DeckItemViewModes::Tested)
+    {
+        LockedWordDeckItem *item = deck->studiedItems(row);
+        StudyDeck *study = deck->getStudyDeck();
+
+        int pos = 0;
+        switch (type)
+        {
+        case (int)DeckColumnTypes::AddedDate:
+            key.nums[0] = ProxySortKey::fromDateTime(item->added);
+            break;
+        case (int)DeckColumnTypes::OldLevel:
+            key.nums[pos++] = study->cardLevelOld(item->cardid);
+            // To the next case:
+        case (int)DeckColumnTypes::Level:
+            key.nums[pos++] = study->cardLevel(item->cardid);
+            // To the next case:
+        case (int)DeckColumnTypes::RetryCount:
+            key.nums[pos++] = study->cardTries(item->cardid)[0];
+            // To the next case:
+        case (int)DeckColumnTypes::WrongCount:
+            key.nums[pos++] = study->cardTries(item->cardid)[2];
+            // To the next case:
+        case (int)DeckColumnTypes::EasyCount:
+            key.nums[pos++] = study->cardTries(item->cardid)[3];
+            // To the next case:
+        case (int)DeckColumnTypes::NextDate:
+            key.nums[pos++] = ProxySortKey::fromDateTime(study->cardNextTestDate(item->cardid));
+            // To the next case:
+        case (int)DeckColumnTypes::Interval:
+            key.nums[pos++] = study->cardSpacing(item->cardid);
+            break;
+        case (int)DeckColumnTypes::OldMultiplier:
+            key.nums[0] = ProxySortKey::fromFloat(study->cardMultiplierOld(item->cardid));
+            break;
+        case (int)DeckColumnTypes::Multiplier:
+            key.nums[0] = ProxySortKey::fromFloat(study->cardMultiplier(item->cardid));
+            break;
+        case (int)DeckColumnTypes::StudiedPart:
+            key.nums[0] = (uchar)item->questiontype;
+            break;
+        case (int)DictColumnTypes::Kanji:
+            key.text = dictionary()->wordEntry(item->data->index)->kanji.toQString();
+            break;
+        case (int)DictColumnTypes::Kana:
+            key.text = dictionary()->wordEntry(item->data->index)->kana.toQString();
+            break;
+        }
+    }
+}
+
 void StudyListModel::setShownParts(bool showkanji, bool showkana, bool showdefinition)
 {
     if (kanjion == showkanji && kanaon == showkana && defon == showdefinition)
@@ -12,6 +12,7 @@
 
 class WordDeck;
 struct WordDeckItem;
+struct ProxySortKey;
 
 enum class StatusTypes;
 
@@ -85,6 +86,9 @@ public:
     // Returns whether "row a" is in front of "row b" when sorting by the passed column and
     // with the given sort order.
     bool sortOrder(int column, int rowa, int rowb);
+    // Fills key with the values of row that give the same ordering as sortOrder() when
+    // sorting by the passed column.
+    void sortKey(int column, int row, ProxySortKey &key);
 
     void setShownParts(bool showkanji, bool showkana, bool showdefinition);
 